@@ -0,0 +1,128 @@
+// AtlasPacker.cpp
+
+#include "AtlasPacker.h"
+
+AtlasPacker::AtlasPacker(unsigned int width, unsigned int height)
+: m_width(width)
+, m_height(height)
+, m_usedArea(0)
+, m_skyline()
+{
+    Reset();
+}
+
+/// Empty the page.
+void AtlasPacker::Reset()
+{
+    m_usedArea = 0;
+    m_skyline.clear();
+    const Segment ground = { 0, 0, m_width };
+    m_skyline.push_back(ground);
+}
+
+///@return Fraction of the page covered by inserted rectangles
+float AtlasPacker::GetOccupancy() const
+{
+    const unsigned long area = static_cast<unsigned long>(m_width) * m_height;
+    if (area == 0)
+        return 0.f;
+    return static_cast<float>(m_usedArea) / static_cast<float>(area);
+}
+
+///@brief Find a place for a rectangle and mark it used.
+///@param x, y [out] Corner of the placed rectangle
+///@return false if the page has no room left for it
+bool AtlasPacker::Insert(unsigned int width, unsigned int height, unsigned int& x, unsigned int& y)
+{
+    if ((width == 0) || (height == 0))
+        return false;
+
+    // Lowest resulting top edge wins; on a tie, the narrowest segment wastes least.
+    size_t bestIndex = m_skyline.size();
+    unsigned int bestTop = 0;
+    unsigned int bestWidth = 0;
+    for (size_t i = 0; i < m_skyline.size(); ++i)
+    {
+        unsigned int fitY = 0;
+        if (!_Fit(i, width, height, fitY))
+            continue;
+        const unsigned int top = fitY + height;
+        if ((bestIndex == m_skyline.size()) ||
+            (top < bestTop) ||
+            ((top == bestTop) && (m_skyline[i].width < bestWidth)))
+        {
+            bestIndex = i;
+            bestTop = top;
+            bestWidth = m_skyline[i].width;
+            y = fitY;
+        }
+    }
+    if (bestIndex == m_skyline.size())
+        return false;
+
+    x = m_skyline[bestIndex].x;
+    _AddSegment(bestIndex, x, y, width, height);
+    m_usedArea += static_cast<unsigned long>(width) * height;
+    return true;
+}
+
+///@brief Check whether a rectangle fits with its left edge at the start of a segment.
+///@param y [out] Lowest height it can sit at there, resting on the highest segment below it
+bool AtlasPacker::_Fit(size_t index, unsigned int width, unsigned int height, unsigned int& y) const
+{
+    if (m_skyline[index].x + width > m_width)
+        return false;
+
+    y = 0;
+    unsigned int widthLeft = width;
+    for (size_t i = index; i < m_skyline.size(); ++i)
+    {
+        if (m_skyline[i].y > y)
+            y = m_skyline[i].y;
+        if (y + height > m_height)
+            return false;
+        if (m_skyline[i].width >= widthLeft)
+            return true;
+        widthLeft -= m_skyline[i].width;
+    }
+    return false;
+}
+
+/// Raise the skyline over a newly placed rectangle, trimming the segments it covers.
+void AtlasPacker::_AddSegment(size_t index, unsigned int x, unsigned int y, unsigned int width, unsigned int height)
+{
+    const Segment top = { x, y + height, width };
+    m_skyline.insert(m_skyline.begin() + index, top);
+
+    const unsigned int right = x + width;
+    size_t i = index + 1;
+    while (i < m_skyline.size())
+    {
+        Segment& seg = m_skyline[i];
+        if (seg.x >= right)
+            break;
+        const unsigned int covered = right - seg.x;
+        if (seg.width <= covered)
+        {
+            m_skyline.erase(m_skyline.begin() + i);
+            continue;
+        }
+        seg.x += covered;
+        seg.width -= covered;
+        break;
+    }
+
+    // Neighbours at the same height become one segment.
+    for (i = 0; i + 1 < m_skyline.size(); )
+    {
+        if (m_skyline[i].y == m_skyline[i + 1].y)
+        {
+            m_skyline[i].width += m_skyline[i + 1].width;
+            m_skyline.erase(m_skyline.begin() + i + 1);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
@@ -0,0 +1,42 @@
+// AtlasPacker.h
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+///@brief Places rectangles in a fixed size page with the skyline bottom-left
+/// heuristic. The top edge of everything placed so far is kept as a list of
+/// horizontal segments; each new rectangle goes where its top ends lowest.
+/// Rectangles can be inserted one at a time as they arrive. Touches no GL state.
+class AtlasPacker
+{
+public:
+    AtlasPacker(unsigned int width, unsigned int height);
+    virtual ~AtlasPacker() {}
+
+    bool Insert(unsigned int width, unsigned int height, unsigned int& x, unsigned int& y);
+    void Reset();
+
+    /// const Accessors
+    unsigned int GetWidth() const { return m_width; }
+    unsigned int GetHeight() const { return m_height; }
+    unsigned long GetUsedArea() const { return m_usedArea; }
+    float GetOccupancy() const;
+
+protected:
+    struct Segment
+    {
+        unsigned int x;
+        unsigned int y;     ///< Height of the skyline over this segment
+        unsigned int width;
+    };
+
+    bool _Fit(size_t index, unsigned int width, unsigned int height, unsigned int& y) const;
+    void _AddSegment(size_t index, unsigned int x, unsigned int y, unsigned int width, unsigned int height);
+
+    unsigned int          m_width;
+    unsigned int          m_height;
+    unsigned long         m_usedArea;
+    std::vector<Segment>  m_skyline; ///< Sorted by x, covering the whole width
+};
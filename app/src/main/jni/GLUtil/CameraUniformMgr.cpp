@@ -0,0 +1,68 @@
+// CameraUniformMgr.cpp
+
+#include "CameraUniformMgr.h"
+#include "GLStateMgr.h"
+#include "MatrixMath.h"
+
+#include <string.h>
+
+const GLuint CameraUniformMgr::BlockBinding;
+
+CameraUniformMgr::CameraUniformMgr()
+: m_ubo(0)
+{
+    MakeIdentityMatrix(m_data.viewmtx);
+    MakeIdentityMatrix(m_data.prmtx);
+    memset(m_data.cameraTime, 0, sizeof(m_data.cameraTime));
+}
+
+///@brief Point program's CameraBlock, if it declares one, at the reserved binding.
+///@return true if the program uses the block
+bool CameraUniformMgr::BindProgram(GLuint program)
+{
+    if (program == 0)
+        return false;
+    const GLuint blockIndex = glGetUniformBlockIndex(program, "CameraBlock");
+    if (blockIndex == GL_INVALID_INDEX)
+        return false;
+    glUniformBlockBinding(program, blockIndex, BlockBinding);
+    return true;
+}
+
+void CameraUniformMgr::Destroy()
+{
+    if (m_ubo != 0)
+    {
+        GLStateMgr::Instance().DeleteBuffer(m_ubo);
+        m_ubo = 0;
+    }
+}
+
+///@brief Set the time for the next Update.
+void CameraUniformMgr::SetTime(double absT, double dt)
+{
+    m_data.cameraTime[0] = static_cast<float>(absT);
+    m_data.cameraTime[1] = static_cast<float>(dt);
+}
+
+///@brief Upload the frame's camera data and bind the buffer. Call once per frame
+/// before drawing; the buffer is created on first use.
+void CameraUniformMgr::Update(const float* pViewMtx, const float* pProjMtx)
+{
+    memcpy(m_data.viewmtx, pViewMtx, sizeof(m_data.viewmtx));
+    memcpy(m_data.prmtx, pProjMtx, sizeof(m_data.prmtx));
+
+    // Binding to the block's index also binds the generic point we upload through.
+    GLStateMgr& state = GLStateMgr::Instance();
+    if (m_ubo == 0)
+    {
+        glGenBuffers(1, &m_ubo);
+        state.BindBufferBase(GL_UNIFORM_BUFFER, BlockBinding, m_ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlockData), &m_data, GL_DYNAMIC_DRAW);
+    }
+    else
+    {
+        state.BindBufferBase(GL_UNIFORM_BUFFER, BlockBinding, m_ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlockData), &m_data);
+    }
+}
@@ -0,0 +1,50 @@
+// CameraUniformMgr.h
+
+#pragma once
+
+#include "Singleton.h"
+#include "GL_Includes.h"
+
+///@brief Per-frame camera data in std140 layout, matching CameraBlock in
+/// shaders/camerablock.glsl.
+struct CameraBlockData
+{
+    float viewmtx[16];
+    float prmtx[16];
+    float cameraTime[4]; ///< x: absolute time in seconds, y: timestep
+};
+
+///@brief Owns the uniform buffer holding camera matrices and time for the frame.
+/// It is filled and bound once per frame to a reserved binding point, and every
+/// program declaring CameraBlock reads it from there, so camera data need not be
+/// uploaded again after each glUseProgram.
+///@warning Do not attempt to access this object outside of the GL thread!
+class CameraUniformMgr : public Singleton
+{
+public:
+    static CameraUniformMgr& Instance()
+    {
+        static CameraUniformMgr instance;
+        return instance;
+    }
+
+    static const GLuint BlockBinding = 0; ///< Reserved for CameraBlock; other blocks must not use it
+    static bool BindProgram(GLuint program);
+
+    void Destroy();
+    void SetTime(double absT, double dt);
+    void Update(const float* pViewMtx, const float* pProjMtx);
+
+    /// const Accessors
+    const CameraBlockData& GetData() const { return m_data; }
+
+protected:
+    GLuint           m_ubo;
+    CameraBlockData  m_data;
+
+private:
+    CameraUniformMgr();
+    ~CameraUniformMgr() {} /// Destroy() should be called before the context is torn down.
+    CameraUniformMgr(CameraUniformMgr const& copy);            // Not Implemented
+    CameraUniformMgr& operator=(CameraUniformMgr const& copy); // Not Implemented
+};
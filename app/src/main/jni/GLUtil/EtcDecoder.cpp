@@ -0,0 +1,367 @@
+// EtcDecoder.cpp
+// Block layouts follow the ETC2/EAC compressed texture image formats in
+// appendix C of the OpenGL ES 3.0 specification.
+
+#include "EtcDecoder.h"
+#include "KtxFile.h"
+
+static const int s_etcModifiers[8][2] = {
+    {  2,   8 }, {  5,  17 }, {  9,  29 }, { 13,  42 },
+    { 18,  60 }, { 24,  80 }, { 33, 106 }, { 47, 183 }
+};
+
+static const int s_etcDistances[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+
+static const int s_eacModifiers[16][8] = {
+    { -3, -6,  -9, -15, 2, 5, 8, 14 },
+    { -3, -7, -10, -13, 2, 6, 9, 12 },
+    { -2, -5,  -8, -13, 1, 4, 7, 12 },
+    { -2, -4,  -6, -13, 1, 3, 5, 12 },
+    { -3, -6,  -8, -12, 2, 5, 7, 11 },
+    { -3, -7,  -9, -11, 2, 6, 8, 10 },
+    { -4, -7,  -8, -11, 3, 6, 7, 10 },
+    { -3, -5,  -8, -11, 2, 4, 7, 10 },
+    { -2, -6,  -8, -10, 1, 5, 7,  9 },
+    { -2, -5,  -8, -10, 1, 4, 7,  9 },
+    { -2, -4,  -8, -10, 1, 3, 7,  9 },
+    { -2, -5,  -7, -10, 1, 4, 6,  9 },
+    { -3, -4,  -7, -10, 2, 3, 6,  9 },
+    { -1, -2,  -3, -10, 0, 1, 2,  9 },
+    { -4, -6,  -8,  -9, 3, 5, 7,  8 },
+    { -3, -5,  -7,  -9, 2, 4, 6,  8 }
+};
+
+static int clampInt(int v, int lo, int hi)
+{
+    return (v < lo) ? lo : ((v > hi) ? hi : v);
+}
+
+static unsigned int bits(unsigned long long word, int high, int low)
+{
+    return static_cast<unsigned int>((word >> low) & ((1ull << (high - low + 1)) - 1));
+}
+
+static unsigned long long readBlock(const unsigned char* p)
+{
+    unsigned long long word = 0;
+    for (int i=0; i<8; ++i)
+        word = (word << 8) | p[i];
+    return word;
+}
+
+static int extend4(unsigned int v) { return static_cast<int>((v << 4) | v); }
+static int extend5(unsigned int v) { return static_cast<int>((v << 3) | (v >> 2)); }
+static int extend6(unsigned int v) { return static_cast<int>((v << 2) | (v >> 4)); }
+static int extend7(unsigned int v) { return static_cast<int>((v << 1) | (v >> 6)); }
+
+static int signExtend3(unsigned int v)
+{
+    return (v & 4) ? static_cast<int>(v) - 8 : static_cast<int>(v);
+}
+
+///@brief Decode one ETC1/ETC2 color block into 16 RGBA pixels, indexed [y*4+x].
+///@param punchthrough true for the RGB8_PUNCHTHROUGH_ALPHA1 formats
+static void decodeEtcColorBlock(const unsigned char* pBlock, bool punchthrough, unsigned char out[16][4])
+{
+    const unsigned long long word = readBlock(pBlock);
+    const bool diffBit = bits(word, 33, 33) != 0;
+    const bool flip = bits(word, 32, 32) != 0;
+    const bool differential = punchthrough || diffBit;
+    const bool opaque = !punchthrough || diffBit;
+
+    int paint[4][3];
+    bool paintMode = false;
+    int base[2][3];
+
+    if (!differential)
+    {
+        for (int c=0; c<3; ++c)
+        {
+            base[0][c] = extend4(bits(word, 63 - 8*c, 60 - 8*c));
+            base[1][c] = extend4(bits(word, 59 - 8*c, 56 - 8*c));
+        }
+    }
+    else
+    {
+        const unsigned int r = bits(word, 63, 59);
+        const unsigned int g = bits(word, 55, 51);
+        const unsigned int b = bits(word, 47, 43);
+        const int r2 = static_cast<int>(r) + signExtend3(bits(word, 58, 56));
+        const int g2 = static_cast<int>(g) + signExtend3(bits(word, 50, 48));
+        const int b2 = static_cast<int>(b) + signExtend3(bits(word, 42, 40));
+
+        if ((r2 < 0) || (r2 > 31))
+        {
+            // T mode
+            int c1[3], c2[3];
+            c1[0] = extend4((bits(word, 60, 59) << 2) | bits(word, 57, 56));
+            c1[1] = extend4(bits(word, 55, 52));
+            c1[2] = extend4(bits(word, 51, 48));
+            c2[0] = extend4(bits(word, 47, 44));
+            c2[1] = extend4(bits(word, 43, 40));
+            c2[2] = extend4(bits(word, 39, 36));
+            const int d = s_etcDistances[(bits(word, 35, 34) << 1) | bits(word, 32, 32)];
+            for (int c=0; c<3; ++c)
+            {
+                paint[0][c] = c1[c];
+                paint[1][c] = clampInt(c2[c] + d, 0, 255);
+                paint[2][c] = c2[c];
+                paint[3][c] = clampInt(c2[c] - d, 0, 255);
+            }
+            paintMode = true;
+        }
+        else if ((g2 < 0) || (g2 > 31))
+        {
+            // H mode
+            const unsigned int r1 = bits(word, 62, 59);
+            const unsigned int g1 = (bits(word, 58, 56) << 1) | bits(word, 52, 52);
+            const unsigned int b1 = (bits(word, 51, 51) << 3) | bits(word, 49, 47);
+            const unsigned int r2h = bits(word, 46, 43);
+            const unsigned int g2h = bits(word, 42, 39);
+            const unsigned int b2h = bits(word, 38, 35);
+            const unsigned int v1 = (r1 << 8) | (g1 << 4) | b1;
+            const unsigned int v2 = (r2h << 8) | (g2h << 4) | b2h;
+            const unsigned int di = (bits(word, 34, 34) << 2) | (bits(word, 32, 32) << 1) | ((v1 >= v2) ? 1 : 0);
+            const int d = s_etcDistances[di];
+            const int c1[3] = { extend4(r1), extend4(g1), extend4(b1) };
+            const int c2[3] = { extend4(r2h), extend4(g2h), extend4(b2h) };
+            for (int c=0; c<3; ++c)
+            {
+                paint[0][c] = clampInt(c1[c] + d, 0, 255);
+                paint[1][c] = clampInt(c1[c] - d, 0, 255);
+                paint[2][c] = clampInt(c2[c] + d, 0, 255);
+                paint[3][c] = clampInt(c2[c] - d, 0, 255);
+            }
+            paintMode = true;
+        }
+        else if ((b2 < 0) || (b2 > 31))
+        {
+            // Planar mode; always opaque
+            const int o[3] = {
+                extend6(bits(word, 62, 57)),
+                extend7((bits(word, 56, 56) << 6) | bits(word, 54, 49)),
+                extend6((bits(word, 48, 48) << 5) | (bits(word, 44, 43) << 3) | bits(word, 41, 39)) };
+            const int h[3] = {
+                extend6((bits(word, 38, 34) << 1) | bits(word, 32, 32)),
+                extend7(bits(word, 31, 25)),
+                extend6(bits(word, 24, 19)) };
+            const int v[3] = {
+                extend6(bits(word, 18, 13)),
+                extend7(bits(word, 12, 6)),
+                extend6(bits(word, 5, 0)) };
+            for (int y=0; y<4; ++y)
+            {
+                for (int x=0; x<4; ++x)
+                {
+                    for (int c=0; c<3; ++c)
+                    {
+                        const int value = (x * (h[c] - o[c]) + y * (v[c] - o[c]) + 4 * o[c] + 2) >> 2;
+                        out[y*4 + x][c] = static_cast<unsigned char>(clampInt(value, 0, 255));
+                    }
+                    out[y*4 + x][3] = 255;
+                }
+            }
+            return;
+        }
+        else
+        {
+            base[0][0] = extend5(r);
+            base[0][1] = extend5(g);
+            base[0][2] = extend5(b);
+            base[1][0] = extend5(static_cast<unsigned int>(r2));
+            base[1][1] = extend5(static_cast<unsigned int>(g2));
+            base[1][2] = extend5(static_cast<unsigned int>(b2));
+        }
+    }
+
+    const unsigned int table[2] = { bits(word, 39, 37), bits(word, 36, 34) };
+    for (int x=0; x<4; ++x)
+    {
+        for (int y=0; y<4; ++y)
+        {
+            const int j = x*4 + y;
+            const unsigned int index = (bits(word, j + 16, j + 16) << 1) | bits(word, j, j);
+            unsigned char* pOut = out[y*4 + x];
+            pOut[3] = 255;
+
+            if (!opaque && (index == 2))
+            {
+                pOut[0] = pOut[1] = pOut[2] = pOut[3] = 0;
+                continue;
+            }
+            if (paintMode)
+            {
+                for (int c=0; c<3; ++c)
+                    pOut[c] = static_cast<unsigned char>(paint[index][c]);
+                continue;
+            }
+
+            const int sub = flip ? ((y < 2) ? 0 : 1) : ((x < 2) ? 0 : 1);
+            const int* pMod = s_etcModifiers[table[sub]];
+            int modifier = (index & 1) ? pMod[1] : pMod[0];
+            if (index & 2)
+                modifier = -modifier;
+            if (!opaque && (index == 0))
+                modifier = 0;
+            for (int c=0; c<3; ++c)
+                pOut[c] = static_cast<unsigned char>(clampInt(base[sub][c] + modifier, 0, 255));
+        }
+    }
+}
+
+///@brief Decode one EAC block into 16 values, indexed [y*4+x].
+///@param elevenBit true for R11/RG11, false for the 8 bit alpha of RGBA8_ETC2_EAC
+///@param isSigned true for the SIGNED R11/RG11 formats
+static void decodeEacBlock(const unsigned char* pBlock, bool elevenBit, bool isSigned, int out[16])
+{
+    const unsigned long long word = readBlock(pBlock);
+    const unsigned int baseBits = bits(word, 63, 56);
+    const int multiplier = static_cast<int>(bits(word, 55, 52));
+    const int* pMod = s_eacModifiers[bits(word, 51, 48)];
+
+    for (int x=0; x<4; ++x)
+    {
+        for (int y=0; y<4; ++y)
+        {
+            const int j = x*4 + y;
+            const int modifier = pMod[bits(word, 47 - 3*j, 45 - 3*j)];
+            int value = 0;
+            if (!elevenBit)
+            {
+                value = clampInt(static_cast<int>(baseBits) + modifier * multiplier, 0, 255);
+            }
+            else if (!isSigned)
+            {
+                const int scaled = (multiplier == 0) ? modifier : modifier * multiplier * 8;
+                value = clampInt(static_cast<int>(baseBits) * 8 + 4 + scaled, 0, 2047);
+            }
+            else
+            {
+                int base = static_cast<signed char>(baseBits);
+                if (base == -128)
+                    base = -127;
+                const int scaled = (multiplier == 0) ? modifier : modifier * multiplier * 8;
+                value = clampInt(base * 8 + scaled, -1023, 1023);
+            }
+            out[y*4 + x] = value;
+        }
+    }
+}
+
+bool DecodeEtcImage(
+    GLenum internalFormat,
+    const unsigned char* pBlocks,
+    size_t dataBytes,
+    unsigned int width,
+    unsigned int height,
+    std::vector<unsigned char>& pixels,
+    GLenum& pixelFormat,
+    GLenum& pixelInternalFormat)
+{
+    pixels.clear();
+    unsigned int blockWidth = 0;
+    unsigned int blockHeight = 0;
+    unsigned int blockBytes = 0;
+    if ((pBlocks == NULL) || !IsEtcFormat(internalFormat))
+        return false;
+    GetCompressedBlockSize(internalFormat, blockWidth, blockHeight, blockBytes);
+    if (dataBytes < GetCompressedImageSize(internalFormat, width, height))
+        return false;
+
+    const bool eacOnly =
+        (internalFormat == GL_COMPRESSED_R11_EAC) ||
+        (internalFormat == GL_COMPRESSED_SIGNED_R11_EAC) ||
+        (internalFormat == GL_COMPRESSED_RG11_EAC) ||
+        (internalFormat == GL_COMPRESSED_SIGNED_RG11_EAC);
+    const bool isSigned =
+        (internalFormat == GL_COMPRESSED_SIGNED_R11_EAC) ||
+        (internalFormat == GL_COMPRESSED_SIGNED_RG11_EAC);
+    const bool hasAlphaBlock =
+        (internalFormat == GL_COMPRESSED_RGBA8_ETC2_EAC) ||
+        (internalFormat == GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC);
+    const bool punchthrough =
+        (internalFormat == GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2) ||
+        (internalFormat == GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2);
+    const bool srgb =
+        (internalFormat == GL_COMPRESSED_SRGB8_ETC2) ||
+        (internalFormat == GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2) ||
+        (internalFormat == GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC);
+
+    unsigned int channels = 4;
+    if (eacOnly)
+    {
+        const bool twoChannel = (blockBytes == 16);
+        channels = twoChannel ? 2 : 1;
+        pixelFormat = twoChannel ? GL_RG : GL_RED;
+        if (isSigned)
+            pixelInternalFormat = twoChannel ? GL_RG8_SNORM : GL_R8_SNORM;
+        else
+            pixelInternalFormat = twoChannel ? GL_RG8 : GL_R8;
+    }
+    else if (hasAlphaBlock || punchthrough)
+    {
+        pixelFormat = GL_RGBA;
+        pixelInternalFormat = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+    }
+    else
+    {
+        channels = 3;
+        pixelFormat = GL_RGB;
+        pixelInternalFormat = srgb ? GL_SRGB8 : GL_RGB8;
+    }
+
+    pixels.resize(width * height * channels);
+    const unsigned int blocksX = (width + 3) / 4;
+    const unsigned int blocksY = (height + 3) / 4;
+    const unsigned char* pBlock = pBlocks;
+    for (unsigned int by=0; by<blocksY; ++by)
+    {
+        for (unsigned int bx=0; bx<blocksX; ++bx, pBlock += blockBytes)
+        {
+            unsigned char rgba[16][4];
+            if (eacOnly)
+            {
+                int values[2][16];
+                for (unsigned int c=0; c<channels; ++c)
+                    decodeEacBlock(pBlock + 8*c, true, isSigned, values[c]);
+                for (int i=0; i<16; ++i)
+                {
+                    for (unsigned int c=0; c<channels; ++c)
+                    {
+                        // Keep the top 8 of the 11 bits; signed values become two's complement bytes.
+                        const int v = isSigned ? (values[c][i] * 127 / 1023) : (values[c][i] >> 3);
+                        rgba[i][c] = static_cast<unsigned char>(v & 0xff);
+                    }
+                }
+            }
+            else
+            {
+                decodeEtcColorBlock(pBlock + (hasAlphaBlock ? 8 : 0), punchthrough, rgba);
+                if (hasAlphaBlock)
+                {
+                    int alpha[16];
+                    decodeEacBlock(pBlock, false, false, alpha);
+                    for (int i=0; i<16; ++i)
+                        rgba[i][3] = static_cast<unsigned char>(alpha[i]);
+                }
+            }
+
+            for (unsigned int y=0; y<4; ++y)
+            {
+                const unsigned int py = by*4 + y;
+                if (py >= height)
+                    break;
+                for (unsigned int x=0; x<4; ++x)
+                {
+                    const unsigned int px = bx*4 + x;
+                    if (px >= width)
+                        break;
+                    unsigned char* pOut = &pixels[(py * width + px) * channels];
+                    for (unsigned int c=0; c<channels; ++c)
+                        pOut[c] = rgba[y*4 + x][c];
+                }
+            }
+        }
+    }
+    return true;
+}
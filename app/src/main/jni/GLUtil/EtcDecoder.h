@@ -0,0 +1,27 @@
+// EtcDecoder.h
+
+#pragma once
+
+#include "GL_Includes.h"
+#include <vector>
+
+///@brief Decode an ETC1, ETC2 or EAC compressed image on the CPU for GPUs that cannot
+/// sample the format directly. Touches no GL state.
+///@param internalFormat The compressed format of pBlocks
+///@param pBlocks [in] The image's blocks, in rows of 4x4 pixel blocks
+///@param dataBytes Size of the data at pBlocks
+///@param width Width of the image in pixels
+///@param height Height of the image in pixels
+///@param pixels [out] Tightly packed pixels, rows bottom to top as the blocks were
+///@param pixelFormat [out] Format to upload pixels with: GL_RED, GL_RG, GL_RGB or GL_RGBA
+///@param pixelInternalFormat [out] Uncompressed internal format to upload pixels to
+///@return false if the format is not an ETC or EAC format, or dataBytes is too short
+bool DecodeEtcImage(
+    GLenum internalFormat,
+    const unsigned char* pBlocks,
+    size_t dataBytes,
+    unsigned int width,
+    unsigned int height,
+    std::vector<unsigned char>& pixels,
+    GLenum& pixelFormat,
+    GLenum& pixelInternalFormat);
@@ -4,14 +4,83 @@
 
 #include "Logging.h"
 #include "FontRenderer.h"
+#include "Timer.h"
+
+///@brief A job on FontMgr's loader thread. FontMgr::Update calls Finish on the GL
+/// thread once Run has returned.
+class FontJob : public WorkerJob
+{
+public:
+    virtual void Finish() = 0;
+};
+
+///@brief Reads one font's files off the GL thread; Finish uploads the result.
+class FontLoadJob : public FontJob
+{
+public:
+    explicit FontLoadJob(FontRenderer* pFont)
+    : m_pFont(pFont)
+    , m_timer()
+    , m_loadSeconds(0.)
+    {}
+
+    virtual void Run()
+    {
+        m_pFont->LoadFiles();
+        m_loadSeconds = m_timer.seconds();
+    }
+
+    virtual void Finish()
+    {
+        m_pFont->InitGL();
+        LOG_INFO("Font %s loaded: files read in %d ms, shader requested after %d ms",
+            m_pFont->GetFontName().c_str(),
+            static_cast<int>(1000. * m_loadSeconds),
+            static_cast<int>(1000. * m_timer.seconds()));
+    }
+
+    FontRenderer* m_pFont;
+    Timer m_timer;         ///< Started when the font was first requested
+    double m_loadSeconds;  ///< Time from request until files were read
+};
+
+///@brief Reads one glyph page of a resident font off the GL thread; Finish uploads it.
+class FontPageJob : public FontJob
+{
+public:
+    FontPageJob(FontRenderer* pFont, unsigned int page)
+    : m_pFont(pFont)
+    , m_page(page)
+    , m_pixels()
+    {}
+
+    virtual void Run()
+    {
+        m_pFont->ReadPagePixels(m_page, m_pixels);
+    }
+
+    virtual void Finish()
+    {
+        m_pFont->ReceivePage(m_page, m_pixels);
+    }
+
+    FontRenderer* m_pFont;
+    unsigned int m_page;
+    std::vector<unsigned char> m_pixels;
+};
+
+/// Large CJK fonts span many atlas pages; keep only the most recently drawn resident.
+static const size_t s_defaultPageBudgetBytes = 8 * 1024 * 1024;
 
 FontMgr::FontMgr()
 : m_windowHeight(0)
-, m_pFontRender10(NULL)
-, m_pFontRender13(NULL)
-, m_pFontRender18(NULL)
-, m_pFontRender24(NULL)
+, m_pageBudgetBytes(s_defaultPageBudgetBytes)
+, m_loader()
 {
+    for (int i=0; i<NumFontSlots; ++i)
+    {
+        m_pFontRenders[i] = NULL;
+    }
 }
 
 FontMgr::~FontMgr()
@@ -24,39 +93,80 @@ FontMgr::~FontMgr()
 /// a call to this in the destructor! They will be double-deleted if not.
 void FontMgr::Destroy()
 {
-    delete m_pFontRender10, m_pFontRender10 = NULL;
-    delete m_pFontRender13, m_pFontRender13 = NULL;
-    delete m_pFontRender18, m_pFontRender18 = NULL;
-    delete m_pFontRender24, m_pFontRender24 = NULL;
+    // Let any in-flight loads finish before deleting the fonts they write to.
+    m_loader.Stop();
+    while (WorkerJob* pJob = m_loader.PopFinished())
+    {
+        delete pJob;
+    }
+
+    for (int i=0; i<NumFontSlots; ++i)
+    {
+        delete m_pFontRenders[i], m_pFontRenders[i] = NULL;
+        m_fontNames[i].clear();
+    }
+}
+
+///@brief Upload any fonts and glyph pages whose files have finished loading, and
+/// make resident any fonts whose shaders have finished building.
+/// Call once per frame on the GL thread.
+void FontMgr::Update()
+{
+    while (WorkerJob* pJob = m_loader.PopFinished())
+    {
+        static_cast<FontJob*>(pJob)->Finish();
+        delete pJob;
+    }
+
+    for (int i=0; i<NumFontSlots; ++i)
+    {
+        if (m_pFontRenders[i] != NULL)
+            m_pFontRenders[i]->UpdateGL();
+    }
 }
 
-FontRenderer* FontMgr::GetFontOfSize(int pts) const
+///@brief Queue a read of one of a font's glyph pages; Update uploads it when done.
+/// Only fonts created by this FontMgr are served.
+void FontMgr::RequestPage(const FontRenderer& font, unsigned int page)
+{
+    for (int i=0; i<NumFontSlots; ++i)
+    {
+        if (m_pFontRenders[i] == &font)
+        {
+            m_loader.Submit(new FontPageJob(m_pFontRenders[i], page));
+            return;
+        }
+    }
+}
+
+///@return The slot whose font best matches the point size, or -1 if the language has no fonts.
+int FontMgr::_SlotForSize(int pts) const
 {
     switch(pts)
     {
     default:
     case 10:
     case 11:
-        if (m_pFontRender10 != NULL)
+        if (!m_fontNames[Font10px].empty())
         {
-            return m_pFontRender10;
+            return Font10px;
         }
     case 12:
     case 13:
     case 14:
     case 15:
-        if (m_pFontRender13 != NULL)
+        if (!m_fontNames[Font13px].empty())
         {
-            return m_pFontRender13;
+            return Font13px;
         }
     case 16:
     case 17:
     case 18:
     case 19:
     case 20:
-        if (m_pFontRender18 != NULL)
+        if (!m_fontNames[Font18px].empty())
         {
-            return m_pFontRender18;
+            return Font18px;
         }
     case 21:
     case 22:
@@ -66,20 +176,98 @@ FontRenderer* FontMgr::GetFontOfSize(int pts) const
     case 26:
     case 27:
     case 28:
-        if (m_pFontRender24 != NULL)
+        if (!m_fontNames[Font24px].empty())
         {
-            return m_pFontRender24;
+            return Font24px;
         }
         break;
     }
 
-    /// Return whatever's not NULL
-    if (m_pFontRender18) return m_pFontRender18;
-    if (m_pFontRender13) return m_pFontRender13;
-    if (m_pFontRender10) return m_pFontRender10;
+    /// Return whatever's available
+    if (!m_fontNames[Font18px].empty()) return Font18px;
+    if (!m_fontNames[Font13px].empty()) return Font13px;
+    if (!m_fontNames[Font10px].empty()) return Font10px;
+    return -1;
+}
+
+///@brief Create the slot's font and queue its files to be read on the loader thread.
+void FontMgr::_RequestLoad(int slot)
+{
+    if (m_pFontRenders[slot] != NULL)
+        return;
+
+    const bool loadNow = false;
+    FontRenderer* pFont = new FontRenderer(m_fontNames[slot].c_str(), m_windowHeight, loadNow);
+    pFont->SetPageBudgetBytes(m_pageBudgetBytes);
+    pFont->SetPageReader(this);
+    m_pFontRenders[slot] = pFont;
+    m_loader.Submit(new FontLoadJob(pFont));
+}
+
+///@return The resident font nearest in size to the given slot, or NULL if none are resident.
+FontRenderer* FontMgr::_GetResidentFallback(int slot) const
+{
+    for (int d=1; d<NumFontSlots; ++d)
+    {
+        const int candidates[] = { slot - d, slot + d };
+        for (int c=0; c<2; ++c)
+        {
+            const int s = candidates[c];
+            if ((s < 0) || (s >= NumFontSlots))
+                continue;
+            const FontRenderer* pFont = m_pFontRenders[s];
+            if ((pFont != NULL) && pFont->IsResident())
+                return m_pFontRenders[s];
+        }
+    }
     return NULL;
 }
 
+///@return The font for the given size if resident, otherwise the nearest resident
+/// size while the requested one loads. May return NULL until some font is resident.
+FontRenderer* FontMgr::GetFontOfSize(int pts)
+{
+    const int slot = _SlotForSize(pts);
+    if (slot < 0)
+        return NULL;
+
+    FontRenderer* pFont = m_pFontRenders[slot];
+    if ((pFont != NULL) && pFont->IsResident())
+        return pFont;
+
+    _RequestLoad(slot);
+    Update();
+
+    pFont = m_pFontRenders[slot];
+    if (pFont->IsResident())
+        return pFont;
+    return _GetResidentFallback(slot);
+}
+
+///@brief Set the texture memory each font may hold in resident glyph pages.
+///@param bytesPerFont Budget in bytes, 0 for no limit
+void FontMgr::SetGlyphPageBudget(size_t bytesPerFont)
+{
+    m_pageBudgetBytes = bytesPerFont;
+    for (int i=0; i<NumFontSlots; ++i)
+    {
+        if (m_pFontRenders[i] != NULL)
+            m_pFontRenders[i]->SetPageBudgetBytes(m_pageBudgetBytes);
+    }
+}
+
+///@return Total texture memory in bytes held by resident glyph pages of all fonts
+size_t FontMgr::GetResidentPageBytes() const
+{
+    size_t total = 0;
+    for (int i=0; i<NumFontSlots; ++i)
+    {
+        if (m_pFontRenders[i] != NULL)
+            total += m_pFontRenders[i]->GetResidentPageBytes();
+    }
+    return total;
+}
+
 void FontMgr::LoadLanguageFonts(Language lang)
 {
     Destroy();
@@ -98,53 +286,34 @@ void FontMgr::LoadLanguageFonts(Language lang)
     case Japanese  : _LoadJapaneseFonts(); break;
     case Chinese   : _LoadChineseFonts(); break;
     }
+
+    if (!m_loader.Start())
+    {
+        LOG_ERROR("FontMgr: could not start loader thread, fonts will load synchronously.");
+    }
 }
 
 ///@todo Consolidate shaders, move windowheight out of fontrend, multi-lang
-///@note Depends on the member variable m_windowHeight
+///@note Fonts are only named here; files are read on first use of each size.
 bool FontMgr::_LoadEnglishFonts()
 {
-    m_pFontRender10 = new FontRenderer("SegoeUI_10px", m_windowHeight);
-    if (m_pFontRender10 == NULL)
-        return false;
-
-    m_pFontRender13 = new FontRenderer("SegoeUI_13px", m_windowHeight);
-    if (m_pFontRender13 == NULL)
-        return false;
-
-    m_pFontRender18 = new FontRenderer("SegoeUI_18px", m_windowHeight);
-    if (m_pFontRender18 == NULL)
-        return false;
-
-    m_pFontRender24 = new FontRenderer("SegoeUI_24px", m_windowHeight);
-    if (m_pFontRender24 == NULL)
-        return false;
-
+    m_fontNames[Font10px] = "SegoeUI_10px";
+    m_fontNames[Font13px] = "SegoeUI_13px";
+    m_fontNames[Font18px] = "SegoeUI_18px";
+    m_fontNames[Font24px] = "SegoeUI_24px";
     return true;
 }
 
 bool FontMgr::_LoadJapaneseFonts()
 {
-    m_pFontRender13 = new FontRenderer("MeiryoUI_24px", m_windowHeight);
-    if (m_pFontRender13 == NULL)
-        return false;
-
-    m_pFontRender18 = new FontRenderer("MeiryoUI_36px", m_windowHeight);
-    if (m_pFontRender18 == NULL)
-        return false;
-
+    m_fontNames[Font13px] = "MeiryoUI_24px";
+    m_fontNames[Font18px] = "MeiryoUI_36px";
     return true;
 }
 
 bool FontMgr::_LoadChineseFonts()
 {
-    m_pFontRender13 = new FontRenderer("FangSong_24px", m_windowHeight);
-    if (m_pFontRender13 == NULL)
-        return false;
-
-    m_pFontRender18 = new FontRenderer("FangSong_36px", m_windowHeight);
-    if (m_pFontRender18 == NULL)
-        return false;
-
+    m_fontNames[Font13px] = "FangSong_24px";
+    m_fontNames[Font18px] = "FangSong_36px";
     return true;
 }
@@ -5,12 +5,19 @@
 #include "Singleton.h"
 #include "GL_Includes.h"
 #include "LanguageEnums.h"
-
-class FontRenderer;
+#include "WorkerPool.h"
+#include "FontRenderer.h"
+#include <string>
 
 ///@brief Holds all font files(catalogued texture maps) and is initialized by GraphicalUI.
+/// Fonts are loaded lazily: the first request for a size reads its files on a worker
+/// thread and then builds its shader without stalling, and a resident font of the
+/// nearest size is returned until both are done.
+/// Glyph pages of each font are read on the same worker thread when first drawn and
+/// uploaded by Update, then evicted least recently used first to stay within the
+/// glyph page budget.
 ///@warning Do not attempt to access this object outside of the GL thread!
-class FontMgr : public Singleton
+class FontMgr : public Singleton, public FontPageReader
 {
 public:
     static FontMgr& Instance()
@@ -22,19 +29,38 @@ public:
 
     void SetWindowHeight(int windowHeight) { m_windowHeight = windowHeight; }
     void LoadLanguageFonts(Language lang);
+    void Update();
+
+    FontRenderer* GetFontOfSize(int pts);
+
+    void SetGlyphPageBudget(size_t bytesPerFont);
+    size_t GetResidentPageBytes() const;
 
-    FontRenderer* GetFontOfSize(int pts) const;
+    virtual void RequestPage(const FontRenderer& font, unsigned int page);
 
 protected:
+    enum FontSlot
+    {
+        Font10px=0,
+        Font13px,
+        Font18px,
+        Font24px,
+        NumFontSlots
+    };
+
     bool _LoadEnglishFonts();
     bool _LoadJapaneseFonts();
     bool _LoadChineseFonts();
 
+    int _SlotForSize(int pts) const;
+    void _RequestLoad(int slot);
+    FontRenderer* _GetResidentFallback(int slot) const;
+
     int            m_windowHeight;
-    FontRenderer*  m_pFontRender10;
-    FontRenderer*  m_pFontRender13;
-    FontRenderer*  m_pFontRender18;
-    FontRenderer*  m_pFontRender24;
+    size_t         m_pageBudgetBytes;             ///< Applied to each font, 0 for no limit
+    std::string    m_fontNames[NumFontSlots];     ///< Empty if the language has no font in that slot
+    FontRenderer*  m_pFontRenders[NumFontSlots];  ///< NULL until first requested
+    WorkerPool     m_loader;
 
 private:
     FontMgr();
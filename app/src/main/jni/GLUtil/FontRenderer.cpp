@@ -4,120 +4,371 @@
 
 #include "DataDirectoryLocation.h"
 #include "ShaderFunctions.h"
+#include "ShaderMgr.h"
 #include "TextureFunctions.h"
+#include "GLStateMgr.h"
+#include "TextureMgr.h"
 
 #include "Logging.h"
 #include "MatrixMath.h"
-#include <fstream>
+#include "Utf8Iterator.h"
+#include "MappedFile.h"
+#include <stdlib.h>
 #include <string.h>
 
 /// Static map of all unrecognize characters so we print each message only once.
-static std::map<wchar_t,int> s_unrecognizedChars;
-
-FontRenderer::FontRenderer(const char* pFontName, int windowHeight)
-: m_texDimension(0)
+static std::map<unsigned int,int> s_unrecognizedChars;
+
+///@param pFontName Base name of the .fnt file in the fonts/ data directory
+///@param loadNow If false, the caller must call LoadFiles and then InitGL before drawing.
+/// Either way, the font draws once UpdateGL has returned true.
+FontRenderer::FontRenderer(const char* pFontName, int windowHeight, bool loadNow)
+: m_fontName(pFontName ? pFontName : "")
+, m_texDimension(0)
 , m_charTable()
 , m_kernTable()
 , m_pageFilenames()
+, m_pageBudgetBytes(0)
 , m_pageTextures()
+, m_pageLastUse()
+, m_pagePixels()
+, m_pageRequested()
+, m_pPageReader(NULL)
+, m_residentPageBytes(0)
+, m_useClock(0)
+, m_resident(false)
 , m_windowHeight(windowHeight)
 , m_lineHeight(0)
 , m_basePx(0)
 , m_shader()
+, m_uniMvmtx(-1)
+, m_uniPrmtx(-1)
+, m_uniTexture(-1)
+, m_uniFontColor(-1)
+, m_vboPosition(0)
+, m_vboTexCoord(0)
+{
+    if (loadNow)
+    {
+        LoadFiles();
+        InitGL();
+    }
+}
+
+///@brief Read the font's .fnt and .kern files and its first page image into memory.
+/// Other pages are read when a glyph on them is first drawn.
+/// Touches no GL state, so may be called from a worker thread.
+void FontRenderer::LoadFiles()
+{
+    LoadMetrics();
+
+    const size_t pageCount = m_pageFilenames.size();
+    m_pageTextures.assign(pageCount, 0);
+    m_pageLastUse.assign(pageCount, 0);
+    m_pagePixels.resize(pageCount);
+    m_pageRequested.assign(pageCount, false);
+
+    /// Preload the first page, which holds ASCII for fonts exported by BMFont,
+    /// so Latin text is drawn from the first frame the font is resident.
+    if (pageCount > 0)
+    {
+        ReadPagePixels(0, m_pagePixels[0]);
+    }
+}
+
+///@brief Read a page's image from disk. Touches no GL state or residency data,
+/// so a FontPageReader may call it from a worker thread once LoadFiles has returned.
+///@param pixels [out] The page's luminance pixels, emptied on failure
+///@return true if the file was read
+bool FontRenderer::ReadPagePixels(unsigned int page, std::vector<unsigned char>& pixels) const
+{
+    pixels.clear();
+    if (page >= m_pageFilenames.size())
+        return false;
+    MappedFile file;
+    const RawImageDesc desc(m_texDimension, m_texDimension, 1);
+    const unsigned char* pPixels = MapRawImage(file, _GetPageRawFilename(page).c_str(), desc);
+    if (pPixels == NULL)
+        return false;
+    pixels.assign(pPixels, pPixels + _GetPageBytes());
+    return true;
+}
+
+///@brief Take the pixels of a page read for this font by its FontPageReader and upload them.
+/// Must be called on the GL thread.
+///@param pixels [in,out] Emptied; the font keeps their contents
+void FontRenderer::ReceivePage(unsigned int page, std::vector<unsigned char>& pixels)
+{
+    if (page >= m_pagePixels.size())
+        return;
+    // A page that could not be read stays marked as requested, so it is not read again every frame.
+    if (pixels.empty())
+        return;
+    m_pageRequested[page] = false;
+    if (m_pageTextures[page] != 0)
+        return;
+
+    m_pagePixels[page].swap(pixels);
+    pixels.clear();
+    if (m_resident)
+        _MakePageResident(page);
+}
+
+///@brief Read only the font's .fnt and .kern files: enough to measure and lay out
+/// text with it, but not to draw it.
+void FontRenderer::LoadMetrics()
 {
-    const std::string fontName = pFontName;
     const std::string dataHome = APP_DATA_DIRECTORY;
     std::string homedir = dataHome;
 
     homedir.append("fonts/");
-    const std::string fntFilename = homedir + fontName + ".fnt";
+    const std::string fntFilename = homedir + m_fontName + ".fnt";
     _LoadFntFile(fntFilename.c_str());
 
     _AddCustomKerningEntries(fntFilename.c_str());
     //PrintKerningPairs(0,0);
     //PrintKerningPairs((int)'t',0);
     //PrintKerningPairs(0,(int)'t');
+}
 
-    /// Load all pages of font
-    for (std::vector<std::string>::iterator it=m_pageFilenames.begin();
-         it != m_pageFilenames.end();
-         ++it)
-    {
-        const std::string pageName = *it;
-        const std::string suffixless = pageName.substr(0, pageName.length()-4);
-        ///@todo png support
-        const std::string texFilename = homedir + suffixless + ".raw";
-        const GLuint tex = CreateTextureFromRawFile(texFilename.c_str(), m_texDimension);
-        m_pageTextures.push_back(tex);
-    }
+///@return Full path of the page's raw luminance image file
+std::string FontRenderer::_GetPageRawFilename(size_t page) const
+{
+    const std::string& pageName = m_pageFilenames[page];
+    const std::string suffixless = pageName.substr(0, pageName.length()-4);
+    ///@todo png support
+    std::string texFilename = APP_DATA_DIRECTORY;
+    texFilename.append("fonts/");
+    texFilename.append(suffixless);
+    texFilename.append(".raw");
+    return texFilename;
+}
+
+///@brief Start building the shader without waiting on the driver. The font is drawn
+/// once UpdateGL finds it built; pages are uploaded as they are first drawn.
+/// Must be called on the GL thread.
+void FontRenderer::InitGL()
+{
+    if (m_resident || m_shader.isPending())
+        return;
+
+    m_shader.requestProgram("fontrenderer");
+    m_uniMvmtx = m_shader.GetUniformHandle("mvmtx");
+    m_uniPrmtx = m_shader.GetUniformHandle("prmtx");
+    m_uniTexture = m_shader.GetUniformHandle("s_texture");
+    m_uniFontColor = m_shader.GetUniformHandle("u_fontColor");
+    ShaderMgr::Instance().AddReloadListener(&m_shader);
+    UpdateGL();
+}
 
-    m_shader.initProgram("fontrenderer");
+///@brief Finish setting up once the shader from InitGL is built. Call each frame on
+/// the GL thread until it returns true; FontMgr does this for its fonts.
+///@return true once the font is resident and can be drawn
+bool FontRenderer::UpdateGL()
+{
+    if (m_resident)
+        return true;
+    if (!m_shader.pollProgram())
+        return false;
+
+    GLStateMgr& state = GLStateMgr::Instance();
+    const GLint attrLocPos = m_shader.GetAttrLoc("a_position");
+    const GLint attrLocTex = m_shader.GetAttrLoc("a_texCoord");
     m_shader.bindVAO();
     {
-        GLuint vertVbo = 0;
-        glGenBuffers(1, &vertVbo);
-        m_shader.AddVbo("a_position", vertVbo);
-        glBindBuffer(GL_ARRAY_BUFFER, vertVbo);
+        glGenBuffers(1, &m_vboPosition);
+        m_shader.AddVbo("a_position", m_vboPosition);
+        state.BindBuffer(GL_ARRAY_BUFFER, m_vboPosition);
         glBufferData(GL_ARRAY_BUFFER, 4*3*sizeof(GLfloat), NULL, GL_STATIC_DRAW);
-        glVertexAttribPointer(m_shader.GetAttrLoc("a_position"), 3, GL_FLOAT, GL_FALSE, 0, NULL);
+        if (attrLocPos >= 0)
+            glVertexAttribPointer(attrLocPos, 3, GL_FLOAT, GL_FALSE, 0, NULL);
 
-        GLuint colVbo = 0;
-        glGenBuffers(1, &colVbo);
-        m_shader.AddVbo("a_texCoord", colVbo);
-        glBindBuffer(GL_ARRAY_BUFFER, colVbo);
+        glGenBuffers(1, &m_vboTexCoord);
+        m_shader.AddVbo("a_texCoord", m_vboTexCoord);
+        state.BindBuffer(GL_ARRAY_BUFFER, m_vboTexCoord);
         glBufferData(GL_ARRAY_BUFFER, 4*2*sizeof(GLfloat), NULL, GL_STATIC_DRAW);
-        glVertexAttribPointer(m_shader.GetAttrLoc("a_texCoord"), 2, GL_FLOAT, GL_FALSE, 0, NULL);
-
-        glEnableVertexAttribArray(m_shader.GetAttrLoc("a_position"));
-        glEnableVertexAttribArray(m_shader.GetAttrLoc("a_texCoord"));
+        if (attrLocTex >= 0)
+            glVertexAttribPointer(attrLocTex, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+
+        // A location of -1 means the attribute was optimized out; GL rejects it.
+        if (attrLocPos >= 0)
+            glEnableVertexAttribArray(attrLocPos);
+        if (attrLocTex >= 0)
+            glEnableVertexAttribArray(attrLocTex);
     }
-    glBindVertexArray(0);
+    state.BindVertexArray(0);
+
+    m_resident = true;
+    return true;
 }
 
 
 FontRenderer::~FontRenderer()
 {
-    if (!m_pageTextures.empty())
-        glDeleteTextures(m_pageTextures.size(), &m_pageTextures[0]);
+    ShaderMgr::Instance().RemoveReloadListener(&m_shader);
+    EvictAllPages();
 }
 
+///@brief Limit the texture memory held by this font's resident pages.
+/// Least recently drawn pages are evicted to stay within it; a single draw call
+/// needing more pages than fit will exceed it until the next draw.
+///@param bytes Budget in bytes, 0 for no limit
+void FontRenderer::SetPageBudgetBytes(size_t bytes)
+{
+    m_pageBudgetBytes = bytes;
+    if (m_pageBudgetBytes == 0)
+        return;
 
-/// Utility function for BMF binary font reading
-/// Blocks are preceded by 1 byte identifier and 4 byte size.
-/// Allocates and returns a block of memory to be frreed by the caller.
-unsigned char* GetBlock(std::ifstream& fin, unsigned char& id, unsigned int& sz)
+    // Outside of a draw call, pages used by the last one are fair game too.
+    ++m_useClock;
+    while (m_residentPageBytes > m_pageBudgetBytes)
+    {
+        if (!_EvictLeastRecentlyUsedPage())
+            break;
+    }
+}
+
+///@brief Delete all page textures; they will be uploaded again as needed.
+void FontRenderer::EvictAllPages()
 {
-    fin.read(reinterpret_cast<char*>(&id), 1);
-    fin.read(reinterpret_cast<char*>(&sz), sizeof(unsigned int));
+    for (size_t i=0; i<m_pageTextures.size(); ++i)
+    {
+        _EvictPage(i);
+    }
+}
 
-    unsigned char* pBlock = new unsigned char[sz];
-    fin.read(reinterpret_cast<char*>(pBlock), sz);
+size_t FontRenderer::GetResidentPageCount() const
+{
+    size_t count = 0;
+    for (std::vector<GLuint>::const_iterator it = m_pageTextures.begin();
+         it != m_pageTextures.end();
+         ++it)
+    {
+        if (*it != 0)
+            ++count;
+    }
+    return count;
+}
 
-    return pBlock;
+void FontRenderer::_EvictPage(size_t page) const
+{
+    GLuint& tex = m_pageTextures[page];
+    if (tex == 0)
+        return;
+    TextureMgr::Instance().UntrackExternal(tex);
+    GLStateMgr::Instance().DeleteTexture(tex);
+    tex = 0;
+    m_residentPageBytes -= _GetPageBytes();
+}
+
+///@brief Evict the resident page drawn from least recently, excluding any
+/// used in the current draw call.
+///@return true if a page was evicted
+bool FontRenderer::_EvictLeastRecentlyUsedPage() const
+{
+    size_t lruPage = m_pageTextures.size();
+    for (size_t i=0; i<m_pageTextures.size(); ++i)
+    {
+        if (m_pageTextures[i] == 0)
+            continue;
+        if (m_pageLastUse[i] == m_useClock)
+            continue;
+        if ((lruPage == m_pageTextures.size()) || (m_pageLastUse[i] < m_pageLastUse[lruPage]))
+            lruPage = i;
+    }
+
+    if (lruPage == m_pageTextures.size())
+        return false;
+    _EvictPage(lruPage);
+    return true;
+}
+
+///@brief Upload a page texture, first evicting others to make room within the budget.
+/// A page not yet in memory is read first, on this thread.
+///@return true if the page is now resident
+bool FontRenderer::_MakePageResident(unsigned int page) const
+{
+    const size_t pageBytes = _GetPageBytes();
+    if (m_pageBudgetBytes > 0)
+    {
+        while (m_residentPageBytes + pageBytes > m_pageBudgetBytes)
+        {
+            if (!_EvictLeastRecentlyUsedPage())
+                break;
+        }
+    }
+
+    std::vector<unsigned char>& pixels = m_pagePixels[page];
+    if (pixels.empty())
+    {
+        ReadPagePixels(page, pixels);
+    }
+
+    const GLuint tex = CreateTextureFromLuminanceBuffer(
+        pixels.empty() ? NULL : &pixels[0],
+        m_texDimension);
+    std::vector<unsigned char>().swap(pixels);
+    if (tex == 0)
+        return false;
+
+    m_pageTextures[page] = tex;
+    m_residentPageBytes += pageBytes;
+    TextureMgr::Instance().TrackExternal(tex, pageBytes);
+    return true;
+}
+
+///@return The texture for a glyph page, uploading it if it is not resident, or 0 if it
+/// could not be made resident or is still being read by the page reader.
+GLuint FontRenderer::_GetPageTexture(unsigned int page) const
+{
+    if (page >= m_pageTextures.size())
+        return 0;
+
+    m_pageLastUse[page] = m_useClock;
+    if (m_pageTextures[page] != 0)
+        return m_pageTextures[page];
+
+    // Never read from disk in a draw call when there is a reader to do it.
+    if (m_pagePixels[page].empty() && (m_pPageReader != NULL))
+    {
+        if (!m_pageRequested[page])
+        {
+            m_pageRequested[page] = true;
+            m_pPageReader->RequestPage(*this, page);
+        }
+        return 0;
+    }
+
+    if (!_MakePageResident(page))
+        return 0;
+    return m_pageTextures[page];
 }
 
 
 /// See BMF docs
 /// http://www.angelcode.com/products/bmfont/doc/file_format.html
-void FontRenderer::_ProcessBlock(unsigned char id, unsigned int sz, unsigned char* pBlock)
+///@param pBlock [in] sz bytes of block data, checked against the file size by the caller
+void FontRenderer::_ProcessBlock(unsigned char id, unsigned int sz, const unsigned char* pBlock)
 {
     switch(id)
     {
     default: break;
 
     case 1: // info
-        BMF_blockInfo bi;
-        memcpy(&bi, pBlock, sizeof(BMF_blockInfo));
+        if (sz >= sizeof(BMF_blockInfo))
         {
+            BMF_blockInfo bi;
+            memcpy(&bi, pBlock, sizeof(BMF_blockInfo));
             //unsigned int namelen = sz - sizeof(BMF_blockInfo);
             //const unsigned char* pName = pBlock + sizeof(BMF_blockInfo);
         }
         break;
 
     case 2: // common
-        BMF_blockCommon b;
-        memcpy(&b, pBlock, sizeof(BMF_blockCommon));
+        if (sz >= sizeof(BMF_blockCommon))
         {
+            BMF_blockCommon b;
+            memcpy(&b, pBlock, sizeof(BMF_blockCommon));
             m_texDimension = b.scaleW;
             if (b.scaleW != b.scaleH)
             {
@@ -131,18 +382,19 @@ void FontRenderer::_ProcessBlock(unsigned char id, unsigned int sz, unsigned cha
 
     case 3: // pages
         {
+            // A list of NULL terminated names; never read past the end of the block
+            // even if the last terminator is missing.
             const char* pName = reinterpret_cast<const char*>(pBlock);
-            if (pName != NULL)
+            const char* pEnd = pName + sz;
+            while (pName < pEnd)
             {
-                std::string name(reinterpret_cast<const char*>(pName));
-                const unsigned int len = name.length()+1; // include terminator
-                const unsigned int num = sz / len;
-                for (unsigned int i=0; i<num; ++i)
+                const void* pTerm = memchr(pName, 0, pEnd - pName);
+                const char* pNameEnd = pTerm ? static_cast<const char*>(pTerm) : pEnd;
+                if (pNameEnd > pName)
                 {
-                    m_pageFilenames.push_back(name);
-                    pName += len;
-                    name.assign(pName);
+                    m_pageFilenames.push_back(std::string(pName, pNameEnd));
                 }
+                pName = pNameEnd + 1;
             }
         }
         break;
@@ -150,13 +402,11 @@ void FontRenderer::_ProcessBlock(unsigned char id, unsigned int sz, unsigned cha
     case 4: // chars
         {
             const size_t charCount = sz / sizeof(BMF_char);
-            //m_charTable.resize(charCount);
-            //memcpy(&m_charTable[0], pBlock, charCount * sizeof(BMF_char));
-            const BMF_char* pCharBlock = reinterpret_cast<const BMF_char*>(pBlock);
-            for(int i=0; i<static_cast<int>(charCount); ++i)
+            for (size_t i=0; i<charCount; ++i)
             {
-                const BMF_char& pC = pCharBlock[i];
-                m_charTable[pC.id] = pC;
+                BMF_char c;
+                memcpy(&c, pBlock + i*sizeof(BMF_char), sizeof(BMF_char));
+                m_charTable[c.id] = c;
             }
         }
         break;
@@ -164,12 +414,10 @@ void FontRenderer::_ProcessBlock(unsigned char id, unsigned int sz, unsigned cha
     case 5: /// kerning pairs
         {
             const size_t kernCount = sz / sizeof(BMF_kern);
-            //m_kernTable.resize(kernCount);
-            //memcpy(&m_kernTable[0], pBlock, kernCount * sizeof(BMF_kern));
-            const BMF_kern* pKernBlock = reinterpret_cast<const BMF_kern*>(pBlock);
-            for(int i=0; i<static_cast<int>(kernCount); ++i)
+            for (size_t i=0; i<kernCount; ++i)
             {
-                const BMF_kern& bk = pKernBlock[i];
+                BMF_kern bk;
+                memcpy(&bk, pBlock + i*sizeof(BMF_kern), sizeof(BMF_kern));
                 _AddKerningEntry(bk.first, bk.second, bk.amount);
             }
         }
@@ -180,6 +428,10 @@ void FontRenderer::_ProcessBlock(unsigned char id, unsigned int sz, unsigned cha
 
 /// Load a bitmap font file created by:
 /// http://www.angelcode.com/products/bmfont/
+/// The file is memory-mapped and its blocks are parsed in place. Blocks are
+/// preceded by 1 byte identifier and 4 byte little-endian size; every block
+/// present is read, and parsing stops at the first block that runs past the
+/// end of the file.
 ///@param pFilename Filename of .fnt binary file exported by BMFont
 void FontRenderer::_LoadFntFile(const char* pFilename)
 {
@@ -187,37 +439,50 @@ void FontRenderer::_LoadFntFile(const char* pFilename)
         return;
 
     LOG_INFO_NONEWLINE("Opening font file %s ...", pFilename);
-    std::ifstream fin(pFilename, std::ios::binary);
-
-    if (fin)
+    MappedFile fnt;
+    if (!fnt.Open(pFilename))
     {
-        // Header is 4 bytes, BMF followed by 3.
-        unsigned char header[4];
-        fin.read(reinterpret_cast<char*>(header), 4);
-        if ((header[0] == 'B') &&
-            (header[1] == 'M') &&
-            (header[2] == 'F') &&
-            (header[3] == 3))
-        {
-            for (unsigned int i=0; i<5; ++i)
-            {
-                unsigned char id;
-                unsigned int sz;
-                unsigned char* pBlock = GetBlock(fin, id, sz);
-
-                _ProcessBlock(id, sz, pBlock);
+        LOG_ERROR("Font file %s not found.\n", pFilename);
+        return;
+    }
 
-                delete [] pBlock;
-            }
-        }
+    const unsigned char* pData = fnt.Data();
+    const size_t fileSz = fnt.Size();
 
-        fin.close();
-        LOG_INFO("success.");
+    // Header is 4 bytes, BMF followed by 3.
+    if ((fileSz < 4) ||
+        (pData[0] != 'B') ||
+        (pData[1] != 'M') ||
+        (pData[2] != 'F') ||
+        (pData[3] != 3))
+    {
+        LOG_ERROR("Font file %s is not a version 3 binary BMFont file.\n", pFilename);
+        return;
     }
-    else
+
+    const size_t headerSz = 5;
+    size_t offset = 4;
+    while (offset + headerSz <= fileSz)
     {
-        LOG_ERROR("Font file %s not found.\n", pFilename);
+        const unsigned char id = pData[offset];
+        const unsigned int sz =
+            (static_cast<unsigned int>(pData[offset+1])      ) |
+            (static_cast<unsigned int>(pData[offset+2]) <<  8) |
+            (static_cast<unsigned int>(pData[offset+3]) << 16) |
+            (static_cast<unsigned int>(pData[offset+4]) << 24);
+        offset += headerSz;
+
+        if (sz > fileSz - offset)
+        {
+            LOG_ERROR("Font file %s: block %d overruns file, ignoring it.\n", pFilename, id);
+            break;
+        }
+
+        _ProcessBlock(id, sz, pData + offset);
+        offset += sz;
     }
+
+    LOG_INFO("success.");
 }
 
 
@@ -247,93 +512,255 @@ void FontRenderer::_AddKerningEntry(int chprev, int ch, short amount)
     m_kernTable[kp] = amount;
 }
 
-///@brief Load custom kerning entries from .kern file.
-/// One entry per line, first 2 wide chars are the pair, then a space, then the pixel displacement.
+/// Decode the contents of a .kern file to code points.
+/// Files saved as UTF-16LE(with BOM) are decoded as such; the shipped files were
+/// also written in text mode, which put a stray 0x0d byte before each 0x0a byte,
+/// so those are dropped first. Anything else is decoded as UTF-8.
+static void DecodeKernFile(const unsigned char* pData, size_t sz, std::vector<unsigned int>& codepoints)
+{
+    codepoints.clear();
+    if ((sz >= 2) && (pData[0] == 0xff) && (pData[1] == 0xfe))
+    {
+        std::vector<unsigned char> bytes;
+        bytes.reserve(sz);
+        for (size_t i=2; i<sz; ++i)
+        {
+            if ((pData[i] == 0x0d) && (i+1 < sz) && (pData[i+1] == 0x0a))
+                continue;
+            bytes.push_back(pData[i]);
+        }
+
+        for (size_t i=0; i+1<bytes.size(); i+=2)
+        {
+            unsigned int cu = bytes[i] | (bytes[i+1] << 8);
+            if ((cu >= 0xd800) && (cu <= 0xdbff) && (i+3 < bytes.size()))
+            {
+                const unsigned int lo = bytes[i+2] | (bytes[i+3] << 8);
+                if ((lo >= 0xdc00) && (lo <= 0xdfff))
+                {
+                    cu = 0x10000 + ((cu - 0xd800) << 10) + (lo - 0xdc00);
+                    i += 2;
+                }
+            }
+            codepoints.push_back(cu);
+        }
+        return;
+    }
+
+    const char* pStr = reinterpret_cast<const char*>(pData);
+    if ((sz >= 3) && (pData[0] == 0xef) && (pData[1] == 0xbb) && (pData[2] == 0xbf))
+    {
+        pStr += 3;
+        sz -= 3;
+    }
+    Utf8Iterator it(pStr, sz);
+    while (!it.AtEnd())
+    {
+        codepoints.push_back(it.Next());
+    }
+}
+
+///@brief Load custom kerning entries from .kern file next to the .fnt file.
+/// One entry per line, first 2 chars are the pair, then a space, then the pixel displacement.
 /// e.g.: "it -2"
+/// Blank lines and lines starting with # are ignored.
+///@return 0 on success, 1 if the filename is not a .fnt, 2 if there is no .kern file
 int FontRenderer::_AddCustomKerningEntries(const char* pFilename)
 {
-#if 0
-    std::string narrowFilename(pFilename);
+    if (pFilename == NULL)
+        return 1;
+
+    const std::string narrowFilename(pFilename);
     const std::string fntSuffix = ".fnt";
-    size_t suffixFound = narrowFilename.rfind(fntSuffix);
-    if (suffixFound != narrowFilename.length() - fntSuffix.length())
-        return -1;
+    if ((narrowFilename.length() < fntSuffix.length()) ||
+        (narrowFilename.compare(narrowFilename.length() - fntSuffix.length(), fntSuffix.length(), fntSuffix) != 0))
+        return 1;
     const std::string suffixless = narrowFilename.substr(0, narrowFilename.length() - fntSuffix.length());
     const std::string kernFilename = suffixless + ".kern";
 
-    // http://www.cplusplus.com/forum/beginner/75503/
-    std::wstring wFilename(kernFilename.begin(), kernFilename.end());
-
-    FILE *file;
-    _wfopen_s(&file,
-        wFilename.c_str(),
-        L"rb,ccs=UTF-16LE" /// Be sure to open the UTF-16 file in binary mode
-        );
-
-    if (file == NULL)
+    MappedFile file;
+    if (!file.Open(kernFilename.c_str()))
         return 2;
 
-    while(!feof(file) && !ferror(file))
+    std::vector<unsigned int> text;
+    DecodeKernFile(file.Data(), file.Size(), text);
+    file.Close();
+
+    size_t lineBegin = 0;
+    while (lineBegin < text.size())
     {
-        const size_t bufSz = 512;
-        wchar_t LineOfChars[bufSz];
-        fgetws(LineOfChars, bufSz, file);
-        std::wstring line(LineOfChars);
+        size_t lineEnd = lineBegin;
+        while ((lineEnd < text.size()) && (text[lineEnd] != '\n'))
+            ++lineEnd;
+        size_t len = lineEnd - lineBegin;
+        if ((len > 0) && (text[lineBegin + len - 1] == '\r'))
+            --len;
 
-        if (line.empty()) // Blank lines ignored
+        const unsigned int* pLine = len > 0 ? &text[lineBegin] : NULL;
+        lineBegin = lineEnd + 1;
+
+        if (len == 0) // Blank lines ignored
             continue;
-        if (line.at(0) == L'#') // comment lines ignored
+        if (pLine[0] == '#') // comment lines ignored
             continue;
-        if (line.length() < 4)
+        if (len < 4)
             continue;
 
-        ///@note First line of file should be blank or we get a bad entry here.
-        const int c1 = line[0];
-        const int c2 = line[1];
-        const std::string numstr(line.begin()+3, line.end());
+        std::string numstr;
+        for (size_t i=3; i<len; ++i)
+        {
+            if (pLine[i] > 0x7f)
+                break;
+            numstr.push_back(static_cast<char>(pLine[i]));
+        }
         const int amt = atoi(numstr.c_str());
-        _AddKerningEntry(c1, c2, static_cast<short>(amt));
+        _AddKerningEntry(pLine[0], pLine[1], static_cast<short>(amt));
     }
 
-    fclose(file);
-#endif
-
     return 0;
 }
 
 
+/// Some characters are drawn shrunk down to 2/3 width.
+static float GetWidthScale(unsigned int ch)
+{
+    const bool isKatakana = (ch >= 0x30a0) && (ch <= 0x30ff);
+    const bool isCJK = (ch >= 0x4e00) && (ch <= 0x9fff);
+    const bool shrink = isCJK | isKatakana;
+    return shrink ? 2.f/3.f : 1.f;
+}
+
+///@return The distance in pixels the pen moves after drawing ch, 0 if ch is not drawn.
+float FontRenderer::GlyphAdvance(unsigned int ch) const
+{
+    const std::map<unsigned int, BMF_char>::const_iterator cit = m_charTable.find(ch);
+    if (cit == m_charTable.end())
+        return 0.f;
+    const BMF_char& charInfo = cit->second;
+    return static_cast<float>(charInfo.xadv) * GetWidthScale(ch);
+}
+
+///@return The horizontal displacement in pixels of ch when it follows chprev.
+int FontRenderer::KerningOffset(unsigned int chprev, unsigned int ch) const
+{
+    const std::pair<int,int> kpair(chprev, ch);
+    const std::map<std::pair<int,int>,short>::const_iterator kit = m_kernTable.find(kpair);
+    if (kit == m_kernTable.end())
+        return 0;
+    return kit->second;
+}
+
+/// Walks a NULL terminated wide string with the same interface as Utf8Iterator
+/// so both string types can share the layout code below. Where wchar_t is 16 bits
+/// the string is UTF-16, and surrogate pairs are combined into one code point.
+class WideCharIterator
+{
+public:
+    explicit WideCharIterator(const wchar_t* pStr) : m_p(pStr) {}
+    bool AtEnd() const { return *m_p == 0; }
+    unsigned int Next()
+    {
+        const unsigned int cu = static_cast<unsigned int>(*m_p++);
+        if ((sizeof(wchar_t) != 2) || (cu < 0xd800) || (cu > 0xdbff))
+            return cu;
+        const unsigned int lo = static_cast<unsigned int>(*m_p);
+        if ((lo < 0xdc00) || (lo > 0xdfff))
+            return cu;
+        ++m_p;
+        return 0x10000 + ((cu - 0xd800) << 10) + (lo - 0xdc00);
+    }
+
+protected:
+    const wchar_t* m_p;
+};
+
+///@return The length of the string as rendered on screen with kerning, in pixels
+///@note Measured as the draw loop and TextLayout place glyphs: the pen moves by
+/// GlyphAdvance and kerning only shifts a glyph, so the length is the furthest
+/// kerned right edge.
+template <class CodepointIterator>
+int FontRenderer::_LengthPixels(CodepointIterator it) const
+{
+    float pen = 0.f;
+    float extent = 0.f;
+    unsigned int chprev = 0;
+    bool first = true;
+    while (!it.AtEnd())
+    {
+        const unsigned int ch = it.Next();
+        const bool hasPrev = !first;
+        const unsigned int prev = chprev;
+        first = false;
+        chprev = ch;
+
+        if ((ch == 0xfeff) || (ch == 0x0d) || (ch == 0x0a)) // Not drawn
+            continue;
+
+        const float adv = GlyphAdvance(ch);
+        if (adv == 0.f)
+            continue;
+        const int kern = hasPrev ? KerningOffset(prev, ch) : 0;
+        const float right = pen + static_cast<float>(kern) + adv;
+        if (right > extent)
+            extent = right;
+        pen += adv;
+    }
+    return static_cast<int>(extent);
+}
+
 ///@param pWStr [in] Wide-character string to determine the length of
 ///@return The length of the string as rendered on screen, in pixels
 int FontRenderer::StringLengthPixels(const wchar_t* pWStr) const
 {
-    int totalPx = 0;
-    // Let's hope that the string is properly NULL terminated here.
-    const unsigned int len = wcslen(pWStr);
-    for (unsigned int i=0; i<len; ++i)
-    {
-        const wchar_t ch = pWStr[i];
-        const std::map<wchar_t, BMF_char>::const_iterator it = m_charTable.find(ch);
-        if (it != m_charTable.end())
-        {
-            const BMF_char& charInfo = it->second;
-            totalPx += charInfo.xadv;
-        }
-    }
-    return totalPx;
+    if (pWStr == NULL)
+        return 0;
+    return _LengthPixels(WideCharIterator(pWStr));
 }
 
-///@brief Convert narrow string to wide and call into that function for compatibility.
+///@param pStr [in] NULL terminated UTF-8 string to determine the length of
 int FontRenderer::StringLengthPixels(const char* pStr) const
 {
-    const std::string s(pStr);
-    const std::wstring ws(s.begin(), s.end());
+    if (pStr == NULL)
+        return 0;
+    return _LengthPixels(Utf8Iterator(pStr, strlen(pStr)));
+}
+
+///@param pStr [in] UTF-8 string to determine the length of, need not be NULL terminated
+///@param len Length of the string in bytes
+int FontRenderer::StringLengthPixels(const char* pStr, size_t len) const
+{
+    if (pStr == NULL)
+        return 0;
+    return _LengthPixels(Utf8Iterator(pStr, len));
+}
+
+///@brief Draw a NULL terminated UTF-8 string.
+void FontRenderer::DrawString(
+    const char* pStr,
+    int x,
+    int y,
+    float3 color,
+    const float* pProjMtx,
+    bool doKerning,
+    const float* pMvMtx) const
+{
+    if (pStr == NULL)
+        return;
 
-    return StringLengthPixels(ws.c_str());
+    _DrawCodepoints(Utf8Iterator(pStr, strlen(pStr)),
+        x,
+        y,
+        color,
+        pProjMtx,
+        doKerning,
+        pMvMtx);
 }
 
-///@brief Convert narrow string to wide and call into that function for compatibility.
+///@brief Draw len bytes of a UTF-8 string, which need not be NULL terminated.
+/// Lets callers draw a substring in place without making a copy of it.
 void FontRenderer::DrawString(
     const char* pStr,
+    size_t len,
     int x,
     int y,
     float3 color,
@@ -341,10 +768,10 @@ void FontRenderer::DrawString(
     bool doKerning,
     const float* pMvMtx) const
 {
-    const std::string s(pStr);
-    const std::wstring ws(s.begin(), s.end());
+    if (pStr == NULL)
+        return;
 
-    DrawWString(ws.c_str(),
+    _DrawCodepoints(Utf8Iterator(pStr, len),
         x,
         y,
         color,
@@ -353,9 +780,31 @@ void FontRenderer::DrawString(
         pMvMtx);
 }
 
+/// Draw a wide-character string of text using font texture and data.
+///@param pStr [in] The NULL terminated string to display
+void FontRenderer::DrawWString(const wchar_t* pStr,
+                              int x,
+                              int y,
+                              float3 color,
+                              const float* pProjMtx,
+                              bool doKerning,
+                              const float* pMvMtx) const
+{
+    if (pStr == NULL)
+        return;
 
-/// Draw an ASCII string of text using font texture and data.
-///@param pStr [in] The ASCII string to display
+    _DrawCodepoints(WideCharIterator(pStr),
+        x,
+        y,
+        color,
+        pProjMtx,
+        doKerning,
+        pMvMtx);
+}
+
+
+/// Draw a sequence of code points using font texture and data.
+///@param it An iterator over the code points to display
 ///@param x The x location on screen
 ///@param y The y location on screen
 ///@param pProjMtx [in] The projection matrix (typically to indicate pixel coordinates on screen)
@@ -363,7 +812,8 @@ void FontRenderer::DrawString(
 ///@param pMvMtx [in] An optional pointer to modelview matrix(default NULL)
 ///@todo Reorder DrawString parameters to put 2 matrices together.
 ///@note When pMvMtx != NULL, projection matrix will not be ortho pixel coordinates.
-void FontRenderer::DrawWString(const wchar_t* pStr,
+template <class CodepointIterator>
+void FontRenderer::_DrawCodepoints(CodepointIterator it,
                               int x,
                               int y,
                               float3 color,
@@ -373,36 +823,51 @@ void FontRenderer::DrawWString(const wchar_t* pStr,
 {
     const float tracking = 1.0f;
 
+    if (!m_resident)
+        return;
     if (m_charTable.empty())
         return;
 
-    const GLuint prog = m_shader.prog();
-    glUseProgram(prog);
+    // Pages drawn from in this call are stamped with the new clock value and
+    // protected from eviction until the call returns.
+    ++m_useClock;
+
+    GLStateMgr& state = GLStateMgr::Instance();
+    state.UseProgram(m_shader.prog());
 
     if (pMvMtx == NULL)
     {
         // The old 2D path - assume an identity mv matrix
         float mvmtx[16];
         MakeIdentityMatrix(mvmtx);
-        glUniformMatrix4fv(m_shader.GetUniLoc("mvmtx"), 1, false, mvmtx);
-        glUniformMatrix4fv(m_shader.GetUniLoc("prmtx"), 1, false, pProjMtx);
+        m_shader.SetUniformMatrix4fv(m_uniMvmtx, mvmtx);
+        m_shader.SetUniformMatrix4fv(m_uniPrmtx, pProjMtx);
     }
     else
     {
-        glUniformMatrix4fv(m_shader.GetUniLoc("mvmtx"), 1, false, pMvMtx);
-        glUniformMatrix4fv(m_shader.GetUniLoc("prmtx"), 1, false, pProjMtx);
+        m_shader.SetUniformMatrix4fv(m_uniMvmtx, pMvMtx);
+        m_shader.SetUniformMatrix4fv(m_uniPrmtx, pProjMtx);
     }
 
+    state.ActiveTexture(GL_TEXTURE0);
+    m_shader.SetUniform1i(m_uniTexture, 0);
+    m_shader.SetUniform3f(m_uniFontColor, color.x, color.y, color.z);
+
     const int texDim = m_texDimension;
     const float fTexDim = static_cast<float>(texDim);
 
     float currx = static_cast<float>(x); // incremented with each character drawn
 
-    // Let's hope that the string is properly NULL terminated here.
-    const unsigned int len = wcslen(pStr);
-    for (unsigned int i=0; i<len; ++i)
+    unsigned int chprev = 0;
+    bool first = true;
+    while (!it.AtEnd())
     {
-        const wchar_t ch = pStr[i];
+        const unsigned int ch = it.Next();
+        const bool hasPrev = !first;
+        const unsigned int prev = chprev;
+        first = false;
+        chprev = ch;
+
         if (ch == 0xfeff) // Skip byte order mark
             continue;
         if (ch == 0x0d) // Skip carriage returns
@@ -412,7 +877,8 @@ void FontRenderer::DrawWString(const wchar_t* pStr,
         //if (ch == 0x09) ///<@todo Handle tab characters?
         //    continue;
 
-        if (m_charTable.find(ch) == m_charTable.end())
+        const std::map<unsigned int, BMF_char>::const_iterator cit = m_charTable.find(ch);
+        if (cit == m_charTable.end())
         {
             // Since the draw function is const, we use a static table to hold
             // unrecognized chars for just one print each.
@@ -423,49 +889,23 @@ void FontRenderer::DrawWString(const wchar_t* pStr,
             }
             continue;
         }
+        const BMF_char& charInfo = cit->second;
 
-        const std::map<wchar_t, BMF_char>::const_iterator it = m_charTable.find(ch);
-        if (it == m_charTable.end())
-            continue;
-        const BMF_char& charInfo = it->second;
-
-        ///@todo Cache the value so we don't have to rebind it if it doesn't change.
-        /// This is probably exactly what the driver does...
-        const unsigned int tIdx = charInfo.page;
-        if (tIdx >= m_pageTextures.size())
-            continue;
-        const GLuint texID = m_pageTextures[tIdx];
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texID);
-        glUniform1i(m_shader.GetUniLoc("s_texture"), 0);
-
-        glUniform3f(m_shader.GetUniLoc("u_fontColor"), color.x, color.y, color.z);
+        // Shrink down some characters to 2/3 width
+        const float widthScale = GetWidthScale(ch);
 
-        int kernamt = 0;
-        if (doKerning)
+        // Uploading a page may bind its texture, so look it up before binding.
+        // A glyph whose page is still being read is left blank, keeping its space.
+        const GLuint texID = _GetPageTexture(charInfo.page);
+        if (texID == 0)
         {
-            //if (i < (len-1))
-            if (i > 0)
-            {
-                const wchar_t chprev = pStr[i-1];
-                //const wchar_t chnext = pStr[i+1];
-
-                // Find kern delta value for this specific character pair.
-                std::pair<int,int> kpair(chprev, ch);
-                const std::map<std::pair<int,int>,short>::const_iterator kit = m_kernTable.find(kpair);
-                if (kit != m_kernTable.end())
-                {
-                    const short& val = kit->second;
-                    kernamt = val;
-                }
-            }
+            currx += tracking * static_cast<float>(charInfo.xadv) * widthScale;
+            continue;
         }
+        state.BindTexture(GL_TEXTURE_2D, texID);
 
-        // Shrink down some characters to 2/3 width
-        const bool isKatakana = (ch >= 0x30a0) && (ch <= 0x30ff);
-        const bool isCJK = (ch >= 0x4e00) && (ch <= 0x9fff);
-        const bool shrink = isCJK | isKatakana;
-        const float widthScale = shrink ? 2.f/3.f : 1.f;
+        // Find kern delta value for this specific character pair.
+        const int kernamt = (doKerning && hasPrev) ? KerningOffset(prev, ch) : 0;
 
         const float xoff = currx + static_cast<float>(kernamt);
         const float yoff = static_cast<float>(y + charInfo.yoff); ///@note Characters are top-aligned
@@ -491,14 +931,14 @@ void FontRenderer::DrawWString(const wchar_t* pStr,
 
         m_shader.bindVAO();
         {
-            glBindBuffer(GL_ARRAY_BUFFER, m_shader.GetVboLoc("a_position"));
+            state.BindBuffer(GL_ARRAY_BUFFER, m_vboPosition);
             glBufferData(GL_ARRAY_BUFFER, 4*3*sizeof(GLfloat), vVertices, GL_STATIC_DRAW);
-            glBindBuffer(GL_ARRAY_BUFFER, m_shader.GetVboLoc("a_texCoord"));
+            state.BindBuffer(GL_ARRAY_BUFFER, m_vboTexCoord);
             glBufferData(GL_ARRAY_BUFFER, 4*2*sizeof(GLfloat), vTexCoords, GL_STATIC_DRAW);
             glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, indices);
         }
-        glBindVertexArray(0);
 
         currx += tracking * static_cast<float>(charInfo.xadv) * widthScale;
     }
+    state.BindVertexArray(0);
 }
@@ -12,14 +12,33 @@
 
 #include "BMFont_structs.h"
 
+class FontRenderer;
+
+///@brief Reads a FontRenderer's glyph pages off the GL thread. When a glyph on a page
+/// that is not in memory is drawn, the font asks for the page here and skips the glyph;
+/// the reader calls ReadPagePixels on its own thread and hands the pixels back to
+/// ReceivePage on the GL thread.
+class FontPageReader
+{
+public:
+    virtual ~FontPageReader() {}
+
+    virtual void RequestPage(const FontRenderer& font, unsigned int page) = 0;
+};
+
 /// Loads bitmap fonts created by AngelSoft's BMFont and displays text
 /// using textured triangles in OpenGLES.
 class FontRenderer : public Renderer
 {
 public:
-    FontRenderer(const char* pFontName, int windowHeight);
+    FontRenderer(const char* pFontName, int windowHeight, bool loadNow=true);
     virtual ~FontRenderer();
 
+    void LoadFiles();
+    void LoadMetrics();
+    void InitGL();
+    bool UpdateGL();
+
     void DrawString(
         const char* pStr,
         int x,
@@ -29,6 +48,16 @@ public:
         bool doKerning,
         const float* pMvMtx=NULL) const;
 
+    void DrawString(
+        const char* pStr,
+        size_t len,
+        int x,
+        int y,
+        float3 color,
+        const float* pProjMtx,
+        bool doKerning,
+        const float* pMvMtx=NULL) const;
+
     void DrawWString(
         const wchar_t* pStr,
         int x,
@@ -40,31 +69,84 @@ public:
 
     void PrintKerningPairs(int firstChar=0, int secondChar=0) const;
 
+    void SetPageBudgetBytes(size_t bytes);
+    void EvictAllPages();
+    void SetPageReader(FontPageReader* pReader) { m_pPageReader = pReader; }
+    bool ReadPagePixels(unsigned int page, std::vector<unsigned char>& pixels) const;
+    void ReceivePage(unsigned int page, std::vector<unsigned char>& pixels);
+
     /// const Accessors
     int StringLengthPixels(const char* pStr) const;
+    int StringLengthPixels(const char* pStr, size_t len) const;
     int StringLengthPixels(const wchar_t* pWStr) const;
+    float GlyphAdvance(unsigned int ch) const;
+    int KerningOffset(unsigned int chprev, unsigned int ch) const;
     int GetWindowHeight() const { return m_windowHeight; }
     int GetLineHeight  () const { return m_lineHeight; }
     int GetBase        () const { return m_basePx; }
+    bool IsResident    () const { return m_resident; }
+    const std::string& GetFontName() const { return m_fontName; }
+    size_t GetPageCount() const { return m_pageFilenames.size(); }
+    size_t GetResidentPageCount() const;
+    size_t GetResidentPageBytes() const { return m_residentPageBytes; }
+    size_t GetPageBudgetBytes  () const { return m_pageBudgetBytes; }
 
 protected:
     void _LoadFntFile(const char* pFilename);
-    void _ProcessBlock(unsigned char id, unsigned int sz, unsigned char* pBlock);
+    void _ProcessBlock(unsigned char id, unsigned int sz, const unsigned char* pBlock);
     void _AddKerningEntry(int chprev, int ch, short amount);
     int _AddCustomKerningEntries(const char* pFilename);
+    std::string _GetPageRawFilename(size_t page) const;
+    size_t _GetPageBytes() const { return m_texDimension * m_texDimension; }
+    GLuint _GetPageTexture(unsigned int page) const;
+    bool _MakePageResident(unsigned int page) const;
+    bool _EvictLeastRecentlyUsedPage() const;
+    void _EvictPage(size_t page) const;
+
+    template <class CodepointIterator>
+    int _LengthPixels(CodepointIterator it) const;
+
+    template <class CodepointIterator>
+    void _DrawCodepoints(
+        CodepointIterator it,
+        int x,
+        int y,
+        float3 color,
+        const float* pProjMtx,
+        bool doKerning,
+        const float* pMvMtx) const;
 
+    std::string                       m_fontName;
     GLuint                            m_texDimension; ///< Square power-of-two dimension textures preferred
-    std::map<wchar_t, BMF_char>       m_charTable;
+    std::map<unsigned int, BMF_char>  m_charTable;        ///< Keyed by code point
     std::map<
         std::pair<int,int>,
         short >                       m_kernTable;
     std::vector<std::string>          m_pageFilenames;
-    std::vector<GLuint>               m_pageTextures;
+    size_t                            m_pageBudgetBytes;   ///< 0 for no limit on resident pages
+
+    /// Pages are uploaded on first draw of one of their glyphs and may be evicted
+    /// again; the draw functions are const, so residency state is mutable.
+    mutable std::vector<GLuint>       m_pageTextures;      ///< 0 if the page is not resident
+    mutable std::vector<unsigned int> m_pageLastUse;       ///< Value of m_useClock when last drawn from
+    mutable std::vector<
+        std::vector<unsigned char> >  m_pagePixels;        ///< Preloaded by LoadFiles, freed on upload
+    mutable std::vector<bool>         m_pageRequested;     ///< Read asked of m_pPageReader and not yet received
+    FontPageReader*                   m_pPageReader;       ///< NULL to read pages on the GL thread when drawn
+    mutable size_t                    m_residentPageBytes;
+    mutable unsigned int              m_useClock;          ///< Incremented once per draw call
+    bool                              m_resident;          ///< true once UpdateGL has found the shader built
     int                               m_windowHeight;
     int                               m_lineHeight;
     int                               m_basePx;
 
     ShaderWithVariables m_shader;
+    int                 m_uniMvmtx;     ///< Uniform handles into m_shader, resolved in InitGL
+    int                 m_uniPrmtx;
+    int                 m_uniTexture;
+    int                 m_uniFontColor;
+    GLuint              m_vboPosition;  ///< Owned by m_shader, created in UpdateGL
+    GLuint              m_vboTexCoord;
 
 private:
     FontRenderer();                                 ///< disallow default constructor
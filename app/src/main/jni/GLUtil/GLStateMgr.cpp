@@ -0,0 +1,226 @@
+// GLStateMgr.cpp
+
+#include "GLStateMgr.h"
+
+/// Shadow value for state that must be set before it can be elided.
+static const GLuint s_unknown = 0xffffffff;
+
+GLStateMgr::GLStateMgr()
+: m_program(s_unknown)
+, m_vao(s_unknown)
+, m_activeUnit(s_unknown)
+, m_blendSrc(s_unknown)
+, m_blendDst(s_unknown)
+, m_depthMask(s_unknown)
+, m_callsIssued(0)
+, m_callsElided(0)
+{
+    Invalidate();
+}
+
+///@brief Forget all shadowed state so the next call to each setter reaches GL.
+void GLStateMgr::Invalidate()
+{
+    m_program = s_unknown;
+    m_vao = s_unknown;
+    for (int i=0; i<NumBufferTargets; ++i)
+        m_buffers[i] = s_unknown;
+    m_activeUnit = s_unknown;
+    for (int u=0; u<NumTextureUnits; ++u)
+        for (int t=0; t<NumTextureTargets; ++t)
+            m_textures[u][t] = s_unknown;
+    for (int i=0; i<NumCapabilities; ++i)
+        m_capabilities[i] = s_unknown;
+    m_blendSrc = s_unknown;
+    m_blendDst = s_unknown;
+    m_depthMask = s_unknown;
+}
+
+///@return true if requested differs from current, which it replaces
+bool GLStateMgr::_Changed(GLuint& current, GLuint requested)
+{
+    if (current == requested)
+    {
+        ++m_callsElided;
+        return false;
+    }
+    current = requested;
+    ++m_callsIssued;
+    return true;
+}
+
+///@return Index into m_buffers, or -1 for targets that are not tracked
+int GLStateMgr::_BufferSlot(GLenum target)
+{
+    switch (target)
+    {
+    case GL_ARRAY_BUFFER:        return 0;
+    case GL_UNIFORM_BUFFER:      return 1;
+    case GL_PIXEL_PACK_BUFFER:   return 2;
+    case GL_PIXEL_UNPACK_BUFFER: return 3;
+    default:                     return -1; // GL_ELEMENT_ARRAY_BUFFER belongs to the VAO
+    }
+}
+
+int GLStateMgr::_TextureSlot(GLenum target)
+{
+    switch (target)
+    {
+    case GL_TEXTURE_2D:       return 0;
+    case GL_TEXTURE_CUBE_MAP: return 1;
+    case GL_TEXTURE_3D:       return 2;
+    case GL_TEXTURE_2D_ARRAY: return 3;
+    default:                  return -1;
+    }
+}
+
+int GLStateMgr::_CapabilitySlot(GLenum cap)
+{
+    switch (cap)
+    {
+    case GL_BLEND:        return 0;
+    case GL_DEPTH_TEST:   return 1;
+    case GL_CULL_FACE:    return 2;
+    case GL_SCISSOR_TEST: return 3;
+    default:              return -1;
+    }
+}
+
+void GLStateMgr::UseProgram(GLuint program)
+{
+    if (_Changed(m_program, program))
+        glUseProgram(program);
+}
+
+void GLStateMgr::BindVertexArray(GLuint vao)
+{
+    if (_Changed(m_vao, vao))
+        glBindVertexArray(vao);
+}
+
+void GLStateMgr::BindBuffer(GLenum target, GLuint buffer)
+{
+    const int slot = _BufferSlot(target);
+    if ((slot >= 0) && !_Changed(m_buffers[slot], buffer))
+        return;
+    if (slot < 0)
+        ++m_callsIssued;
+    glBindBuffer(target, buffer);
+}
+
+///@brief glBindBufferBase also binds the buffer to target's generic binding point.
+void GLStateMgr::BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    ++m_callsIssued;
+    glBindBufferBase(target, index, buffer);
+    const int slot = _BufferSlot(target);
+    if (slot >= 0)
+        m_buffers[slot] = buffer;
+}
+
+void GLStateMgr::ActiveTexture(GLenum unit)
+{
+    if (_Changed(m_activeUnit, unit - GL_TEXTURE0))
+        glActiveTexture(unit);
+}
+
+void GLStateMgr::BindTexture(GLenum target, GLuint texture)
+{
+    const int slot = _TextureSlot(target);
+    if ((slot >= 0) && (m_activeUnit < NumTextureUnits))
+    {
+        if (_Changed(m_textures[m_activeUnit][slot], texture))
+            glBindTexture(target, texture);
+        return;
+    }
+    ++m_callsIssued;
+    glBindTexture(target, texture);
+}
+
+void GLStateMgr::_SetCapability(GLenum cap, bool enable)
+{
+    const int slot = _CapabilitySlot(cap);
+    if ((slot >= 0) && !_Changed(m_capabilities[slot], enable ? 1 : 0))
+        return;
+    if (slot < 0)
+        ++m_callsIssued;
+    if (enable)
+        glEnable(cap);
+    else
+        glDisable(cap);
+}
+
+void GLStateMgr::Enable(GLenum cap)
+{
+    _SetCapability(cap, true);
+}
+
+void GLStateMgr::Disable(GLenum cap)
+{
+    _SetCapability(cap, false);
+}
+
+void GLStateMgr::BlendFunc(GLenum sfactor, GLenum dfactor)
+{
+    if ((m_blendSrc == sfactor) && (m_blendDst == dfactor))
+    {
+        ++m_callsElided;
+        return;
+    }
+    m_blendSrc = sfactor;
+    m_blendDst = dfactor;
+    ++m_callsIssued;
+    glBlendFunc(sfactor, dfactor);
+}
+
+void GLStateMgr::DepthMask(GLboolean flag)
+{
+    if (_Changed(m_depthMask, flag ? 1 : 0))
+        glDepthMask(flag);
+}
+
+void GLStateMgr::DeleteProgram(GLuint program)
+{
+    if (program == 0)
+        return;
+    glDeleteProgram(program);
+    // A program in use is only flagged for deletion, but forget it anyway.
+    if (m_program == program)
+        m_program = s_unknown;
+}
+
+void GLStateMgr::DeleteVertexArray(GLuint vao)
+{
+    if (vao == 0)
+        return;
+    glDeleteVertexArrays(1, &vao);
+    if (m_vao == vao)
+        m_vao = 0; // Deleting the bound VAO reverts to the default
+}
+
+void GLStateMgr::DeleteBuffer(GLuint buffer)
+{
+    if (buffer == 0)
+        return;
+    glDeleteBuffers(1, &buffer);
+    for (int i=0; i<NumBufferTargets; ++i)
+    {
+        if (m_buffers[i] == buffer)
+            m_buffers[i] = 0;
+    }
+}
+
+void GLStateMgr::DeleteTexture(GLuint texture)
+{
+    if (texture == 0)
+        return;
+    glDeleteTextures(1, &texture);
+    for (int u=0; u<NumTextureUnits; ++u)
+    {
+        for (int t=0; t<NumTextureTargets; ++t)
+        {
+            if (m_textures[u][t] == texture)
+                m_textures[u][t] = 0;
+        }
+    }
+}
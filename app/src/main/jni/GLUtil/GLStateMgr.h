@@ -0,0 +1,78 @@
+// GLStateMgr.h
+
+#pragma once
+
+#include "Singleton.h"
+#include "GL_Includes.h"
+
+///@brief Shadows the GL binding and enable state most often set around draws
+/// and issues a GL call only when the requested state differs from it.
+/// All C++ code should set the tracked state through here; anything changing
+/// it behind our back (such as Lua's FFI GL calls) must be followed by
+/// Invalidate(). Objects must be deleted through here as well, since GL
+/// unbinds deleted objects and may hand their names out again.
+///@warning Do not attempt to access this object outside of the GL thread!
+class GLStateMgr : public Singleton
+{
+public:
+    static GLStateMgr& Instance()
+    {
+        static GLStateMgr instance;
+        return instance;
+    }
+
+    void Invalidate();
+
+    void UseProgram(GLuint program);
+    void BindVertexArray(GLuint vao);
+    void BindBuffer(GLenum target, GLuint buffer);
+    void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+    void ActiveTexture(GLenum unit);
+    void BindTexture(GLenum target, GLuint texture);
+    void Enable(GLenum cap);
+    void Disable(GLenum cap);
+    void BlendFunc(GLenum sfactor, GLenum dfactor);
+    void DepthMask(GLboolean flag);
+
+    void DeleteProgram(GLuint program);
+    void DeleteVertexArray(GLuint vao);
+    void DeleteBuffer(GLuint buffer);
+    void DeleteTexture(GLuint texture);
+
+    /// const Accessors
+    int GetCallsIssued() const { return m_callsIssued; }
+    int GetCallsElided() const { return m_callsElided; }
+    void ResetCallCounts() { m_callsIssued = 0; m_callsElided = 0; }
+
+protected:
+    bool _Changed(GLuint& current, GLuint requested);
+    static int _BufferSlot(GLenum target);
+    static int _TextureSlot(GLenum target);
+    static int _CapabilitySlot(GLenum cap);
+    void _SetCapability(GLenum cap, bool enable);
+
+    enum {
+        NumBufferTargets = 4,   ///< Array, uniform, pixel pack and unpack
+        NumTextureUnits = 16,
+        NumTextureTargets = 4,  ///< 2D, cube map, 3D and 2D array
+        NumCapabilities = 4     ///< Blend, depth test, cull face and scissor test
+    };
+
+    GLuint  m_program;
+    GLuint  m_vao;
+    GLuint  m_buffers[NumBufferTargets];
+    GLuint  m_activeUnit;  ///< Offset from GL_TEXTURE0
+    GLuint  m_textures[NumTextureUnits][NumTextureTargets];
+    GLuint  m_capabilities[NumCapabilities];
+    GLuint  m_blendSrc;
+    GLuint  m_blendDst;
+    GLuint  m_depthMask;
+    int     m_callsIssued;
+    int     m_callsElided;
+
+private:
+    GLStateMgr();
+    ~GLStateMgr() {}
+    GLStateMgr(GLStateMgr const& copy);            // Not Implemented
+    GLStateMgr& operator=(GLStateMgr const& copy); // Not Implemented
+};
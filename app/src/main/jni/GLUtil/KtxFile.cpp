@@ -0,0 +1,354 @@
+// KtxFile.cpp
+
+#include "KtxFile.h"
+#include "Logging.h"
+
+#include <string.h>
+
+static const unsigned char s_ktx1Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const unsigned char s_ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const unsigned int s_ktx1HeaderBytes = 64;
+static const unsigned int s_ktx2HeaderBytes = 80;
+static const unsigned int s_ktx2LevelIndexBytes = 24;
+
+static unsigned int readU32(const unsigned char* p, bool swap)
+{
+    if (swap)
+        return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+}
+
+static size_t readU64(const unsigned char* p)
+{
+    const unsigned long long lo = readU32(p, false);
+    const unsigned long long hi = readU32(p + 4, false);
+    return static_cast<size_t>(lo | (hi << 32));
+}
+
+static size_t padTo4(size_t n)
+{
+    return (n + 3) & ~static_cast<size_t>(3);
+}
+
+struct VkFormatEntry
+{
+    unsigned int vkFormat;
+    GLenum internalFormat;
+    GLenum format;
+    GLenum type;
+};
+
+/// The KTX2 formats that have a GLES 3.0 equivalent; ASTC is handled separately.
+static const VkFormatEntry s_vkFormats[] = {
+    {   9, GL_R8,                                      GL_RED,  GL_UNSIGNED_BYTE },
+    {  16, GL_RG8,                                     GL_RG,   GL_UNSIGNED_BYTE },
+    {  23, GL_RGB8,                                    GL_RGB,  GL_UNSIGNED_BYTE },
+    {  29, GL_SRGB8,                                   GL_RGB,  GL_UNSIGNED_BYTE },
+    {  37, GL_RGBA8,                                   GL_RGBA, GL_UNSIGNED_BYTE },
+    {  43, GL_SRGB8_ALPHA8,                            GL_RGBA, GL_UNSIGNED_BYTE },
+    { 147, GL_COMPRESSED_RGB8_ETC2,                    0, 0 },
+    { 148, GL_COMPRESSED_SRGB8_ETC2,                   0, 0 },
+    { 149, GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2,  0, 0 },
+    { 150, GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2, 0, 0 },
+    { 151, GL_COMPRESSED_RGBA8_ETC2_EAC,               0, 0 },
+    { 152, GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC,        0, 0 },
+    { 153, GL_COMPRESSED_R11_EAC,                      0, 0 },
+    { 154, GL_COMPRESSED_SIGNED_R11_EAC,               0, 0 },
+    { 155, GL_COMPRESSED_RG11_EAC,                     0, 0 },
+    { 156, GL_COMPRESSED_SIGNED_RG11_EAC,              0, 0 },
+};
+
+/// VK_FORMAT_ASTC_4x4_UNORM_BLOCK through VK_FORMAT_ASTC_12x12_SRGB_BLOCK
+/// alternate UNORM and SRGB in the same block size order as the GL enums.
+static const unsigned int s_vkAstcFirst = 157;
+static const unsigned int s_astcBlockSizeCount = 14;
+static const unsigned char s_astcBlockDims[s_astcBlockSizeCount][2] = {
+    { 4, 4}, { 5, 4}, { 5, 5}, { 6, 5}, { 6, 6}, { 8, 5}, { 8, 6},
+    { 8, 8}, {10, 5}, {10, 6}, {10, 8}, {10,10}, {12,10}, {12,12}
+};
+
+bool IsEtcFormat(GLenum internalFormat)
+{
+    if (internalFormat == GL_ETC1_RGB8_OES)
+        return true;
+    return (internalFormat >= GL_COMPRESSED_R11_EAC) && (internalFormat <= GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC);
+}
+
+bool IsAstcFormat(GLenum internalFormat)
+{
+    if ((internalFormat >= GL_COMPRESSED_RGBA_ASTC_4x4_KHR) && (internalFormat <= GL_COMPRESSED_RGBA_ASTC_12x12_KHR))
+        return true;
+    return (internalFormat >= GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR) && (internalFormat <= GL_COMPRESSED_SRGB8_ALPHA8_ASTC_12x12_KHR);
+}
+
+///@return false if the format is not a compressed format known here
+bool GetCompressedBlockSize(GLenum internalFormat, unsigned int& blockWidth, unsigned int& blockHeight, unsigned int& blockBytes)
+{
+    if (IsEtcFormat(internalFormat))
+    {
+        blockWidth = 4;
+        blockHeight = 4;
+        const bool twoBlocks =
+            (internalFormat == GL_COMPRESSED_RG11_EAC) ||
+            (internalFormat == GL_COMPRESSED_SIGNED_RG11_EAC) ||
+            (internalFormat == GL_COMPRESSED_RGBA8_ETC2_EAC) ||
+            (internalFormat == GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC);
+        blockBytes = twoBlocks ? 16 : 8;
+        return true;
+    }
+    if (IsAstcFormat(internalFormat))
+    {
+        const unsigned int i = (internalFormat >= GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR) ?
+            internalFormat - GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR :
+            internalFormat - GL_COMPRESSED_RGBA_ASTC_4x4_KHR;
+        blockWidth = s_astcBlockDims[i][0];
+        blockHeight = s_astcBlockDims[i][1];
+        blockBytes = 16;
+        return true;
+    }
+    return false;
+}
+
+///@return Bytes in one compressed image of the given size, or 0 if the format is not known here
+size_t GetCompressedImageSize(GLenum internalFormat, unsigned int width, unsigned int height)
+{
+    unsigned int blockWidth = 0;
+    unsigned int blockHeight = 0;
+    unsigned int blockBytes = 0;
+    if (!GetCompressedBlockSize(internalFormat, blockWidth, blockHeight, blockBytes))
+        return 0;
+    const size_t blocksX = (width + blockWidth - 1) / blockWidth;
+    const size_t blocksY = (height + blockHeight - 1) / blockHeight;
+    return blocksX * blocksY * blockBytes;
+}
+
+KtxFile::KtxFile()
+: m_file()
+, m_images()
+, m_glInternalFormat(0)
+, m_glFormat(0)
+, m_glType(0)
+, m_width(0)
+, m_height(0)
+, m_levelCount(0)
+, m_layerCount(0)
+, m_faceCount(0)
+, m_isArray(false)
+, m_generateMips(false)
+, m_rowAlignment(1)
+{
+}
+
+///@brief Map a .ktx or .ktx2 file and index its images.
+///@return false if the file is missing, malformed or uses an unsupported feature
+bool KtxFile::Open(const char* pFilename)
+{
+    Close();
+    if (!m_file.Open(pFilename))
+    {
+        LOG_ERROR("File %s not found.", pFilename);
+        return false;
+    }
+
+    bool ok = false;
+    if ((m_file.Size() >= s_ktx1HeaderBytes) && (memcmp(m_file.Data(), s_ktx1Identifier, 12) == 0))
+        ok = _ParseKtx1();
+    else if ((m_file.Size() >= s_ktx2HeaderBytes) && (memcmp(m_file.Data(), s_ktx2Identifier, 12) == 0))
+        ok = _ParseKtx2();
+    else
+        LOG_ERROR("%s is not a KTX file.", pFilename);
+
+    if (!ok)
+    {
+        LOG_ERROR("Could not read KTX file %s", pFilename);
+        Close();
+    }
+    return ok;
+}
+
+void KtxFile::Close()
+{
+    m_file.Close();
+    m_images.clear();
+    m_glInternalFormat = 0;
+    m_glFormat = 0;
+    m_glType = 0;
+    m_width = 0;
+    m_height = 0;
+    m_levelCount = 0;
+    m_layerCount = 0;
+    m_faceCount = 0;
+    m_isArray = false;
+    m_generateMips = false;
+    m_rowAlignment = 1;
+}
+
+///@return The image's data, pointing into the mapped file, or NULL if out of range
+const unsigned char* KtxFile::GetImage(unsigned int level, unsigned int layer, unsigned int face, size_t& bytes) const
+{
+    bytes = 0;
+    if ((level >= m_levelCount) || (layer >= m_layerCount) || (face >= m_faceCount))
+        return NULL;
+    const ImageRef& image = m_images[(level * m_layerCount + layer) * m_faceCount + face];
+    bytes = image.bytes;
+    return m_file.Data() + image.offset;
+}
+
+bool KtxFile::_AddImage(size_t offset, size_t bytes)
+{
+    if ((offset > m_file.Size()) || (bytes > m_file.Size() - offset))
+    {
+        LOG_ERROR("KTX image data runs past the end of the file.");
+        return false;
+    }
+    ImageRef image;
+    image.offset = offset;
+    image.bytes = bytes;
+    m_images.push_back(image);
+    return true;
+}
+
+bool KtxFile::_ParseKtx1()
+{
+    const unsigned char* pHeader = m_file.Data() + 12;
+    const unsigned int endianness = readU32(pHeader, false);
+    const bool swap = (endianness == 0x01020304);
+    if (!swap && (endianness != 0x04030201))
+        return false;
+
+    m_glType                  = readU32(pHeader +  4, swap);
+    const unsigned int typeSz = readU32(pHeader +  8, swap);
+    m_glFormat                = readU32(pHeader + 12, swap);
+    m_glInternalFormat        = readU32(pHeader + 16, swap);
+    m_width                   = readU32(pHeader + 24, swap);
+    m_height                  = readU32(pHeader + 28, swap);
+    const unsigned int depth  = readU32(pHeader + 32, swap);
+    const unsigned int arrayElements = readU32(pHeader + 36, swap);
+    m_faceCount               = readU32(pHeader + 40, swap);
+    m_levelCount              = readU32(pHeader + 44, swap);
+    const unsigned int kvBytes = readU32(pHeader + 48, swap);
+
+    if (depth > 1)
+    {
+        LOG_ERROR("3D KTX textures are not supported.");
+        return false;
+    }
+    if (swap && (typeSz > 1))
+    {
+        LOG_ERROR("KTX file has the wrong endianness for its pixel type.");
+        return false;
+    }
+    if ((m_faceCount != 1) && (m_faceCount != 6))
+        return false;
+
+    // KTX 1 pads uncompressed rows to 4 bytes, as GL unpacks by default.
+    m_rowAlignment = 4;
+    m_isArray = (arrayElements > 0);
+    m_layerCount = m_isArray ? arrayElements : 1;
+    m_generateMips = (m_levelCount == 0);
+    if (m_levelCount == 0)
+        m_levelCount = 1;
+
+    size_t offset = s_ktx1HeaderBytes + kvBytes;
+    for (unsigned int level=0; level<m_levelCount; ++level)
+    {
+        if (offset + 4 > m_file.Size())
+            return false;
+        const size_t imageSize = readU32(m_file.Data() + offset, swap);
+        offset += 4;
+
+        // A non-array cubemap gives the size of one face, padded; anything else the whole level.
+        if ((m_faceCount == 6) && !m_isArray)
+        {
+            for (unsigned int face=0; face<m_faceCount; ++face)
+            {
+                if (!_AddImage(offset, imageSize))
+                    return false;
+                offset += padTo4(imageSize);
+            }
+        }
+        else
+        {
+            const size_t perImage = imageSize / (m_layerCount * m_faceCount);
+            for (unsigned int i=0; i<m_layerCount * m_faceCount; ++i)
+            {
+                if (!_AddImage(offset + i * perImage, perImage))
+                    return false;
+            }
+            offset += padTo4(imageSize);
+        }
+    }
+    return true;
+}
+
+bool KtxFile::_ParseKtx2()
+{
+    const unsigned char* pHeader = m_file.Data() + 12;
+    const unsigned int vkFormat    = readU32(pHeader +  0, false);
+    m_width                        = readU32(pHeader +  8, false);
+    m_height                       = readU32(pHeader + 12, false);
+    const unsigned int depth       = readU32(pHeader + 16, false);
+    const unsigned int layerCount  = readU32(pHeader + 20, false);
+    m_faceCount                    = readU32(pHeader + 24, false);
+    m_levelCount                   = readU32(pHeader + 28, false);
+    const unsigned int supercompression = readU32(pHeader + 32, false);
+
+    if (supercompression != 0)
+    {
+        LOG_ERROR("Supercompressed KTX2 files are not supported.");
+        return false;
+    }
+    if (depth > 1)
+    {
+        LOG_ERROR("3D KTX textures are not supported.");
+        return false;
+    }
+    if ((m_faceCount != 1) && (m_faceCount != 6))
+        return false;
+
+    m_glInternalFormat = 0;
+    for (size_t i=0; i<sizeof(s_vkFormats)/sizeof(s_vkFormats[0]); ++i)
+    {
+        if (s_vkFormats[i].vkFormat == vkFormat)
+        {
+            m_glInternalFormat = s_vkFormats[i].internalFormat;
+            m_glFormat = s_vkFormats[i].format;
+            m_glType = s_vkFormats[i].type;
+        }
+    }
+    if ((vkFormat >= s_vkAstcFirst) && (vkFormat < s_vkAstcFirst + 2 * s_astcBlockSizeCount))
+    {
+        const unsigned int i = (vkFormat - s_vkAstcFirst) / 2;
+        const bool srgb = ((vkFormat - s_vkAstcFirst) % 2) != 0;
+        m_glInternalFormat = (srgb ? GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR : GL_COMPRESSED_RGBA_ASTC_4x4_KHR) + i;
+        m_glFormat = 0;
+        m_glType = 0;
+    }
+    if (m_glInternalFormat == 0)
+    {
+        LOG_ERROR("KTX2 vkFormat %u is not supported.", vkFormat);
+        return false;
+    }
+
+    m_isArray = (layerCount > 0);
+    m_layerCount = m_isArray ? layerCount : 1;
+    m_generateMips = (m_levelCount == 0);
+    if (m_levelCount == 0)
+        m_levelCount = 1;
+
+    if (s_ktx2HeaderBytes + m_levelCount * s_ktx2LevelIndexBytes > m_file.Size())
+        return false;
+    for (unsigned int level=0; level<m_levelCount; ++level)
+    {
+        const unsigned char* pIndex = m_file.Data() + s_ktx2HeaderBytes + level * s_ktx2LevelIndexBytes;
+        const size_t levelOffset = readU64(pIndex);
+        const size_t levelBytes = readU64(pIndex + 8);
+        const size_t perImage = levelBytes / (m_layerCount * m_faceCount);
+        for (unsigned int i=0; i<m_layerCount * m_faceCount; ++i)
+        {
+            if (!_AddImage(levelOffset + i * perImage, perImage))
+                return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,83 @@
+// KtxFile.h
+
+#pragma once
+
+#include "GL_Includes.h"
+#include "MappedFile.h"
+#include <vector>
+
+/// ETC1 and ASTC formats are not in the core GL or GLES 3.0 headers.
+#ifndef GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+#define GL_COMPRESSED_RGBA_ASTC_4x4_KHR           0x93B0
+#define GL_COMPRESSED_RGBA_ASTC_12x12_KHR         0x93BD
+#define GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR   0x93D0
+#define GL_COMPRESSED_SRGB8_ALPHA8_ASTC_12x12_KHR 0x93DD
+#endif
+#ifndef GL_ETC1_RGB8_OES
+#define GL_ETC1_RGB8_OES                          0x8D64
+#endif
+
+///@brief A KTX (version 1) or KTX2 texture container mapped into memory.
+/// Images are referenced in place in the mapping, not copied. Supercompressed
+/// KTX2 files are not supported. Touches no GL state, so may be opened on a
+/// worker thread.
+class KtxFile
+{
+public:
+    KtxFile();
+    virtual ~KtxFile() {}
+
+    bool Open(const char* pFilename);
+    void Close();
+
+    const unsigned char* GetImage(unsigned int level, unsigned int layer, unsigned int face, size_t& bytes) const;
+
+    /// const Accessors
+    bool IsOpen() const { return m_file.IsOpen(); }
+    bool IsCompressed() const { return m_glType == 0; }
+    GLenum GetInternalFormat() const { return m_glInternalFormat; }
+    GLenum GetFormat() const { return m_glFormat; }
+    GLenum GetType() const { return m_glType; }
+    unsigned int GetWidth() const { return m_width; }
+    unsigned int GetHeight() const { return m_height; }
+    unsigned int GetLevelCount() const { return m_levelCount; }
+    unsigned int GetLayerCount() const { return m_layerCount; }
+    unsigned int GetFaceCount() const { return m_faceCount; }
+    bool IsArray() const { return m_isArray; }
+    bool NeedsMipmapGeneration() const { return m_generateMips; }
+    int GetRowAlignment() const { return m_rowAlignment; } ///< For uncompressed images
+
+protected:
+    struct ImageRef
+    {
+        size_t offset;
+        size_t bytes;
+    };
+
+    bool _ParseKtx1();
+    bool _ParseKtx2();
+    bool _AddImage(size_t offset, size_t bytes);
+
+    MappedFile                 m_file;
+    std::vector<ImageRef>      m_images; ///< Ordered by level, then layer, then face
+    GLenum                     m_glInternalFormat;
+    GLenum                     m_glFormat;
+    GLenum                     m_glType;
+    unsigned int               m_width;
+    unsigned int               m_height;
+    unsigned int               m_levelCount;
+    unsigned int               m_layerCount;
+    unsigned int               m_faceCount;
+    bool                       m_isArray;
+    bool                       m_generateMips;
+    int                        m_rowAlignment;
+
+private:
+    KtxFile(const KtxFile&);              ///< disallow copy constructor
+    KtxFile& operator = (const KtxFile&); ///< disallow assignment operator
+};
+
+bool IsEtcFormat(GLenum internalFormat);
+bool IsAstcFormat(GLenum internalFormat);
+bool GetCompressedBlockSize(GLenum internalFormat, unsigned int& blockWidth, unsigned int& blockHeight, unsigned int& blockBytes);
+size_t GetCompressedImageSize(GLenum internalFormat, unsigned int width, unsigned int height);
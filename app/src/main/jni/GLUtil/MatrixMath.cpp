@@ -6,27 +6,558 @@
 
 #include "VectorMath.h"
 #include "MatrixMath.h"
+#include "WorkerPool.h"
 
 #ifndef M_PI
 #  define M_PI   3.14159265358979323846264338327
 #endif
 
+// Vector kernels are picked at compile time: SSE is part of every x86 ABI we
+// build for, NEON is there on arm64 and on armv7 built with -mfpu=neon.
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#  include <xmmintrin.h>
+#  define MATRIXMATH_SSE
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#  include <arm_neon.h>
+#  define MATRIXMATH_NEON
+#endif
+
+/// Four floats as plain scalars. Every kernel below is written once against an
+/// ops struct; given the same sequence of IEEE operations, the vector versions
+/// produce exactly the same bits as this one.
+struct ScalarOps
+{
+    struct V { float f[4]; };
+
+    static inline V Load(const float* p) { V r = {{ p[0], p[1], p[2], p[3] }}; return r; }
+    static inline void Store(float* p, const V& a) { p[0] = a.f[0]; p[1] = a.f[1]; p[2] = a.f[2]; p[3] = a.f[3]; }
+    static inline V Splat(float x) { V r = {{ x, x, x, x }}; return r; }
+    static inline V Add(const V& a, const V& b) { V r = {{ a.f[0]+b.f[0], a.f[1]+b.f[1], a.f[2]+b.f[2], a.f[3]+b.f[3] }}; return r; }
+    static inline V Sub(const V& a, const V& b) { V r = {{ a.f[0]-b.f[0], a.f[1]-b.f[1], a.f[2]-b.f[2], a.f[3]-b.f[3] }}; return r; }
+    static inline V Mul(const V& a, const V& b) { V r = {{ a.f[0]*b.f[0], a.f[1]*b.f[1], a.f[2]*b.f[2], a.f[3]*b.f[3] }}; return r; }
+    static inline V Div(const V& a, const V& b) { V r = {{ a.f[0]/b.f[0], a.f[1]/b.f[1], a.f[2]/b.f[2], a.f[3]/b.f[3] }}; return r; }
+    static inline float First(const V& a) { return a.f[0]; }
+
+    /// Lanes x0 and x1 of a, then lanes y0 and y1 of b, as _mm_shuffle_ps does.
+    template <int x0, int x1, int y0, int y1>
+    static inline V Shuffle(const V& a, const V& b) { V r = {{ a.f[x0], a.f[x1], b.f[y0], b.f[y1] }}; return r; }
+
+    /// Four packed xyz points to and from one lane each of x, y and z
+    static inline void LoadXYZ(const float* p, V& x, V& y, V& z)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            x.f[i] = p[3*i];
+            y.f[i] = p[3*i + 1];
+            z.f[i] = p[3*i + 2];
+        }
+    }
+    static inline void StoreXYZ(float* p, const V& x, const V& y, const V& z)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            p[3*i]     = x.f[i];
+            p[3*i + 1] = y.f[i];
+            p[3*i + 2] = z.f[i];
+        }
+    }
+
+    static inline void Transpose(float* dst, const float* src)
+    {
+        float t[16];
+        for (int i = 0; i < 4; ++i)
+            for (int j = 0; j < 4; ++j)
+                t[4*j + i] = src[4*i + j];
+        memcpy(dst, t, 16*sizeof(float));
+    }
+};
+
+#if defined(MATRIXMATH_SSE)
+struct SimdOps
+{
+    typedef __m128 V;
+
+    static inline V Load(const float* p) { return _mm_loadu_ps(p); }
+    static inline void Store(float* p, V a) { _mm_storeu_ps(p, a); }
+    static inline V Splat(float x) { return _mm_set1_ps(x); }
+    static inline V Add(V a, V b) { return _mm_add_ps(a, b); }
+    static inline V Sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static inline V Mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static inline V Div(V a, V b) { return _mm_div_ps(a, b); }
+    static inline float First(V a) { return _mm_cvtss_f32(a); }
+
+    template <int x0, int x1, int y0, int y1>
+    static inline V Shuffle(V a, V b) { return _mm_shuffle_ps(a, b, _MM_SHUFFLE(y1, y0, x1, x0)); }
+
+    static inline void LoadXYZ(const float* p, V& x, V& y, V& z)
+    {
+        const V a = Load(p);     // x0 y0 z0 x1
+        const V b = Load(p + 4); // y1 z1 x2 y2
+        const V c = Load(p + 8); // z2 x3 y3 z3
+        x = Shuffle<0,3,0,2>(a, Shuffle<2,2,1,1>(b, c));
+        y = Shuffle<0,2,0,2>(Shuffle<1,1,0,0>(a, b), Shuffle<3,3,2,2>(b, c));
+        z = Shuffle<0,2,0,2>(Shuffle<2,2,1,1>(a, b), Shuffle<0,0,3,3>(c, c));
+    }
+    static inline void StoreXYZ(float* p, V x, V y, V z)
+    {
+        Store(p,     Shuffle<0,2,0,2>(Shuffle<0,0,0,0>(x, y), Shuffle<0,0,1,1>(z, x)));
+        Store(p + 4, Shuffle<0,2,0,2>(Shuffle<1,1,1,1>(y, z), Shuffle<2,2,2,2>(x, y)));
+        Store(p + 8, Shuffle<0,2,0,2>(Shuffle<2,2,3,3>(z, x), Shuffle<3,3,3,3>(y, z)));
+    }
+
+    static inline void Transpose(float* dst, const float* src)
+    {
+        V c0 = Load(src);
+        V c1 = Load(src + 4);
+        V c2 = Load(src + 8);
+        V c3 = Load(src + 12);
+        _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+        Store(dst, c0);
+        Store(dst + 4, c1);
+        Store(dst + 8, c2);
+        Store(dst + 12, c3);
+    }
+};
+#elif defined(MATRIXMATH_NEON)
+struct SimdOps
+{
+    typedef float32x4_t V;
+
+    static inline V Load(const float* p) { return vld1q_f32(p); }
+    static inline void Store(float* p, V a) { vst1q_f32(p, a); }
+    static inline V Splat(float x) { return vdupq_n_f32(x); }
+    static inline V Add(V a, V b) { return vaddq_f32(a, b); }
+    static inline V Sub(V a, V b) { return vsubq_f32(a, b); }
+    // Separate multiply and add; a fused vmla would round differently from ScalarOps.
+    static inline V Mul(V a, V b) { return vmulq_f32(a, b); }
+    static inline float First(V a) { return vgetq_lane_f32(a, 0); }
+
+    static inline V Div(V a, V b)
+    {
+#if defined(__aarch64__)
+        return vdivq_f32(a, b);
+#else
+        // armv7 NEON has only a reciprocal estimate; divide lane by lane to stay exact.
+        V r = vdupq_n_f32(vgetq_lane_f32(a, 0) / vgetq_lane_f32(b, 0));
+        r = vsetq_lane_f32(vgetq_lane_f32(a, 1) / vgetq_lane_f32(b, 1), r, 1);
+        r = vsetq_lane_f32(vgetq_lane_f32(a, 2) / vgetq_lane_f32(b, 2), r, 2);
+        r = vsetq_lane_f32(vgetq_lane_f32(a, 3) / vgetq_lane_f32(b, 3), r, 3);
+        return r;
+#endif
+    }
+
+    template <int x0, int x1, int y0, int y1>
+    static inline V Shuffle(V a, V b)
+    {
+        V r = vdupq_n_f32(vgetq_lane_f32(a, x0));
+        r = vsetq_lane_f32(vgetq_lane_f32(a, x1), r, 1);
+        r = vsetq_lane_f32(vgetq_lane_f32(b, y0), r, 2);
+        r = vsetq_lane_f32(vgetq_lane_f32(b, y1), r, 3);
+        return r;
+    }
+
+    static inline void LoadXYZ(const float* p, V& x, V& y, V& z)
+    {
+        const float32x4x3_t xyz = vld3q_f32(p);
+        x = xyz.val[0];
+        y = xyz.val[1];
+        z = xyz.val[2];
+    }
+    static inline void StoreXYZ(float* p, V x, V y, V z)
+    {
+        float32x4x3_t xyz;
+        xyz.val[0] = x;
+        xyz.val[1] = y;
+        xyz.val[2] = z;
+        vst3q_f32(p, xyz);
+    }
+
+    static inline void Transpose(float* dst, const float* src)
+    {
+        // A de-interleaving load reads the columns out as rows.
+        const float32x4x4_t rows = vld4q_f32(src);
+        Store(dst, rows.val[0]);
+        Store(dst + 4, rows.val[1]);
+        Store(dst + 8, rows.val[2]);
+        Store(dst + 12, rows.val[3]);
+    }
+};
+#endif
+
+#if defined(MATRIXMATH_SSE) || defined(MATRIXMATH_NEON)
+static bool s_useSimd = true;
+#else
+static bool s_useSimd = false;
+#endif
+
+/// Use the vector kernels if they were compiled in. Turning them off gives the
+/// scalar kernels for comparison; results are the same either way.
+void SetMatrixSimdEnabled(bool enable)
+{
+#if defined(MATRIXMATH_SSE) || defined(MATRIXMATH_NEON)
+    s_useSimd = enable;
+#else
+    (void)enable;
+#endif
+}
+
+bool IsMatrixSimdEnabled()
+{
+    return s_useSimd;
+}
+
+/// dst = a * b, with dst allowed to be either input. Column c of the product is
+/// a's columns weighted by column c of b.
+template <class Ops>
+static void multiplyKernel(float* dst, const float* a, const float* b)
+{
+    typedef typename Ops::V V;
+    const V c0 = Ops::Load(a);
+    const V c1 = Ops::Load(a + 4);
+    const V c2 = Ops::Load(a + 8);
+    const V c3 = Ops::Load(a + 12);
+    V r[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        const float* bc = b + 4*i;
+        r[i] = Ops::Add(Ops::Add(Ops::Add(
+            Ops::Mul(c0, Ops::Splat(bc[0])),
+            Ops::Mul(c1, Ops::Splat(bc[1]))),
+            Ops::Mul(c2, Ops::Splat(bc[2]))),
+            Ops::Mul(c3, Ops::Splat(bc[3])));
+    }
+    for (int i = 0; i < 4; ++i)
+        Ops::Store(dst + 4*i, r[i]);
+}
+
+/// The first three columns of m times the upper 3x3 of r; the last column of m is kept.
+template <class Ops>
+static void multiplyUpper3x3Kernel(float* m, const float* r)
+{
+    typedef typename Ops::V V;
+    const V c0 = Ops::Load(m);
+    const V c1 = Ops::Load(m + 4);
+    const V c2 = Ops::Load(m + 8);
+    V out[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        const float* rc = r + 4*i;
+        out[i] = Ops::Add(Ops::Add(
+            Ops::Mul(c0, Ops::Splat(rc[0])),
+            Ops::Mul(c1, Ops::Splat(rc[1]))),
+            Ops::Mul(c2, Ops::Splat(rc[2])));
+    }
+    for (int i = 0; i < 3; ++i)
+        Ops::Store(m + 4*i, out[i]);
+}
+
+/// m = m * translation(x,y,z), which only changes the last column.
+template <class Ops>
+static void translateKernel(float* m, float x, float y, float z)
+{
+    const typename Ops::V c3 = Ops::Add(Ops::Add(Ops::Add(
+        Ops::Mul(Ops::Load(m), Ops::Splat(x)),
+        Ops::Mul(Ops::Load(m + 4), Ops::Splat(y))),
+        Ops::Mul(Ops::Load(m + 8), Ops::Splat(z))),
+        Ops::Load(m + 12));
+    Ops::Store(m + 12, c3);
+}
+
+/// mtx * (x,y,z,1) with the perspective divide.
+template <class Ops>
+static float3 transformKernel(const float3& pt, const float* mtx)
+{
+    typedef typename Ops::V V;
+    const V h = Ops::Add(Ops::Add(Ops::Add(
+        Ops::Mul(Ops::Load(mtx), Ops::Splat(pt.x)),
+        Ops::Mul(Ops::Load(mtx + 4), Ops::Splat(pt.y))),
+        Ops::Mul(Ops::Load(mtx + 8), Ops::Splat(pt.z))),
+        Ops::Load(mtx + 12));
+    float out[4];
+    Ops::Store(out, Ops::Div(h, Ops::template Shuffle<3,3,3,3>(h, h)));
+    const float3 vec3 = { out[0], out[1], out[2] };
+    return vec3;
+}
+
+// 2x2 matrices as four lanes [m00 m01 m10 m11], for the block inverse below.
+template <class Ops>
+static inline typename Ops::V mat2Mul(typename Ops::V a, typename Ops::V b)
+{
+    return Ops::Add(
+        Ops::Mul(a, Ops::template Shuffle<0,3,0,3>(b, b)),
+        Ops::Mul(Ops::template Shuffle<1,0,3,2>(a, a), Ops::template Shuffle<2,1,2,1>(b, b)));
+}
+
+/// adjugate(a) * b
+template <class Ops>
+static inline typename Ops::V mat2AdjMul(typename Ops::V a, typename Ops::V b)
+{
+    return Ops::Sub(
+        Ops::Mul(Ops::template Shuffle<3,3,0,0>(a, a), b),
+        Ops::Mul(Ops::template Shuffle<1,1,2,2>(a, a), Ops::template Shuffle<2,3,0,1>(b, b)));
+}
+
+/// a * adjugate(b)
+template <class Ops>
+static inline typename Ops::V mat2MulAdj(typename Ops::V a, typename Ops::V b)
+{
+    return Ops::Sub(
+        Ops::Mul(a, Ops::template Shuffle<3,0,3,0>(b, b)),
+        Ops::Mul(Ops::template Shuffle<1,0,3,2>(a, a), Ops::template Shuffle<2,1,2,1>(b, b)));
+}
+
+/// General 4x4 inverse by 2x2 blocks [A B; C D] and their adjugates. The layout
+/// does not matter: the inverse of the transpose is the transpose of the inverse.
+///@return false if the matrix is singular; dst is then left alone
+template <class Ops>
+static bool invertKernel(float* dst, const float* src)
+{
+    typedef typename Ops::V V;
+    const V r0 = Ops::Load(src);
+    const V r1 = Ops::Load(src + 4);
+    const V r2 = Ops::Load(src + 8);
+    const V r3 = Ops::Load(src + 12);
+
+    const V A = Ops::template Shuffle<0,1,0,1>(r0, r1);
+    const V B = Ops::template Shuffle<2,3,2,3>(r0, r1);
+    const V C = Ops::template Shuffle<0,1,0,1>(r2, r3);
+    const V D = Ops::template Shuffle<2,3,2,3>(r2, r3);
+
+    // Determinants of A, B, C and D
+    const V detSub = Ops::Sub(
+        Ops::Mul(Ops::template Shuffle<0,2,0,2>(r0, r2), Ops::template Shuffle<1,3,1,3>(r1, r3)),
+        Ops::Mul(Ops::template Shuffle<1,3,1,3>(r0, r2), Ops::template Shuffle<0,2,0,2>(r1, r3)));
+    const V detA = Ops::template Shuffle<0,0,0,0>(detSub, detSub);
+    const V detB = Ops::template Shuffle<1,1,1,1>(detSub, detSub);
+    const V detC = Ops::template Shuffle<2,2,2,2>(detSub, detSub);
+    const V detD = Ops::template Shuffle<3,3,3,3>(detSub, detSub);
+
+    const V D_C = mat2AdjMul<Ops>(D, C);
+    const V A_B = mat2AdjMul<Ops>(A, B);
+    V X_ = Ops::Sub(Ops::Mul(detD, A), mat2Mul<Ops>(B, D_C));
+    V W_ = Ops::Sub(Ops::Mul(detA, D), mat2Mul<Ops>(C, A_B));
+    V Y_ = Ops::Sub(Ops::Mul(detB, C), mat2MulAdj<Ops>(D, A_B));
+    V Z_ = Ops::Sub(Ops::Mul(detC, B), mat2MulAdj<Ops>(A, D_C));
+
+    // |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+    V tr = Ops::Mul(A_B, Ops::template Shuffle<0,2,1,3>(D_C, D_C));
+    tr = Ops::Add(tr, Ops::template Shuffle<1,0,3,2>(tr, tr));
+    tr = Ops::Add(tr, Ops::template Shuffle<2,3,0,1>(tr, tr));
+    const V detM = Ops::Sub(Ops::Add(Ops::Mul(detA, detD), Ops::Mul(detB, detC)), tr);
+    if (Ops::First(detM) == 0.f)
+        return false;
+
+    const float adjSign[4] = { 1.f, -1.f, -1.f, 1.f };
+    const V rDetM = Ops::Div(Ops::Load(adjSign), detM);
+    X_ = Ops::Mul(X_, rDetM);
+    Y_ = Ops::Mul(Y_, rDetM);
+    Z_ = Ops::Mul(Z_, rDetM);
+    W_ = Ops::Mul(W_, rDetM);
+
+    Ops::Store(dst,      Ops::template Shuffle<3,1,3,1>(X_, Y_));
+    Ops::Store(dst + 4,  Ops::template Shuffle<2,0,2,0>(X_, Y_));
+    Ops::Store(dst + 8,  Ops::template Shuffle<3,1,3,1>(Z_, W_));
+    Ops::Store(dst + 12, Ops::template Shuffle<2,0,2,0>(Z_, W_));
+    return true;
+}
+
+/// Points below this many per thread are not worth a thread's start up.
+static const size_t s_minPointsPerThread = 16384;
+
+/// A matrix with each element in every lane, to transform four points at once.
+template <class Ops>
+struct SplatMatrix
+{
+    explicit SplatMatrix(const float* mtx)
+    {
+        for (int i = 0; i < 16; ++i)
+            m[i] = Ops::Splat(mtx[i]);
+    }
+    typename Ops::V m[16];
+};
+
+/// Four points, one per lane, in the same operation order as transformKernel.
+template <class Ops>
+static inline void transformFourKernel(const SplatMatrix<Ops>& s, bool projective,
+    typename Ops::V& x, typename Ops::V& y, typename Ops::V& z)
+{
+    typedef typename Ops::V V;
+    const V px = x;
+    const V py = y;
+    const V pz = z;
+    x = Ops::Add(Ops::Add(Ops::Add(Ops::Mul(s.m[0], px), Ops::Mul(s.m[4], py)), Ops::Mul(s.m[ 8], pz)), s.m[12]);
+    y = Ops::Add(Ops::Add(Ops::Add(Ops::Mul(s.m[1], px), Ops::Mul(s.m[5], py)), Ops::Mul(s.m[ 9], pz)), s.m[13]);
+    z = Ops::Add(Ops::Add(Ops::Add(Ops::Mul(s.m[2], px), Ops::Mul(s.m[6], py)), Ops::Mul(s.m[10], pz)), s.m[14]);
+    if (!projective)
+        return;
+    const V w = Ops::Add(Ops::Add(Ops::Add(Ops::Mul(s.m[3], px), Ops::Mul(s.m[7], py)), Ops::Mul(s.m[11], pz)), s.m[15]);
+    x = Ops::Div(x, w);
+    y = Ops::Div(y, w);
+    z = Ops::Div(z, w);
+}
+
+/// One call's worth of points, in either layout; the unused layout's pointers are NULL.
+struct PointBatch
+{
+    const float* pMtx;
+    bool         projective;
+    const float* pIn;       ///< Packed xyz
+    float*       pOut;
+    const float* pInX;      ///< Separate x, y and z arrays
+    const float* pInY;
+    const float* pInZ;
+    float*       pOutX;
+    float*       pOutY;
+    float*       pOutZ;
+};
+
+template <class Ops>
+static void transformPackedRange(const PointBatch& b, size_t begin, size_t end)
+{
+    typedef typename Ops::V V;
+    const SplatMatrix<Ops> s(b.pMtx);
+    V x, y, z;
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        Ops::LoadXYZ(b.pIn + 3*i, x, y, z);
+        transformFourKernel<Ops>(s, b.projective, x, y, z);
+        Ops::StoreXYZ(b.pOut + 3*i, x, y, z);
+    }
+    if (i == end)
+        return;
+
+    // The last one to three points go through a zero padded block.
+    float tail[12] = { 0 };
+    const size_t n = 3 * (end - i);
+    memcpy(tail, b.pIn + 3*i, n*sizeof(float));
+    Ops::LoadXYZ(tail, x, y, z);
+    transformFourKernel<Ops>(s, b.projective, x, y, z);
+    Ops::StoreXYZ(tail, x, y, z);
+    memcpy(b.pOut + 3*i, tail, n*sizeof(float));
+}
+
+template <class Ops>
+static void transformSeparateRange(const PointBatch& b, size_t begin, size_t end)
+{
+    typedef typename Ops::V V;
+    const SplatMatrix<Ops> s(b.pMtx);
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        V x = Ops::Load(b.pInX + i);
+        V y = Ops::Load(b.pInY + i);
+        V z = Ops::Load(b.pInZ + i);
+        transformFourKernel<Ops>(s, b.projective, x, y, z);
+        Ops::Store(b.pOutX + i, x);
+        Ops::Store(b.pOutY + i, y);
+        Ops::Store(b.pOutZ + i, z);
+    }
+    if (i == end)
+        return;
+
+    float tx[4] = { 0 };
+    float ty[4] = { 0 };
+    float tz[4] = { 0 };
+    const size_t n = end - i;
+    memcpy(tx, b.pInX + i, n*sizeof(float));
+    memcpy(ty, b.pInY + i, n*sizeof(float));
+    memcpy(tz, b.pInZ + i, n*sizeof(float));
+    V x = Ops::Load(tx);
+    V y = Ops::Load(ty);
+    V z = Ops::Load(tz);
+    transformFourKernel<Ops>(s, b.projective, x, y, z);
+    Ops::Store(tx, x);
+    Ops::Store(ty, y);
+    Ops::Store(tz, z);
+    memcpy(b.pOutX + i, tx, n*sizeof(float));
+    memcpy(b.pOutY + i, ty, n*sizeof(float));
+    memcpy(b.pOutZ + i, tz, n*sizeof(float));
+}
+
+static void transformRange(const PointBatch& b, size_t begin, size_t end)
+{
+#if defined(MATRIXMATH_SSE) || defined(MATRIXMATH_NEON)
+    if (s_useSimd)
+    {
+        if (b.pIn != NULL)
+            transformPackedRange<SimdOps>(b, begin, end);
+        else
+            transformSeparateRange<SimdOps>(b, begin, end);
+        return;
+    }
+#endif
+    if (b.pIn != NULL)
+        transformPackedRange<ScalarOps>(b, begin, end);
+    else
+        transformSeparateRange<ScalarOps>(b, begin, end);
+}
+
+/// Transforms one slice of a batch on a worker thread.
+class PointBatchJob : public WorkerJob
+{
+public:
+    PointBatchJob(const PointBatch& batch, size_t begin, size_t end)
+    : m_batch(batch)
+    , m_begin(begin)
+    , m_end(end)
+    {
+    }
+    virtual void Run() { transformRange(m_batch, m_begin, m_end); }
+
+protected:
+    PointBatch m_batch;
+    size_t     m_begin;
+    size_t     m_end;
+};
+
+/// Split a batch into slices of whole blocks of four, one per thread; the calling
+/// thread does the first slice and waits for the rest.
+static void transformBatch(const PointBatch& b, size_t count, int numThreads)
+{
+    const size_t maxThreads = count / s_minPointsPerThread;
+    if (static_cast<size_t>(numThreads) > maxThreads)
+        numThreads = static_cast<int>(maxThreads);
+
+    WorkerPool pool;
+    if ((numThreads <= 1) || !pool.Start(numThreads - 1))
+    {
+        transformRange(b, 0, count);
+        return;
+    }
+
+    const size_t slice = ((count + numThreads - 1) / numThreads + 3) & ~static_cast<size_t>(3);
+    int submitted = 0;
+    for (size_t begin = slice; begin < count; begin += slice)
+    {
+        const size_t end = (begin + slice < count) ? begin + slice : count;
+        pool.Submit(new PointBatchJob(b, begin, end));
+        ++submitted;
+    }
+    transformRange(b, 0, (slice < count) ? slice : count);
+    for (int i = 0; i < submitted; ++i)
+        delete pool.WaitFinished();
+}
+
+/// The divide is skipped when the last row is 0,0,0,1, as it would divide by 1.
+static bool isProjective(const float* mtx)
+{
+    return !((mtx[3] == 0.f) && (mtx[7] == 0.f) && (mtx[11] == 0.f) && (mtx[15] == 1.f));
+}
+
+#if defined(MATRIXMATH_SSE) || defined(MATRIXMATH_NEON)
+#  define MATRIXMATH_DISPATCH(kernel, args) \
+    (s_useSimd ? kernel<SimdOps> args : kernel<ScalarOps> args)
+#else
+#  define MATRIXMATH_DISPATCH(kernel, args) \
+    (kernel<ScalarOps> args)
+#endif
+
 // Transforms the point by the specified 4x4 transformation matrix.
 // Note that the matrix is specified in COLUMN order.
 float3 transform(const float3 pt, const float* mtx)
 {
-    float4 vec = {
-        mtx[0]*pt.x + mtx[4]*pt.y + mtx[ 8]*pt.z + mtx[12],
-        mtx[1]*pt.x + mtx[5]*pt.y + mtx[ 9]*pt.z + mtx[13],
-        mtx[2]*pt.x + mtx[6]*pt.y + mtx[10]*pt.z + mtx[14],
-        mtx[3]*pt.x + mtx[7]*pt.y + mtx[11]*pt.z + mtx[15],
-    };
-    float3 vec3 = {
-        vec.x / vec.w,
-        vec.y / vec.w,
-        vec.z / vec.w,
-    };
-    return vec3;
+    return MATRIXMATH_DISPATCH(transformKernel, (pt, mtx));
 }
 
 void MakeIdentityMatrix(float* dst)
@@ -63,7 +594,7 @@ void MakeRotationMatrix(float* mtx, float theta, float3 axis)
     float len = length(axis);
     if (len < 0.000001f)
         return;
-    normalize(axis);
+    axis = normalize(axis);
 
     float c = static_cast<float>(cos(theta));
     float s = static_cast<float>(sin(theta));
@@ -94,89 +625,129 @@ void MakeRotationMatrix(float* mtx, float theta, float3 axis)
 }
 
 
-// Store result in first parameter
-void preMultiply(float* a, const float* b)
-{
-    if(!a || !b) return;
 
-    float result[16];
-    memset(result, 0, 16*sizeof(float));
+// Transforms count packed points; pOut may be pIn. Each result is what
+// transform() gives for that point. numThreads > 1 splits large batches.
+void TransformPoints(float3* pOut, const float3* pIn, size_t count, const float* mtx, int numThreads)
+{
+    if (!pOut || !pIn || !mtx || (count == 0))
+        return;
+    PointBatch b;
+    memset(&b, 0, sizeof(b));
+    b.pMtx = mtx;
+    b.projective = isProjective(mtx);
+    b.pIn = reinterpret_cast<const float*>(pIn);
+    b.pOut = reinterpret_cast<float*>(pOut);
+    transformBatch(b, count, numThreads);
+}
 
-    for (unsigned int i=0; i<16; i+=4)
-    {
-        for (unsigned int j=0; j<4; ++j)
-        {
-            result[i+j] =  a[i+0] * b[j+0]
-                         + a[i+1] * b[j+4]
-                         + a[i+2] * b[j+8]
-                         + a[i+3] * b[j+12];
-        }
-    }
+// Transforms count points held as separate x, y and z arrays; the outputs may be the inputs.
+void TransformPoints(float* pOutX, float* pOutY, float* pOutZ,
+                     const float* pInX, const float* pInY, const float* pInZ,
+                     size_t count, const float* mtx, int numThreads)
+{
+    if (!pOutX || !pOutY || !pOutZ || !pInX || !pInY || !pInZ || !mtx || (count == 0))
+        return;
+    PointBatch b;
+    memset(&b, 0, sizeof(b));
+    b.pMtx = mtx;
+    b.projective = isProjective(mtx);
+    b.pInX = pInX;
+    b.pInY = pInY;
+    b.pInZ = pInZ;
+    b.pOutX = pOutX;
+    b.pOutY = pOutY;
+    b.pOutZ = pOutZ;
+    transformBatch(b, count, numThreads);
+}
 
-    memcpy(a, result, 16*sizeof(float));
+// Store result in first parameter: a = b * a
+void preMultiply(float* a, const float* b)
+{
+    if(!a || !b) return;
+    MATRIXMATH_DISPATCH(multiplyKernel, (a, b, a));
 }
 
-// Store result in first parameter
+// Store result in first parameter: a = a * b
 void postMultiply(float* a, const float* b)
 {
     if (!a || !b)
         return;
+    MATRIXMATH_DISPATCH(multiplyKernel, (a, a, b));
+}
 
-    float result[16];
-    memset(result, 0, 16*sizeof(float));
+// dst = a * b; dst may be a or b
+void MultiplyMatrix(float* dst, const float* a, const float* b)
+{
+    if (!dst || !a || !b)
+        return;
+    MATRIXMATH_DISPATCH(multiplyKernel, (dst, a, b));
+}
 
-    for (unsigned int i=0; i<16; i+=4)
+// dst may be src
+void TransposeMatrix(float* dst, const float* src)
+{
+    if (!dst || !src)
+        return;
+#if defined(MATRIXMATH_SSE) || defined(MATRIXMATH_NEON)
+    if (s_useSimd)
     {
-        for (unsigned int j=0; j<4; ++j)
-        {
-            result[i+j] =  b[i+0] * a[j+0]
-                         + b[i+1] * a[j+4]
-                         + b[i+2] * a[j+8]
-                         + b[i+3] * a[j+12];
-        }
+        SimdOps::Transpose(dst, src);
+        return;
     }
+#endif
+    ScalarOps::Transpose(dst, src);
+}
 
-    memcpy(a, result, 16*sizeof(float));
+// dst may be src. Returns false, leaving dst untouched, if src is singular.
+bool InvertMatrix(float* dst, const float* src)
+{
+    if (!dst || !src)
+        return false;
+    return MATRIXMATH_DISPATCH(invertKernel, (dst, src));
 }
 
+// Only the translation column changes
 void glhTranslate(float* mtx,
                   float x, 
                   float y,
                   float z)
 {
-    float txmtx[16] = {
-        1,0,0,0,
-        0,1,0,0, 
-        0,0,1,0,
-        x,y,z,1
-    };
-    postMultiply(mtx, txmtx);
+    if (!mtx)
+        return;
+    MATRIXMATH_DISPATCH(translateKernel, (mtx, x, y, z));
 }
 
+// Only the first three columns change
 void glhRotate(float* mtx,
                float theta,
                float x, 
                float y,
                float z)
 {
+    if (!mtx)
+        return;
     float rotmtx[16];
     float3 axis = {x,y,z};
+    MakeIdentityMatrix(rotmtx);
     MakeRotationMatrix(rotmtx, -theta * (float)M_PI / 180.0f, axis);
-    postMultiply(mtx, rotmtx);
+    MATRIXMATH_DISPATCH(multiplyUpper3x3Kernel, (mtx, rotmtx));
 }
 
+// Scales the first three columns in place
 void glhScale(float* mtx,
               float x, 
               float y,
               float z)
 {
-    float scmtx[16] = {
-        x,0,0,0,
-        0,y,0,0, 
-        0,0,z,0,
-        0,0,0,1
-    };
-    postMultiply(mtx, scmtx);
+    if (!mtx)
+        return;
+    for (int i = 0; i < 4; ++i)
+    {
+        mtx[i]     *= x;
+        mtx[4 + i] *= y;
+        mtx[8 + i] *= z;
+    }
 }
 
 /// Support for glhPerspectivef2, which is a standin for gluPerspective.
@@ -10,9 +10,17 @@
 
 #include "vectortypes.h"
 #include "VectorMath.h"
+#include <stddef.h>
 
 float3 transform(const float3 pt, const float* mtx);
 
+/// Batched transform() of packed or separate x, y and z points; a matrix whose
+/// last row is 0,0,0,1 skips the divide. numThreads > 1 splits large batches.
+void TransformPoints(float3* pOut, const float3* pIn, size_t count, const float* mtx, int numThreads = 1);
+void TransformPoints(float* pOutX, float* pOutY, float* pOutZ,
+                     const float* pInX, const float* pInY, const float* pInZ,
+                     size_t count, const float* mtx, int numThreads = 1);
+
 void MakeIdentityMatrix   (float* dst);
 void MakeTranslationMatrix(float* mtx, float3 vec);
 void MakeRotationMatrix   (float* mtx, float theta, float3 axis);
@@ -20,6 +28,14 @@ void MakeRotationMatrix   (float* mtx, float theta, float3 axis);
 void preMultiply (float* m1, const float* m2); // modifies first parameter
 void postMultiply(float* m1, const float* m2); // modifies first parameter
 
+void MultiplyMatrix (float* dst, const float* a, const float* b);
+void TransposeMatrix(float* dst, const float* src);
+bool InvertMatrix   (float* dst, const float* src);
+
+/// SSE or NEON kernels are used where compiled in; scalar ones give the same results.
+void SetMatrixSimdEnabled(bool enable);
+bool IsMatrixSimdEnabled();
+
 void glhTranslate(float* mtx,
                   float x, 
                   float y,
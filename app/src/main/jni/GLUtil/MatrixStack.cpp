@@ -0,0 +1,186 @@
+// MatrixStack.cpp
+
+#include "MatrixStack.h"
+#include "MatrixMath.h"
+
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#  define M_PI   3.14159265358979323846264338327
+#endif
+
+/// Room reserved up front, so pointers from the accessors survive pushes up to this depth.
+static const size_t s_reservedDepth = 32;
+
+MatrixStack::MatrixStack()
+: m_stack()
+{
+    m_stack.reserve(s_reservedDepth);
+    m_stack.resize(1);
+    LoadIdentity();
+}
+
+/// Duplicate the top matrix.
+void MatrixStack::Push()
+{
+    m_stack.push_back(m_stack.back());
+}
+
+///@return false, leaving the stack alone, if only the bottom matrix is left
+bool MatrixStack::Pop()
+{
+    if (m_stack.size() <= 1)
+        return false;
+    m_stack.pop_back();
+    return true;
+}
+
+void MatrixStack::LoadIdentity()
+{
+    Entry& top = _Modify();
+    MakeIdentityMatrix(top.mtx);
+    top.affine = true;
+}
+
+void MatrixStack::Load(const float* pMtx)
+{
+    if (pMtx == NULL)
+        return;
+    Entry& top = _Modify();
+    memcpy(top.mtx, pMtx, sizeof(top.mtx));
+    top.affine = _IsAffine(pMtx);
+}
+
+/// top = top * pMtx
+void MatrixStack::Multiply(const float* pMtx)
+{
+    if (pMtx == NULL)
+        return;
+    Entry& top = _Modify();
+    postMultiply(top.mtx, pMtx);
+    top.affine = top.affine && _IsAffine(pMtx);
+}
+
+/// As glhTranslate: only the last column changes.
+void MatrixStack::Translate(float x, float y, float z)
+{
+    glhTranslate(_Modify().mtx, x, y, z);
+}
+
+/// As glhScale: three columns are scaled.
+void MatrixStack::Scale(float x, float y, float z)
+{
+    glhScale(_Modify().mtx, x, y, z);
+}
+
+///@brief As glhRotate. A rotation about a coordinate axis only mixes the two
+/// columns at right angles to it, in 8 multiplies instead of 36.
+void MatrixStack::Rotate(float degrees, float x, float y, float z)
+{
+    int i = -1;
+    int j = -1;
+    float axisSign = 1.f;
+    if ((y == 0.f) && (z == 0.f))      { i = 1; j = 2; axisSign = x; }
+    else if ((z == 0.f) && (x == 0.f)) { i = 2; j = 0; axisSign = y; }
+    else if ((x == 0.f) && (y == 0.f)) { i = 0; j = 1; axisSign = z; }
+
+    if (i < 0)
+    {
+        glhRotate(_Modify().mtx, degrees, x, y, z);
+        return;
+    }
+    if (axisSign == 0.f)
+        return;
+
+    // Same angle and sense as glhRotate's rotation matrix.
+    const double theta = -static_cast<double>(degrees) * M_PI / 180.0;
+    const float c = static_cast<float>(cos(theta));
+    const float s = (axisSign > 0.f ? 1.f : -1.f) * static_cast<float>(sin(theta));
+    float* m = _Modify().mtx;
+    float* ci = m + 4*i;
+    float* cj = m + 4*j;
+    for (int r = 0; r < 4; ++r)
+    {
+        const float a = ci[r];
+        const float b = cj[r];
+        ci[r] = a*c - b*s;
+        cj[r] = a*s + b*c;
+    }
+}
+
+///@return Inverse of the top matrix, or the identity if it is singular
+const float* MatrixStack::GetInverse() const
+{
+    Entry& top = m_stack.back();
+    if (top.inverseValid)
+        return top.inverse;
+
+    top.inverseValid = true;
+    const float* m = top.mtx;
+    if (!top.affine)
+    {
+        if (!InvertMatrix(top.inverse, m))
+            MakeIdentityMatrix(top.inverse);
+        return top.inverse;
+    }
+
+    // [A t; 0 1]^-1 = [A^-1 -A^-1 t; 0 1]. The rows of A^-1 are cross products
+    // of A's columns over its determinant.
+    const float3 a = { m[0], m[1], m[2] };
+    const float3 b = { m[4], m[5], m[6] };
+    const float3 c = { m[8], m[9], m[10] };
+    const float3 t = { m[12], m[13], m[14] };
+    const float3 bc = cross(b, c);
+    const float det = dot(a, bc);
+    if (det == 0.f)
+    {
+        MakeIdentityMatrix(top.inverse);
+        return top.inverse;
+    }
+    const float invDet = 1.f / det;
+    const float3 rows[3] = { invDet * bc, invDet * cross(c, a), invDet * cross(a, b) };
+    float* inv = top.inverse;
+    for (int r = 0; r < 3; ++r)
+    {
+        inv[r]      = rows[r].x;
+        inv[4 + r]  = rows[r].y;
+        inv[8 + r]  = rows[r].z;
+        inv[12 + r] = -dot(rows[r], t);
+    }
+    inv[3] = inv[7] = inv[11] = 0.f;
+    inv[15] = 1.f;
+    return top.inverse;
+}
+
+///@return The 3x3 matrix that transforms normals: the transpose of the inverse of
+/// the top's upper 3x3, column-major as a GLSL mat3 expects
+const float* MatrixStack::GetNormalMatrix() const
+{
+    Entry& top = m_stack.back();
+    if (top.normalValid)
+        return top.normal;
+
+    const float* inv = GetInverse();
+    for (int col = 0; col < 3; ++col)
+    {
+        for (int row = 0; row < 3; ++row)
+            top.normal[3*col + row] = inv[4*row + col];
+    }
+    top.normalValid = true;
+    return top.normal;
+}
+
+/// The top entry, with its cached inverse and normal matrix dropped as it is about to change.
+MatrixStack::Entry& MatrixStack::_Modify()
+{
+    Entry& top = m_stack.back();
+    top.inverseValid = false;
+    top.normalValid = false;
+    return top;
+}
+
+bool MatrixStack::_IsAffine(const float* pMtx)
+{
+    return (pMtx[3] == 0.f) && (pMtx[7] == 0.f) && (pMtx[11] == 0.f) && (pMtx[15] == 1.f);
+}
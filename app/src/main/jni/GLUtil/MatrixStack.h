@@ -0,0 +1,50 @@
+// MatrixStack.h
+
+#pragma once
+
+#include <vector>
+
+///@brief A stack of column-major 4x4 matrices, like the fixed function GL's.
+/// Translate, Rotate and Scale multiply on the right in place, touching only the
+/// columns that change, and keep track of whether the top is affine (last row
+/// 0,0,0,1). The inverse and normal matrix of the top are computed on first
+/// request and cached until it next changes; an affine top has a cheaper inverse.
+/// Pointers from the accessors stay valid until the stack is pushed past 32 deep.
+class MatrixStack
+{
+public:
+    MatrixStack();
+    virtual ~MatrixStack() {}
+
+    void Push();
+    bool Pop();
+    void LoadIdentity();
+    void Load(const float* pMtx);
+    void Multiply(const float* pMtx);
+    void Translate(float x, float y, float z);
+    void Rotate(float degrees, float x, float y, float z);
+    void Scale(float x, float y, float z);
+
+    /// const Accessors
+    const float* Get() const { return m_stack.back().mtx; }
+    const float* GetInverse() const;
+    const float* GetNormalMatrix() const;
+    bool IsAffine() const { return m_stack.back().affine; }
+    int GetDepth() const { return static_cast<int>(m_stack.size()); }
+
+protected:
+    struct Entry
+    {
+        float mtx[16];
+        float inverse[16];  ///< Valid if inverseValid
+        float normal[9];    ///< Column-major 3x3 inverse transpose; valid if normalValid
+        bool  affine;
+        bool  inverseValid;
+        bool  normalValid;
+    };
+
+    Entry& _Modify();
+    static bool _IsAffine(const float* pMtx);
+
+    mutable std::vector<Entry> m_stack; ///< Never empty; caches fill in from const accessors
+};
@@ -0,0 +1,256 @@
+// ProgramCacheMgr.cpp
+
+#include "ProgramCacheMgr.h"
+
+#include "DataDirectoryLocation.h"
+#include "Logging.h"
+#include "MappedFile.h"
+#include "Timer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#ifdef _WIN32
+#  include <direct.h>
+#else
+#  include <sys/stat.h>
+#  include <sys/types.h>
+#endif
+
+/// Every cache file begins with this, followed by the binary itself.
+struct ProgramCacheHeader
+{
+    char magic[4];
+    unsigned int version;
+    unsigned int hashLo;
+    unsigned int hashHi;
+    unsigned int keyLength;
+    unsigned int format;
+    unsigned int binaryLength;
+    unsigned int compileMicroseconds;
+};
+
+static const char s_magic[4] = { 'F', 'C', 'P', 'B' };
+static const unsigned int s_version = 1;
+
+/// 64-bit FNV-1a
+static unsigned long long HashBytes(const char* pData, size_t len, unsigned long long h)
+{
+    for (size_t i=0; i<len; ++i)
+    {
+        h ^= static_cast<unsigned char>(pData[i]);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static unsigned long long HashKey(const std::string& driver, const std::string& key)
+{
+    unsigned long long h = 14695981039346656037ULL;
+    h = HashBytes(driver.c_str(), driver.length() + 1, h); // include terminator as separator
+    h = HashBytes(key.data(), key.length(), h);
+    return h;
+}
+
+static std::string GetGLString(GLenum name)
+{
+    const GLubyte* pStr = glGetString(name);
+    if (pStr == NULL)
+        return "";
+    return std::string(reinterpret_cast<const char*>(pStr));
+}
+
+ProgramCacheMgr::ProgramCacheMgr()
+: m_directory(std::string(APP_DATA_DIRECTORY) + "shadercache/")
+, m_driverString()
+, m_supported(-1)
+, m_hits(0)
+, m_misses(0)
+, m_secondsSaved(0.)
+{
+}
+
+///@brief Append one shader stage's source to a cache key.
+/// The stage type is included so the same sources in different stages hash differently.
+void ProgramCacheMgr::AppendStage(std::string& key, GLenum type, const std::string& src)
+{
+    char typeStr[16];
+    sprintf(typeStr, "%u", static_cast<unsigned int>(type));
+    key.append(typeStr);
+    key.push_back('\0');
+    key.append(src);
+    key.push_back('\0');
+}
+
+///@brief Ask the driver to keep the binary retrievable. Call before glLinkProgram.
+void ProgramCacheMgr::PrepareForLink(GLuint program)
+{
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+///@return true if the driver supports at least one program binary format
+bool ProgramCacheMgr::_IsSupported()
+{
+    if (m_supported < 0)
+    {
+        GLint numFormats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+        m_supported = (numFormats > 0) ? 1 : 0;
+
+        m_driverString = GetGLString(GL_VENDOR);
+        m_driverString.push_back('\n');
+        m_driverString.append(GetGLString(GL_RENDERER));
+        m_driverString.push_back('\n');
+        m_driverString.append(GetGLString(GL_VERSION));
+
+        if (m_supported == 0)
+        {
+            LOG_INFO("ProgramCacheMgr: no program binary formats, caching disabled.");
+        }
+    }
+    return m_supported != 0;
+}
+
+std::string ProgramCacheMgr::_GetFilename(const std::string& key)
+{
+    const unsigned long long h = HashKey(m_driverString, key);
+    char name[32];
+    sprintf(name, "%08x%08x.bin",
+        static_cast<unsigned int>(h >> 32),
+        static_cast<unsigned int>(h & 0xffffffff));
+    return m_directory + name;
+}
+
+///@brief Create a program from a cached binary.
+///@param key All stage sources, built with AppendStage
+///@return The linked program, or 0 if there is no valid entry and the caller must compile.
+GLuint ProgramCacheMgr::LoadProgram(const std::string& key)
+{
+    if (!_IsSupported())
+        return 0;
+
+    const Timer loadTimer;
+    const std::string filename = _GetFilename(key);
+    const unsigned long long h = HashKey(m_driverString, key);
+
+    MappedFile file;
+    if (!file.Open(filename.c_str()))
+    {
+        ++m_misses;
+        return 0;
+    }
+
+    ProgramCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    if (file.Size() >= sizeof(ProgramCacheHeader))
+    {
+        memcpy(&header, file.Data(), sizeof(ProgramCacheHeader));
+    }
+    const bool headerOk =
+        (memcmp(header.magic, s_magic, sizeof(s_magic)) == 0) &&
+        (header.version == s_version) &&
+        (header.hashLo == static_cast<unsigned int>(h & 0xffffffff)) &&
+        (header.hashHi == static_cast<unsigned int>(h >> 32)) &&
+        (header.keyLength == key.length()) &&
+        (header.binaryLength == file.Size() - sizeof(ProgramCacheHeader));
+    if (!headerOk)
+    {
+        LOG_ERROR("ProgramCacheMgr: discarding invalid cache file %s", filename.c_str());
+        file.Close();
+        remove(filename.c_str());
+        ++m_misses;
+        return 0;
+    }
+
+    const GLuint program = glCreateProgram();
+    glProgramBinary(program,
+        header.format,
+        file.Data() + sizeof(ProgramCacheHeader),
+        header.binaryLength);
+    file.Close();
+
+    GLint linkStatus = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+    if (linkStatus != GL_TRUE)
+    {
+        // The driver may reject binaries for reasons the version string does not show.
+        glDeleteProgram(program);
+        remove(filename.c_str());
+        ++m_misses;
+        return 0;
+    }
+
+    ++m_hits;
+    m_secondsSaved += 1.e-6 * static_cast<double>(header.compileMicroseconds) - loadTimer.seconds();
+    return program;
+}
+
+///@brief Write a successfully linked program's binary to the cache.
+///@param compileSeconds Time taken to compile and link, reported as saved on later hits
+void ProgramCacheMgr::StoreProgram(const std::string& key, GLuint program, double compileSeconds)
+{
+    if ((program == 0) || !_IsSupported())
+        return;
+
+    GLint binaryLength = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+    if (binaryLength <= 0)
+        return;
+
+    std::vector<unsigned char> binary(binaryLength);
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, binaryLength, &written, &format, &binary[0]);
+    if (written <= 0)
+        return;
+
+    const unsigned long long h = HashKey(m_driverString, key);
+    ProgramCacheHeader header;
+    memcpy(header.magic, s_magic, sizeof(s_magic));
+    header.version = s_version;
+    header.hashLo = static_cast<unsigned int>(h & 0xffffffff);
+    header.hashHi = static_cast<unsigned int>(h >> 32);
+    header.keyLength = static_cast<unsigned int>(key.length());
+    header.format = format;
+    header.binaryLength = static_cast<unsigned int>(written);
+    header.compileMicroseconds = static_cast<unsigned int>(1.e6 * compileSeconds);
+
+#ifdef _WIN32
+    _mkdir(m_directory.c_str());
+#else
+    mkdir(m_directory.c_str(), 0755);
+#endif
+
+    // Write to a temporary name first so a crash never leaves a truncated entry.
+    const std::string filename = _GetFilename(key);
+    const std::string tmpFilename = filename + ".tmp";
+    FILE* pFile = fopen(tmpFilename.c_str(), "wb");
+    if (pFile == NULL)
+    {
+        LOG_ERROR("ProgramCacheMgr: could not write %s", tmpFilename.c_str());
+        return;
+    }
+    const bool ok =
+        (fwrite(&header, sizeof(header), 1, pFile) == 1) &&
+        (fwrite(&binary[0], written, 1, pFile) == 1);
+    fclose(pFile);
+
+    remove(filename.c_str());
+    if (!ok || (rename(tmpFilename.c_str(), filename.c_str()) != 0))
+    {
+        remove(tmpFilename.c_str());
+    }
+}
+
+void ProgramCacheMgr::LogStats() const
+{
+    const int total = m_hits + m_misses;
+    if (total == 0)
+        return;
+    LOG_INFO("Program cache: %d of %d programs loaded from cache (%d%%), ~%d ms of compiling saved",
+        m_hits,
+        total,
+        (100 * m_hits) / total,
+        static_cast<int>(1000. * m_secondsSaved));
+}
@@ -0,0 +1,51 @@
+// ProgramCacheMgr.h
+
+#pragma once
+
+#include "Singleton.h"
+#include "GL_Includes.h"
+#include <string>
+
+///@brief Stores linked program binaries on disk so later launches can skip compiling.
+/// Entries are keyed by a hash of all stage sources together with GL_VENDOR,
+/// GL_RENDERER and GL_VERSION, so a driver update simply misses and recompiles.
+///@warning Do not attempt to access this object outside of the GL thread!
+class ProgramCacheMgr : public Singleton
+{
+public:
+    static ProgramCacheMgr& Instance()
+    {
+        static ProgramCacheMgr instance;
+        return instance;
+    }
+
+    void SetDirectory(const std::string& dir) { m_directory = dir; }
+    static void AppendStage(std::string& key, GLenum type, const std::string& src);
+    static void PrepareForLink(GLuint program);
+
+    GLuint LoadProgram(const std::string& key);
+    void StoreProgram(const std::string& key, GLuint program, double compileSeconds);
+    void LogStats() const;
+
+    /// const Accessors
+    int GetHitCount() const { return m_hits; }
+    int GetMissCount() const { return m_misses; }
+    double GetSecondsSaved() const { return m_secondsSaved; }
+
+protected:
+    bool _IsSupported();
+    std::string _GetFilename(const std::string& key);
+
+    std::string  m_directory;
+    std::string  m_driverString;  ///< Queried on first use, once there is a context
+    int          m_supported;     ///< -1 until queried
+    int          m_hits;
+    int          m_misses;
+    double       m_secondsSaved;  ///< Recorded compile time of hits less time taken to load them
+
+private:
+    ProgramCacheMgr();
+    ~ProgramCacheMgr() {}
+    ProgramCacheMgr(ProgramCacheMgr const& copy);            // Not Implemented
+    ProgramCacheMgr& operator=(ProgramCacheMgr const& copy); // Not Implemented
+};
@@ -2,8 +2,11 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include <string>
+#include <vector>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -11,6 +14,9 @@
 #include "GL_Includes.h"
 
 #include "ShaderFunctions.h"
+#include "ProgramCacheMgr.h"
+#include "CameraUniformMgr.h"
+#include "GLStateMgr.h"
 #include "Logging.h"
 #ifdef __ANDROID__
 #define LOG_INFO(...) LOGI(__VA_ARGS__)
@@ -68,20 +74,32 @@ void printProgramInfoLog(GLuint obj)
     }
 }
 
-// Retrieve shader source from a std::map of hard-coded shaders generated by
-// shader_hardcoder.py to the file shaderlist.h.
-const std::string GetShaderSourceFromTable(const char* filename)
+// Find shader source in the sorted table of hard-coded shaders generated by
+// hardcode_shaders.py to g_shaders.h. Returns a pointer into the table and sets
+// length, or returns NULL if the file is not there. Nothing is copied.
+const char* GetShaderSourceFromTable(const char* filename, size_t& length)
 {
-    if (g_shaderMap.empty())
-    {
-        initShaderList();
-    }
+    length = 0;
+    if (filename == NULL)
+        return NULL;
 
-    if (g_shaderMap.count(filename) > 0)
+    size_t lo = 0;
+    size_t hi = g_shaderCount;
+    while (lo < hi)
     {
-        return g_shaderMap[filename];
+        const size_t mid = lo + (hi - lo) / 2;
+        const int cmp = strcmp(filename, g_shaderTable[mid].name);
+        if (cmp == 0)
+        {
+            length = g_shaderTable[mid].length;
+            return g_shaderTable[mid].source;
+        }
+        if (cmp < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
     }
-    return "";
+    return NULL;
 }
 
 // Do not attempt to load shaders from file on device.
@@ -91,13 +109,23 @@ const std::string GetShaderSourceFromTable(const char* filename)
 #  define LOAD_SHADERS_FROM_FILESYSTEM 1
 #endif
 
+// Return the directory shader source files are read from, or an empty string
+// if shaders only come from the hard-coded table on this platform.
+const std::string GetShaderSourceDirectory()
+{
+#if LOAD_SHADERS_FROM_FILESYSTEM
+    return "../shaders/";
+#else
+    return "";
+#endif
+}
+
 #if LOAD_SHADERS_FROM_FILESYSTEM
 // Load a string of shader source from the given filename in the data/ directory
 // and return a copy of it.
 const std::string GetShaderSourceFromFile(const char* filename)
 {
-    const std::string shaderHomedir = "../shaders/";
-    const std::string shaderPath = shaderHomedir + filename;
+    const std::string shaderPath = GetShaderSourceDirectory() + filename;
 
     std::ifstream t(shaderPath.c_str());
     std::stringstream shaderSource;
@@ -107,8 +135,8 @@ const std::string GetShaderSourceFromFile(const char* filename)
 #endif
 
 // Return shader source from filename, if it can be retrieved.
-// If not, fall back to the hard-coded array in our global std::map.
-const std::string GetShaderSource(const char* filename)
+// If not, fall back to the hard-coded table. #include directives are left as is.
+static const std::string GetRawShaderSource(const char* filename)
 {
 #if LOAD_SHADERS_FROM_FILESYSTEM
     const std::string fileSrc = GetShaderSourceFromFile(filename);
@@ -117,31 +145,356 @@ const std::string GetShaderSource(const char* filename)
         return fileSrc;
     }
 #endif
-    return GetShaderSourceFromTable(filename);
+    size_t length = 0;
+    const char* pSource = GetShaderSourceFromTable(filename, length);
+    if (pSource == NULL)
+        return "";
+    return std::string(pSource, length);
 }
 
-// http://stackoverflow.com/questions/1494399/how-do-i-search-find-and-replace-in-a-standard-string
-void myReplace(std::string& str,
-               const std::string& oldStr,
-               const std::string& newStr)
+// The modification time and size of an include file when it was read, to tell
+// whether it has changed since. Zero for files in the hard-coded table only.
+struct IncludeStamp
+{
+    std::string name;
+    long long mtime;
+    long long size;
+};
+
+static IncludeStamp stampShaderInclude(const std::string& name)
 {
-    std::string::size_type pos = 0u;
-    while((pos = str.find(oldStr, pos)) != std::string::npos)
+    IncludeStamp stamp;
+    stamp.name = name;
+    stamp.mtime = 0;
+    stamp.size = 0;
+#if LOAD_SHADERS_FROM_FILESYSTEM
+    const std::string path = GetShaderSourceDirectory() + name;
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0)
     {
-        str.replace(pos, oldStr.length(), newStr);
-        pos += newStr.length();
+        stamp.mtime = static_cast<long long>(st.st_mtime);
+        stamp.size = static_cast<long long>(st.st_size);
     }
+#endif
+    return stamp;
 }
 
-// Once source is obtained from either file or hard-coded map, compile the
-// shader, release the string memory and return the ID.
-GLuint loadShaderFile(const char* filename, const unsigned long Type)
+// Source with its #includes resolved, and every include file it looked up,
+// found or not, as they were when it was resolved.
+struct ResolvedSource
+{
+    std::string text;
+    std::vector<IncludeStamp> includes;
+};
+
+// true if none of the entry's include files has been written, created or
+// removed since it was resolved.
+static bool isResolvedSourceCurrent(const ResolvedSource& resolved)
+{
+    for (std::vector<IncludeStamp>::const_iterator it = resolved.includes.begin();
+         it != resolved.includes.end();
+         ++it)
+    {
+        const IncludeStamp now = stampShaderInclude(it->name);
+        if ((now.mtime != it->mtime) || (now.size != it->size))
+            return false;
+    }
+    return true;
+}
+
+// Sources with their #includes resolved, keyed by a hash of the file name and
+// unprocessed text. Only the GL thread touches these.
+static std::map<unsigned long long, ResolvedSource> s_resolvedSources;
+// For each include file, the top level files that pulled it in.
+static std::map<std::string, std::vector<std::string> > s_includers;
+
+// 64-bit FNV-1a
+static unsigned long long hashShaderSource(const char* filename, const std::string& source)
+{
+    unsigned long long h = 14695981039346656037ULL;
+    for (const char* p = filename; *p != '\0'; ++p)
+    {
+        h ^= static_cast<unsigned char>(*p);
+        h *= 1099511628211ULL;
+    }
+    h *= 1099511628211ULL; // terminator separates name from text
+    for (size_t i=0; i<source.length(); ++i)
+    {
+        h ^= static_cast<unsigned char>(source[i]);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// If line is #include "file" or #include <file>, put the file name in includeName.
+static bool parseIncludeLine(const std::string& line, std::string& includeName)
+{
+    std::string::size_type pos = line.find_first_not_of(" \t");
+    if ((pos == std::string::npos) || (line[pos] != '#'))
+        return false;
+    pos = line.find_first_not_of(" \t", pos + 1);
+    if ((pos == std::string::npos) || (line.compare(pos, 7, "include") != 0))
+        return false;
+    pos = line.find_first_not_of(" \t", pos + 7);
+    if ((pos == std::string::npos) || ((line[pos] != '"') && (line[pos] != '<')))
+        return false;
+    const char close = (line[pos] == '"') ? '"' : '>';
+    const std::string::size_type end = line.find(close, pos + 1);
+    if ((end == std::string::npos) || (end == pos + 1))
+        return false;
+    includeName = line.substr(pos + 1, end - pos - 1);
+    return true;
+}
+
+// Append source to out with its #include lines replaced by the included text.
+// Each file is included at most once, so shared blocks and include cycles are
+// harmless. Included text is bracketed with #line directives giving each file
+// its own source string number, so driver messages read file:line.
+// Names that were not found are added to missing.
+static void appendIncludes(
+    const std::string& source,
+    int sourceIndex,
+    std::string& out,
+    std::vector<std::string>& included,
+    std::vector<std::string>& missing)
+{
+    int lineNumber = 0;
+    std::string::size_type pos = 0;
+    while (pos < source.length())
+    {
+        std::string::size_type eol = source.find('\n', pos);
+        if (eol == std::string::npos)
+            eol = source.length();
+        const std::string line = source.substr(pos, eol - pos);
+        pos = eol + 1;
+        ++lineNumber;
+
+        std::string includeName;
+        if (!parseIncludeLine(line, includeName))
+        {
+            // #version may only appear once, at the top of the main file.
+            if ((sourceIndex != 0) && (line.compare(0, 8, "#version") == 0))
+                out.append("// #version omitted from included file");
+            else
+                out.append(line);
+            out.push_back('\n');
+            continue;
+        }
+
+        if (std::find(included.begin(), included.end(), includeName) != included.end())
+        {
+            out.append("// #include \"" + includeName + "\" already included\n");
+            continue;
+        }
+
+        const std::string includeSrc = GetRawShaderSource(includeName.c_str());
+        if (includeSrc.empty())
+        {
+            LOG_ERROR("Shader include not found: \"%s\"", includeName.c_str());
+            if (std::find(missing.begin(), missing.end(), includeName) == missing.end())
+                missing.push_back(includeName);
+            out.append("#error include not found: " + includeName + "\n");
+            continue;
+        }
+
+        included.push_back(includeName);
+        const int includeIndex = static_cast<int>(included.size());
+        char lineStr[64];
+        sprintf(lineStr, "// #include \"%s\" is source %d\n#line 1 %d\n",
+            includeName.c_str(), includeIndex, includeIndex);
+        out.append(lineStr);
+        appendIncludes(includeSrc, includeIndex, out, included, missing);
+        sprintf(lineStr, "#line %d %d\n", lineNumber + 1, sourceIndex);
+        out.append(lineStr);
+    }
+}
+
+// Resolve the #include directives in source against the shader directory and
+// the hard-coded table. filename names source for the cache and hot reload; it
+// may be NULL for source that does not come from a file, such as Lua's.
+// A cached result is used only while the include files it read are unchanged.
+const std::string resolveShaderIncludes(const std::string& source, const char* filename)
+{
+    if (source.find("#include") == std::string::npos)
+        return source;
+
+    const unsigned long long h = hashShaderSource(filename ? filename : "", source);
+    const std::map<unsigned long long, ResolvedSource>::const_iterator it = s_resolvedSources.find(h);
+    if ((it != s_resolvedSources.end()) && isResolvedSourceCurrent(it->second))
+        return it->second.text;
+
+    std::string out;
+    out.reserve(source.length());
+    std::vector<std::string> included;
+    std::vector<std::string> missing;
+    appendIncludes(source, 0, out, included, missing);
+    if (!source.empty() && (source[source.length()-1] != '\n'))
+        out.erase(out.length() - 1);
+
+    if (filename != NULL)
+    {
+        for (std::vector<std::string>::const_iterator inc = included.begin();
+             inc != included.end();
+             ++inc)
+        {
+            std::vector<std::string>& includers = s_includers[*inc];
+            if (std::find(includers.begin(), includers.end(), filename) == includers.end())
+                includers.push_back(filename);
+        }
+    }
+
+    ResolvedSource& resolved = s_resolvedSources[h];
+    resolved.text = out;
+    resolved.includes.clear();
+    for (std::vector<std::string>::const_iterator inc = included.begin();
+         inc != included.end();
+         ++inc)
+    {
+        resolved.includes.push_back(stampShaderInclude(*inc));
+    }
+    for (std::vector<std::string>::const_iterator inc = missing.begin();
+         inc != missing.end();
+         ++inc)
+    {
+        resolved.includes.push_back(stampShaderInclude(*inc));
+    }
+    return out;
+}
+
+// Return the files that included includeName, directly or through another
+// include, the last time they were loaded.
+void getShaderIncluders(const std::string& includeName, std::vector<std::string>& filenames)
+{
+    filenames.clear();
+    const std::map<std::string, std::vector<std::string> >::const_iterator it = s_includers.find(includeName);
+    if (it != s_includers.end())
+        filenames = it->second;
+}
+
+// Forget resolved sources so the next load reads included files again.
+void clearShaderSourceCache()
+{
+    s_resolvedSources.clear();
+}
+
+// Return shader source from filename with its #includes resolved.
+const std::string GetShaderSource(const char* filename)
+{
+    return resolveShaderIncludes(GetRawShaderSource(filename), filename);
+}
+
+// Split a list of defines separated by spaces, tabs or semicolons into a sorted
+// list without duplicates, so the same set always makes the same variant.
+void parseShaderDefines(const char* pDefines, std::vector<std::string>& defines)
+{
+    defines.clear();
+    if (pDefines == NULL)
+        return;
+
+    std::string token;
+    for (const char* p = pDefines; ; ++p)
+    {
+        const char c = *p;
+        if ((c == '\0') || (c == ' ') || (c == '\t') || (c == ';'))
+        {
+            if (!token.empty())
+                defines.push_back(token);
+            token.clear();
+            if (c == '\0')
+                break;
+        }
+        else
+        {
+            token.push_back(c);
+        }
+    }
+
+    std::sort(defines.begin(), defines.end());
+    defines.erase(std::unique(defines.begin(), defines.end()), defines.end());
+}
+
+// Return the ShaderMgr key for a shader name and a set of defines: the name alone
+// if there are none, otherwise name#DEF1;DEF2 with the defines in sorted order.
+const std::string makeShaderVariantKey(const char* name, const std::vector<std::string>& defines)
+{
+    std::string key(name ? name : "");
+    for (size_t i=0; i<defines.size(); ++i)
+    {
+        key.push_back((i == 0) ? '#' : ';');
+        key.append(defines[i]);
+    }
+    return key;
+}
+
+// Inverse of makeShaderVariantKey.
+void splitShaderVariantKey(const std::string& key, std::string& name, std::vector<std::string>& defines)
+{
+    const std::string::size_type hash = key.find('#');
+    name = key.substr(0, hash);
+    if (hash == std::string::npos)
+        defines.clear();
+    else
+        parseShaderDefines(key.c_str() + hash + 1, defines);
+}
+
+// Prepare shader source for this platform and variant: adjust the #version line
+// where the driver needs it, then insert a #define for each entry(NAME or NAME=value)
+// after it. A #line directive keeps compiler messages on the original line numbers.
+const std::string preprocessShaderSource(const std::string& source, const std::vector<std::string>& defines)
 {
-    std::string shaderSource = GetShaderSource(filename);
+    if (source.empty())
+        return source;
+
+    // Defines go after the #version line, which must come first.
+    std::string::size_type insertPos = 0;
+    int nextLine = 1;
+    std::string versionLine;
+    if (source.compare(0, 8, "#version") == 0)
+    {
+        const std::string::size_type eol = source.find('\n');
+        insertPos = (eol == std::string::npos) ? source.length() : eol + 1;
+        versionLine = source.substr(0, insertPos);
+        nextLine = 2;
+    }
+
 #ifdef _MACOS
-    myReplace(shaderSource, "#version 310 es", "#version 330");
+    if (versionLine.compare(0, 15, "#version 310 es") == 0)
+    {
+        versionLine = "#version 330\n";
+    }
 #endif
-    
+
+    if (defines.empty() && (source.compare(0, insertPos, versionLine) == 0))
+        return source;
+
+    std::string out = versionLine;
+    if (!out.empty() && (out[out.length()-1] != '\n'))
+        out.push_back('\n');
+    for (std::vector<std::string>::const_iterator it = defines.begin();
+         it != defines.end();
+         ++it)
+    {
+        std::string def = *it;
+        const std::string::size_type eq = def.find('=');
+        if (eq != std::string::npos)
+            def[eq] = ' ';
+        out.append("#define ");
+        out.append(def);
+        out.push_back('\n');
+    }
+    if (!defines.empty())
+    {
+        char lineStr[32];
+        sprintf(lineStr, "#line %d\n", nextLine);
+        out.append(lineStr);
+    }
+    out.append(source, insertPos, std::string::npos);
+    return out;
+}
+
+// Compile a shader of the given type from source and return the ID.
+static GLuint compileShaderSource(const std::string& shaderSource, const unsigned long Type)
+{
     if (shaderSource.empty())
         return 0;
     GLint length = shaderSource.length();
@@ -156,108 +509,234 @@ GLuint loadShaderFile(const char* filename, const unsigned long Type)
     return shaderId;
 }
 
-// Append any applicable suffixes to the name given and attempt to find
-// vertex, fragment and (optionally) geometry shader source.
-GLuint makeShaderByName(const char* name)
+// Once source is obtained from either file or hard-coded map, compile the
+// shader, release the string memory and return the ID.
+GLuint loadShaderFile(const char* filename, const unsigned long Type)
 {
-    if (!name)
-        return 0;
+    const std::vector<std::string> noDefines;
+    return compileShaderSource(preprocessShaderSource(GetShaderSource(filename), noDefines), Type);
+}
 
-    std::string vs(name);
-    std::string fs(name);
-    vs += ".vert";
-    fs += ".frag";
+#ifndef GL_COMPLETION_STATUS_KHR
+#  define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
 
-    LOG_INFO("Create shader: [%s] ...", name);
+// Returns true if the driver compiles and links on its own threads and lets us
+// poll for completion with GL_COMPLETION_STATUS_KHR instead of blocking.
+bool hasParallelShaderCompile()
+{
+    static int s_hasParallel = -1;
+    if (s_hasParallel < 0)
+    {
+        s_hasParallel = 0;
+        GLint numExtensions = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+        for (GLint i=0; i<numExtensions; ++i)
+        {
+            const char* pExt = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+            if (pExt == NULL)
+                continue;
+            if (!strcmp(pExt, "GL_KHR_parallel_shader_compile") ||
+                !strcmp(pExt, "GL_ARB_parallel_shader_compile"))
+            {
+                s_hasParallel = 1;
+                break;
+            }
+        }
+        LOG_INFO("Parallel shader compile: %s", s_hasParallel ? "yes" : "no");
+    }
+    return s_hasParallel != 0;
+}
 
-    GLint compileStatus = GL_FALSE;
+// Submit the vertex and fragment shader files for compiling and linking under the
+// given name, without waiting on the results. Each stage is compiled once and
+// no status is queried here; finishShader checks the link and reports errors.
+// If pAttribLocations is given, its attributes are bound to those locations
+// before linking, e.g. to keep a relinked program compatible with existing VAOs.
+static bool beginShaderFromFiles(
+    const std::string& name,
+    const char* vert,
+    const char* frag,
+    const std::map<std::string, GLint>* pAttribLocations,
+    const std::vector<std::string>& defines,
+    PendingShader& pending)
+{
+    pending = PendingShader();
+    pending.name = name;
+    pending.timer.reset();
 
-    /// Vertex shader
-    GLuint vertSrc = loadShaderFile(vs.c_str(), GL_VERTEX_SHADER);
-    compileStatus = GL_FALSE;
-    glGetShaderiv(vertSrc, GL_COMPILE_STATUS, &compileStatus);
-    if (compileStatus == GL_FALSE)
+    const std::string vertSource = preprocessShaderSource(GetShaderSource(vert), defines);
+    const std::string fragSource = preprocessShaderSource(GetShaderSource(frag), defines);
+    // Vertex and fragment shaders are required
+    if (vertSource.empty() || fragSource.empty())
+    {
+        LOG_ERROR("Create shader: [%s] ... source not found.", name.c_str());
+        return false;
+    }
+
+    ProgramCacheMgr::AppendStage(pending.cacheKey, GL_VERTEX_SHADER, vertSource);
+    ProgramCacheMgr::AppendStage(pending.cacheKey, GL_FRAGMENT_SHADER, fragSource);
+    if (pAttribLocations != NULL)
+    {
+        for (std::map<std::string, GLint>::const_iterator it = pAttribLocations->begin();
+             it != pAttribLocations->end();
+             ++it)
+        {
+            char locStr[16];
+            sprintf(locStr, "=%d;", it->second);
+            pending.cacheKey.append(it->first);
+            pending.cacheKey.append(locStr);
+        }
+    }
+    pending.program = ProgramCacheMgr::Instance().LoadProgram(pending.cacheKey);
+    if (pending.program != 0)
     {
-        printShaderInfoLog(vertSrc);
+        pending.fromCache = true;
+        return true;
     }
 
-    /// Fragment shader
-    GLuint fragSrc = loadShaderFile(fs.c_str(), GL_FRAGMENT_SHADER);
-    compileStatus = GL_FALSE;
-    glGetShaderiv(fragSrc, GL_COMPILE_STATUS, &compileStatus);
-    if (compileStatus == GL_FALSE)
+    pending.vertShader = compileShaderSource(vertSource, GL_VERTEX_SHADER);
+    pending.fragShader = compileShaderSource(fragSource, GL_FRAGMENT_SHADER);
+
+    pending.program = glCreateProgram();
+    glAttachShader(pending.program, pending.vertShader);
+    glAttachShader(pending.program, pending.fragShader);
+
+    if (pAttribLocations != NULL)
     {
-        printShaderInfoLog(fragSrc);
+        for (std::map<std::string, GLint>::const_iterator it = pAttribLocations->begin();
+             it != pAttribLocations->end();
+             ++it)
+        {
+            if (it->second >= 0)
+                glBindAttribLocation(pending.program, it->second, it->first.c_str());
+        }
     }
 
-    GLuint program = glCreateProgram();
+    ProgramCacheMgr::PrepareForLink(pending.program);
+    glLinkProgram(pending.program);
+    return true;
+}
 
-    glCompileShader(vertSrc);
-    glCompileShader(fragSrc);
+// Append any applicable suffixes to the name given and submit the vertex and
+// fragment shaders for compiling and linking, without waiting on the results.
+// Status is checked by finishShader, so the driver may work on many programs
+// at once when they are all begun before any is finished.
+bool beginShaderByName(
+    const char* name,
+    const std::vector<std::string>& defines,
+    PendingShader& pending,
+    const std::map<std::string, GLint>* pAttribLocations)
+{
+    pending = PendingShader();
+    if (!name)
+        return false;
 
-    glAttachShader(program, vertSrc);
-    glAttachShader(program, fragSrc);
+    std::string vs(name);
+    std::string fs(name);
+    vs += ".vert";
+    fs += ".frag";
+    return beginShaderFromFiles(makeShaderVariantKey(name, defines), vs.c_str(), fs.c_str(), pAttribLocations, defines, pending);
+}
 
-    // Will be deleted when program is.
-    glDeleteShader(vertSrc);
-    glDeleteShader(fragSrc);
+// Returns true when finishShader can be called without stalling.
+// Without parallel compile support there is no way to tell, so always true.
+bool isShaderReady(const PendingShader& pending)
+{
+    if (pending.fromCache || (pending.program == 0))
+        return true;
+    if (!hasParallelShaderCompile())
+        return true;
+
+    GLint complete = GL_FALSE;
+    glGetProgramiv(pending.program, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete == GL_TRUE;
+}
 
-    glLinkProgram(program);
+// Check the results of beginShaderByName, blocking if they are not ready,
+// report any errors and release the shader objects. Returns the program.
+GLuint finishShader(PendingShader& pending)
+{
+    const GLuint program = pending.program;
+    if (pending.fromCache)
+    {
+        LOG_INFO("Create shader: [%s] ... loaded from cache.", pending.name.c_str());
+        CameraUniformMgr::BindProgram(program);
+        return program;
+    }
+    if (program == 0)
+        return 0;
 
     GLint linkStatus = GL_FALSE;
     glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
     if (linkStatus == GL_TRUE)
     {
-        LOG_INFO("  success.");
+        LOG_INFO("Create shader: [%s] ... success.", pending.name.c_str());
+        ProgramCacheMgr::Instance().StoreProgram(pending.cacheKey, program, pending.timer.seconds());
+        CameraUniformMgr::BindProgram(program);
     }
     else
     {
-        LOG_ERROR("  Link failed: ");
+        LOG_ERROR("Create shader: [%s] ... Link failed: ", pending.name.c_str());
+        const GLuint shaders[] = { pending.vertShader, pending.fragShader };
+        for (int i=0; i<2; ++i)
+        {
+            GLint compileStatus = GL_FALSE;
+            glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &compileStatus);
+            if (compileStatus == GL_FALSE)
+            {
+                printShaderInfoLog(shaders[i]);
+            }
+        }
         printProgramInfoLog(program);
     }
 
-    glUseProgram(0);
+    // Shaders are no longer needed once the program is linked.
+    glDetachShader(program, pending.vertShader);
+    glDetachShader(program, pending.fragShader);
+    glDeleteShader(pending.vertShader);
+    glDeleteShader(pending.fragShader);
+    pending.vertShader = 0;
+    pending.fragShader = 0;
+
     return program;
 }
 
-GLuint makeShaderFromSource(
-    const char* vert,
-    const char* frag)
+// Compile and link a program by name, blocking until it is done.
+GLuint makeShaderByName(const char* name)
 {
-    const GLuint vertSrc = loadShaderFile(vert, GL_VERTEX_SHADER);
-    printShaderInfoLog(vertSrc);
-
-    const GLuint fragSrc = loadShaderFile(frag, GL_FRAGMENT_SHADER);
-    printShaderInfoLog(fragSrc);
+    const std::vector<std::string> noDefines;
+    return makeShaderByName(name, noDefines);
+}
 
-    // Vertex and fragment shaders are required
-    if ((vertSrc == 0) || (fragSrc == 0))
-    {
-        LOG_ERROR("  SHADER NOT COMPILED - source not found.");
+// Compile and link a variant of a program with the given defines, blocking until it is done.
+GLuint makeShaderByName(const char* name, const std::vector<std::string>& defines)
+{
+    PendingShader pending;
+    if (!beginShaderByName(name, defines, pending))
         return 0;
-    }
-
-    const GLuint program = glCreateProgram();
-
-    glCompileShader(vertSrc);
-    glCompileShader(fragSrc);
-
-    GLint success = 0;
-    glGetShaderiv(vertSrc, GL_COMPILE_STATUS, &success);
-    //assert(success == GL_TRUE);
-    glGetShaderiv(fragSrc, GL_COMPILE_STATUS, &success);
-    //assert(success == GL_TRUE);
-
-    glAttachShader(program, vertSrc);
-    glAttachShader(program, fragSrc);
-
-    // Will be deleted when program is.
-    glDeleteShader(vertSrc);
-    glDeleteShader(fragSrc);
-
-    glLinkProgram(program);
-    printProgramInfoLog(program);
+    const GLuint program = finishShader(pending);
+    GLStateMgr::Instance().UseProgram(0);
+    return program;
+}
 
-    glUseProgram(0);
+// Compile and link a program from vertex and fragment shader files, blocking until
+// it is done. The program is returned even if it failed to link; check GL_LINK_STATUS.
+// If pAttribLocations is given, its attributes are bound to those locations
+// before linking, e.g. to keep a relinked program compatible with existing VAOs.
+// If pDefines is given, they are injected into both stages.
+GLuint makeShaderFromSource(
+    const char* vert,
+    const char* frag,
+    const std::map<std::string, GLint>* pAttribLocations,
+    const std::vector<std::string>* pDefines)
+{
+    const std::vector<std::string> noDefines;
+    const std::vector<std::string>& defines = pDefines ? *pDefines : noDefines;
+    PendingShader pending;
+    if (!beginShaderFromFiles(vert, vert, frag, pAttribLocations, defines, pending))
+        return 0;
+    const GLuint program = finishShader(pending);
+    GLStateMgr::Instance().UseProgram(0);
     return program;
 }
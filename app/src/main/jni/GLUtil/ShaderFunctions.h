@@ -3,18 +3,65 @@
 #pragma once
 
 #include "GL_Includes.h"
+#include "Timer.h"
 
+#include <map>
 #include <string>
+#include <vector>
 typedef char GLchar;
 
+///@brief A program submitted by beginShaderByName whose status has not been checked yet.
+struct PendingShader
+{
+    PendingShader()
+    : name()
+    , cacheKey()
+    , program(0)
+    , vertShader(0)
+    , fragShader(0)
+    , fromCache(false)
+    , timer()
+    {}
+
+    std::string name;
+    std::string cacheKey;
+    GLuint program;
+    GLuint vertShader;
+    GLuint fragShader;
+    bool fromCache;
+    Timer timer;
+};
+
 GLint getUniLoc(const GLuint program, const GLchar *name);
 void  printShaderInfoLog(GLuint obj);
 void  printProgramInfoLog(GLuint obj);
 
+const char* GetShaderSourceFromTable(const char* filename, size_t& length);
+const std::string GetShaderSourceDirectory();
 const std::string GetShaderSource(const char* filename);
+const std::string resolveShaderIncludes(const std::string& source, const char* filename=NULL);
+void getShaderIncluders(const std::string& includeName, std::vector<std::string>& filenames);
+void clearShaderSourceCache();
+
+void parseShaderDefines(const char* pDefines, std::vector<std::string>& defines);
+const std::string makeShaderVariantKey(const char* name, const std::vector<std::string>& defines);
+void splitShaderVariantKey(const std::string& key, std::string& name, std::vector<std::string>& defines);
+const std::string preprocessShaderSource(const std::string& source, const std::vector<std::string>& defines);
 GLuint loadShaderFile(const char* filename, const unsigned long Type);
 GLuint makeShaderByName(const char* name);
+GLuint makeShaderByName(const char* name, const std::vector<std::string>& defines);
+
+bool  hasParallelShaderCompile();
+bool  beginShaderByName(
+    const char* name,
+    const std::vector<std::string>& defines,
+    PendingShader& pending,
+    const std::map<std::string, GLint>* pAttribLocations=NULL);
+bool  isShaderReady(const PendingShader& pending);
+GLuint finishShader(PendingShader& pending);
 
 GLuint makeShaderFromSource(
     const char* vertSrc,
-    const char* fragSrc);
+    const char* fragSrc,
+    const std::map<std::string, GLint>* pAttribLocations=NULL,
+    const std::vector<std::string>* pDefines=NULL);
@@ -0,0 +1,287 @@
+// ShaderMgr.cpp
+
+#include "ShaderMgr.h"
+#include "GLStateMgr.h"
+#include "Logging.h"
+
+#include <algorithm>
+
+void ShaderMgr::Destroy()
+{
+    // Pending programs are finished first so their shader objects are released too.
+    while (!m_pending.empty())
+    {
+        _Finish(m_pending.begin());
+    }
+
+    typedef std::map<std::string, GLuint>::iterator it_type;
+    for(it_type it = m_shaderTable.begin(); it != m_shaderTable.end(); ++it)
+    {
+        GLStateMgr::Instance().DeleteProgram(it->second);
+    }
+    m_shaderTable.clear();
+    m_watcher.Stop();
+    m_listeners.clear();
+}
+
+///@brief Submit a shader for compiling without waiting on it.
+/// Request all of a scene's shaders together so the driver can compile them in parallel.
+void ShaderMgr::RequestShader(const char* pKey)
+{
+    if (pKey == NULL)
+        return;
+
+    std::string key(pKey);
+    if (key.empty())
+        return;
+    if ((m_shaderTable.count(key) > 0) || (m_pending.count(key) > 0))
+        return;
+
+    std::string name;
+    std::vector<std::string> defines;
+    splitShaderVariantKey(key, name, defines);
+
+    PendingShader& pending = m_pending[key];
+    if (!beginShaderByName(name.c_str(), defines, pending))
+    {
+        m_pending.erase(key);
+        m_shaderTable[key] = 0;
+    }
+}
+
+///@brief Check the status of any pending programs that have finished compiling.
+/// Call once per frame.
+void ShaderMgr::Update()
+{
+    _PollHotReload();
+
+    std::map<std::string, PendingShader>::iterator it = m_pending.begin();
+    while (it != m_pending.end())
+    {
+        std::map<std::string, PendingShader>::iterator next = it;
+        ++next;
+        if (isShaderReady(it->second))
+        {
+            _Finish(it);
+        }
+        it = next;
+    }
+
+    // Copy so listeners may add or remove themselves while being updated.
+    const std::vector<ShaderReloadListener*> listeners = m_listeners;
+    for (std::vector<ShaderReloadListener*>::const_iterator lit = listeners.begin();
+         lit != listeners.end();
+         ++lit)
+    {
+        (*lit)->OnShaderMgrUpdate();
+    }
+}
+
+///@return The key's program: the new one, or for a rebuild that failed, the previous one
+GLuint ShaderMgr::_Finish(std::map<std::string, PendingShader>::iterator it)
+{
+    const std::string key = it->first;
+    const GLuint prog = finishShader(it->second);
+    m_pending.erase(it);
+
+    GLuint& tableProg = m_shaderTable[key];
+    if (tableProg != 0)
+    {
+        // A rebuild after the source changed: keep the previous program unless this one linked.
+        GLint linkStatus = GL_FALSE;
+        if (prog != 0)
+            glGetProgramiv(prog, GL_LINK_STATUS, &linkStatus);
+        if (linkStatus != GL_TRUE)
+        {
+            GLStateMgr::Instance().DeleteProgram(prog);
+            LOG_ERROR("  [%s] failed to build, keeping previous program.", key.c_str());
+            return tableProg;
+        }
+        GLStateMgr::Instance().DeleteProgram(tableProg);
+    }
+    tableProg = prog;
+    return prog;
+}
+
+///@return The program if it is ready, or 0 while it is still compiling.
+/// Requests the shader if it has not been already.
+GLuint ShaderMgr::PollShaderByName(const char* pKey)
+{
+    if (pKey == NULL)
+        return 0;
+
+    std::string key(pKey);
+    const std::map<std::string, GLuint>::const_iterator found = m_shaderTable.find(key);
+    if (found != m_shaderTable.end())
+        return found->second;
+
+    RequestShader(pKey);
+    const std::map<std::string, PendingShader>::iterator it = m_pending.find(key);
+    if (it == m_pending.end())
+        return 0;
+    if (!isShaderReady(it->second))
+        return 0;
+    return _Finish(it);
+}
+
+///@return The program, blocking until it has been compiled if necessary.
+GLuint ShaderMgr::GetShaderByName(const char* pKey)
+{
+    if (pKey == NULL)
+        return 0;
+
+    std::string key(pKey);
+
+    /// Return a NULL shader for an empty string
+    if (key.empty())
+        return 0;
+
+    const std::map<std::string, GLuint>::const_iterator found = m_shaderTable.find(key);
+    if (found != m_shaderTable.end())
+        return found->second;
+
+    RequestShader(pKey);
+    const std::map<std::string, PendingShader>::iterator it = m_pending.find(key);
+    if (it == m_pending.end())
+        return m_shaderTable[key];
+    return _Finish(it);
+}
+
+///@brief Get a variant of a shader built with the given defines injected after its #version line.
+///@param pDefines Defines separated by spaces or semicolons, each NAME or NAME=value
+///@return The program, blocking until it has been compiled if necessary.
+GLuint ShaderMgr::GetShaderVariant(const char* pName, const char* pDefines)
+{
+    std::vector<std::string> defines;
+    parseShaderDefines(pDefines, defines);
+    return GetShaderByName(makeShaderVariantKey(pName, defines).c_str());
+}
+
+///@return The variant's program if it is ready, or 0 while it is still compiling.
+GLuint ShaderMgr::PollShaderVariant(const char* pName, const char* pDefines)
+{
+    std::vector<std::string> defines;
+    parseShaderDefines(pDefines, defines);
+    return PollShaderByName(makeShaderVariantKey(pName, defines).c_str());
+}
+
+bool ShaderMgr::IsPending(const char* pKey) const
+{
+    if (pKey == NULL)
+        return false;
+    return m_pending.count(pKey) > 0;
+}
+
+///@brief Watch the shader source directory and rebuild shaders as their files change.
+///@return false if shaders are not loaded from files on this platform or it cannot be watched
+bool ShaderMgr::EnableHotReload()
+{
+    const std::string dir = GetShaderSourceDirectory();
+    if (dir.empty())
+        return false;
+    if (!m_watcher.Start(dir))
+    {
+        LOG_INFO("Shader hot reload not available for %s", dir.c_str());
+        return false;
+    }
+    LOG_INFO("Watching %s for shader changes", dir.c_str());
+    return true;
+}
+
+void ShaderMgr::AddReloadListener(ShaderReloadListener* pListener)
+{
+    if (pListener == NULL)
+        return;
+    if (std::find(m_listeners.begin(), m_listeners.end(), pListener) == m_listeners.end())
+        m_listeners.push_back(pListener);
+}
+
+void ShaderMgr::RemoveReloadListener(ShaderReloadListener* pListener)
+{
+    m_listeners.erase(
+        std::remove(m_listeners.begin(), m_listeners.end(), pListener),
+        m_listeners.end());
+}
+
+void ShaderMgr::_PollHotReload()
+{
+    if (!m_watcher.IsWatching())
+        return;
+
+    std::vector<std::string> changedFiles;
+    m_watcher.Poll(changedFiles);
+    if (changedFiles.empty())
+        return;
+
+    // Shaders that include a changed file must be rebuilt along with it.
+    clearShaderSourceCache();
+    const size_t directCount = changedFiles.size();
+    for (size_t i=0; i<directCount; ++i)
+    {
+        std::vector<std::string> includers;
+        getShaderIncluders(changedFiles[i], includers);
+        changedFiles.insert(changedFiles.end(), includers.begin(), includers.end());
+    }
+
+    // Both stages of a shader are often saved together; rebuild it only once.
+    std::vector<std::string> changedNames;
+    for (std::vector<std::string>::const_iterator it = changedFiles.begin();
+         it != changedFiles.end();
+         ++it)
+    {
+        const std::string::size_type dot = it->rfind('.');
+        if (dot == std::string::npos)
+            continue;
+        const std::string name = it->substr(0, dot);
+        if (std::find(changedNames.begin(), changedNames.end(), name) == changedNames.end())
+            changedNames.push_back(name);
+    }
+
+    for (std::vector<std::string>::const_iterator it = changedNames.begin();
+         it != changedNames.end();
+         ++it)
+    {
+        _ReloadShader(*it);
+    }
+}
+
+///@brief Start rebuilding a shader after its source changed, then notify listeners.
+/// Each variant keeps its previous program until Update finds the new one linked,
+/// and keeps it for good if the new one fails to link.
+void ShaderMgr::_ReloadShader(const std::string& name)
+{
+    LOG_INFO("Shader source changed: [%s]", name.c_str());
+
+    // Rebuild every variant of the shader.
+    for (std::map<std::string, GLuint>::iterator it = m_shaderTable.begin();
+         it != m_shaderTable.end();
+         ++it)
+    {
+        std::string baseName;
+        std::vector<std::string> defines;
+        splitShaderVariantKey(it->first, baseName, defines);
+        if (baseName != name)
+            continue;
+
+        PendingShader& pending = m_pending[it->first];
+        if (pending.program != 0)
+        {
+            // A rebuild from older files is superseded.
+            GLStateMgr::Instance().DeleteProgram(finishShader(pending));
+        }
+        if (!beginShaderByName(baseName.c_str(), defines, pending))
+        {
+            m_pending.erase(it->first);
+            LOG_ERROR("  [%s] failed to build, keeping previous program.", it->first.c_str());
+        }
+    }
+
+    // Copy so listeners may add or remove themselves while being notified.
+    const std::vector<ShaderReloadListener*> listeners = m_listeners;
+    for (std::vector<ShaderReloadListener*>::const_iterator it = listeners.begin();
+         it != listeners.end();
+         ++it)
+    {
+        (*it)->OnShaderChanged(name);
+    }
+}
@@ -5,9 +5,32 @@
 #include "Singleton.h"
 #include <string>
 #include <map>
+#include <vector>
 #include "ShaderFunctions.h"
+#include "FileWatcher.h"
+
+///@brief Receives notice from ShaderMgr when a shader's source files change on disk.
+class ShaderReloadListener
+{
+public:
+    virtual ~ShaderReloadListener() {}
+
+    ///@param name Shader name without its .vert/.frag suffix
+    virtual void OnShaderChanged(const std::string& name) = 0;
+
+    /// Called from every ShaderMgr::Update, to finish rebuilds without blocking.
+    virtual void OnShaderMgrUpdate() {}
+};
 
 ///@brief A list of all shaders for use in the UI
+/// Shaders may be requested ahead of use so the driver can compile them in parallel;
+/// PollShaderByName then returns 0 until a program is ready, letting the caller draw
+/// a placeholder instead of stalling. GetShaderByName always blocks until ready.
+/// Keys may name a variant, built from the same files with #defines injected;
+/// see makeShaderVariantKey. Each variant is compiled and cached separately.
+/// With hot reload enabled, shaders whose files or #included files change are rebuilt in place
+/// without waiting on the driver; the previous program is used until Update finds the new one
+/// linked, and is kept if the new one fails to build.
 ///@warning Do not attempt to access this object outside of the GL thread!
 class ShaderMgr : public Singleton
 {
@@ -17,41 +40,36 @@ public:
         static ShaderMgr instance;
         return instance;
     }
-    void Destroy()
-    {
-        typedef std::map<std::string, GLuint>::iterator it_type;
-        for(it_type it = m_shaderTable.begin(); it != m_shaderTable.end(); ++it)
-        {
-            GLuint prog = it->second;
-            if (prog != 0)
-                glDeleteProgram(prog);
-        }
-    }
-
-    GLuint GetShaderByName(const char* pKey)
-    {
-        if (pKey == NULL)
-            return 0;
+    void Destroy();
 
-        std::string key(pKey);
+    void RequestShader(const char* pKey);
+    void Update();
+    GLuint PollShaderByName(const char* pKey);
+    GLuint GetShaderByName(const char* pKey);
+    GLuint GetShaderVariant(const char* pName, const char* pDefines);
+    GLuint PollShaderVariant(const char* pName, const char* pDefines);
 
-        /// Return a NULL shader for an empty string
-        if (key.empty())
-            return 0;
+    bool EnableHotReload();
+    void AddReloadListener(ShaderReloadListener* pListener);
+    void RemoveReloadListener(ShaderReloadListener* pListener);
 
-        if (m_shaderTable.count(key) == 0)
-        {
-            m_shaderTable[key] = makeShaderByName(pKey);
-        }
-
-        return m_shaderTable[key];
-    }
+    /// const Accessors
+    bool IsPending(const char* pKey) const;
+    bool IsHotReloadEnabled() const { return m_watcher.IsWatching(); }
+    int GetPendingCount() const { return static_cast<int>(m_pending.size()); }
 
 protected:
-    std::map<std::string, GLuint>  m_shaderTable;
+    GLuint _Finish(std::map<std::string, PendingShader>::iterator it);
+    void _PollHotReload();
+    void _ReloadShader(const std::string& name);
+
+    std::map<std::string, GLuint>         m_shaderTable;
+    std::map<std::string, PendingShader>  m_pending;  ///< Submitted, status not yet checked
+    FileWatcher                           m_watcher;
+    std::vector<ShaderReloadListener*>    m_listeners;
 
 private:
-    ShaderMgr() : m_shaderTable() {}
+    ShaderMgr() : m_shaderTable(), m_pending(), m_watcher(), m_listeners() {}
     ~ShaderMgr() {} /// Destroy() should be called before the context is torn down.
     ShaderMgr(ShaderMgr const& copy);            // Not Implemented
     ShaderMgr& operator=(ShaderMgr const& copy); // Not Implemented
@@ -2,20 +2,40 @@
 
 #include "ShaderWithVariables.h"
 #include "ShaderFunctions.h"
-#include "StringFunctions.h"
+#include "ProgramCacheMgr.h"
+#include "CameraUniformMgr.h"
+#include "Timer.h"
 #include "Logging.h"
 
+#include <string.h>
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <vector>
 
+int ShaderWithVariables::s_totalUploadsIssued = 0;
+int ShaderWithVariables::s_totalUploadsSkipped = 0;
+
 ShaderWithVariables::ShaderWithVariables()
-: m_program(0)
+: m_name()
+, m_defines()
+, m_program(0)
 , m_vao(0)
+, m_pending()
+, m_isPending(false)
+, m_reload()
+, m_isReloading(false)
 , m_attrs()
 , m_unis()
+, m_blocks()
 , m_vbos()
+, m_uniHandleNames()
+, m_uniHandleLocs()
+, m_attrHandleNames()
+, m_attrHandleLocs()
+, m_uniShadows()
+, m_uploadsIssued(0)
+, m_uploadsSkipped(0)
 {
 }
 
@@ -26,15 +46,30 @@ ShaderWithVariables::~ShaderWithVariables()
 
 void ShaderWithVariables::destroy()
 {
+    if (m_isPending)
+    {
+        // Waits for the driver, but releases the shader objects with the program.
+        m_program = finishShader(m_pending);
+        m_pending = PendingShader();
+        m_isPending = false;
+    }
+
+    if (m_isReloading)
+    {
+        GLStateMgr::Instance().DeleteProgram(finishShader(m_reload));
+        m_reload = PendingShader();
+        m_isReloading = false;
+    }
+
     if (m_program != 0)
     {
-        glDeleteProgram(m_program);
+        GLStateMgr::Instance().DeleteProgram(m_program);
         m_program = 0;
     }
 
     if (m_vao != 0)
     {
-        glDeleteVertexArrays(1, &m_vao);
+        GLStateMgr::Instance().DeleteVertexArray(m_vao);
         m_vao = 0;
     }
 
@@ -42,43 +77,172 @@ void ShaderWithVariables::destroy()
         it != m_vbos.end();
         ++it)
     {
-        GLuint vbo = it->second;
-        glDeleteBuffers(1, &vbo);
+        GLStateMgr::Instance().DeleteBuffer(it->second);
     }
 
     m_attrs.clear();
     m_unis.clear();
+    m_blocks.clear();
     m_vbos.clear();
+    resolveHandles();
 }
 
-void ShaderWithVariables::initProgram(const char* shadername)
+///@param pDefines Optional defines to build a variant with, separated by spaces or semicolons
+void ShaderWithVariables::initProgram(const char* shadername, const char* pDefines)
 {
     glGenVertexArrays(1, &m_vao);
 
     LOG_INFO("Shader [%s]", shadername);
+    m_name = shadername;
+    parseShaderDefines(pDefines, m_defines);
 
     std::string vs = shadername;
     std::string fs = shadername;
     vs += ".vert";
     fs += ".frag";
 
-    m_program = makeShaderFromSource(vs.c_str(), fs.c_str());
+    m_program = makeShaderFromSource(vs.c_str(), fs.c_str(), NULL, &m_defines);
     if (m_program == 0)
         return;
 
-    const std::string vsrc = GetShaderSource(vs.c_str());
-    findVariables(vsrc.c_str());
-    const std::string fsrc = GetShaderSource(fs.c_str());
-    findVariables(fsrc.c_str());
+    reflectProgram();
+
+    LOG_INFO(" %d uniforms, %d attributes, %d uniform blocks", m_unis.size(), m_attrs.size(), m_blocks.size());
+}
+
+///@brief Start building a program without waiting for the driver to compile it.
+/// Call pollProgram until it returns true before drawing with the program;
+/// handles may be resolved in the meantime.
+///@param pDefines Optional defines to build a variant with, separated by spaces or semicolons
+void ShaderWithVariables::requestProgram(const char* shadername, const char* pDefines)
+{
+    glGenVertexArrays(1, &m_vao);
+
+    LOG_INFO("Shader [%s] requested", shadername);
+    m_name = shadername;
+    parseShaderDefines(pDefines, m_defines);
+    m_isPending = beginShaderByName(shadername, m_defines, m_pending);
+}
+
+///@return true once the program from requestProgram or initProgram is ready to draw
+/// with. Never waits on the driver; the program is reflected on the call that finds it done.
+bool ShaderWithVariables::pollProgram()
+{
+    if (!m_isPending)
+        return m_program != 0;
+    if (!isShaderReady(m_pending))
+        return false;
+
+    m_program = finishShader(m_pending);
+    m_pending = PendingShader();
+    m_isPending = false;
+    reflectProgram();
+    LOG_INFO(" %d uniforms, %d attributes, %d uniform blocks", m_unis.size(), m_attrs.size(), m_blocks.size());
+    return m_program != 0;
+}
+
+///@brief Start rebuilding the program from its files without waiting on the driver.
+/// The current program stays in use until pollReload finds the new one linked.
+///@return true if a rebuild was started
+bool ShaderWithVariables::reloadProgram()
+{
+    if (m_name.empty())
+        return false;
+
+    if (m_isPending)
+    {
+        // Still building from the old files; start again from the new ones.
+        GLStateMgr::Instance().DeleteProgram(finishShader(m_pending));
+        m_isPending = beginShaderByName(m_name.c_str(), m_defines, m_pending);
+        return false;
+    }
+
+    if (m_isReloading)
+    {
+        // Superseded by newer files.
+        GLStateMgr::Instance().DeleteProgram(finishShader(m_reload));
+        m_reload = PendingShader();
+        m_isReloading = false;
+    }
+
+    // Array attributes are listed under both "name" and "name[0]"; bind each only once,
+    // by its base name, as glBindAttribLocation does not take subscripts.
+    std::map<std::string, GLint> attribLocations;
+    for (std::map<std::string, GLint>::const_iterator it = m_attrs.begin();
+         it != m_attrs.end();
+         ++it)
+    {
+        if (it->first.find('[') == std::string::npos)
+            attribLocations.insert(*it);
+    }
+
+    m_isReloading = beginShaderByName(m_name.c_str(), m_defines, m_reload, &attribLocations);
+    if (!m_isReloading)
+        LOG_ERROR("Shader [%s] failed to reload, keeping previous program.", m_name.c_str());
+    return m_isReloading;
+}
+
+///@brief Swap in the program started by reloadProgram once the driver is done with it.
+/// On failure the current program is kept. Never waits on the driver.
+///@return true if the program was replaced
+bool ShaderWithVariables::pollReload()
+{
+    if (!m_isReloading)
+        return false;
+    if (!isShaderReady(m_reload))
+        return false;
+
+    const GLuint newProgram = finishShader(m_reload);
+    m_reload = PendingShader();
+    m_isReloading = false;
+
+    GLint linkStatus = GL_FALSE;
+    if (newProgram != 0)
+        glGetProgramiv(newProgram, GL_LINK_STATUS, &linkStatus);
+    if (linkStatus != GL_TRUE)
+    {
+        if (newProgram != 0)
+            GLStateMgr::Instance().DeleteProgram(newProgram);
+        LOG_ERROR("Shader [%s] failed to reload, keeping previous program.", m_name.c_str());
+        return false;
+    }
 
-    LOG_INFO(" %d uniforms, %d attributes", m_unis.size(), m_attrs.size());
+    GLStateMgr::Instance().DeleteProgram(m_program);
+    m_program = newProgram;
+    reflectProgram();
+    LOG_INFO("Shader [%s] reloaded.", m_name.c_str());
+    return true;
+}
+
+void ShaderWithVariables::OnShaderChanged(const std::string& name)
+{
+    if (name == m_name)
+        reloadProgram();
+}
+
+void ShaderWithVariables::OnShaderMgrUpdate()
+{
+    pollReload();
 }
 
 void ShaderWithVariables::initComputeShader(const char* shadername)
 {
+    m_name.clear();
+    m_defines.clear();
+    const std::string comp_src = GetShaderSource(shadername);
+    std::string cacheKey;
+    ProgramCacheMgr::AppendStage(cacheKey, GL_COMPUTE_SHADER, comp_src);
+    const GLuint cached_prog = ProgramCacheMgr::Instance().LoadProgram(cacheKey);
+    if (cached_prog != 0)
+    {
+        m_program = cached_prog;
+        reflectProgram();
+        return;
+    }
+    const Timer compileTimer;
+
     GLuint comp_shader = 0;
     comp_shader = glCreateShader(GL_COMPUTE_SHADER);
-    const std::string comp_src = GetShaderSource(shadername);
     const GLchar* pSS = &comp_src[0];
     glShaderSource(comp_shader, 1, &pSS, NULL);
 
@@ -98,6 +262,8 @@ void ShaderWithVariables::initComputeShader(const char* shadername)
 
     GLuint comp_prog = glCreateProgram();
     glAttachShader(comp_prog, comp_shader);
+    glDeleteShader(comp_shader); // Will be deleted when program is.
+    ProgramCacheMgr::PrepareForLink(comp_prog);
     glLinkProgram(comp_prog);
 
     glGetProgramiv(comp_prog, GL_LINK_STATUS, &status);
@@ -112,48 +278,140 @@ void ShaderWithVariables::initComputeShader(const char* shadername)
     }
 
     m_program = comp_prog;
-    findVariables(comp_src.c_str());
+    reflectProgram();
     if (errors == false)
     {
         std::cout << "Compute shader compiled successfully." << std::endl;
+        ProgramCacheMgr::Instance().StoreProgram(cacheKey, comp_prog, compileTimer.seconds());
     }
 }
 
-void ShaderWithVariables::findVariables(const char* vertsrc)
+/// Strip the "[0]" GL appends to the names of array variables.
+static std::string BaseVariableName(const char* pName)
 {
-    ///@todo handle all kinds of line breaks?
-    std::vector<std::string> vtoks = split(vertsrc, '\n');
+    std::string name(pName);
+    const std::string::size_type bracket = name.find('[');
+    if (bracket != std::string::npos)
+        name.erase(bracket);
+    return name;
+}
 
-    for (std::vector<std::string>::const_iterator it = vtoks.begin();
-        it != vtoks.end();
-        ++it)
+///@brief Fill in the variable tables from the linked program's active variables.
+void ShaderWithVariables::reflectProgram()
+{
+    m_attrs.clear();
+    m_unis.clear();
+    m_blocks.clear();
+
+    if (m_program != 0)
     {
-        const std::string& line = *it;
-        ///@todo Handle tabs, etc.
-        std::vector<std::string> tokens = split(line, ' ');
-        if (tokens.size() < 3)
-            continue;
+        GLint linkStatus = GL_FALSE;
+        glGetProgramiv(m_program, GL_LINK_STATUS, &linkStatus);
+        if (linkStatus != GL_TRUE)
+        {
+            resolveHandles();
+            return;
+        }
 
-        // We are assuming this will strip off the trailing semicolon.
-        std::string var = tokens[2];
-        var = var.substr(0, var.length()-1);
+        GLint count = 0;
+        GLint maxLen = 0;
+        std::vector<GLchar> name;
 
-        if (!tokens[0].compare("uniform"))
+        glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLen);
+        name.resize(maxLen + 1);
+        for (GLint i=0; i<count; ++i)
         {
-            m_unis[var] = glGetUniformLocation(m_program, var.c_str());
+            GLsizei len = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(m_program, i, static_cast<GLsizei>(name.size()), &len, &size, &type, &name[0]);
+            const GLint loc = glGetUniformLocation(m_program, &name[0]);
+            if (loc == -1) // Members of uniform blocks have no location
+                continue;
+            m_unis[BaseVariableName(&name[0])] = loc;
+            m_unis[&name[0]] = loc;
         }
-        else if (!tokens[0].compare("in"))
+
+        glGetProgramiv(m_program, GL_ACTIVE_ATTRIBUTES, &count);
+        glGetProgramiv(m_program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLen);
+        name.resize(maxLen + 1);
+        for (GLint i=0; i<count; ++i)
         {
-            m_attrs[var] = glGetAttribLocation(m_program, var.c_str());
+            GLsizei len = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveAttrib(m_program, i, static_cast<GLsizei>(name.size()), &len, &size, &type, &name[0]);
+            const GLint loc = glGetAttribLocation(m_program, &name[0]);
+            m_attrs[BaseVariableName(&name[0])] = loc;
+            m_attrs[&name[0]] = loc;
         }
-        else if (!tokens[0].compare("attribute")) // deprecated keyword
+
+        glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+        glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLen);
+        name.resize(maxLen + 1);
+        for (GLint i=0; i<count; ++i)
         {
-            m_attrs[var] = glGetAttribLocation(m_program, var.c_str());
+            GLsizei len = 0;
+            glGetActiveUniformBlockName(m_program, i, static_cast<GLsizei>(name.size()), &len, &name[0]);
+            m_blocks[&name[0]] = static_cast<GLuint>(i);
         }
+
+        // Camera data is shared by all programs through one buffer bound once per frame.
+        const GLuint cameraBlock = GetUniformBlockIndex("CameraBlock");
+        if (cameraBlock != GL_INVALID_INDEX)
+            glUniformBlockBinding(m_program, cameraBlock, CameraUniformMgr::BlockBinding);
     }
+
+    resolveHandles();
 }
 
-GLint ShaderWithVariables::GetAttrLoc(const std::string name) const
+///@brief Look up the location of every handed-out handle in the current tables.
+/// The program may be new, so forget the values previously uploaded.
+void ShaderWithVariables::resolveHandles()
+{
+    for (size_t i=0; i<m_uniHandleNames.size(); ++i)
+    {
+        m_uniHandleLocs[i] = GetUniLoc(m_uniHandleNames[i]);
+    }
+    invalidateUniformCache();
+    for (size_t i=0; i<m_attrHandleNames.size(); ++i)
+    {
+        m_attrHandleLocs[i] = GetAttrLoc(m_attrHandleNames[i]);
+    }
+}
+
+///@return A handle for the named uniform, for use with GetUniLoc(int).
+/// Names not active in the program still get a handle, whose location is -1.
+int ShaderWithVariables::GetUniformHandle(const std::string& name)
+{
+    for (size_t i=0; i<m_uniHandleNames.size(); ++i)
+    {
+        if (m_uniHandleNames[i] == name)
+            return static_cast<int>(i);
+    }
+    m_uniHandleNames.push_back(name);
+    m_uniHandleLocs.push_back(GetUniLoc(name));
+    UniformShadow shadow;
+    shadow.valid = false;
+    m_uniShadows.push_back(shadow);
+    return static_cast<int>(m_uniHandleNames.size()) - 1;
+}
+
+///@return A handle for the named attribute, for use with GetAttrLoc(int).
+int ShaderWithVariables::GetAttributeHandle(const std::string& name)
+{
+    for (size_t i=0; i<m_attrHandleNames.size(); ++i)
+    {
+        if (m_attrHandleNames[i] == name)
+            return static_cast<int>(i);
+    }
+    m_attrHandleNames.push_back(name);
+    m_attrHandleLocs.push_back(GetAttrLoc(name));
+    return static_cast<int>(m_attrHandleNames.size()) - 1;
+}
+
+GLint ShaderWithVariables::GetAttrLoc(const std::string& name) const
 {
     std::map<std::string, GLint>::const_iterator it = m_attrs.find(name);
     if (it == m_attrs.end()) // key not found
@@ -161,7 +419,7 @@ GLint ShaderWithVariables::GetAttrLoc(const std::string name) const
     return it->second;
 }
 
-GLint ShaderWithVariables::GetUniLoc(const std::string name) const
+GLint ShaderWithVariables::GetUniLoc(const std::string& name) const
 {
     std::map<std::string, GLint>::const_iterator it = m_unis.find(name);
     if (it == m_unis.end()) // key not found
@@ -176,3 +434,89 @@ GLuint ShaderWithVariables::GetVboLoc(const std::string name) const
         return 0; // -1 values are ignored silently by GL
     return it->second;
 }
+
+GLuint ShaderWithVariables::GetUniformBlockIndex(const std::string& name) const
+{
+    std::map<std::string, GLuint>::const_iterator it = m_blocks.find(name);
+    if (it == m_blocks.end()) // key not found
+        return GL_INVALID_INDEX;
+    return it->second;
+}
+
+///@brief Forget the last uploaded values so the next SetUniform* call on each handle uploads.
+void ShaderWithVariables::invalidateUniformCache() const
+{
+    for (std::vector<UniformShadow>::iterator it = m_uniShadows.begin();
+        it != m_uniShadows.end();
+        ++it)
+    {
+        it->valid = false;
+    }
+}
+
+///@return true if the value differs from the last one uploaded through handle, which
+/// it replaces; the caller then uploads it. false if the upload can be skipped.
+bool ShaderWithVariables::uniformChanged(int handle, const void* pData, size_t bytes) const
+{
+    const GLint loc = GetUniLoc(handle);
+    if (loc == -1)
+        return false; // GL would ignore it anyway
+
+    UniformShadow& shadow = m_uniShadows[handle];
+    if (shadow.valid && (memcmp(shadow.data, pData, bytes) == 0))
+    {
+        ++m_uploadsSkipped;
+        ++s_totalUploadsSkipped;
+        return false;
+    }
+    memcpy(shadow.data, pData, bytes);
+    shadow.valid = true;
+    ++m_uploadsIssued;
+    ++s_totalUploadsIssued;
+    return true;
+}
+
+void ShaderWithVariables::SetUniform1i(int handle, GLint v) const
+{
+    if (uniformChanged(handle, &v, sizeof(v)))
+        glUniform1i(GetUniLoc(handle), v);
+}
+
+void ShaderWithVariables::SetUniform1f(int handle, GLfloat v) const
+{
+    if (uniformChanged(handle, &v, sizeof(v)))
+        glUniform1f(GetUniLoc(handle), v);
+}
+
+void ShaderWithVariables::SetUniform2f(int handle, GLfloat x, GLfloat y) const
+{
+    const GLfloat v[] = { x, y };
+    if (uniformChanged(handle, v, sizeof(v)))
+        glUniform2fv(GetUniLoc(handle), 1, v);
+}
+
+void ShaderWithVariables::SetUniform3f(int handle, GLfloat x, GLfloat y, GLfloat z) const
+{
+    const GLfloat v[] = { x, y, z };
+    if (uniformChanged(handle, v, sizeof(v)))
+        glUniform3fv(GetUniLoc(handle), 1, v);
+}
+
+void ShaderWithVariables::SetUniform4f(int handle, GLfloat x, GLfloat y, GLfloat z, GLfloat w) const
+{
+    const GLfloat v[] = { x, y, z, w };
+    if (uniformChanged(handle, v, sizeof(v)))
+        glUniform4fv(GetUniLoc(handle), 1, v);
+}
+
+void ShaderWithVariables::SetUniformMatrix4fv(int handle, const GLfloat* pMtx) const
+{
+    if ((pMtx != NULL) && uniformChanged(handle, pMtx, 16 * sizeof(GLfloat)))
+        glUniformMatrix4fv(GetUniLoc(handle), 1, GL_FALSE, pMtx);
+}
+
+void ShaderWithVariables::ResetTotalUniformUploadCounts()
+{
+    s_totalUploadsIssued = 0;
+    s_totalUploadsSkipped = 0;
+}
@@ -9,36 +9,112 @@
 #endif
 
 #include "GL_Includes.h"
+#include "GLStateMgr.h"
+#include "ShaderMgr.h"
 
 #include <map>
 #include <string>
+#include <vector>
 
-///@brief 
-class ShaderWithVariables
+///@brief A linked program with its active uniforms, attributes and uniform blocks
+/// found by querying GL after linking.
+/// Hot paths should resolve names to integer handles once with GetUniformHandle/
+/// GetAttributeHandle and then look up locations by handle, which indexes a flat array.
+/// Handles stay valid across destroy() and re-initialization of the program.
+/// When registered with ShaderMgr::AddReloadListener, a program created by initProgram
+/// is rebuilt when its files change, keeping attribute locations so VAOs stay valid.
+/// The rebuild is swapped in by a later ShaderMgr::Update once the driver has linked
+/// it, so editing a shader does not stall a frame.
+/// The SetUniform* functions keep a copy of the last value sent for each handle and
+/// skip the glUniform call when it has not changed. They upload to the bound program,
+/// which must be this one; values set with glUniform directly are not seen, so call
+/// invalidateUniformCache after doing that.
+/// A program declaring CameraBlock has it bound to CameraUniformMgr's buffer.
+/// requestProgram starts a build without waiting on it; pollProgram returns false
+/// until it is done, so the caller can draw a placeholder instead of stalling.
+class ShaderWithVariables : public ShaderReloadListener
 {
 public:
     ShaderWithVariables();
     virtual ~ShaderWithVariables();
 
-    virtual void initProgram(const char* shadername);
+    virtual void initProgram(const char* shadername, const char* pDefines=NULL);
+    virtual void requestProgram(const char* shadername, const char* pDefines=NULL);
+    bool pollProgram();
     virtual void initComputeShader(const char* shadername);
     virtual void AddVbo(const std::string name, GLuint vbo) { m_vbos[name] = vbo; }
     virtual void destroy();
+    virtual bool reloadProgram();
+    bool pollReload();
+    virtual void OnShaderChanged(const std::string& name);
+    virtual void OnShaderMgrUpdate();
 
     virtual GLuint prog() const { return m_program; }
-    virtual void bindVAO() const { glBindVertexArray(m_vao); }
-    virtual GLint GetAttrLoc(const std::string name) const;
-    virtual GLint GetUniLoc(const std::string name) const;
+    bool isPending() const { return m_isPending; }
+    virtual void bindVAO() const { GLStateMgr::Instance().BindVertexArray(m_vao); }
+    virtual GLint GetAttrLoc(const std::string& name) const;
+    virtual GLint GetUniLoc(const std::string& name) const;
     virtual GLuint GetVboLoc(const std::string name) const;
+    virtual GLuint GetUniformBlockIndex(const std::string& name) const;
+
+    int GetUniformHandle(const std::string& name);
+    int GetAttributeHandle(const std::string& name);
+    GLint GetUniLoc(int handle) const
+    {
+        return ((handle >= 0) && (handle < static_cast<int>(m_uniHandleLocs.size()))) ? m_uniHandleLocs[handle] : -1;
+    }
+    GLint GetAttrLoc(int handle) const
+    {
+        return ((handle >= 0) && (handle < static_cast<int>(m_attrHandleLocs.size()))) ? m_attrHandleLocs[handle] : -1;
+    }
+
+    void SetUniform1i(int handle, GLint v) const;
+    void SetUniform1f(int handle, GLfloat v) const;
+    void SetUniform2f(int handle, GLfloat x, GLfloat y) const;
+    void SetUniform3f(int handle, GLfloat x, GLfloat y, GLfloat z) const;
+    void SetUniform4f(int handle, GLfloat x, GLfloat y, GLfloat z, GLfloat w) const;
+    void SetUniformMatrix4fv(int handle, const GLfloat* pMtx) const;
+    void invalidateUniformCache() const;
+
+    int GetUniformUploadsIssued() const { return m_uploadsIssued; }
+    int GetUniformUploadsSkipped() const { return m_uploadsSkipped; }
+    static int GetTotalUniformUploadsIssued() { return s_totalUploadsIssued; }
+    static int GetTotalUniformUploadsSkipped() { return s_totalUploadsSkipped; }
+    static void ResetTotalUniformUploadCounts();
 
 protected:
-    virtual void findVariables(const char* vertsrc);
+    virtual void reflectProgram();
+    void resolveHandles();
+    bool uniformChanged(int handle, const void* pData, size_t bytes) const;
+
+    ///@brief The last value uploaded through a uniform handle.
+    struct UniformShadow
+    {
+        bool valid;
+        unsigned char data[16 * sizeof(GLfloat)]; ///< Large enough for a mat4
+    };
 
+    std::string m_name;  ///< Name passed to initProgram, empty for compute shaders
+    std::vector<std::string> m_defines;
     GLuint m_program;
     GLuint m_vao;
+    PendingShader m_pending; ///< Build started by requestProgram, valid if m_isPending
+    bool m_isPending;
+    PendingShader m_reload; ///< Rebuild started by reloadProgram, valid if m_isReloading
+    bool m_isReloading;
     std::map<std::string, GLint> m_attrs;
     std::map<std::string, GLint> m_unis;
+    std::map<std::string, GLuint> m_blocks;
     std::map<std::string, GLuint> m_vbos;
+    std::vector<std::string> m_uniHandleNames;
+    std::vector<GLint> m_uniHandleLocs;
+    std::vector<std::string> m_attrHandleNames;
+    std::vector<GLint> m_attrHandleLocs;
+    mutable std::vector<UniformShadow> m_uniShadows; ///< Indexed by uniform handle
+    mutable int m_uploadsIssued;
+    mutable int m_uploadsSkipped;
+    static int s_totalUploadsIssued;
+    static int s_totalUploadsSkipped;
 
 private: // Disallow copy ctor and assignment operator
     ShaderWithVariables(const ShaderWithVariables&);
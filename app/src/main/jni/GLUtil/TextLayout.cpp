@@ -0,0 +1,386 @@
+// TextLayout.cpp
+
+#include "TextLayout.h"
+#include "FontRenderer.h"
+#include "Utf8Iterator.h"
+
+#include <algorithm>
+#include <map>
+
+TextLayout::TextLayout()
+: m_pFont(NULL)
+, m_wrapWidth(0)
+, m_doKerning(true)
+, m_text()
+, m_textValid(false)
+, m_paragraphs()
+, m_firstLines()
+, m_lineCount(0)
+, m_relayoutCount(0)
+, m_dirty(false)
+{
+}
+
+TextLayout::~TextLayout()
+{
+}
+
+void TextLayout::_MarkAllDirty()
+{
+    for (std::vector<Paragraph>::iterator it = m_paragraphs.begin();
+        it != m_paragraphs.end();
+        ++it)
+    {
+        it->dirty = true;
+    }
+    m_dirty = true;
+}
+
+void TextLayout::SetFont(const FontRenderer* pFont)
+{
+    if (pFont == m_pFont)
+        return;
+    m_pFont = pFont;
+    _MarkAllDirty();
+}
+
+void TextLayout::SetWrapWidth(int widthPx)
+{
+    if (widthPx == m_wrapWidth)
+        return;
+    m_wrapWidth = widthPx;
+    _MarkAllDirty();
+}
+
+void TextLayout::SetDoKerning(bool doKerning)
+{
+    if (doKerning == m_doKerning)
+        return;
+    m_doKerning = doKerning;
+    _MarkAllDirty();
+}
+
+///@brief Replace all text, splitting it into paragraphs on line feeds.
+/// Paragraphs are matched to the old ones by content, not position: unchanged
+/// paragraphs at the start and end are kept in place, and any in between whose
+/// text was there before take its line breaks, so inserting a line near the top
+/// of a long text lays out only that line.
+void TextLayout::SetText(const std::string& text)
+{
+    if (m_textValid && (text == m_text))
+        return;
+    m_text = text;
+    m_textValid = true;
+
+    // Byte range of each new paragraph, without its line feed or carriage return
+    std::vector<std::pair<size_t, size_t> > ranges;
+    size_t pos = 0;
+    while (!text.empty() && (pos <= text.length()))
+    {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos)
+            end = text.length();
+
+        size_t len = end - pos;
+        if ((len > 0) && (text[pos + len - 1] == '\r'))
+            --len;
+        ranges.push_back(std::make_pair(pos, len));
+        pos = end + 1;
+    }
+
+    const size_t oldCount = m_paragraphs.size();
+    const size_t newCount = ranges.size();
+    size_t head = 0;
+    while ((head < oldCount) && (head < newCount) &&
+        (m_paragraphs[head].text.compare(0, std::string::npos, text, ranges[head].first, ranges[head].second) == 0))
+    {
+        ++head;
+    }
+    size_t tail = 0;
+    while ((tail < oldCount - head) && (tail < newCount - head))
+    {
+        const Paragraph& para = m_paragraphs[oldCount - 1 - tail];
+        const std::pair<size_t, size_t>& range = ranges[newCount - 1 - tail];
+        if (para.text.compare(0, std::string::npos, text, range.first, range.second) != 0)
+            break;
+        ++tail;
+    }
+    if ((head == oldCount) && (head == newCount))
+        return;
+
+    // Line breaks depend only on a paragraph's text, so any old paragraph with
+    // the same text can lend its lines to a new one.
+    std::map<std::string, size_t> oldMiddle;
+    for (size_t i = head; i < oldCount - tail; ++i)
+        oldMiddle.insert(std::make_pair(m_paragraphs[i].text, i));
+
+    std::vector<Paragraph> middle(newCount - head - tail);
+    for (size_t i = 0; i < middle.size(); ++i)
+    {
+        const std::pair<size_t, size_t>& range = ranges[head + i];
+        Paragraph& para = middle[i];
+        para.text.assign(text, range.first, range.second);
+        const std::map<std::string, size_t>::const_iterator it = oldMiddle.find(para.text);
+        if (it == oldMiddle.end())
+        {
+            para.dirty = true;
+            continue;
+        }
+        const Paragraph& old = m_paragraphs[it->second];
+        para.lines = old.lines;
+        para.dirty = old.dirty;
+    }
+
+    m_paragraphs.erase(m_paragraphs.begin() + head, m_paragraphs.begin() + (oldCount - tail));
+    m_paragraphs.insert(m_paragraphs.begin() + head, middle.begin(), middle.end());
+    m_dirty = true;
+}
+
+void TextLayout::SetParagraph(size_t idx, const std::string& text)
+{
+    if (idx >= m_paragraphs.size())
+        return;
+    Paragraph& para = m_paragraphs[idx];
+    if (para.text == text)
+        return;
+    para.text = text;
+    para.dirty = true;
+    m_dirty = true;
+    m_textValid = false;
+}
+
+void TextLayout::InsertParagraph(size_t idx, const std::string& text)
+{
+    if (idx > m_paragraphs.size())
+        idx = m_paragraphs.size();
+    Paragraph para;
+    para.text = text;
+    para.dirty = true;
+    m_paragraphs.insert(m_paragraphs.begin() + idx, para);
+    m_dirty = true;
+    m_textValid = false;
+}
+
+void TextLayout::EraseParagraph(size_t idx)
+{
+    if (idx >= m_paragraphs.size())
+        return;
+    m_paragraphs.erase(m_paragraphs.begin() + idx);
+    m_dirty = true;
+    m_textValid = false;
+}
+
+void TextLayout::Clear()
+{
+    m_paragraphs.clear();
+    m_firstLines.clear();
+    m_text.clear();
+    m_textValid = false;
+    m_lineCount = 0;
+    m_dirty = false;
+}
+
+///@brief Re-lay-out any paragraphs edited since the last call.
+void TextLayout::Update()
+{
+    m_relayoutCount = 0;
+    if (!m_dirty)
+        return;
+
+    int lineCount = 0;
+    m_firstLines.resize(m_paragraphs.size());
+    for (size_t i = 0; i < m_paragraphs.size(); ++i)
+    {
+        Paragraph& para = m_paragraphs[i];
+        if (para.dirty)
+        {
+            _LayoutParagraph(para);
+            para.dirty = false;
+            ++m_relayoutCount;
+        }
+        m_firstLines[i] = lineCount;
+        lineCount += static_cast<int>(para.lines.size());
+    }
+    m_lineCount = lineCount;
+    m_dirty = false;
+}
+
+///@brief Find the paragraph and line within it of a wrapped line.
+///@param lineIdx Index of the line counting from the top of the text
+///@return false if there is no such line
+///@note Reflects the text as of the last call to Update.
+bool TextLayout::FindLine(int lineIdx, size_t& paragraph, size_t& lineInParagraph) const
+{
+    if ((lineIdx < 0) || (lineIdx >= m_lineCount) || (m_firstLines.size() != m_paragraphs.size()))
+        return false;
+    const std::vector<int>::const_iterator it = std::upper_bound(m_firstLines.begin(), m_firstLines.end(), lineIdx);
+    paragraph = static_cast<size_t>(it - m_firstLines.begin()) - 1;
+    lineInParagraph = static_cast<size_t>(lineIdx - m_firstLines[paragraph]);
+    return true;
+}
+
+///@return Index of a paragraph's first wrapped line counting from the top of
+/// the text as of the last call to Update, or -1 if there is no such paragraph
+int TextLayout::GetParagraphFirstLine(size_t idx) const
+{
+    if ((idx >= m_firstLines.size()) || (m_firstLines.size() != m_paragraphs.size()))
+        return -1;
+    return m_firstLines[idx];
+}
+
+///@brief Break one paragraph into lines no wider than the wrap width.
+/// Lines break after the last space that fits; a word too long for a line of
+/// its own is broken between glyphs. Every line holds at least one code point.
+/// The spaces a line is broken at are left off both lines.
+void TextLayout::_LayoutParagraph(Paragraph& para) const
+{
+    para.lines.clear();
+
+    const std::string& text = para.text;
+    const char* pBase = text.c_str();
+    Line line = { 0, 0, 0 };
+
+    if ((m_pFont == NULL) || text.empty())
+    {
+        line.len = text.length();
+        para.lines.push_back(line);
+        return;
+    }
+
+    const float maxWidth = static_cast<float>(m_wrapWidth);
+    const bool wrap = m_wrapWidth > 0;
+
+    size_t lineBegin = 0;
+    float pen = 0.f;          // Pen position relative to the start of the line
+    float lineExtent = 0.f;   // Right edge of the last glyph on the line
+    size_t breakPos = 0;      // Byte offset just past the last space, 0 for none
+    size_t breakEnd = 0;      // Byte offset of that space
+    float breakPen = 0.f;     // Pen position just past the last space
+    float breakExtent = 0.f;  // Line extent before that space
+    unsigned int chprev = 0;
+
+    Utf8Iterator it(pBase, text.length());
+    while (!it.AtEnd())
+    {
+        const size_t chBegin = it.Position() - pBase;
+        const unsigned int ch = it.Next();
+        const size_t chEnd = it.Position() - pBase;
+
+        const int kern = (m_doKerning && (chBegin > lineBegin)) ? m_pFont->KerningOffset(chprev, ch) : 0;
+        const float adv = m_pFont->GlyphAdvance(ch);
+        const float extent = pen + static_cast<float>(kern) + adv;
+        chprev = ch;
+
+        if (ch == ' ')
+        {
+            breakEnd = chBegin;
+            breakPos = chEnd;
+            breakExtent = lineExtent;
+            pen += adv;
+            breakPen = pen;
+            continue;
+        }
+
+        if (wrap && (extent > maxWidth) && (chBegin > lineBegin))
+        {
+            if (breakPos > lineBegin)
+            {
+                // Break at the last space: carry the partial word to the next line.
+                line.begin = lineBegin;
+                line.len = breakEnd - lineBegin;
+                line.widthPx = static_cast<int>(breakExtent);
+                para.lines.push_back(line);
+
+                lineBegin = breakPos;
+                pen -= breakPen;
+                lineExtent -= breakPen;
+            }
+            breakPos = 0;
+
+            // Re-measure this glyph at its new place on the line. If the carried
+            // word is still too long for it, or there was no space to break at,
+            // break the word before this glyph.
+            const int newKern = (m_doKerning && (chBegin > lineBegin)) ? kern : 0;
+            float newExtent = pen + static_cast<float>(newKern) + adv;
+            if ((newExtent > maxWidth) && (chBegin > lineBegin))
+            {
+                line.begin = lineBegin;
+                line.len = chBegin - lineBegin;
+                line.widthPx = static_cast<int>(lineExtent);
+                para.lines.push_back(line);
+
+                lineBegin = chBegin;
+                pen = 0.f;
+                lineExtent = 0.f;
+                newExtent = adv;
+            }
+            if (newExtent > lineExtent)
+                lineExtent = newExtent;
+            pen += adv;
+            continue;
+        }
+
+        if (extent > lineExtent)
+            lineExtent = extent;
+        pen += adv;
+    }
+
+    line.begin = lineBegin;
+    line.len = text.length() - lineBegin;
+    line.widthPx = static_cast<int>(lineExtent);
+    para.lines.push_back(line);
+}
+
+///@brief Draw the laid out lines top to bottom starting at (x,y).
+///@param firstLine Index of the first wrapped line to draw, for scrolling
+///@param maxLines Maximum number of lines to draw, -1 for all
+///@note Call Update first so the line breaks reflect the current text.
+void TextLayout::Draw(
+    int x,
+    int y,
+    int lineHeight,
+    float3 color,
+    const float* pProjMtx,
+    int firstLine,
+    int maxLines) const
+{
+    if (m_pFont == NULL)
+        return;
+
+    int lineIdx = 0;
+    int drawn = 0;
+    for (std::vector<Paragraph>::const_iterator it = m_paragraphs.begin();
+        it != m_paragraphs.end();
+        ++it)
+    {
+        const Paragraph& para = *it;
+        const int numLines = static_cast<int>(para.lines.size());
+        if (lineIdx + numLines <= firstLine)
+        {
+            lineIdx += numLines;
+            continue;
+        }
+
+        for (std::vector<Line>::const_iterator lit = para.lines.begin();
+            lit != para.lines.end();
+            ++lit, ++lineIdx)
+        {
+            if (lineIdx < firstLine)
+                continue;
+            if ((maxLines >= 0) && (drawn >= maxLines))
+                return;
+
+            const Line& line = *lit;
+            m_pFont->DrawString(
+                para.text.c_str() + line.begin,
+                line.len,
+                x,
+                y,
+                color,
+                pProjMtx,
+                m_doKerning);
+            y += lineHeight;
+            ++drawn;
+        }
+    }
+}
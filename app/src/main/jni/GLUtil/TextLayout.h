@@ -0,0 +1,84 @@
+// TextLayout.h
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "vectortypes.h"
+
+class FontRenderer;
+
+///@brief Word-wraps multi-line text to a pixel width using a FontRenderer's glyph metrics.
+/// Text is held as a list of paragraphs(split on line feeds), each with its own cached
+/// list of line breaks. Editing a paragraph only marks that paragraph dirty, so the next
+/// call to Update re-lays-out just the lines touched by the edit. Scripts reach it
+/// through the textlayout_* Lua functions.
+class TextLayout
+{
+public:
+    /// One wrapped line: a byte range into its paragraph's text.
+    struct Line
+    {
+        size_t begin;
+        size_t len;
+        int widthPx;
+    };
+
+    TextLayout();
+    virtual ~TextLayout();
+
+    void SetFont(const FontRenderer* pFont);
+    void SetWrapWidth(int widthPx);
+    void SetDoKerning(bool doKerning);
+
+    void SetText(const std::string& text);
+    void SetParagraph(size_t idx, const std::string& text);
+    void InsertParagraph(size_t idx, const std::string& text);
+    void EraseParagraph(size_t idx);
+    void Clear();
+
+    void Update();
+    void Draw(
+        int x,
+        int y,
+        int lineHeight,
+        float3 color,
+        const float* pProjMtx,
+        int firstLine=0,
+        int maxLines=-1) const;
+
+    /// const Accessors
+    size_t GetParagraphCount() const { return m_paragraphs.size(); }
+    const std::string& GetParagraph(size_t idx) const { return m_paragraphs[idx].text; }
+    const std::vector<Line>& GetParagraphLines(size_t idx) const { return m_paragraphs[idx].lines; }
+    int GetLineCount() const { return m_lineCount; }
+    bool FindLine(int lineIdx, size_t& paragraph, size_t& lineInParagraph) const;
+    int GetParagraphFirstLine(size_t idx) const;
+    int GetRelayoutCount() const { return m_relayoutCount; }
+
+protected:
+    struct Paragraph
+    {
+        std::string text;
+        std::vector<Line> lines;
+        bool dirty;
+    };
+
+    void _LayoutParagraph(Paragraph& para) const;
+    void _MarkAllDirty();
+
+    const FontRenderer*    m_pFont;
+    int                    m_wrapWidth; ///< Pixels, 0 or less for no wrapping
+    bool                   m_doKerning;
+    std::string            m_text;      ///< Last string given to SetText, to skip repeated calls
+    bool                   m_textValid; ///< False once paragraphs are edited individually
+    std::vector<Paragraph> m_paragraphs;
+    std::vector<int>       m_firstLines; ///< First wrapped line of each paragraph, set by Update
+    int                    m_lineCount;
+    int                    m_relayoutCount; ///< Paragraphs laid out by the last Update
+    bool                   m_dirty;
+
+private:
+    TextLayout(const TextLayout&);              ///< disallow copy constructor
+    TextLayout& operator = (const TextLayout&); ///< disallow assignment operator
+};
@@ -0,0 +1,255 @@
+// TextureAtlas.cpp
+
+#include "TextureAtlas.h"
+#include "TextureFunctions.h"
+#include "TextureMgr.h"
+#include "GLStateMgr.h"
+#include "MappedFile.h"
+#include "Logging.h"
+#include <string.h>
+#include <algorithm>
+
+/// Pixel transfer format for a channel count of 1 to 4 bytes per pixel.
+static bool getAtlasPixelFormat(unsigned int channels, GLenum& internalFormat, GLenum& format)
+{
+    switch (channels)
+    {
+    case 1: internalFormat = GL_R8;    format = GL_RED;  return true;
+    case 2: internalFormat = GL_RG8;   format = GL_RG;   return true;
+    case 3: internalFormat = GL_RGB8;  format = GL_RGB;  return true;
+    case 4: internalFormat = GL_RGBA8; format = GL_RGBA; return true;
+    default: return false;
+    }
+}
+
+///@brief Surround an image with copies of its edge texels.
+///@param left, bottom Padding columns and rows before the image
+///@param paddedWidth, paddedHeight Size of the result, at least the image's
+///@param padded [out] Tightly packed rows of the padded image
+static void padImage(const unsigned char* pPixels, unsigned int width, unsigned int height, unsigned int channels,
+    unsigned int left, unsigned int bottom, unsigned int paddedWidth, unsigned int paddedHeight,
+    std::vector<unsigned char>& padded)
+{
+    const size_t rowBytes = static_cast<size_t>(width) * channels;
+    const size_t paddedRowBytes = static_cast<size_t>(paddedWidth) * channels;
+    padded.resize(paddedRowBytes * paddedHeight);
+    for (unsigned int row = 0; row < paddedHeight; ++row)
+    {
+        // Rows below and above the image repeat its first and last.
+        const unsigned int srcRow = (row < bottom) ? 0 : std::min(row - bottom, height - 1);
+        const unsigned char* pSrc = pPixels + srcRow * rowBytes;
+        unsigned char* pDst = &padded[row * paddedRowBytes];
+        for (unsigned int col = 0; col < left; ++col)
+            memcpy(pDst + col * channels, pSrc, channels);
+        memcpy(pDst + left * channels, pSrc, rowBytes);
+        for (unsigned int col = left + width; col < paddedWidth; ++col)
+            memcpy(pDst + col * channels, pSrc + rowBytes - channels, channels);
+    }
+}
+
+///@param pageDimension Width and height of each page in pixels
+///@param channels Bytes per pixel of every image added, 1 to 4
+///@param arrayLayers Number of layers of a GL_TEXTURE_2D_ARRAY to hold the pages,
+/// all allocated when the first image is added; 0 to make 2D page textures as needed
+///@param padding Pixels around each image filled with copies of its edge texels,
+/// so linear filtering at an edge never reaches a neighbouring image
+TextureAtlas::TextureAtlas(unsigned int pageDimension, unsigned int channels, unsigned int arrayLayers, unsigned int padding)
+: m_pageDimension(pageDimension)
+, m_channels(channels)
+, m_arrayLayers(arrayLayers)
+, m_padding(padding)
+, m_packers()
+, m_textures()
+, m_imageArea(0)
+, m_imageCount(0)
+, m_padded()
+{
+}
+
+TextureAtlas::~TextureAtlas()
+{
+}
+
+/// Delete the page textures. Regions handed out before are no longer valid.
+void TextureAtlas::Destroy()
+{
+    for (std::vector<GLuint>::const_iterator it = m_textures.begin(); it != m_textures.end(); ++it)
+    {
+        TextureMgr::Instance().UntrackExternal(*it);
+        GLStateMgr::Instance().DeleteTexture(*it);
+    }
+    m_textures.clear();
+    m_packers.clear();
+    m_imageArea = 0;
+    m_imageCount = 0;
+}
+
+///@return The texture holding a page; every page of an array atlas is in the same one
+GLuint TextureAtlas::GetTexture(unsigned int page) const
+{
+    if (IsArray())
+        return m_textures.empty() ? 0 : m_textures[0];
+    return (page < m_textures.size()) ? m_textures[page] : 0;
+}
+
+///@return Fraction of the allocated pages covered by images
+float TextureAtlas::GetEfficiency() const
+{
+    const unsigned int pages = IsArray() ? m_arrayLayers : GetPageCount();
+    const float pageArea = static_cast<float>(m_pageDimension) * static_cast<float>(m_pageDimension);
+    if ((pages == 0) || (pageArea == 0.f) || m_textures.empty())
+        return 0.f;
+    return static_cast<float>(m_imageArea) / (pageArea * static_cast<float>(pages));
+}
+
+void TextureAtlas::LogStats() const
+{
+    LOG_INFO("TextureAtlas: %u images in %u of %u %u px pages, %d%% of allocated area used.",
+        m_imageCount, GetPageCount(), IsArray() ? m_arrayLayers : GetPageCount(),
+        m_pageDimension, static_cast<int>(100.f * GetEfficiency() + .5f));
+}
+
+///@brief Pack an image into the first page with room for it and upload it there.
+///@param pPixels [in] Tightly packed rows of width * channels bytes
+///@param region [out] Where the image was placed
+///@return false if the image is larger than a page or every page is full
+bool TextureAtlas::Add(const unsigned char* pPixels, unsigned int width, unsigned int height, AtlasRegion& region)
+{
+    if ((pPixels == NULL) || (width == 0) || (height == 0))
+        return false;
+    if ((width > m_pageDimension) || (height > m_pageDimension))
+    {
+        LOG_ERROR("TextureAtlas: %u x %u image does not fit in a %u px page.", width, height, m_pageDimension);
+        return false;
+    }
+
+    // Padding that would not fit beside an image as wide as the page is not needed
+    // there, as clamping to the page edge keeps filtering inside it.
+    const unsigned int packWidth = std::min(width + 2 * m_padding, m_pageDimension);
+    const unsigned int packHeight = std::min(height + 2 * m_padding, m_pageDimension);
+    unsigned int page = 0;
+    unsigned int x = 0;
+    unsigned int y = 0;
+    for (page = 0; page < m_packers.size(); ++page)
+    {
+        if (m_packers[page].Insert(packWidth, packHeight, x, y))
+            break;
+    }
+    if (page == m_packers.size())
+    {
+        if (!_AddPage() || !m_packers.back().Insert(packWidth, packHeight, x, y))
+        {
+            LOG_ERROR("TextureAtlas: no room for a %u x %u image in %u pages.", width, height, GetPageCount());
+            return false;
+        }
+    }
+
+    const unsigned int left = (packWidth - width) / 2;
+    const unsigned int bottom = (packHeight - height) / 2;
+    padImage(pPixels, width, height, m_channels, left, bottom, packWidth, packHeight, m_padded);
+    _Upload(page, x, y, packWidth, packHeight, &m_padded[0]);
+
+    // Inset half a texel so that linear filtering at the edges samples only the
+    // image's own edge texels.
+    const float dim = static_cast<float>(m_pageDimension);
+    region.page = page;
+    region.x = x + left;
+    region.y = y + bottom;
+    region.width = width;
+    region.height = height;
+    region.u0 = (static_cast<float>(region.x) + .5f) / dim;
+    region.v0 = (static_cast<float>(region.y) + .5f) / dim;
+    region.u1 = (static_cast<float>(region.x + width) - .5f) / dim;
+    region.v1 = (static_cast<float>(region.y + height) - .5f) / dim;
+
+    m_imageArea += static_cast<unsigned long>(width) * height;
+    ++m_imageCount;
+    return true;
+}
+
+/// Read a raw image file of width * height * channels bytes and add it to the atlas.
+bool TextureAtlas::AddRawFile(const char* pFilename, unsigned int width, unsigned int height, AtlasRegion& region)
+{
+    if (pFilename == NULL)
+        return false;
+    MappedFile file;
+    const unsigned char* pPixels = MapRawImage(file, pFilename, RawImageDesc(width, height, m_channels));
+    if (pPixels == NULL)
+    {
+        LOG_ERROR("TextureAtlas: could not read %s", pFilename);
+        return false;
+    }
+    return Add(pPixels, width, height, region);
+}
+
+///@brief Start a new page, making its texture cleared to zero.
+/// An array atlas makes its one texture with all its layers on the first call.
+///@return false if an array atlas has used all its layers
+bool TextureAtlas::_AddPage()
+{
+    GLenum internalFormat = 0;
+    GLenum format = 0;
+    if (!getAtlasPixelFormat(m_channels, internalFormat, format) || (m_pageDimension == 0))
+    {
+        LOG_ERROR("TextureAtlas: bad layout %u px x %u channels", m_pageDimension, m_channels);
+        return false;
+    }
+    if (IsArray() && (m_packers.size() >= m_arrayLayers))
+        return false;
+
+    m_packers.push_back(AtlasPacker(m_pageDimension, m_pageDimension));
+    if (IsArray() && !m_textures.empty())
+        return true;
+
+    GLuint textureId = 0;
+    glGenTextures(1, &textureId);
+    if (textureId == 0)
+    {
+        LOG_ERROR("Failed to create GL texture.");
+        m_packers.pop_back();
+        return false;
+    }
+
+    const GLenum target = GetTarget();
+    const std::vector<unsigned char> zeros(m_pageDimension * m_pageDimension * m_channels, 0);
+    GLStateMgr::Instance().BindTexture(target, textureId);
+    GLStateMgr::Instance().BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (IsArray())
+    {
+        glTexImage3D(target, 0, internalFormat, m_pageDimension, m_pageDimension, m_arrayLayers, 0, format, GL_UNSIGNED_BYTE, NULL);
+        for (unsigned int layer = 0; layer < m_arrayLayers; ++layer)
+            glTexSubImage3D(target, 0, 0, 0, layer, m_pageDimension, m_pageDimension, 1, format, GL_UNSIGNED_BYTE, &zeros[0]);
+    }
+    else
+    {
+        glTexImage2D(target, 0, internalFormat, m_pageDimension, m_pageDimension, 0, format, GL_UNSIGNED_BYTE, &zeros[0]);
+    }
+
+    const size_t layers = IsArray() ? m_arrayLayers : 1;
+    m_textures.push_back(textureId);
+    TextureMgr::Instance().TrackExternal(textureId, zeros.size() * layers);
+    return true;
+}
+
+/// Copy a rectangle of pixels into a page texture.
+void TextureAtlas::_Upload(unsigned int page, unsigned int x, unsigned int y, unsigned int width, unsigned int height, const unsigned char* pPixels) const
+{
+    GLenum internalFormat = 0;
+    GLenum format = 0;
+    getAtlasPixelFormat(m_channels, internalFormat, format);
+
+    const GLenum target = GetTarget();
+    GLStateMgr::Instance().BindTexture(target, GetTexture(page));
+    GLStateMgr::Instance().BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (IsArray())
+        glTexSubImage3D(target, 0, x, y, page, width, height, 1, format, GL_UNSIGNED_BYTE, pPixels);
+    else
+        glTexSubImage2D(target, 0, x, y, width, height, format, GL_UNSIGNED_BYTE, pPixels);
+}
@@ -0,0 +1,67 @@
+// TextureAtlas.h
+
+#pragma once
+
+#include "AtlasPacker.h"
+#include "GL_Includes.h"
+#include <vector>
+
+///@brief Where an image was placed in a TextureAtlas.
+struct AtlasRegion
+{
+    unsigned int page;      ///< Page index, which is the layer in an array atlas
+    unsigned int x;         ///< Corner of the image in the page, in pixels, inside its padding
+    unsigned int y;
+    unsigned int width;
+    unsigned int height;
+    float        u0;        ///< Texture coordinates of the centers of the image's corner texels
+    float        v0;
+    float        u1;
+    float        v1;
+};
+
+///@brief Packs small images into a few large textures so that geometry using any
+/// of them can be drawn with one bind. Images are added one at a time, at any point
+/// after the GL context exists, and are uploaded straight into place.
+/// Pages are either separate GL_TEXTURE_2Ds, added as each one fills, or a fixed
+/// number of layers of one GL_TEXTURE_2D_ARRAY, which needs only one bind in total.
+/// Page textures count toward TextureMgr's total texture memory.
+///@warning Do not attempt to access this object outside of the GL thread!
+class TextureAtlas
+{
+public:
+    TextureAtlas(unsigned int pageDimension, unsigned int channels, unsigned int arrayLayers = 0, unsigned int padding = 1);
+    virtual ~TextureAtlas();
+    void Destroy();
+
+    bool Add(const unsigned char* pPixels, unsigned int width, unsigned int height, AtlasRegion& region);
+    bool AddRawFile(const char* pFilename, unsigned int width, unsigned int height, AtlasRegion& region);
+    void LogStats() const;
+
+    /// const Accessors
+    bool IsArray() const { return m_arrayLayers > 0; }
+    GLenum GetTarget() const { return IsArray() ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D; }
+    GLuint GetTexture(unsigned int page) const;
+    unsigned int GetPageCount() const { return static_cast<unsigned int>(m_packers.size()); }
+    unsigned int GetImageCount() const { return m_imageCount; }
+    unsigned int GetPageDimension() const { return m_pageDimension; }
+    float GetEfficiency() const;
+
+protected:
+    bool _AddPage();
+    void _Upload(unsigned int page, unsigned int x, unsigned int y, unsigned int width, unsigned int height, const unsigned char* pPixels) const;
+
+    unsigned int              m_pageDimension;
+    unsigned int              m_channels;
+    unsigned int              m_arrayLayers;  ///< 0 for separate 2D page textures
+    unsigned int              m_padding;      ///< Pixels on each side of an image repeating its edge texels
+    std::vector<AtlasPacker>  m_packers;      ///< One per page in use
+    std::vector<GLuint>       m_textures;     ///< One per page, or the one array texture
+    unsigned long             m_imageArea;    ///< Pixels covered by images, without padding
+    unsigned int              m_imageCount;
+    std::vector<unsigned char> m_padded;      ///< Image being added with its padding filled in
+
+private:
+    TextureAtlas(const TextureAtlas&);              ///< disallow copy constructor
+    TextureAtlas& operator = (const TextureAtlas&); ///< disallow assignment operator
+};
@@ -3,46 +3,36 @@
 #include "GL_Includes.h"
 
 #include "TextureFunctions.h"
+#include "GLStateMgr.h"
+#include "KtxFile.h"
+#include "EtcDecoder.h"
+#include "MappedFile.h"
+#include "WorkerPool.h"
+#include "Timer.h"
 #include "Logging.h"
 #include <stdio.h>
 #include <fstream>
+#include <string>
+#include <algorithm>
 
-/// Load a square, power-of-two sized texture file from raw format.
-/// Assume file is luminance(grayscale) format, 8 bits per pixel.
-///@param pFilename Fully qualified path name
+/// Create a square, power-of-two sized texture from luminance(grayscale)
+/// pixels in memory, 8 bits per pixel.
+///@param pPixels [in] dimension*dimension bytes of pixel data
 ///@param dimension Size in pixels of one dimension of the square image
 ///@return TextureID of created texture (0 for none)
-GLuint CreateTextureFromRawFile(const char* pFilename, unsigned int dimension, int offset)
+GLuint CreateTextureFromLuminanceBuffer(const unsigned char* pPixels, unsigned int dimension)
 {
-    if (pFilename == NULL)
+    if (pPixels == NULL)
         return 0;
 
     GLuint textureId = 0;
 
-    LOG_INFO("Opening %d px square file %s ...", dimension, pFilename);
-    std::ifstream fs;
-    fs.open(pFilename, std::ios::in|std::ios::binary);
-    if (!fs.is_open())
-    {
-        LOG_ERROR("File %s not found.", pFilename);
-        return 0;
-    }
-
-    fs.seekg(offset, fs.beg);
-
-    const unsigned int dimx = dimension;
-    const unsigned int dimy = dimension;
-    const unsigned int sz = dimx * dimy;
-    const unsigned int szBytes = sz;
-    GLubyte* pPixels = new GLubyte[szBytes];
-    fs.read(reinterpret_cast<char*>(pPixels), szBytes);
-
     /// Create an OpenGL texture
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     glGenTextures(1, &textureId);
     if (textureId != 0)
     {
-        glBindTexture(GL_TEXTURE_2D, textureId);
+        GLStateMgr::Instance().BindTexture(GL_TEXTURE_2D, textureId);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -52,8 +42,8 @@ GLuint CreateTextureFromRawFile(const char* pFilename, unsigned int dimension, i
         glTexImage2D(GL_TEXTURE_2D,
             0,
             GL_R8,
-            dimx,
-            dimy,
+            dimension,
+            dimension,
             0,
             GL_RED,
             GL_UNSIGNED_BYTE,
@@ -63,9 +53,269 @@ GLuint CreateTextureFromRawFile(const char* pFilename, unsigned int dimension, i
     {
         LOG_INFO("Failed to create GL texture.");
     }
+    return textureId;
+}
+
+/// Pixel transfer format for a channel count of 1 to 4 bytes per pixel.
+static bool getRawPixelFormat(unsigned int channels, GLenum& internalFormat, GLenum& format)
+{
+    switch (channels)
+    {
+    case 1: internalFormat = GL_R8;    format = GL_RED;  return true;
+    case 2: internalFormat = GL_RG8;   format = GL_RG;   return true;
+    case 3: internalFormat = GL_RGB8;  format = GL_RGB;  return true;
+    case 4: internalFormat = GL_RGBA8; format = GL_RGBA; return true;
+    default: return false;
+    }
+}
+
+RawImageDesc::RawImageDesc(unsigned int w, unsigned int h, unsigned int c, unsigned int stride, int off)
+: width(w)
+, height(h)
+, channels(c)
+, rowStride(stride)
+, offset(off)
+{
+}
 
-    delete [] pPixels;
-    fs.close();
+///@return Bytes from the start of one row to the next
+unsigned int RawImageDesc::GetRowStride() const
+{
+    return (rowStride != 0) ? rowStride : width * channels;
+}
+
+/// Read the layout of a raw image from its sidecar file, named pFilename with ".info"
+/// appended. Each line holds a key and a number: width, height, channels, and
+/// optionally stride (bytes per row) and offset (bytes before the first row).
+///@return false if there is no sidecar or it lacks width, height or channels
+bool ReadRawImageInfo(const char* pFilename, RawImageDesc& desc)
+{
+    if (pFilename == NULL)
+        return false;
+
+    std::ifstream fs((std::string(pFilename) + ".info").c_str());
+    if (!fs.is_open())
+        return false;
+
+    RawImageDesc info;
+    std::string key;
+    long value = 0;
+    while (fs >> key >> value)
+    {
+        if (key == "width")         info.width = static_cast<unsigned int>(value);
+        else if (key == "height")   info.height = static_cast<unsigned int>(value);
+        else if (key == "channels") info.channels = static_cast<unsigned int>(value);
+        else if (key == "stride")   info.rowStride = static_cast<unsigned int>(value);
+        else if (key == "offset")   info.offset = static_cast<int>(value);
+    }
+    if ((info.width == 0) || (info.height == 0) || (info.channels == 0))
+        return false;
+    desc = info;
+    return true;
+}
+
+/// Find the unpack state that makes GL step through rows at the image's stride.
+/// A stride of whole pixels is given as a row length; a padded one as an alignment.
+///@return false if no unpack state gives the stride
+static bool getRawUnpackState(const RawImageDesc& desc, GLint& rowLength, GLint& alignment)
+{
+    const unsigned int stride = desc.GetRowStride();
+    if (stride % desc.channels == 0)
+    {
+        rowLength = stride / desc.channels;
+        alignment = 1;
+        return true;
+    }
+    const unsigned int rowBytes = desc.width * desc.channels;
+    for (alignment = 2; alignment <= 8; alignment *= 2)
+    {
+        if (stride == ((rowBytes + alignment - 1) & ~(alignment - 1)))
+        {
+            rowLength = desc.width;
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Map a raw image file and check that it holds the whole image desc describes.
+///@param file [out] Holds the mapping; the pixels are valid while it stays open
+///@return Pointer to the first pixel of the image, or NULL on failure
+const unsigned char* MapRawImage(MappedFile& file, const char* pFilename, const RawImageDesc& desc)
+{
+    if ((desc.width == 0) || (desc.height == 0) || (desc.channels == 0))
+        return NULL;
+    if (!file.Open(pFilename))
+    {
+        LOG_ERROR("File %s not found.", pFilename);
+        return NULL;
+    }
+
+    GLint rowLength = 0;
+    GLint alignment = 0;
+    if (!getRawUnpackState(desc, rowLength, alignment))
+    {
+        LOG_ERROR("Stride %u of %s is not whole pixels or a 2, 4 or 8 byte aligned row.", desc.GetRowStride(), pFilename);
+        return NULL;
+    }
+
+    const size_t stride = desc.GetRowStride();
+    const size_t needed = static_cast<size_t>(desc.offset) + stride * (desc.height - 1) + desc.width * desc.channels;
+    if ((desc.offset < 0) || (stride < desc.width * desc.channels) || (file.Size() < needed))
+    {
+        LOG_ERROR("%s holds %d bytes, too few for a %u x %u x %u image with stride %u at offset %d.",
+            pFilename, static_cast<int>(file.Size()), desc.width, desc.height, desc.channels,
+            static_cast<unsigned int>(stride), desc.offset);
+        return NULL;
+    }
+    return file.Data() + desc.offset;
+}
+
+/// Upload pixels straight from a mapped file. Rows need not be 4 byte aligned,
+/// so any width works, and padding past the end of each row is skipped by GL.
+static void uploadRawPixels(
+    GLenum target,
+    bool subImage,
+    GLint x,
+    GLint y,
+    GLsizei width,
+    GLsizei height,
+    const RawImageDesc& desc,
+    const unsigned char* pPixels)
+{
+    GLenum internalFormat = 0;
+    GLenum format = 0;
+    getRawPixelFormat(desc.channels, internalFormat, format);
+    GLint rowLength = 0;
+    GLint alignment = 1;
+    getRawUnpackState(desc, rowLength, alignment);
+
+    // Pointers are offsets into a bound unpack buffer.
+    GLStateMgr::Instance().BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+    if (subImage)
+        glTexSubImage2D(target, 0, x, y, width, height, format, GL_UNSIGNED_BYTE, pPixels);
+    else
+        glTexImage2D(target, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, pPixels);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+}
+
+/// Load a texture of any size from a raw image file, uploading directly from a
+/// memory mapping of the file with no intermediate copy.
+///@param pFilename Fully qualified path name
+///@param desc Layout of the image in the file
+///@param filter Minification filter. A mipmap filter has mipmaps generated at load;
+/// files with a mip chain made offline should be converted to KTX instead.
+///@return TextureID of created texture (0 for none)
+GLuint CreateTextureFromMappedRawFile(const char* pFilename, const RawImageDesc& desc, GLint filter)
+{
+    if (pFilename == NULL)
+        return 0;
+
+    GLenum internalFormat = 0;
+    GLenum format = 0;
+    if (!getRawPixelFormat(desc.channels, internalFormat, format) || (desc.width == 0) || (desc.height == 0))
+    {
+        LOG_ERROR("Bad raw image layout %u x %u x %u for %s", desc.width, desc.height, desc.channels, pFilename);
+        return 0;
+    }
+
+    MappedFile file;
+    const unsigned char* pPixels = MapRawImage(file, pFilename, desc);
+    if (pPixels == NULL)
+        return 0;
+
+    GLuint textureId = 0;
+    glGenTextures(1, &textureId);
+    if (textureId == 0)
+    {
+        LOG_ERROR("Failed to create GL texture.");
+        return 0;
+    }
+
+    const bool mipmapped = (filter != GL_LINEAR) && (filter != GL_NEAREST);
+    const bool nearest = (filter == GL_NEAREST) || (filter == GL_NEAREST_MIPMAP_NEAREST) || (filter == GL_NEAREST_MIPMAP_LINEAR);
+    GLStateMgr::Instance().BindTexture(GL_TEXTURE_2D, textureId);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, nearest ? GL_NEAREST : GL_LINEAR);
+    if (!mipmapped)
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    uploadRawPixels(GL_TEXTURE_2D, false, 0, 0, desc.width, desc.height, desc, pPixels);
+    if (mipmapped)
+        glGenerateMipmap(GL_TEXTURE_2D);
+    return textureId;
+}
+
+/// Load a texture from a raw image file described by its ".info" sidecar.
+///@return TextureID of created texture (0 for none)
+GLuint CreateTextureFromMappedRawFile(const char* pFilename, GLint filter)
+{
+    RawImageDesc desc;
+    if (!ReadRawImageInfo(pFilename, desc))
+    {
+        LOG_ERROR("No image info for %s", pFilename == NULL ? "(null)" : pFilename);
+        return 0;
+    }
+    return CreateTextureFromMappedRawFile(pFilename, desc, filter);
+}
+
+/// Replace a rectangle of an existing texture with a rectangle of a raw image file.
+///@param texture A GL_TEXTURE_2D with the same channel count as the file
+///@param srcX, srcY Corner of the rectangle in the file, in pixels
+///@param width, height Size of the rectangle
+///@param dstX, dstY Where to put it in level 0 of the texture
+///@return true if the file held the rectangle and it was uploaded
+bool UpdateTextureFromMappedRawFile(
+    GLuint texture,
+    const char* pFilename,
+    const RawImageDesc& desc,
+    unsigned int srcX,
+    unsigned int srcY,
+    unsigned int width,
+    unsigned int height,
+    int dstX,
+    int dstY)
+{
+    if ((texture == 0) || (pFilename == NULL))
+        return false;
+    if ((srcX + width > desc.width) || (srcY + height > desc.height))
+    {
+        LOG_ERROR("Rectangle %u,%u %ux%u is outside the %u x %u image %s",
+            srcX, srcY, width, height, desc.width, desc.height, pFilename);
+        return false;
+    }
+    GLenum internalFormat = 0;
+    GLenum format = 0;
+    if (!getRawPixelFormat(desc.channels, internalFormat, format))
+        return false;
+
+    MappedFile file;
+    const unsigned char* pPixels = MapRawImage(file, pFilename, desc);
+    if (pPixels == NULL)
+        return false;
+
+    pPixels += srcY * desc.GetRowStride() + srcX * desc.channels;
+    GLStateMgr::Instance().BindTexture(GL_TEXTURE_2D, texture);
+    uploadRawPixels(GL_TEXTURE_2D, true, dstX, dstY, width, height, desc, pPixels);
+    return true;
+}
+
+/// Load a square texture file from raw format.
+/// Assume file is luminance(grayscale) format, 8 bits per pixel.
+///@param pFilename Fully qualified path name
+///@param dimension Size in pixels of one dimension of the square image
+///@return TextureID of created texture (0 for none)
+GLuint CreateTextureFromRawFile(const char* pFilename, unsigned int dimension, int offset)
+{
+    if (pFilename == NULL)
+        return 0;
+
+    LOG_INFO("Opening %d px square file %s ...", dimension, pFilename);
+    const GLuint textureId = CreateTextureFromMappedRawFile(pFilename, RawImageDesc(dimension, dimension, 1, 0, offset), GL_LINEAR_MIPMAP_LINEAR);
     if (textureId != 0)
     {
         LOG_INFO("success.");
@@ -91,51 +341,381 @@ GLuint CreateColorTextureFromRawFile(
     if (pFilename == NULL)
         return 0;
 
-    GLuint textureId = 0;
-
     LOG_INFO_NONEWLINE("Opening %d x %d px texture file %s ...", x, y, pFilename);
-    std::ifstream fs;
-    fs.open(pFilename, std::ios::in|std::ios::binary);
-    if (!fs.is_open())
+    const GLuint textureId = CreateTextureFromMappedRawFile(pFilename, RawImageDesc(x, y, 3), GL_LINEAR_MIPMAP_LINEAR);
+    if (textureId != 0)
     {
-        LOG_ERROR("File %s not found.", pFilename);
-        return 0;
+        LOG_INFO("success.");
     }
+    return textureId;
+}
 
-    const unsigned int sz = x * y * 3; ///< RGB
-    const unsigned int szBytes = sz;
-    GLubyte* pPixels = new GLubyte[szBytes];
-    fs.read(reinterpret_cast<char*>(pPixels), szBytes);
+/// Maps one cubemap face and reads every page of it on a worker thread, so the
+/// six faces come off storage concurrently and the GL thread only uploads.
+class CubeFaceJob : public WorkerJob
+{
+public:
+    CubeFaceJob(const char* pFilename, const RawImageDesc* pDesc)
+    : m_filename(pFilename)
+    , m_desc()
+    , m_file()
+    , m_pPixels(NULL)
+    , m_useSidecar(pDesc == NULL)
+    , m_touched(0)
+    {
+        if (pDesc != NULL)
+            m_desc = *pDesc;
+    }
 
-    /// Create an OpenGL texture
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glGenTextures(1, &textureId);
+    virtual void Run()
+    {
+        if (m_useSidecar && !ReadRawImageInfo(m_filename.c_str(), m_desc))
+        {
+            LOG_ERROR("No image info for %s", m_filename.c_str());
+            return;
+        }
+        m_pPixels = MapRawImage(m_file, m_filename.c_str(), m_desc);
+        if (m_pPixels == NULL)
+            return;
+
+        // Fault in each page of the mapping now rather than during the upload.
+        const size_t pageSize = 4096;
+        unsigned int sum = 0;
+        for (size_t i = 0; i < m_file.Size(); i += pageSize)
+            sum += m_file.Data()[i];
+        m_touched = sum;
+    }
+
+    std::string          m_filename;
+    RawImageDesc         m_desc;
+    MappedFile           m_file;
+    const unsigned char* m_pPixels; ///< NULL if the face failed to load
+    bool                 m_useSidecar;
+    volatile unsigned int m_touched;
+
+private:
+    CubeFaceJob(const CubeFaceJob&);              ///< disallow copy constructor
+    CubeFaceJob& operator = (const CubeFaceJob&); ///< disallow assignment operator
+};
+
+/// Read the six faces on one worker thread each, check they are the same square
+/// size and format, and upload them all to one cubemap.
+///@param pDesc Layout shared by all faces, or NULL to read each face's sidecar
+static GLuint createCubemapFromRawFiles(const char* const pFilenames[6], const RawImageDesc* pDesc, bool mipmaps)
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        if (pFilenames[i] == NULL)
+            return 0;
+    }
+
+    const Timer loadTimer;
+    WorkerPool pool;
+    pool.Start(6);
+    CubeFaceJob* faces[6];
+    for (int i = 0; i < 6; ++i)
+    {
+        faces[i] = new CubeFaceJob(pFilenames[i], pDesc);
+        pool.Submit(faces[i]);
+    }
+    for (int i = 0; i < 6; ++i)
+        pool.WaitFinished();
+    pool.Stop();
+    const double readSeconds = loadTimer.seconds();
+
+    bool valid = true;
+    const RawImageDesc& desc = faces[0]->m_desc;
+    GLenum internalFormat = 0;
+    GLenum format = 0;
+    for (int i = 0; i < 6; ++i)
+    {
+        const CubeFaceJob& face = *faces[i];
+        if (face.m_pPixels == NULL)
+        {
+            valid = false;
+        }
+        else if ((faces[0]->m_pPixels != NULL) && (
+            (face.m_desc.width != desc.width) ||
+            (face.m_desc.height != desc.height) ||
+            (face.m_desc.channels != desc.channels)))
+        {
+            LOG_ERROR("Cubemap face %s is %u x %u x %u, but %s is %u x %u x %u.",
+                face.m_filename.c_str(), face.m_desc.width, face.m_desc.height, face.m_desc.channels,
+                faces[0]->m_filename.c_str(), desc.width, desc.height, desc.channels);
+            valid = false;
+        }
+    }
+    if (valid && (desc.width != desc.height))
+    {
+        LOG_ERROR("Cubemap faces must be square, not %u x %u.", desc.width, desc.height);
+        valid = false;
+    }
+    if (valid && !getRawPixelFormat(desc.channels, internalFormat, format))
+    {
+        LOG_ERROR("Bad cubemap channel count %u", desc.channels);
+        valid = false;
+    }
+
+    GLuint textureId = 0;
+    if (valid)
+        glGenTextures(1, &textureId);
     if (textureId != 0)
     {
-        glBindTexture(GL_TEXTURE_2D, textureId);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        const GLenum target = GL_TEXTURE_CUBE_MAP;
+        GLStateMgr::Instance().BindTexture(target, textureId);
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        if (!mipmaps)
+            glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, 0);
+        for (int i = 0; i < 6; ++i)
+        {
+            // Each face keeps its own stride and offset; only the image size must match.
+            uploadRawPixels(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, false, 0, 0,
+                desc.width, desc.height, faces[i]->m_desc, faces[i]->m_pPixels);
+        }
+        if (mipmaps)
+            glGenerateMipmap(target);
+        LOG_INFO("Loaded %u px cubemap in %.2f ms (%.2f ms reading faces).",
+            desc.width, 1000. * loadTimer.seconds(), 1000. * readSeconds);
+    }
 
-        glTexImage2D(GL_TEXTURE_2D,
-            0,
-            GL_RGB,
-            x,
-            y,
-            0,
-            GL_RGB,
-            GL_UNSIGNED_BYTE,
-            pPixels);
+    for (int i = 0; i < 6; ++i)
+        delete faces[i];
+    return textureId;
+}
+
+/// Load a cubemap from six raw files of the same layout.
+///@param pFilenames Fully qualified path names in GL face order: +X, -X, +Y, -Y, +Z, -Z
+///@param desc Layout of the image in each file; width and height must be equal
+///@param mipmaps Generate a full mip chain after upload
+///@return TextureID of created GL_TEXTURE_CUBE_MAP (0 for none)
+GLuint CreateCubemapFromRawFiles(const char* const pFilenames[6], const RawImageDesc& desc, bool mipmaps)
+{
+    return createCubemapFromRawFiles(pFilenames, &desc, mipmaps);
+}
+
+/// Load a cubemap from six raw files described by their ".info" sidecars.
+///@return TextureID of created GL_TEXTURE_CUBE_MAP (0 for none)
+GLuint CreateCubemapFromRawFiles(const char* const pFilenames[6], bool mipmaps)
+{
+    return createCubemapFromRawFiles(pFilenames, NULL, mipmaps);
+}
+
+/// Check a compressed format against the list the GL reports, queried once.
+/// Desktop GL 4.3 can sample ETC2 without listing it; those contexts take
+/// the CPU decoding path, which gives the same image.
+bool IsCompressedFormatSupported(GLenum internalFormat)
+{
+    static std::vector<GLint> formats;
+    static bool queried = false;
+    if (!queried)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+        if (count > 0)
+        {
+            formats.resize(count);
+            glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, &formats[0]);
+        }
+        queried = true;
     }
-    else
+    return std::find(formats.begin(), formats.end(), static_cast<GLint>(internalFormat)) != formats.end();
+}
+
+/// Upload one image of a KTX file to the bound texture, decoding it on the CPU
+/// if the GL does not support its compressed format.
+static bool uploadKtxImage(
+    const KtxFile& ktx,
+    GLenum imageTarget,
+    unsigned int level,
+    unsigned int layer,
+    unsigned int face,
+    bool decodeOnCpu)
+{
+    const unsigned int w = std::max(1u, ktx.GetWidth() >> level);
+    const unsigned int h = std::max(1u, ktx.GetHeight() >> level);
+    size_t bytes = 0;
+    const unsigned char* pData = ktx.GetImage(level, layer, face, bytes);
+    if (pData == NULL)
+        return false;
+
+    const bool isArray = ktx.IsArray();
+    const GLsizei layers = static_cast<GLsizei>(ktx.GetLayerCount());
+
+    if (ktx.IsCompressed() && (bytes < GetCompressedImageSize(ktx.GetInternalFormat(), w, h)))
+    {
+        LOG_ERROR("KTX image %u/%u/%u is %u bytes, too short for %ux%u.",
+            level, layer, face, static_cast<unsigned int>(bytes), w, h);
+        return false;
+    }
+
+    if (!ktx.IsCompressed() || decodeOnCpu)
+    {
+        std::vector<unsigned char> decoded;
+        GLenum internalFormat = ktx.GetInternalFormat();
+        GLenum format = ktx.GetFormat();
+        GLenum type = ktx.GetType();
+        GLint alignment = ktx.GetRowAlignment();
+        if (ktx.IsCompressed())
+        {
+            if (!DecodeEtcImage(internalFormat, pData, bytes, w, h, decoded, format, internalFormat))
+                return false;
+            pData = &decoded[0];
+            type = GL_UNSIGNED_BYTE;
+            alignment = 1;
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+        if (!isArray)
+        {
+            glTexImage2D(imageTarget, level, internalFormat, w, h, 0, format, type, pData);
+        }
+        else
+        {
+            if (layer == 0)
+                glTexImage3D(imageTarget, level, internalFormat, w, h, layers, 0, format, type, NULL);
+            glTexSubImage3D(imageTarget, level, 0, 0, layer, w, h, 1, format, type, pData);
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        return true;
+    }
+
+    if (!isArray)
+    {
+        glCompressedTexImage2D(imageTarget, level, ktx.GetInternalFormat(), w, h, 0, static_cast<GLsizei>(bytes), pData);
+        return true;
+    }
+    // Layers of one level are contiguous in the file; upload them together.
+    if (layer == 0)
+        glCompressedTexImage3D(imageTarget, level, ktx.GetInternalFormat(), w, h, layers, 0, static_cast<GLsizei>(bytes) * layers, pData);
+    return true;
+}
+
+///@return GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP or GL_TEXTURE_2D_ARRAY
+GLenum GetKtxTarget(const KtxFile& ktx)
+{
+    if (ktx.GetFaceCount() == 6)
+        return GL_TEXTURE_CUBE_MAP;
+    return ktx.IsArray() ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+}
+
+/// Check that a KTX file's images can be uploaded to this GL.
+///@param decodeOnCpu [out] true if its compressed format must be decoded first
+///@return false if the GL cannot take the file's format or layout
+bool CanUploadKtx(const KtxFile& ktx, bool& decodeOnCpu)
+{
+    decodeOnCpu = false;
+    if ((ktx.GetFaceCount() == 6) && ktx.IsArray())
+    {
+        LOG_ERROR("Cubemap arrays are not supported.");
+        return false;
+    }
+    if (ktx.IsCompressed() && !IsCompressedFormatSupported(ktx.GetInternalFormat()))
+    {
+        if (!IsEtcFormat(ktx.GetInternalFormat()))
+        {
+            LOG_ERROR("Compressed format 0x%x is not supported by this GL.", ktx.GetInternalFormat());
+            return false;
+        }
+        decodeOnCpu = true;
+    }
+    return true;
+}
+
+/// Upload all faces and layers of one mip level of a KTX file to the bound texture.
+///@return The number of bytes read from the file, or 0 on failure
+size_t UploadKtxLevel(const KtxFile& ktx, unsigned int level, bool decodeOnCpu)
+{
+    const GLenum target = GetKtxTarget(ktx);
+    const bool isCube = (target == GL_TEXTURE_CUBE_MAP);
+    GLStateMgr::Instance().BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    size_t total = 0;
+    for (unsigned int layer=0; layer<ktx.GetLayerCount(); ++layer)
+    {
+        for (unsigned int face=0; face<ktx.GetFaceCount(); ++face)
+        {
+            const GLenum imageTarget = isCube ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : target;
+            if (!uploadKtxImage(ktx, imageTarget, level, layer, face, decodeOnCpu))
+            {
+                LOG_ERROR("Could not upload image %u/%u/%u", level, layer, face);
+                return 0;
+            }
+            size_t bytes = 0;
+            ktx.GetImage(level, layer, face, bytes);
+            total += bytes;
+        }
+    }
+    return total;
+}
+
+/// Load a KTX (version 1) or KTX2 texture file. Compressed images are passed to
+/// the GL as they are when it supports the format. Otherwise ETC2 and EAC images
+/// are decoded on the CPU first; ASTC images cannot be and fail to load.
+///@param pFilename Fully qualified path name
+///@param pTarget [out] If not NULL, GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP or GL_TEXTURE_2D_ARRAY
+///@return TextureID of created texture (0 for none)
+GLuint CreateTextureFromKtxFile(const char* pFilename, GLenum* pTarget)
+{
+    if (pFilename == NULL)
+        return 0;
+
+    KtxFile ktx;
+    if (!ktx.Open(pFilename))
+        return 0;
+
+    bool decodeOnCpu = false;
+    if (!CanUploadKtx(ktx, decodeOnCpu))
+    {
+        LOG_ERROR("Cannot load %s", pFilename);
+        return 0;
+    }
+    if (decodeOnCpu)
+        LOG_INFO("Decoding %s on the CPU.", pFilename);
+
+    const GLenum target = GetKtxTarget(ktx);
+    GLuint textureId = 0;
+    glGenTextures(1, &textureId);
+    if (textureId == 0)
     {
         LOG_ERROR("Failed to create GL texture.");
+        return 0;
     }
 
-    delete [] pPixels;
-    fs.close();
-    if (textureId != 0)
+    GLStateMgr::Instance().BindTexture(target, textureId);
+    for (unsigned int level=0; level<ktx.GetLevelCount(); ++level)
     {
-        LOG_INFO("success.");
+        if (UploadKtxLevel(ktx, level, decodeOnCpu) == 0)
+        {
+            LOG_ERROR("Could not load %s", pFilename);
+            GLStateMgr::Instance().DeleteTexture(textureId);
+            return 0;
+        }
     }
+    SetKtxTextureParameters(ktx, decodeOnCpu);
+
+    if (pTarget != NULL)
+        *pTarget = target;
     return textureId;
 }
+
+/// Set filtering and the mip range of the bound texture to suit a KTX file,
+/// generating mipmaps if the file asks for them and its format allows.
+/// Call after level 0 has been uploaded.
+void SetKtxTextureParameters(const KtxFile& ktx, bool decodeOnCpu)
+{
+    const GLenum target = GetKtxTarget(ktx);
+    // Compressed formats cannot have their mipmaps generated.
+    const bool generateMips = ktx.NeedsMipmapGeneration() && (!ktx.IsCompressed() || decodeOnCpu);
+    const bool mipmapped = (ktx.GetLevelCount() > 1) || generateMips;
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (generateMips)
+        glGenerateMipmap(target);
+    else
+        glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, ktx.GetLevelCount() - 1);
+}
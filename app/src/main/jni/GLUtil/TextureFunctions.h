@@ -3,11 +3,68 @@
 #pragma once
 
 #include "GL_Includes.h"
+#include <vector>
 
-/// Load a square, power-of-two sized texture file from raw format
+///@brief Layout of an uncompressed image in a raw file.
+struct RawImageDesc
+{
+    RawImageDesc(unsigned int w = 0, unsigned int h = 0, unsigned int c = 1, unsigned int stride = 0, int off = 0);
+    unsigned int GetRowStride() const;
+
+    unsigned int width;
+    unsigned int height;
+    unsigned int channels;  ///< 1 to 4 bytes per pixel
+    unsigned int rowStride; ///< Bytes per row in the file; 0 for width*channels
+    int          offset;    ///< Bytes before the first row
+};
+
+/// Read a raw image's layout from its ".info" sidecar file
+bool ReadRawImageInfo(const char* pFilename, RawImageDesc& desc);
+
+/// Load a raw file of any size, uploading straight from a mapping of the file
+GLuint CreateTextureFromMappedRawFile(const char* pFilename, const RawImageDesc& desc, GLint filter = GL_LINEAR);
+GLuint CreateTextureFromMappedRawFile(const char* pFilename, GLint filter = GL_LINEAR);
+
+/// Replace part of a texture with part of a raw file
+bool UpdateTextureFromMappedRawFile(
+    GLuint texture,
+    const char* pFilename,
+    const RawImageDesc& desc,
+    unsigned int srcX,
+    unsigned int srcY,
+    unsigned int width,
+    unsigned int height,
+    int dstX,
+    int dstY);
+
+/// Load a square texture file from raw format
 GLuint CreateTextureFromRawFile(const char* pFilename, unsigned int dimension, int offset = 0);
 
+/// Map a raw image file for reading in place; touches no GL state
+class MappedFile;
+const unsigned char* MapRawImage(MappedFile& file, const char* pFilename, const RawImageDesc& desc);
+
+/// Create a square luminance texture from pixels already in memory
+GLuint CreateTextureFromLuminanceBuffer(const unsigned char* pPixels, unsigned int dimension);
+
 GLuint CreateColorTextureFromRawFile(
     const char* pFilename,
     unsigned int x,
     unsigned int y);
+
+/// Load six raw faces into a cubemap, reading them in parallel on worker threads
+GLuint CreateCubemapFromRawFiles(const char* const pFilenames[6], const RawImageDesc& desc, bool mipmaps = false);
+GLuint CreateCubemapFromRawFiles(const char* const pFilenames[6], bool mipmaps = false);
+
+/// Load a KTX or KTX2 file with all of its mip levels, cubemap faces and array layers
+GLuint CreateTextureFromKtxFile(const char* pFilename, GLenum* pTarget = NULL);
+
+/// Pieces of CreateTextureFromKtxFile, for loaders that upload levels over time
+class KtxFile;
+GLenum GetKtxTarget(const KtxFile& ktx);
+bool CanUploadKtx(const KtxFile& ktx, bool& decodeOnCpu);
+size_t UploadKtxLevel(const KtxFile& ktx, unsigned int level, bool decodeOnCpu);
+void SetKtxTextureParameters(const KtxFile& ktx, bool decodeOnCpu);
+
+/// Whether the GL can sample a compressed format directly
+bool IsCompressedFormatSupported(GLenum internalFormat);
@@ -0,0 +1,444 @@
+// TextureLoadMgr.cpp
+
+#include "TextureLoadMgr.h"
+#include "TextureFunctions.h"
+#include "KtxFile.h"
+#include "GLStateMgr.h"
+#include "MappedFile.h"
+#include "Logging.h"
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+///@brief Maps one raw image file and reads every page of it off the GL thread;
+/// TextureLoadMgr::Update copies it from the mapping into a staging buffer.
+class TextureLoadJob : public WorkerJob
+{
+public:
+    TextureLoadJob(const char* pFilename, unsigned int width, unsigned int height, unsigned int channels, int offset, GLuint texture)
+    : m_filename(pFilename)
+    , m_width(width)
+    , m_height(height)
+    , m_channels(channels)
+    , m_offset(offset)
+    , m_texture(texture)
+    , m_file()
+    , m_pPixels(NULL)
+    , m_cancelled(false)
+    , m_touched(0)
+    {}
+
+    virtual void Run()
+    {
+        m_pPixels = MapRawImage(m_file, m_filename.c_str(), RawImageDesc(m_width, m_height, m_channels, 0, m_offset));
+        if (m_pPixels == NULL)
+            return;
+
+        // Fault in each page of the mapping now rather than during the copy on the GL thread.
+        const size_t pageSize = 4096;
+        unsigned int sum = 0;
+        for (size_t i = 0; i < m_file.Size(); i += pageSize)
+            sum += m_file.Data()[i];
+        m_touched = sum;
+    }
+
+    size_t GetBytes() const { return static_cast<size_t>(m_width) * m_height * m_channels; }
+
+    std::string m_filename;
+    unsigned int m_width;
+    unsigned int m_height;
+    unsigned int m_channels;
+    int m_offset;
+    GLuint m_texture;
+    MappedFile m_file;
+    const unsigned char* m_pPixels; ///< NULL if the file could not be read
+    bool m_cancelled;  ///< Only touched on the GL thread
+    volatile unsigned int m_touched;
+
+private:
+    TextureLoadJob(const TextureLoadJob&);              ///< disallow copy constructor
+    TextureLoadJob& operator = (const TextureLoadJob&); ///< disallow assignment operator
+};
+
+/// 1MB is a 512x512 RGBA image; about a millisecond of copying on slow devices.
+static const size_t s_defaultUploadBudgetBytes = 1024 * 1024;
+
+/// Mip levels this size and smaller are uploaded as soon as a KTX texture is loaded.
+static const unsigned int s_immediateMipDimension = 32;
+
+static GLenum FormatForChannels(unsigned int channels)
+{
+    switch (channels)
+    {
+    case 1:  return GL_RED;
+    case 2:  return GL_RG;
+    case 3:  return GL_RGB;
+    default: return GL_RGBA;
+    }
+}
+
+static GLenum InternalFormatForChannels(unsigned int channels)
+{
+    switch (channels)
+    {
+    case 1:  return GL_R8;
+    case 2:  return GL_RG8;
+    case 3:  return GL_RGB8;
+    default: return GL_RGBA8;
+    }
+}
+
+TextureLoadMgr::TextureLoadMgr()
+: m_loader()
+, m_loading()
+, m_ready()
+, m_streaming()
+, m_nextSlot(0)
+, m_uploadBudgetBytes(s_defaultUploadBudgetBytes)
+, m_bytesUploadedLastFrame(0)
+{
+    for (int i=0; i<NumStagingSlots; ++i)
+    {
+        m_slots[i].pbo = 0;
+        m_slots[i].capacity = 0;
+        m_slots[i].fence = 0;
+    }
+}
+
+/// Release GL data before context is torn down. Loads in flight are abandoned;
+/// their textures keep the placeholder.
+void TextureLoadMgr::Destroy()
+{
+    m_loader.Stop();
+    while (WorkerJob* pJob = m_loader.PopFinished())
+    {
+        delete pJob;
+    }
+    while (!m_ready.empty())
+    {
+        delete m_ready.front();
+        m_ready.pop_front();
+    }
+    m_loading.clear();
+    for (std::vector<StreamingTexture>::iterator it = m_streaming.begin();
+         it != m_streaming.end();
+         ++it)
+    {
+        delete it->pKtx;
+    }
+    m_streaming.clear();
+
+    for (int i=0; i<NumStagingSlots; ++i)
+    {
+        StagingSlot& slot = m_slots[i];
+        if (slot.fence != 0)
+            glDeleteSync(slot.fence);
+        GLStateMgr::Instance().DeleteBuffer(slot.pbo);
+        slot.pbo = 0;
+        slot.capacity = 0;
+        slot.fence = 0;
+    }
+}
+
+///@brief Create a texture and start loading a raw image file into it.
+///@param pFilename Fully qualified path name
+///@param channels Bytes per pixel: 1 for luminance, 3 for RGB, 4 for RGBA
+///@param offset Number of bytes to skip at the start of the file
+///@param filter GL_LINEAR or GL_NEAREST, for both minification and magnification
+///@return A texture usable at once, showing a placeholder until the image is uploaded
+GLuint TextureLoadMgr::LoadRawTexture(const char* pFilename, unsigned int width, unsigned int height, unsigned int channels, int offset, GLint filter)
+{
+    if ((pFilename == NULL) || (width == 0) || (height == 0) || (channels == 0) || (channels > 4))
+        return 0;
+
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    if (texture == 0)
+    {
+        LOG_ERROR("Failed to create GL texture.");
+        return 0;
+    }
+
+    const unsigned char grey[4] = { 128, 128, 128, 255 };
+    GLStateMgr::Instance().BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    GLStateMgr::Instance().BindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, InternalFormatForChannels(channels), 1, 1, 0,
+        FormatForChannels(channels), GL_UNSIGNED_BYTE, grey);
+
+    TextureLoadJob* pJob = new TextureLoadJob(pFilename, width, height, channels, offset, texture);
+    m_loading[texture] = pJob;
+    if (!m_loader.IsRunning() && !m_loader.Start())
+    {
+        LOG_ERROR("TextureLoadMgr: could not start loader thread, loading synchronously.");
+    }
+    m_loader.Submit(pJob);
+    return texture;
+}
+
+///@brief Create a texture from a KTX file, uploading its mip levels from smallest
+/// to largest over this and the following frames.
+///@param pFilename Fully qualified path name
+///@param pTarget [out] If not NULL, GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP or GL_TEXTURE_2D_ARRAY
+///@return A texture usable at once at reduced resolution, or 0 on failure
+GLuint TextureLoadMgr::LoadKtxTexture(const char* pFilename, GLenum* pTarget)
+{
+    if (pFilename == NULL)
+        return 0;
+
+    KtxFile* pKtx = new KtxFile();
+    bool decodeOnCpu = false;
+    if (!pKtx->Open(pFilename) || !CanUploadKtx(*pKtx, decodeOnCpu))
+    {
+        LOG_ERROR("TextureLoadMgr: cannot load %s", pFilename);
+        delete pKtx;
+        return 0;
+    }
+
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    if (texture == 0)
+    {
+        LOG_ERROR("Failed to create GL texture.");
+        delete pKtx;
+        return 0;
+    }
+
+    const GLenum target = GetKtxTarget(*pKtx);
+    GLStateMgr::Instance().BindTexture(target, texture);
+    // Until the finest level arrives, the levels uploaded so far must be a complete mip range.
+    if (pKtx->GetLevelCount() > 1)
+        glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, pKtx->GetLevelCount() - 1);
+    if (pTarget != NULL)
+        *pTarget = target;
+
+    StreamingTexture stream;
+    stream.texture = texture;
+    stream.pKtx = pKtx;
+    stream.nextLevel = static_cast<int>(pKtx->GetLevelCount()) - 1;
+    stream.decodeOnCpu = decodeOnCpu;
+
+    // The smallest level is always needed for the texture to be complete.
+    do
+    {
+        if (!_StreamLevel(stream))
+        {
+            delete pKtx;
+            GLStateMgr::Instance().DeleteTexture(texture);
+            return 0;
+        }
+    } while ((stream.nextLevel >= 0) &&
+        (std::max(pKtx->GetWidth(), pKtx->GetHeight()) >> stream.nextLevel) <= s_immediateMipDimension);
+
+    if (stream.nextLevel < 0)
+        delete pKtx;
+    else
+        m_streaming.push_back(stream);
+    return texture;
+}
+
+///@brief Drop a pending load, for instance because its texture is being deleted.
+void TextureLoadMgr::CancelLoad(GLuint texture)
+{
+    for (std::vector<StreamingTexture>::iterator it = m_streaming.begin();
+         it != m_streaming.end();
+         ++it)
+    {
+        if (it->texture == texture)
+        {
+            delete it->pKtx;
+            m_streaming.erase(it);
+            return;
+        }
+    }
+
+    std::map<GLuint, TextureLoadJob*>::iterator it = m_loading.find(texture);
+    if (it == m_loading.end())
+        return;
+    it->second->m_cancelled = true;
+    m_loading.erase(it);
+}
+
+bool TextureLoadMgr::IsLoading(GLuint texture) const
+{
+    if (m_loading.find(texture) != m_loading.end())
+        return true;
+    for (std::vector<StreamingTexture>::const_iterator it = m_streaming.begin();
+         it != m_streaming.end();
+         ++it)
+    {
+        if (it->texture == texture)
+            return true;
+    }
+    return false;
+}
+
+///@brief Upload the stream's next mip level and make it the texture's base level.
+/// After the finest level, set the texture's filtering and generate its mipmaps if needed.
+///@return false if the level could not be uploaded
+bool TextureLoadMgr::_StreamLevel(StreamingTexture& stream)
+{
+    const GLenum target = GetKtxTarget(*stream.pKtx);
+    GLStateMgr::Instance().BindTexture(target, stream.texture);
+    const size_t bytes = UploadKtxLevel(*stream.pKtx, stream.nextLevel, stream.decodeOnCpu);
+    if (bytes == 0)
+        return false;
+    glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, stream.nextLevel);
+    // Mipmaps can only be generated once the finest level is there.
+    if (stream.nextLevel == 0)
+        SetKtxTextureParameters(*stream.pKtx, stream.decodeOnCpu);
+    --stream.nextLevel;
+    m_bytesUploadedLastFrame += bytes;
+    return true;
+}
+
+///@brief Upload the next mip levels of streaming KTX textures, oldest first, within the budget.
+void TextureLoadMgr::_UpdateStreaming()
+{
+    while (!m_streaming.empty())
+    {
+        StreamingTexture& stream = m_streaming.front();
+        const unsigned int level = static_cast<unsigned int>(stream.nextLevel);
+        size_t bytes = 0;
+        for (unsigned int layer=0; layer<stream.pKtx->GetLayerCount(); ++layer)
+        {
+            for (unsigned int face=0; face<stream.pKtx->GetFaceCount(); ++face)
+            {
+                size_t imageBytes = 0;
+                stream.pKtx->GetImage(level, layer, face, imageBytes);
+                bytes += imageBytes;
+            }
+        }
+        if ((m_bytesUploadedLastFrame > 0) &&
+            (m_bytesUploadedLastFrame + bytes > m_uploadBudgetBytes))
+            return;
+
+        const bool ok = _StreamLevel(stream);
+        if (!ok)
+            LOG_ERROR("TextureLoadMgr: mip level %u failed, keeping lower resolution.", level);
+        if (!ok || (stream.nextLevel < 0))
+        {
+            delete stream.pKtx;
+            m_streaming.erase(m_streaming.begin());
+        }
+    }
+}
+
+///@return true if the GPU is done reading from the slot, which may then be refilled
+bool TextureLoadMgr::_IsSlotFree(StagingSlot& slot)
+{
+    if (slot.fence == 0)
+        return true;
+    const GLenum status = glClientWaitSync(slot.fence, 0, 0);
+    if ((status != GL_ALREADY_SIGNALED) && (status != GL_CONDITION_SATISFIED))
+        return false;
+    glDeleteSync(slot.fence);
+    slot.fence = 0;
+    return true;
+}
+
+///@brief Copy the job's pixels into the slot's buffer and specify its texture from there.
+///@return false if the buffer could not be mapped
+bool TextureLoadMgr::_Upload(TextureLoadJob* pJob, StagingSlot& slot)
+{
+    GLStateMgr& state = GLStateMgr::Instance();
+    const size_t bytes = pJob->GetBytes();
+    if (slot.pbo == 0)
+        glGenBuffers(1, &slot.pbo);
+    state.BindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+    if (slot.capacity < bytes)
+    {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+        slot.capacity = bytes;
+    }
+
+    void* pDst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (pDst == NULL)
+        return false;
+    memcpy(pDst, pJob->m_pPixels, bytes);
+    if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_FALSE)
+        return false; // Contents were lost; the caller may retry
+
+    state.BindTexture(GL_TEXTURE_2D, pJob->m_texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D,
+        0,
+        InternalFormatForChannels(pJob->m_channels),
+        pJob->m_width,
+        pJob->m_height,
+        0,
+        FormatForChannels(pJob->m_channels),
+        GL_UNSIGNED_BYTE,
+        NULL); // Offset into the bound pixel unpack buffer
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    return true;
+}
+
+///@brief Upload images that have finished loading, up to the byte budget.
+/// Call once per frame on the GL thread.
+void TextureLoadMgr::Update()
+{
+    while (WorkerJob* pJob = m_loader.PopFinished())
+    {
+        TextureLoadJob* pLoad = static_cast<TextureLoadJob*>(pJob);
+        if (pLoad->m_cancelled)
+        {
+            delete pLoad;
+        }
+        else if (pLoad->m_pPixels == NULL)
+        {
+            LOG_ERROR("TextureLoadMgr: could not read %s, keeping placeholder.", pLoad->m_filename.c_str());
+            m_loading.erase(pLoad->m_texture);
+            delete pLoad;
+        }
+        else
+        {
+            m_ready.push_back(pLoad);
+        }
+    }
+
+    m_bytesUploadedLastFrame = 0;
+    bool bound = false;
+    while (!m_ready.empty())
+    {
+        TextureLoadJob* pJob = m_ready.front();
+        if (pJob->m_cancelled)
+        {
+            m_ready.pop_front();
+            delete pJob;
+            continue;
+        }
+
+        const size_t bytes = pJob->GetBytes();
+        if ((m_bytesUploadedLastFrame > 0) &&
+            (m_bytesUploadedLastFrame + bytes > m_uploadBudgetBytes))
+            break;
+
+        StagingSlot& slot = m_slots[m_nextSlot];
+        if (!_IsSlotFree(slot))
+            break; // The GPU is behind; try again next frame.
+
+        bound = true;
+        if (!_Upload(pJob, slot))
+            break;
+        m_nextSlot = (m_nextSlot + 1) % NumStagingSlots;
+        m_bytesUploadedLastFrame += bytes;
+
+        m_ready.pop_front();
+        m_loading.erase(pJob->m_texture);
+        delete pJob;
+    }
+
+    // Other uploads pass client memory pointers, which need no buffer bound.
+    if (bound)
+        GLStateMgr::Instance().BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    _UpdateStreaming();
+}
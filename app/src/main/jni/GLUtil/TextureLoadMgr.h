@@ -0,0 +1,90 @@
+// TextureLoadMgr.h
+
+#pragma once
+
+#include "Singleton.h"
+#include "GL_Includes.h"
+#include "WorkerPool.h"
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+class TextureLoadJob;
+class KtxFile;
+
+///@brief Loads raw image files into textures without stalling the GL thread.
+/// LoadRawTexture returns a texture name at once, holding a 1x1 grey placeholder.
+/// The file is read on a worker thread, and Update copies finished images into a
+/// ring of pixel unpack buffers and specifies the texture from there. The driver
+/// can then transfer the pixels asynchronously. Each frame uploads at most the
+/// byte budget, except that one image is always allowed so large ones progress.
+///
+/// LoadKtxTexture uploads the smallest mip levels of a KTX file at once and the
+/// rest coarse to fine over the following frames, within the same budget.
+/// The texture's base level follows the uploads, so it samples a blurry but
+/// complete image until the full resolution arrives. Its filtering is set, and
+/// any mipmaps the file leaves to be generated are made, after the finest level.
+///@warning Do not attempt to access this object outside of the GL thread!
+class TextureLoadMgr : public Singleton
+{
+public:
+    static TextureLoadMgr& Instance()
+    {
+        static TextureLoadMgr instance;
+        return instance;
+    }
+    void Destroy();
+
+    GLuint LoadRawTexture(const char* pFilename, unsigned int width, unsigned int height, unsigned int channels, int offset = 0, GLint filter = GL_LINEAR);
+    GLuint LoadKtxTexture(const char* pFilename, GLenum* pTarget = NULL);
+    void CancelLoad(GLuint texture);
+    void Update();
+
+    void SetUploadBudget(size_t bytesPerFrame) { m_uploadBudgetBytes = bytesPerFrame; }
+
+    /// const Accessors
+    bool IsLoading(GLuint texture) const;
+    int GetPendingCount() const { return static_cast<int>(m_loading.size() + m_streaming.size()); }
+    size_t GetBytesUploadedLastFrame() const { return m_bytesUploadedLastFrame; }
+
+protected:
+    ///@brief One pixel unpack buffer of the ring, reusable once the GPU has read it.
+    struct StagingSlot
+    {
+        GLuint  pbo;
+        size_t  capacity;
+        GLsync  fence;  ///< Set after the upload that last read from this slot
+    };
+
+    ///@brief A KTX texture whose finer mip levels are still to be uploaded.
+    struct StreamingTexture
+    {
+        GLuint    texture;
+        KtxFile*  pKtx;         ///< Mapped until the last level is uploaded
+        int       nextLevel;    ///< Counts down to 0
+        bool      decodeOnCpu;
+    };
+
+    bool _IsSlotFree(StagingSlot& slot);
+    bool _Upload(TextureLoadJob* pJob, StagingSlot& slot);
+    bool _StreamLevel(StreamingTexture& stream);
+    void _UpdateStreaming();
+
+    enum { NumStagingSlots = 3 };
+
+    WorkerPool                          m_loader;
+    std::map<GLuint, TextureLoadJob*>   m_loading;  ///< Submitted and not yet uploaded, by texture
+    std::deque<TextureLoadJob*>         m_ready;    ///< Read from file, waiting for upload
+    std::vector<StreamingTexture>       m_streaming;
+    StagingSlot                         m_slots[NumStagingSlots];
+    int                                 m_nextSlot;
+    size_t                              m_uploadBudgetBytes;
+    size_t                              m_bytesUploadedLastFrame;
+
+private:
+    TextureLoadMgr();
+    ~TextureLoadMgr() {} /// Destroy() should be called before the context is torn down.
+    TextureLoadMgr(TextureLoadMgr const& copy);            // Not Implemented
+    TextureLoadMgr& operator=(TextureLoadMgr const& copy); // Not Implemented
+};
@@ -0,0 +1,219 @@
+// TextureMgr.cpp
+
+#include "TextureMgr.h"
+#include "TextureLoadMgr.h"
+#include "TextureFunctions.h"
+#include "GLStateMgr.h"
+#include "Logging.h"
+
+#include <stdio.h>
+
+/// Unreferenced textures are kept until the total passes this.
+static const size_t s_defaultBudgetBytes = 64 * 1024 * 1024;
+
+TextureMgr::TextureMgr()
+: m_byKey()
+, m_entries()
+, m_budgetBytes(s_defaultBudgetBytes)
+, m_totalBytes(0)
+, m_releaseClock(0)
+{
+}
+
+/// Release GL data before context is torn down. External textures are left to their owners.
+void TextureMgr::Destroy()
+{
+    std::map<GLuint, Entry>::iterator it = m_entries.begin();
+    while (it != m_entries.end())
+    {
+        std::map<GLuint, Entry>::iterator next = it;
+        ++next;
+        if (!it->second.key.empty())
+            _Delete(it);
+        it = next;
+    }
+}
+
+///@brief Get a texture for a raw image file, loading it in the background if it is
+/// not already resident. It shows a placeholder until loaded.
+///@return The texture, to be passed to Release when no longer needed, or 0 on failure
+GLuint TextureMgr::Acquire(const char* pFilename, unsigned int width, unsigned int height, unsigned int channels, GLint filter)
+{
+    if (pFilename == NULL)
+        return 0;
+
+    char params[64];
+    sprintf(params, "|%ux%ux%u|%d", width, height, channels, filter);
+    const std::string key = std::string(pFilename) + params;
+
+    const GLuint existing = _Find(key);
+    if (existing != 0)
+        return existing;
+
+    const GLuint texture = TextureLoadMgr::Instance().LoadRawTexture(pFilename, width, height, channels, 0, filter);
+    if (texture == 0)
+        return 0;
+
+    _Add(texture, key, static_cast<size_t>(width) * height * channels);
+    return texture;
+}
+
+///@brief Get a cube map for six raw face files in the order posx, negx, posy, negy,
+/// posz, negz, loading them in parallel if not already resident.
+///@return The texture, to be passed to Release when no longer needed, or 0 on failure
+GLuint TextureMgr::AcquireCubemap(const char* const pFilenames[6], const RawImageDesc& desc, bool mipmaps)
+{
+    std::string key;
+    for (int i = 0; i < 6; ++i)
+    {
+        if (pFilenames[i] == NULL)
+            return 0;
+        key += pFilenames[i];
+        key += '|';
+    }
+    char params[64];
+    sprintf(params, "cube|%ux%ux%u|%d", desc.width, desc.height, desc.channels, mipmaps ? 1 : 0);
+    key += params;
+
+    const GLuint existing = _Find(key);
+    if (existing != 0)
+        return existing;
+
+    const GLuint texture = CreateCubemapFromRawFiles(pFilenames, desc, mipmaps);
+    if (texture == 0)
+        return 0;
+
+    size_t bytes = 6 * static_cast<size_t>(desc.width) * desc.height * desc.channels;
+    if (mipmaps)
+        bytes += bytes / 3;
+    _Add(texture, key, bytes);
+    return texture;
+}
+
+void TextureMgr::Release(GLuint texture)
+{
+    std::map<GLuint, Entry>::iterator it = m_entries.find(texture);
+    if ((it == m_entries.end()) || it->second.key.empty())
+        return;
+    Entry& entry = it->second;
+    if (entry.refCount <= 0)
+    {
+        LOG_ERROR("TextureMgr: texture %u released more times than acquired.", texture);
+        return;
+    }
+    if (--entry.refCount == 0)
+    {
+        entry.lastRelease = ++m_releaseClock;
+        _EvictToBudget();
+    }
+}
+
+///@brief Count a texture created outside of TextureMgr toward the total.
+void TextureMgr::TrackExternal(GLuint texture, size_t bytes)
+{
+    if ((texture == 0) || (m_entries.find(texture) != m_entries.end()))
+        return;
+    Entry entry;
+    entry.bytes = bytes;
+    entry.refCount = 1;
+    entry.lastRelease = 0;
+    m_entries[texture] = entry;
+    m_totalBytes += bytes;
+    _EvictToBudget();
+}
+
+///@brief Stop counting an external texture; call when its owner deletes it.
+void TextureMgr::UntrackExternal(GLuint texture)
+{
+    std::map<GLuint, Entry>::iterator it = m_entries.find(texture);
+    if ((it == m_entries.end()) || !it->second.key.empty())
+        return;
+    m_totalBytes -= it->second.bytes;
+    m_entries.erase(it);
+}
+
+void TextureMgr::SetBudget(size_t bytes)
+{
+    m_budgetBytes = bytes;
+    _EvictToBudget();
+}
+
+int TextureMgr::GetRefCount(GLuint texture) const
+{
+    const std::map<GLuint, Entry>::const_iterator it = m_entries.find(texture);
+    if (it == m_entries.end())
+        return 0;
+    return it->second.refCount;
+}
+
+///@return The texture already loaded for a key with its reference count raised, or 0
+GLuint TextureMgr::_Find(const std::string& key)
+{
+    const std::map<std::string, GLuint>::const_iterator found = m_byKey.find(key);
+    if (found == m_byKey.end())
+        return 0;
+    ++m_entries[found->second].refCount;
+    return found->second;
+}
+
+void TextureMgr::_Add(GLuint texture, const std::string& key, size_t bytes)
+{
+    Entry entry;
+    entry.key = key;
+    entry.bytes = bytes;
+    entry.refCount = 1;
+    entry.lastRelease = 0;
+    m_entries[texture] = entry;
+    m_byKey[key] = texture;
+    m_totalBytes += bytes;
+    _EvictToBudget();
+}
+
+///@brief Delete unreferenced textures, least recently released first, until within budget.
+void TextureMgr::_EvictToBudget()
+{
+    while (m_totalBytes > m_budgetBytes)
+    {
+        std::map<GLuint, Entry>::iterator oldest = m_entries.end();
+        for (std::map<GLuint, Entry>::iterator it = m_entries.begin();
+             it != m_entries.end();
+             ++it)
+        {
+            const Entry& entry = it->second;
+            if ((entry.refCount != 0) || entry.key.empty())
+                continue;
+            if ((oldest == m_entries.end()) || (entry.lastRelease < oldest->second.lastRelease))
+                oldest = it;
+        }
+        if (oldest == m_entries.end())
+            return; // Everything left is in use
+        _Delete(oldest);
+    }
+}
+
+void TextureMgr::_Delete(std::map<GLuint, Entry>::iterator it)
+{
+    const GLuint texture = it->first;
+    TextureLoadMgr::Instance().CancelLoad(texture);
+    GLStateMgr::Instance().DeleteTexture(texture);
+    m_totalBytes -= it->second.bytes;
+    m_byKey.erase(it->second.key);
+    m_entries.erase(it);
+}
+
+void TextureMgr::LogStats() const
+{
+    int inUse = 0;
+    for (std::map<GLuint, Entry>::const_iterator it = m_entries.begin();
+         it != m_entries.end();
+         ++it)
+    {
+        if (it->second.refCount > 0)
+            ++inUse;
+    }
+    LOG_INFO("Textures: %d tracked, %d in use, %d KB of %d KB budget",
+        static_cast<int>(m_entries.size()),
+        inUse,
+        static_cast<int>(m_totalBytes / 1024),
+        static_cast<int>(m_budgetBytes / 1024));
+}
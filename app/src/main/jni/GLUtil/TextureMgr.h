@@ -0,0 +1,70 @@
+// TextureMgr.h
+
+#pragma once
+
+#include "Singleton.h"
+#include "GL_Includes.h"
+#include <map>
+#include <string>
+
+struct RawImageDesc;
+
+///@brief Shares textures loaded from files and keeps count of texture memory.
+/// Acquiring the same file with the same parameters twice returns the same texture
+/// with its reference count raised; each Acquire is matched by a Release. Released
+/// textures stay cached, so loading them again is free, until the total texture
+/// memory exceeds the budget. Then the least recently released are deleted.
+/// Textures created elsewhere, such as font glyph pages, can be tracked to count
+/// toward the total; they are never evicted.
+///@warning Do not attempt to access this object outside of the GL thread!
+class TextureMgr : public Singleton
+{
+public:
+    static TextureMgr& Instance()
+    {
+        static TextureMgr instance;
+        return instance;
+    }
+    void Destroy();
+
+    GLuint Acquire(const char* pFilename, unsigned int width, unsigned int height, unsigned int channels, GLint filter = GL_LINEAR);
+    GLuint AcquireCubemap(const char* const pFilenames[6], const RawImageDesc& desc, bool mipmaps = false);
+    void Release(GLuint texture);
+    void TrackExternal(GLuint texture, size_t bytes);
+    void UntrackExternal(GLuint texture);
+
+    void SetBudget(size_t bytes);
+    void LogStats() const;
+
+    /// const Accessors
+    size_t GetBudget() const { return m_budgetBytes; }
+    size_t GetTotalBytes() const { return m_totalBytes; }
+    int GetTextureCount() const { return static_cast<int>(m_entries.size()); }
+    int GetRefCount(GLuint texture) const;
+
+protected:
+    struct Entry
+    {
+        std::string   key;        ///< Empty for external textures
+        size_t        bytes;
+        int           refCount;
+        unsigned int  lastRelease;
+    };
+
+    GLuint _Find(const std::string& key);
+    void _Add(GLuint texture, const std::string& key, size_t bytes);
+    void _EvictToBudget();
+    void _Delete(std::map<GLuint, Entry>::iterator it);
+
+    std::map<std::string, GLuint>  m_byKey;
+    std::map<GLuint, Entry>        m_entries;
+    size_t                         m_budgetBytes;
+    size_t                         m_totalBytes;
+    unsigned int                   m_releaseClock;
+
+private:
+    TextureMgr();
+    ~TextureMgr() {} /// Destroy() should be called before the context is torn down.
+    TextureMgr(TextureMgr const& copy);            // Not Implemented
+    TextureMgr& operator=(TextureMgr const& copy); // Not Implemented
+};
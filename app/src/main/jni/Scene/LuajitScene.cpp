@@ -3,6 +3,18 @@
 #include "LuajitScene.h"
 #include "DataDirectoryLocation.h"
 #include "Logging.h"
+#include "ProgramCacheMgr.h"
+#include "CameraUniformMgr.h"
+#include "TextureLoadMgr.h"
+#include "GLStateMgr.h"
+#include "TextureMgr.h"
+#include "TextureFunctions.h"
+#include "TextureAtlas.h"
+#include "MatrixStack.h"
+#include "FontRenderer.h"
+#include "TextLayout.h"
+#include "ShaderMgr.h"
+#include "Timer.h"
 #include <sstream>
 
 #ifdef USE_SIXENSE
@@ -62,11 +74,640 @@ static const struct luaL_Reg printlib [] = {
     {NULL, NULL} /* end of array */
 };
 
+// timer_seconds() returns seconds on the monotonic wall clock the host times its
+// own work with, for timing script and native code against each other.
+static int l_timer_seconds(lua_State* L) {
+    static const Timer s_timer;
+    lua_pushnumber(L, s_timer.seconds());
+    return 1;
+}
+
+static const struct luaL_Reg timerlib [] = {
+    {"timer_seconds", l_timer_seconds},
+    {NULL, NULL} /* end of array */
+};
+
+// program_cache_load(key) returns a linked program from the binary cache, or 0.
+static int l_program_cache_load(lua_State* L) {
+    size_t len = 0;
+    const char* pKey = luaL_checklstring(L, 1, &len);
+    const std::string key(pKey, len);
+    const GLuint prog = ProgramCacheMgr::Instance().LoadProgram(key);
+    lua_pushinteger(L, prog);
+    return 1;
+}
+
+// program_cache_store(key, program, compileSeconds) writes a linked program's binary to the cache.
+static int l_program_cache_store(lua_State* L) {
+    size_t len = 0;
+    const char* pKey = luaL_checklstring(L, 1, &len);
+    const std::string key(pKey, len);
+    const GLuint prog = static_cast<GLuint>(luaL_checkinteger(L, 2));
+    const double compileSeconds = luaL_optnumber(L, 3, 0.);
+    ProgramCacheMgr::Instance().StoreProgram(key, prog, compileSeconds);
+    return 0;
+}
+
+static const struct luaL_Reg programcachelib [] = {
+    {"program_cache_load", l_program_cache_load},
+    {"program_cache_store", l_program_cache_store},
+    {NULL, NULL} /* end of array */
+};
+
+// shader_preprocess(src, defines) returns src with its #includes resolved from
+// the shaders directory and any defines injected after its #version line, the
+// same way C++ shader variants are built.
+static int l_shader_preprocess(lua_State* L) {
+    size_t len = 0;
+    const char* pSrc = luaL_checklstring(L, 1, &len);
+    const char* pDefines = luaL_optstring(L, 2, "");
+    std::vector<std::string> defines;
+    parseShaderDefines(pDefines, defines);
+    std::string out = resolveShaderIncludes(std::string(pSrc, len));
+    if (!defines.empty())
+        out = preprocessShaderSource(out, defines);
+    lua_pushlstring(L, out.c_str(), out.length());
+    return 1;
+}
+
+// shader_variant(name, defines) returns the ShaderMgr program for a variant of a
+// shader in the shaders directory.
+static int l_shader_variant(lua_State* L) {
+    const char* pName = luaL_checkstring(L, 1);
+    const char* pDefines = luaL_optstring(L, 2, "");
+    const GLuint prog = ShaderMgr::Instance().GetShaderVariant(pName, pDefines);
+    lua_pushinteger(L, prog);
+    return 1;
+}
+
+static const struct luaL_Reg shadervariantlib [] = {
+    {"shader_preprocess", l_shader_preprocess},
+    {"shader_variant", l_shader_variant},
+    {NULL, NULL} /* end of array */
+};
+
+// camera_block_bind(prog) points prog's CameraBlock, if it declares one, at the
+// camera uniform buffer the host fills each frame. Returns true if it does.
+static int l_camera_block_bind(lua_State* L) {
+    const GLuint prog = static_cast<GLuint>(luaL_checkinteger(L, 1));
+    lua_pushboolean(L, CameraUniformMgr::BindProgram(prog));
+    return 1;
+}
+
+static const struct luaL_Reg cameralib [] = {
+    {"camera_block_bind", l_camera_block_bind},
+    {NULL, NULL} /* end of array */
+};
+
+// Objects created for Lua are full userdata whose metatable names their type and
+// frees them on __gc, so luaL_checkudata rejects anything else passed in their place.
+static void registerUserdataType(lua_State* L, const char* pType, lua_CFunction gc) {
+    luaL_newmetatable(L, pType);
+    lua_pushcfunction(L, gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+}
+
+// A text layout measures with a FontRenderer holding only the font's metrics.
+struct LuaTextLayout {
+    FontRenderer* pFont;
+    TextLayout* pLayout;
+};
+
+static const char* s_textLayoutType = "flickercladding.TextLayout";
+
+static TextLayout* checkTextLayout(lua_State* L) {
+    return static_cast<LuaTextLayout*>(luaL_checkudata(L, 1, s_textLayoutType))->pLayout;
+}
+
+// Lua counts paragraphs and lines from 1.
+static size_t checkParagraphIndex(lua_State* L, int idx) {
+    const lua_Integer i = luaL_checkinteger(L, idx);
+    luaL_argcheck(L, i >= 1, idx, "paragraph index must be 1 or more");
+    return static_cast<size_t>(i - 1);
+}
+
+// textlayout_new(fontName, wrapWidth) returns a layout that word-wraps paragraphs
+// to wrapWidth pixels of the named font in the fonts directory, 0 for no wrapping.
+// Only the font's metrics are read; draw the lines with any renderer of that font.
+static int l_textlayout_new(lua_State* L) {
+    const char* pFontName = luaL_checkstring(L, 1);
+    const int wrapWidth = static_cast<int>(luaL_optinteger(L, 2, 0));
+    LuaTextLayout* pUd = static_cast<LuaTextLayout*>(lua_newuserdata(L, sizeof(LuaTextLayout)));
+    pUd->pFont = NULL;
+    pUd->pLayout = NULL;
+    luaL_getmetatable(L, s_textLayoutType);
+    lua_setmetatable(L, -2);
+
+    const bool loadNow = false;
+    pUd->pFont = new FontRenderer(pFontName, 0, loadNow);
+    pUd->pFont->LoadMetrics();
+    pUd->pLayout = new TextLayout();
+    pUd->pLayout->SetFont(pUd->pFont);
+    pUd->pLayout->SetWrapWidth(wrapWidth);
+    return 1;
+}
+
+static int l_textlayout_gc(lua_State* L) {
+    LuaTextLayout* pUd = static_cast<LuaTextLayout*>(luaL_checkudata(L, 1, s_textLayoutType));
+    delete pUd->pLayout, pUd->pLayout = NULL;
+    delete pUd->pFont, pUd->pFont = NULL;
+    return 0;
+}
+
+static int l_textlayout_set_wrap_width(lua_State* L) {
+    checkTextLayout(L)->SetWrapWidth(static_cast<int>(luaL_checkinteger(L, 2)));
+    return 0;
+}
+
+// textlayout_set_text(layout, text) replaces all paragraphs, keeping the line
+// breaks of any whose text is unchanged.
+static int l_textlayout_set_text(lua_State* L) {
+    TextLayout* pLayout = checkTextLayout(L);
+    size_t len = 0;
+    const char* pText = luaL_checklstring(L, 2, &len);
+    pLayout->SetText(std::string(pText, len));
+    return 0;
+}
+
+static int l_textlayout_set_paragraph(lua_State* L) {
+    TextLayout* pLayout = checkTextLayout(L);
+    const size_t idx = checkParagraphIndex(L, 2);
+    size_t len = 0;
+    const char* pText = luaL_checklstring(L, 3, &len);
+    pLayout->SetParagraph(idx, std::string(pText, len));
+    return 0;
+}
+
+static int l_textlayout_insert_paragraph(lua_State* L) {
+    TextLayout* pLayout = checkTextLayout(L);
+    const size_t idx = checkParagraphIndex(L, 2);
+    size_t len = 0;
+    const char* pText = luaL_checklstring(L, 3, &len);
+    pLayout->InsertParagraph(idx, std::string(pText, len));
+    return 0;
+}
+
+static int l_textlayout_erase_paragraph(lua_State* L) {
+    TextLayout* pLayout = checkTextLayout(L);
+    pLayout->EraseParagraph(checkParagraphIndex(L, 2));
+    return 0;
+}
+
+// textlayout_update(layout) lays out edited paragraphs and returns the number of
+// wrapped lines and the number of paragraphs that were laid out again.
+static int l_textlayout_update(lua_State* L) {
+    TextLayout* pLayout = checkTextLayout(L);
+    pLayout->Update();
+    lua_pushinteger(L, pLayout->GetLineCount());
+    lua_pushinteger(L, pLayout->GetRelayoutCount());
+    return 2;
+}
+
+// textlayout_line(layout, n) returns the paragraph holding wrapped line n, the
+// line's first and last byte in it for string.sub, and its width in pixels;
+// nil past the last line.
+static int l_textlayout_line(lua_State* L) {
+    const TextLayout* pLayout = checkTextLayout(L);
+    const int lineIdx = static_cast<int>(luaL_checkinteger(L, 2)) - 1;
+    size_t paragraph = 0;
+    size_t lineInParagraph = 0;
+    if (!pLayout->FindLine(lineIdx, paragraph, lineInParagraph)) {
+        lua_pushnil(L);
+        return 1;
+    }
+    const TextLayout::Line& line = pLayout->GetParagraphLines(paragraph)[lineInParagraph];
+    lua_pushinteger(L, static_cast<lua_Integer>(paragraph + 1));
+    lua_pushinteger(L, static_cast<lua_Integer>(line.begin + 1));
+    lua_pushinteger(L, static_cast<lua_Integer>(line.begin + line.len));
+    lua_pushinteger(L, line.widthPx);
+    return 4;
+}
+
+// textlayout_paragraph_lines(layout, i) returns the first wrapped line of
+// paragraph i and its line count; nil if there is no such paragraph.
+static int l_textlayout_paragraph_lines(lua_State* L) {
+    const TextLayout* pLayout = checkTextLayout(L);
+    const size_t idx = checkParagraphIndex(L, 2);
+    const int firstLine = pLayout->GetParagraphFirstLine(idx);
+    if (firstLine < 0) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_pushinteger(L, firstLine + 1);
+    lua_pushinteger(L, static_cast<lua_Integer>(pLayout->GetParagraphLines(idx).size()));
+    return 2;
+}
+
+static const struct luaL_Reg textlayoutlib [] = {
+    {"textlayout_new", l_textlayout_new},
+    {"textlayout_set_wrap_width", l_textlayout_set_wrap_width},
+    {"textlayout_set_text", l_textlayout_set_text},
+    {"textlayout_set_paragraph", l_textlayout_set_paragraph},
+    {"textlayout_insert_paragraph", l_textlayout_insert_paragraph},
+    {"textlayout_erase_paragraph", l_textlayout_erase_paragraph},
+    {"textlayout_update", l_textlayout_update},
+    {"textlayout_line", l_textlayout_line},
+    {"textlayout_paragraph_lines", l_textlayout_paragraph_lines},
+    {NULL, NULL} /* end of array */
+};
+
+// Texture paths are taken as given, the scene's data directory already prepended,
+// the same as scripts pass them to io.open.
+// Lua's FFI GL calls change bindings behind GLStateMgr's back, so every native
+// that touches GL invalidates its shadow state first.
+
+// texture_load_raw(path, width, height, channels) returns a texture that shows a
+// placeholder until the raw file has been read and uploaded in the background.
+// Pass it to texture_delete when done.
+static int l_texture_load_raw(lua_State* L) {
+    GLStateMgr::Instance().Invalidate();
+    const char* pFilename = luaL_checkstring(L, 1);
+    const unsigned int width = static_cast<unsigned int>(luaL_checkinteger(L, 2));
+    const unsigned int height = static_cast<unsigned int>(luaL_checkinteger(L, 3));
+    const unsigned int channels = static_cast<unsigned int>(luaL_optinteger(L, 4, 3));
+    const GLuint tex = TextureLoadMgr::Instance().LoadRawTexture(pFilename, width, height, channels);
+    lua_pushinteger(L, tex);
+    return 1;
+}
+
+// texture_acquire(path, width, height, channels, filter) returns a texture shared
+// with any other caller that acquired the same file with the same parameters.
+// Pass it to texture_release when done instead of deleting it.
+static int l_texture_acquire(lua_State* L) {
+    GLStateMgr::Instance().Invalidate();
+    const char* pFilename = luaL_checkstring(L, 1);
+    const unsigned int width = static_cast<unsigned int>(luaL_checkinteger(L, 2));
+    const unsigned int height = static_cast<unsigned int>(luaL_checkinteger(L, 3));
+    const unsigned int channels = static_cast<unsigned int>(luaL_optinteger(L, 4, 3));
+    const GLint filter = static_cast<GLint>(luaL_optinteger(L, 5, GL_LINEAR));
+    const GLuint tex = TextureMgr::Instance().Acquire(pFilename, width, height, channels, filter);
+    lua_pushinteger(L, tex);
+    return 1;
+}
+
+// Read a table of six face paths in the order posx, negx, posy, negy, posz, negz.
+static void checkCubemapPaths(lua_State* L, int idx, std::string* pPaths, const char** pFilenames) {
+    luaL_checktype(L, idx, LUA_TTABLE);
+    for (int i = 0; i < 6; ++i) {
+        lua_rawgeti(L, idx, i + 1);
+        pPaths[i] = luaL_checkstring(L, -1);
+        lua_pop(L, 1);
+        pFilenames[i] = pPaths[i].c_str();
+    }
+}
+
+// texture_acquire_cubemap(paths, width, height, channels, mipmaps) is
+// texture_acquire for a cube map of six raw faces, read in parallel.
+static int l_texture_acquire_cubemap(lua_State* L) {
+    GLStateMgr::Instance().Invalidate();
+    std::string paths[6];
+    const char* pFilenames[6];
+    checkCubemapPaths(L, 1, paths, pFilenames);
+    const RawImageDesc desc(
+        static_cast<unsigned int>(luaL_checkinteger(L, 2)),
+        static_cast<unsigned int>(luaL_checkinteger(L, 3)),
+        static_cast<unsigned int>(luaL_optinteger(L, 4, 3)));
+    lua_pushinteger(L, TextureMgr::Instance().AcquireCubemap(pFilenames, desc, lua_toboolean(L, 5) != 0));
+    return 1;
+}
+
+static int l_texture_release(lua_State* L) {
+    GLStateMgr::Instance().Invalidate();
+    const GLuint tex = static_cast<GLuint>(luaL_checkinteger(L, 1));
+    TextureMgr::Instance().Release(tex);
+    return 0;
+}
+
+// texture_memory() returns the bytes of texture memory in use and the number of textures.
+static int l_texture_memory(lua_State* L) {
+    lua_pushinteger(L, static_cast<int>(TextureMgr::Instance().GetTotalBytes()));
+    lua_pushinteger(L, TextureMgr::Instance().GetTextureCount());
+    return 2;
+}
+
+// texture_load_ktx(path) returns a texture and its target loaded from a .ktx or
+// .ktx2 file, decoding ETC2 on the CPU if the GPU cannot sample it, or 0 on failure.
+// Pass it to texture_delete when done.
+static int l_texture_load_ktx(lua_State* L) {
+    GLStateMgr::Instance().Invalidate();
+    const char* pFilename = luaL_checkstring(L, 1);
+    GLenum target = GL_TEXTURE_2D;
+    const GLuint tex = CreateTextureFromKtxFile(pFilename, &target);
+    lua_pushinteger(L, tex);
+    lua_pushinteger(L, target);
+    return 2;
+}
+
+// texture_create_raw(path, width, height, channels, stride) returns a texture
+// uploaded straight from a mapping of the raw file, blocking until done. With
+// only a path, the layout is read from the file's .info sidecar. Pass it to
+// texture_delete when done.
+static int l_texture_create_raw(lua_State* L) {
+    GLStateMgr::Instance().Invalidate();
+    const char* pFilename = luaL_checkstring(L, 1);
+    if (lua_isnoneornil(L, 2)) {
+        lua_pushinteger(L, CreateTextureFromMappedRawFile(pFilename));
+        return 1;
+    }
+    const RawImageDesc desc(
+        static_cast<unsigned int>(luaL_checkinteger(L, 2)),
+        static_cast<unsigned int>(luaL_checkinteger(L, 3)),
+        static_cast<unsigned int>(luaL_optinteger(L, 4, 3)),
+        static_cast<unsigned int>(luaL_optinteger(L, 5, 0)));
+    lua_pushinteger(L, CreateTextureFromMappedRawFile(pFilename, desc));
+    return 1;
+}
+
+// texture_stream_ktx(path) is texture_load_ktx, but only the smallest mip levels
+// are uploaded at once; the rest arrive over the following frames.
+static int l_texture_stream_ktx(lua_State* L) {
+    GLStateMgr::Instance().Invalidate();
+    const char* pFilename = luaL_checkstring(L, 1);
+    GLenum target = GL_TEXTURE_2D;
+    const GLuint tex = TextureLoadMgr::Instance().LoadKtxTexture(pFilename, &target);
+    lua_pushinteger(L, tex);
+    lua_pushinteger(L, target);
+    return 2;
+}
+
+// texture_load_cubemap(paths, width, height, channels, mipmaps) returns a cube
+// map texture loaded from a table of six raw files in the order posx, negx, posy,
+// negy, posz, negz. The faces are read in parallel. With no width, each face's
+// layout is read from its .info sidecar. Pass it to texture_delete when done.
+static int l_texture_load_cubemap(lua_State* L) {
+    GLStateMgr::Instance().Invalidate();
+    std::string paths[6];
+    const char* pFilenames[6];
+    checkCubemapPaths(L, 1, paths, pFilenames);
+    if (lua_isnoneornil(L, 2)) {
+        lua_pushinteger(L, CreateCubemapFromRawFiles(pFilenames, lua_toboolean(L, 5) != 0));
+        return 1;
+    }
+    const RawImageDesc desc(
+        static_cast<unsigned int>(luaL_checkinteger(L, 2)),
+        static_cast<unsigned int>(luaL_checkinteger(L, 3)),
+        static_cast<unsigned int>(luaL_optinteger(L, 4, 3)));
+    lua_pushinteger(L, CreateCubemapFromRawFiles(pFilenames, desc, lua_toboolean(L, 5) != 0));
+    return 1;
+}
+
+// texture_delete(tex) stops any load or mip streaming still in progress into a
+// texture from the loaders above and deletes it. Deleting them with
+// glDeleteTextures instead leaves the loader writing into a freed name.
+static int l_texture_delete(lua_State* L) {
+    GLStateMgr::Instance().Invalidate();
+    const GLuint tex = static_cast<GLuint>(luaL_checkinteger(L, 1));
+    TextureLoadMgr::Instance().CancelLoad(tex);
+    GLStateMgr::Instance().DeleteTexture(tex);
+    return 0;
+}
+
+static const struct luaL_Reg texturelib [] = {
+    {"texture_load_raw", l_texture_load_raw},
+    {"texture_acquire", l_texture_acquire},
+    {"texture_acquire_cubemap", l_texture_acquire_cubemap},
+    {"texture_release", l_texture_release},
+    {"texture_memory", l_texture_memory},
+    {"texture_load_ktx", l_texture_load_ktx},
+    {"texture_stream_ktx", l_texture_stream_ktx},
+    {"texture_create_raw", l_texture_create_raw},
+    {"texture_load_cubemap", l_texture_load_cubemap},
+    {"texture_delete", l_texture_delete},
+    {NULL, NULL} /* end of array */
+};
+
+static const char* s_atlasType = "flickercladding.TextureAtlas";
+
+static TextureAtlas* checkAtlas(lua_State* L) {
+    TextureAtlas* pAtlas = *static_cast<TextureAtlas**>(luaL_checkudata(L, 1, s_atlasType));
+    luaL_argcheck(L, pAtlas != NULL, 1, "atlas has been destroyed");
+    return pAtlas;
+}
+
+// atlas_create(pageDimension, channels, layers, padding) returns a new texture atlas.
+// With layers > 0 its pages are that many layers of one GL_TEXTURE_2D_ARRAY;
+// otherwise each page is its own GL_TEXTURE_2D. Its textures are freed when it is
+// collected, or at once by atlas_destroy.
+static int l_atlas_create(lua_State* L) {
+    const unsigned int dimension = static_cast<unsigned int>(luaL_checkinteger(L, 1));
+    const unsigned int channels = static_cast<unsigned int>(luaL_optinteger(L, 2, 4));
+    const unsigned int layers = static_cast<unsigned int>(luaL_optinteger(L, 3, 0));
+    const unsigned int padding = static_cast<unsigned int>(luaL_optinteger(L, 4, 1));
+    TextureAtlas** ppAtlas = static_cast<TextureAtlas**>(lua_newuserdata(L, sizeof(TextureAtlas*)));
+    *ppAtlas = NULL;
+    luaL_getmetatable(L, s_atlasType);
+    lua_setmetatable(L, -2);
+    *ppAtlas = new TextureAtlas(dimension, channels, layers, padding);
+    return 1;
+}
+
+// Also the atlas's __gc; a destroyed atlas is left holding NULL.
+static int l_atlas_destroy(lua_State* L) {
+    TextureAtlas** ppAtlas = static_cast<TextureAtlas**>(luaL_checkudata(L, 1, s_atlasType));
+    if (*ppAtlas == NULL)
+        return 0;
+    GLStateMgr::Instance().Invalidate();
+    (*ppAtlas)->Destroy();
+    delete *ppAtlas, *ppAtlas = NULL;
+    return 0;
+}
+
+// atlas_add_raw(atlas, path, width, height) packs a raw image into the atlas and
+// returns its page and texture coordinates page, u0, v0, u1, v1; nil if it did not fit.
+static int l_atlas_add_raw(lua_State* L) {
+    TextureAtlas* pAtlas = checkAtlas(L);
+    const char* pFilename = luaL_checkstring(L, 2);
+    const unsigned int width = static_cast<unsigned int>(luaL_checkinteger(L, 3));
+    const unsigned int height = static_cast<unsigned int>(luaL_checkinteger(L, 4));
+    GLStateMgr::Instance().Invalidate();
+    AtlasRegion region;
+    if (!pAtlas->AddRawFile(pFilename, width, height, region)) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_pushinteger(L, region.page);
+    lua_pushnumber(L, region.u0);
+    lua_pushnumber(L, region.v0);
+    lua_pushnumber(L, region.u1);
+    lua_pushnumber(L, region.v1);
+    return 5;
+}
+
+// atlas_texture(atlas, page) returns the texture holding a page and its target.
+static int l_atlas_texture(lua_State* L) {
+    const TextureAtlas* pAtlas = checkAtlas(L);
+    const unsigned int page = static_cast<unsigned int>(luaL_optinteger(L, 2, 0));
+    lua_pushinteger(L, pAtlas->GetTexture(page));
+    lua_pushinteger(L, pAtlas->GetTarget());
+    return 2;
+}
+
+// atlas_stats(atlas) returns the fraction of page area used, the page count and the image count.
+static int l_atlas_stats(lua_State* L) {
+    const TextureAtlas* pAtlas = checkAtlas(L);
+    pAtlas->LogStats();
+    lua_pushnumber(L, pAtlas->GetEfficiency());
+    lua_pushinteger(L, pAtlas->GetPageCount());
+    lua_pushinteger(L, pAtlas->GetImageCount());
+    return 3;
+}
+
+static const struct luaL_Reg atlaslib [] = {
+    {"atlas_create", l_atlas_create},
+    {"atlas_destroy", l_atlas_destroy},
+    {"atlas_add_raw", l_atlas_add_raw},
+    {"atlas_texture", l_atlas_texture},
+    {"atlas_stats", l_atlas_stats},
+    {NULL, NULL} /* end of array */
+};
+
+// Matrix stacks are driven through these calls; the matrices themselves come back
+// as pointers to 16 (or 9) floats for ffi.cast("float*", p), valid until the stack
+// is next changed.
+static const char* s_matrixStackType = "flickercladding.MatrixStack";
+
+static MatrixStack* checkMatrixStack(lua_State* L) {
+    MatrixStack* pStack = *static_cast<MatrixStack**>(luaL_checkudata(L, 1, s_matrixStackType));
+    luaL_argcheck(L, pStack != NULL, 1, "matrix stack has been deleted");
+    return pStack;
+}
+
+// Read a matrix given as a table of 16 numbers in column order, 1-indexed.
+static void checkMatrixTable(lua_State* L, int idx, float* pMtx) {
+    luaL_checktype(L, idx, LUA_TTABLE);
+    for (int i = 0; i < 16; ++i) {
+        lua_rawgeti(L, idx, i + 1);
+        pMtx[i] = static_cast<float>(lua_tonumber(L, -1));
+        lua_pop(L, 1);
+    }
+}
+
+// mstack_new() returns a stack holding one identity matrix. It is freed when
+// collected, or at once by mstack_delete.
+static int l_mstack_new(lua_State* L) {
+    MatrixStack** ppStack = static_cast<MatrixStack**>(lua_newuserdata(L, sizeof(MatrixStack*)));
+    *ppStack = NULL;
+    luaL_getmetatable(L, s_matrixStackType);
+    lua_setmetatable(L, -2);
+    *ppStack = new MatrixStack();
+    return 1;
+}
+
+// Also the stack's __gc; a deleted stack is left holding NULL.
+static int l_mstack_delete(lua_State* L) {
+    MatrixStack** ppStack = static_cast<MatrixStack**>(luaL_checkudata(L, 1, s_matrixStackType));
+    delete *ppStack, *ppStack = NULL;
+    return 0;
+}
+
+static int l_mstack_push(lua_State* L) {
+    checkMatrixStack(L)->Push();
+    return 0;
+}
+
+static int l_mstack_pop(lua_State* L) {
+    lua_pushboolean(L, checkMatrixStack(L)->Pop());
+    return 1;
+}
+
+static int l_mstack_identity(lua_State* L) {
+    checkMatrixStack(L)->LoadIdentity();
+    return 0;
+}
+
+static int l_mstack_load(lua_State* L) {
+    MatrixStack* pStack = checkMatrixStack(L);
+    float mtx[16];
+    checkMatrixTable(L, 2, mtx);
+    pStack->Load(mtx);
+    return 0;
+}
+
+static int l_mstack_multiply(lua_State* L) {
+    MatrixStack* pStack = checkMatrixStack(L);
+    float mtx[16];
+    checkMatrixTable(L, 2, mtx);
+    pStack->Multiply(mtx);
+    return 0;
+}
+
+static int l_mstack_translate(lua_State* L) {
+    checkMatrixStack(L)->Translate(
+        static_cast<float>(luaL_checknumber(L, 2)),
+        static_cast<float>(luaL_checknumber(L, 3)),
+        static_cast<float>(luaL_checknumber(L, 4)));
+    return 0;
+}
+
+// mstack_rotate(stack, degrees, x, y, z)
+static int l_mstack_rotate(lua_State* L) {
+    checkMatrixStack(L)->Rotate(
+        static_cast<float>(luaL_checknumber(L, 2)),
+        static_cast<float>(luaL_checknumber(L, 3)),
+        static_cast<float>(luaL_checknumber(L, 4)),
+        static_cast<float>(luaL_checknumber(L, 5)));
+    return 0;
+}
+
+static int l_mstack_scale(lua_State* L) {
+    checkMatrixStack(L)->Scale(
+        static_cast<float>(luaL_checknumber(L, 2)),
+        static_cast<float>(luaL_checknumber(L, 3)),
+        static_cast<float>(luaL_checknumber(L, 4)));
+    return 0;
+}
+
+static int l_mstack_get(lua_State* L) {
+    lua_pushlightuserdata(L, const_cast<float*>(checkMatrixStack(L)->Get()));
+    return 1;
+}
+
+static int l_mstack_inverse(lua_State* L) {
+    lua_pushlightuserdata(L, const_cast<float*>(checkMatrixStack(L)->GetInverse()));
+    return 1;
+}
+
+// mstack_normal(stack) returns a pointer to a column-major 3x3 matrix.
+static int l_mstack_normal(lua_State* L) {
+    lua_pushlightuserdata(L, const_cast<float*>(checkMatrixStack(L)->GetNormalMatrix()));
+    return 1;
+}
+
+static const struct luaL_Reg matrixstacklib [] = {
+    {"mstack_new", l_mstack_new},
+    {"mstack_delete", l_mstack_delete},
+    {"mstack_push", l_mstack_push},
+    {"mstack_pop", l_mstack_pop},
+    {"mstack_identity", l_mstack_identity},
+    {"mstack_load", l_mstack_load},
+    {"mstack_multiply", l_mstack_multiply},
+    {"mstack_translate", l_mstack_translate},
+    {"mstack_rotate", l_mstack_rotate},
+    {"mstack_scale", l_mstack_scale},
+    {"mstack_get", l_mstack_get},
+    {"mstack_inverse", l_mstack_inverse},
+    {"mstack_normal", l_mstack_normal},
+    {NULL, NULL} /* end of array */
+};
+
 extern void luaopen_luamylib(lua_State *L)
 {
     lua_getglobal(L, "_G");
     luaL_register(L, NULL, printlib);
+    luaL_register(L, NULL, timerlib);
+    luaL_register(L, NULL, programcachelib);
+    luaL_register(L, NULL, shadervariantlib);
+    luaL_register(L, NULL, cameralib);
+    luaL_register(L, NULL, textlayoutlib);
+    luaL_register(L, NULL, texturelib);
+    luaL_register(L, NULL, atlaslib);
+    luaL_register(L, NULL, matrixstacklib);
     lua_pop(L, 1);
+
+    registerUserdataType(L, s_textLayoutType, l_textlayout_gc);
+    registerUserdataType(L, s_atlasType, l_atlas_destroy);
+    registerUserdataType(L, s_matrixStackType, l_mstack_delete);
 }
 
 void LuajitScene::initGL()
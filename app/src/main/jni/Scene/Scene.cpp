@@ -25,12 +25,18 @@
 
 //#include <GL/glew.h>
 #include "GL_Includes.h"
+#include "GLStateMgr.h"
+#include "ShaderMgr.h"
 
 #include "Logging.h"
 
 Scene::Scene()
 : m_basic()
 , m_plane()
+, m_basicMvmtx(-1)
+, m_planeMvmtx(-1)
+, m_basicReady(false)
+, m_planeReady(false)
 , m_phaseVal(0.0f)
 , m_amplitude(0.01f)
 {
@@ -40,23 +46,50 @@ Scene::~Scene()
 {
 }
 
+///@brief Start building both programs together so the driver can compile them in
+/// parallel. Their VAOs are set up by _PollPrograms once each is ready.
 void Scene::initGL()
 {
-    m_basic.initProgram("basic");
-    m_basic.bindVAO();
-    _InitCubeAttributes();
-    glBindVertexArray(0);
-
-    m_plane.initProgram("basicplane");
-    m_plane.bindVAO();
-    _InitPlaneAttributes();
-    glBindVertexArray(0);
+    // Projection comes from the camera uniform block, filled once per frame.
+    m_basic.requestProgram("basic", "CAMERA_BLOCK");
+    m_basicMvmtx = m_basic.GetUniformHandle("mvmtx");
+    m_plane.requestProgram("basicplane", "CAMERA_BLOCK");
+    m_planeMvmtx = m_plane.GetUniformHandle("mvmtx");
+    ShaderMgr::Instance().AddReloadListener(&m_basic);
+    ShaderMgr::Instance().AddReloadListener(&m_plane);
+    m_basicReady = false;
+    m_planeReady = false;
+    _PollPrograms();
 }
 
 void Scene::exitGL()
 {
+    ShaderMgr::Instance().RemoveReloadListener(&m_basic);
+    ShaderMgr::Instance().RemoveReloadListener(&m_plane);
     m_basic.destroy();
     m_plane.destroy();
+    m_basicReady = false;
+    m_planeReady = false;
+}
+
+///@brief Set up the VAO of each program that has finished building since the last call.
+void Scene::_PollPrograms()
+{
+    if (!m_basicReady && m_basic.pollProgram())
+    {
+        m_basic.bindVAO();
+        _InitCubeAttributes();
+        GLStateMgr::Instance().BindVertexArray(0);
+        m_basicReady = true;
+    }
+
+    if (!m_planeReady && m_plane.pollProgram())
+    {
+        m_plane.bindVAO();
+        _InitPlaneAttributes();
+        GLStateMgr::Instance().BindVertexArray(0);
+        m_planeReady = true;
+    }
 }
 
 ///@brief While the basic VAO is bound, gen and bind all buffers and attribs.
@@ -78,14 +111,14 @@ void Scene::_InitCubeAttributes()
     GLuint vertVbo = 0;
     glGenBuffers(1, &vertVbo);
     m_basic.AddVbo("vPosition", vertVbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vertVbo);
+    GLStateMgr::Instance().BindBuffer(GL_ARRAY_BUFFER, vertVbo);
     glBufferData(GL_ARRAY_BUFFER, 8*3*sizeof(GLfloat), verts, GL_STATIC_DRAW);
     glVertexAttribPointer(m_basic.GetAttrLoc("vPosition"), 3, GL_FLOAT, GL_FALSE, 0, NULL);
 
     GLuint colVbo = 0;
     glGenBuffers(1, &colVbo);
     m_basic.AddVbo("vColor", colVbo);
-    glBindBuffer(GL_ARRAY_BUFFER, colVbo);
+    GLStateMgr::Instance().BindBuffer(GL_ARRAY_BUFFER, colVbo);
     glBufferData(GL_ARRAY_BUFFER, 8*3*sizeof(GLfloat), verts, GL_STATIC_DRAW);
     glVertexAttribPointer(m_basic.GetAttrLoc("vColor"), 3, GL_FLOAT, GL_FALSE, 0, NULL);
 
@@ -103,7 +136,7 @@ void Scene::_InitCubeAttributes()
     GLuint quadVbo = 0;
     glGenBuffers(1, &quadVbo);
     m_basic.AddVbo("elements", quadVbo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadVbo);
+    GLStateMgr::Instance().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadVbo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, 12*3*sizeof(GLuint), quads, GL_STATIC_DRAW);
 }
 
@@ -121,7 +154,7 @@ void Scene::_InitPlaneAttributes()
     GLuint vertVbo = 0;
     glGenBuffers(1, &vertVbo);
     m_plane.AddVbo("vPosition", vertVbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vertVbo);
+    GLStateMgr::Instance().BindBuffer(GL_ARRAY_BUFFER, vertVbo);
     glBufferData(GL_ARRAY_BUFFER, 4*3*sizeof(GLfloat), verts, GL_STATIC_DRAW);
     glVertexAttribPointer(m_plane.GetAttrLoc("vPosition"), 3, GL_FLOAT, GL_FALSE, 0, NULL);
 
@@ -134,7 +167,7 @@ void Scene::_InitPlaneAttributes()
     GLuint colVbo = 0;
     glGenBuffers(1, &colVbo);
     m_plane.AddVbo("vTexCoord", colVbo);
-    glBindBuffer(GL_ARRAY_BUFFER, colVbo);
+    GLStateMgr::Instance().BindBuffer(GL_ARRAY_BUFFER, colVbo);
     glBufferData(GL_ARRAY_BUFFER, 4*2*sizeof(GLfloat), texs, GL_STATIC_DRAW);
     glVertexAttribPointer(m_plane.GetAttrLoc("vTexCoord"), 2, GL_FLOAT, GL_FALSE, 0, NULL);
 
@@ -147,7 +180,7 @@ void Scene::_InitPlaneAttributes()
     GLuint triVbo = 0;
     glGenBuffers(1, &triVbo);
     m_plane.AddVbo("elements", triVbo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, triVbo);
+    GLStateMgr::Instance().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, triVbo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, 2*3*sizeof(GLuint), tris, GL_STATIC_DRAW);
 }
 
@@ -159,7 +192,6 @@ void Scene::DrawColorCube() const
                    6*3*2, // 6 triangle pairs
                    GL_UNSIGNED_INT,
                    0);
-    glBindVertexArray(0);
 }
 
 /// Draw a circle of color cubes(why not)
@@ -184,7 +216,7 @@ void Scene::_DrawBouncingCubes(
             glm::vec3(0.0f, oscVal, radius));
         sinmtx = glm::scale(sinmtx, glm::vec3(scale));
 
-        glUniformMatrix4fv(m_basic.GetUniLoc("mvmtx"), 1, false, glm::value_ptr(sinmtx));
+        m_basic.SetUniformMatrix4fv(m_basicMvmtx, glm::value_ptr(sinmtx));
         DrawColorCube();
     }
 }
@@ -205,7 +237,7 @@ void Scene::_DrawScenePlanes(const glm::mat4& modelview) const
             modelview,
             glm::vec3(0.0f, ceilHeight, 0.0f));
 
-        glUniformMatrix4fv(m_basic.GetUniLoc("mvmtx"), 1, false, glm::value_ptr(ceilmtx));
+        m_plane.SetUniformMatrix4fv(m_planeMvmtx, glm::value_ptr(ceilmtx));
 
         // ceiling
         glDrawElements(GL_TRIANGLES,
@@ -213,33 +245,36 @@ void Scene::_DrawScenePlanes(const glm::mat4& modelview) const
                        GL_UNSIGNED_INT,
                        0);
     }
-    glBindVertexArray(0);
 }
 
 
 /// Draw the scene(matrices have already been set up).
+/// The projection is read from CameraUniformMgr's block, which the caller fills each frame.
+/// Parts whose programs are still building are skipped, leaving the rest as a placeholder.
 void Scene::DrawScene(
     const glm::mat4& modelview,
     const glm::mat4& projection,
     const glm::mat4& object) const
 {
-    glUseProgram(m_plane.prog());
+    // Bindings are left in place between draws; GLStateMgr skips the repeats.
+    GLStateMgr& state = GLStateMgr::Instance();
+    if (m_planeReady)
     {
-        glUniformMatrix4fv(m_plane.GetUniLoc("mvmtx"), 1, false, glm::value_ptr(modelview));
-        glUniformMatrix4fv(m_plane.GetUniLoc("prmtx"), 1, false, glm::value_ptr(projection));
+        state.UseProgram(m_plane.prog());
+        m_plane.SetUniformMatrix4fv(m_planeMvmtx, glm::value_ptr(modelview));
 
         _DrawScenePlanes(modelview);
     }
-    glUseProgram(0);
 
-    glUseProgram(m_basic.prog());
+    if (m_basicReady)
     {
-        glUniformMatrix4fv(m_basic.GetUniLoc("mvmtx"), 1, false, glm::value_ptr(modelview));
-        glUniformMatrix4fv(m_basic.GetUniLoc("prmtx"), 1, false, glm::value_ptr(projection));
+        state.UseProgram(m_basic.prog());
+        m_basic.SetUniformMatrix4fv(m_basicMvmtx, glm::value_ptr(modelview));
 
         _DrawBouncingCubes(modelview, glm::vec3(0.0f, 1.0f, 0.5f), 0.25f, 0.064f);
         _DrawBouncingCubes(modelview, glm::vec3(0.0f, 0.0f, 0.5f), 1.5f, 0.5f);
 
+        (void)projection;
         (void)object;
 #if 0
         glm::mat4 objectMatrix = modelview;
@@ -248,11 +283,12 @@ void Scene::DrawScene(
         objectMatrix = glm::translate(objectMatrix, glm::vec3(0.5f));
         objectMatrix *= object;
         objectMatrix = glm::translate(objectMatrix, glm::vec3(-0.5f));
-        glUniformMatrix4fv(m_basic.GetUniLoc("mvmtx"), 1, false, glm::value_ptr(objectMatrix));
+        m_basic.SetUniformMatrix4fv(m_basicMvmtx, glm::value_ptr(objectMatrix));
         DrawColorCube();
 #endif
     }
-    glUseProgram(0);
+    state.BindVertexArray(0);
+    state.UseProgram(0);
 }
 
 
@@ -270,6 +306,7 @@ void Scene::RenderForOneEye(const float* pMview, const float* pPersp) const
 
 void Scene::timestep(double /*absTime*/, double dt)
 {
+    _PollPrograms();
     m_phaseVal += static_cast<float>(dt);
 }
 
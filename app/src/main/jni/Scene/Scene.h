@@ -50,6 +50,7 @@ protected:
 protected:
     void _InitCubeAttributes();
     void _InitPlaneAttributes();
+    void _PollPrograms();
 
     void _DrawBouncingCubes(
         const glm::mat4& modelview,
@@ -60,6 +61,10 @@ protected:
 
     ShaderWithVariables m_basic;
     ShaderWithVariables m_plane;
+    int m_basicMvmtx; ///< Uniform handles
+    int m_planeMvmtx;
+    bool m_basicReady; ///< Program built and VAO set up; what is not ready is left out of the scene
+    bool m_planeReady;
 
     float m_phaseVal;
 
@@ -6,6 +6,13 @@
 #include "AndroidTouchEnums.h"
 #include "FontMgr.h"
 #include "FontRenderer.h"
+#include "ProgramCacheMgr.h"
+#include "CameraUniformMgr.h"
+#include "GLStateMgr.h"
+#include "TextureLoadMgr.h"
+#include "TextureMgr.h"
+#include "ShaderMgr.h"
+#include "ShaderWithVariables.h"
 #include "MatrixMath.h"
 #include "VectorMath.h"
 #include "Logging.h"
@@ -16,12 +23,17 @@ TabletWindow::TabletWindow()
 : m_luaScene()
 , m_fps()
 , m_logDumpTimer()
+, m_uniformsIssued(0)
+, m_uniformsSkipped(0)
+, m_stateCallsIssued(0)
+, m_stateCallsElided(0)
 , m_iconx(20)
 , m_icony(240)
 , m_iconScale(1.f)
 , m_glVersion()
 , m_glRenderer()
 , m_glSLVersion()
+, m_errorLayout()
 , m_holding(false)
 , m_holdingMask(0)
 , m_pointerStates(8)
@@ -29,6 +41,7 @@ TabletWindow::TabletWindow()
 , m_lastTouchPoint(0,0)
 , m_chassisYaw(0.f)
 , m_chassisYawAtTouch(0.f)
+, m_viewStack()
 , m_movingChassisFlag(false)
 {
     m_chassisPos.x = 0.f;
@@ -63,6 +76,8 @@ void FileWriteTest()
 
 void TabletWindow::initGL()
 {
+    const Timer initTimer;
+
     const std::string v(reinterpret_cast<const char*>(glGetString(GL_VERSION)));
     m_glVersion = v;
 
@@ -73,18 +88,26 @@ void TabletWindow::initGL()
     m_glSLVersion = s;
 
     m_tp.initGL();
+    ShaderMgr::Instance().EnableHotReload();
 
     const Language lang = USEnglish;
     FontMgr::Instance().LoadLanguageFonts(lang);
 
     m_luaScene.m_pLoaderFunc = m_pLoaderFunc;
     m_luaScene.initGL();
+
+    ProgramCacheMgr::Instance().LogStats();
+    LOG_INFO("TabletWindow::initGL took %d ms", static_cast<int>(1000. * initTimer.seconds()));
 }
 
 void TabletWindow::exitGL()
 {
     m_luaScene.exitGL();
     m_tp.exitGL();
+    CameraUniformMgr::Instance().Destroy();
+    TextureMgr::Instance().LogStats();
+    TextureMgr::Instance().Destroy();
+    TextureLoadMgr::Instance().Destroy();
 }
 
 void TabletWindow::setWindowSize(int w, int h)
@@ -105,14 +128,15 @@ void TabletWindow::_DrawText(int winw, int winh)
         0.f, static_cast<float>(winw),
         static_cast<float>(winh), 0.f,
         -1.f, 1.f);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    GLStateMgr& state = GLStateMgr::Instance();
+    state.Enable(GL_BLEND);
+    state.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     const FontRenderer* pFont24 = FontMgr::Instance().GetFontOfSize(24);
     if (pFont24 != NULL)
     {
         const int lineh = 40;
-        int y = 40 - lineh + winh - 100;
+        int y = 40 - lineh + winh - 180;
         if (m_movingChassisFlag) { y -= 4 * lineh; }
         const float3 col = {.5f, 1.f, .5f};
         const bool doKerning = true;
@@ -166,25 +190,35 @@ void TabletWindow::_DrawText(int winw, int winh)
             proj,
             doKerning);
 
+        std::ostringstream uoss;
+        uoss << m_uniformsIssued << " uniforms set, " << m_uniformsSkipped << " skipped";
+        pFont24->DrawString(
+            uoss.str().c_str(),
+            10,
+            y += lineh,
+            col,
+            proj,
+            doKerning);
+
+        std::ostringstream soss;
+        soss << m_stateCallsIssued << " GL state calls, " << m_stateCallsElided << " elided";
+        pFont24->DrawString(
+            soss.str().c_str(),
+            10,
+            y += lineh,
+            col,
+            proj,
+            doKerning);
+
         y -= winh - 20; // position text at top
         const float3 red = { 1.f, .8f, .8f };
-        std::string err = m_luaScene.ErrorText();
-        const int cols = 40;
-        std::string chunk = err.substr(0, cols);
-        while (chunk.length() > 0)
-        {
-            chunk = err.substr(0, cols);
-            pFont24->DrawString(
-                chunk.c_str(),
-                10,
-                y += lineh,
-                red,
-                proj,
-                doKerning);
-            err = err.substr(chunk.length());
-        }
+        m_errorLayout.SetFont(pFont24);
+        m_errorLayout.SetWrapWidth(winw - 20);
+        m_errorLayout.SetText(m_luaScene.ErrorText());
+        m_errorLayout.Update();
+        m_errorLayout.Draw(10, y + lineh, lineh, red, proj);
     }
-    glDisable(GL_BLEND);
+    state.Disable(GL_BLEND);
 }
 
 void TabletWindow::_DisplayOverlay(int winw, int winh)
@@ -211,39 +245,58 @@ void TabletWindow::_DisplayOverlay(int winw, int winh)
 ///@brief draws a 3D scene from a camera location
 void TabletWindow::_DisplayScene(int winw, int winh)
 {
-    float mvmtx[16];
     float prmtx[16];
-    MakeIdentityMatrix(mvmtx);
-
-    glhTranslate(mvmtx, m_chassisPos.x, m_chassisPos.y, m_chassisPos.z);
-
-    glhRotate(mvmtx, m_chassisYaw, 0.f, 1.f, 0.f);
+    m_viewStack.LoadIdentity();
+    m_viewStack.Translate(m_chassisPos.x, m_chassisPos.y, m_chassisPos.z);
+    m_viewStack.Rotate(m_chassisYaw, 0.f, 1.f, 0.f);
+    const float* mvmtx = m_viewStack.Get();
 
     glhPerspectivef2(prmtx,
         80.f,
         static_cast<float>(winw) / static_cast<float>(winh),
         .1f, 100.f);
 
+    // Bound once here for every program declaring CameraBlock.
+    CameraUniformMgr::Instance().Update(mvmtx, prmtx);
+
     m_luaScene.RenderForOneEye(mvmtx, prmtx);
+
+    // Lua sets GL state directly, out of GLStateMgr's sight.
+    GLStateMgr::Instance().Invalidate();
 }
 
 void TabletWindow::display(int winw, int winh)
 {
+    GLStateMgr& state = GLStateMgr::Instance();
+    state.Invalidate(); // Lua may have changed GL state since the last frame
+
+    FontMgr::Instance().Update();
+    ShaderMgr::Instance().Update();
+    TextureLoadMgr::Instance().Update();
+
     glViewport(0, 0, winw, winh);
     const float g = .1f;
     glClearColor(g, g, g, 0.f);
     glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
 
-    glEnable(GL_DEPTH_TEST);
+    state.Enable(GL_DEPTH_TEST);
     _DisplayScene(winw, winh);
 
-    glDisable(GL_DEPTH_TEST);
+    state.Disable(GL_DEPTH_TEST);
     _DisplayOverlay(winw, winh);
+
+    m_uniformsIssued = ShaderWithVariables::GetTotalUniformUploadsIssued();
+    m_uniformsSkipped = ShaderWithVariables::GetTotalUniformUploadsSkipped();
+    ShaderWithVariables::ResetTotalUniformUploadCounts();
+    m_stateCallsIssued = state.GetCallsIssued();
+    m_stateCallsElided = state.GetCallsElided();
+    state.ResetCallCounts();
 }
 
 void TabletWindow::timestep(double absT, double dt)
 {
     m_fps.OnFrame();
+    CameraUniformMgr::Instance().SetTime(absT, dt);
 
 #if 1
     // Log fps at regular intervals
@@ -7,7 +7,9 @@
 #include "LuajitScene.h"
 
 #include "TouchPoints.h"
+#include "TextLayout.h"
 #include "FPSTimer.h"
+#include "MatrixStack.h"
 #include "vectortypes.h"
 
 class TabletWindow
@@ -36,6 +38,10 @@ protected:
 
     FPSTimer m_fps;
     Timer m_logDumpTimer;
+    int m_uniformsIssued;  ///< Uniform uploads in the last frame
+    int m_uniformsSkipped; ///< Uniform uploads found redundant in the last frame
+    int m_stateCallsIssued; ///< GL binding and enable calls made in the last frame
+    int m_stateCallsElided; ///< Those GLStateMgr found redundant
     int m_winw;
     int m_winh;
     int m_iconx;
@@ -44,6 +50,7 @@ protected:
     std::string m_glVersion;
     std::string m_glRenderer;
     std::string m_glSLVersion;
+    TextLayout m_errorLayout;
 
     // 3D camera location
     float3 m_chassisPos;
@@ -51,6 +58,7 @@ protected:
     int2 m_lastTouchPoint;
     float m_chassisYaw;
     float m_chassisYawAtTouch;
+    MatrixStack m_viewStack;
 
     // Motion event states
     bool m_holding;
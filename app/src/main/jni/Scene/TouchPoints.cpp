@@ -2,17 +2,19 @@
 
 #include "TouchPoints.h"
 #include "ShaderFunctions.h"
+#include "ShaderMgr.h"
+#include "GLStateMgr.h"
 #include "MatrixMath.h"
 #include "Logging.h"
 #include "AndroidTouchEnums.h"
 #include <string>
 
 TouchPoints::TouchPoints()
-: g_progBasic(0)
-, g_attrLocPos(-1)
-, g_attrLocCol(-1)
-, g_uniLocMvmtx(-1)
-, g_uniLocPrmtx(-1)
+: m_basic()
+, m_attrPos(-1)
+, m_attrCol(-1)
+, m_uniMvmtx(-1)
+, m_uniPrmtx(-1)
 {
 }
 
@@ -20,30 +22,36 @@ TouchPoints::~TouchPoints()
 {
 }
 
+///@brief Start building the program; display draws nothing until it is ready.
 void TouchPoints::initGL()
 {
-    g_progBasic = makeShaderByName("basic");
-    LOGI("g_progBasic = %d", g_progBasic);
+    m_basic.requestProgram("basic");
 
-    g_attrLocPos = glGetAttribLocation(g_progBasic, "vPosition");
-    g_attrLocCol = glGetAttribLocation(g_progBasic, "vColor");
-    g_uniLocMvmtx = glGetUniformLocation(g_progBasic, "mvmtx");
-    g_uniLocPrmtx = glGetUniformLocation(g_progBasic, "prmtx");
-    LOGI("glGetAttribLocation(\"g_attrLocPos\") = %d\n", g_attrLocPos);
-    //LOGI("glGetAttribLocation(\"g_attrLocCol\") = %d\n", g_attrLocCol);
+    m_attrPos = m_basic.GetAttributeHandle("vPosition");
+    m_attrCol = m_basic.GetAttributeHandle("vColor");
+    m_uniMvmtx = m_basic.GetUniformHandle("mvmtx");
+    m_uniPrmtx = m_basic.GetUniformHandle("prmtx");
+    ShaderMgr::Instance().AddReloadListener(&m_basic);
 }
 
 void TouchPoints::exitGL()
 {
-    glDeleteProgram(g_progBasic);
+    ShaderMgr::Instance().RemoveReloadListener(&m_basic);
+    m_basic.destroy();
 }
 
 void TouchPoints::display(float* mview, float* proj, const std::vector<touchState>& touches)
 {
-    glUseProgram(g_progBasic);
+    // Touches are not shown for the few frames the program may take to build.
+    if (!m_basic.pollProgram())
+        return;
 
-    glUniformMatrix4fv(g_uniLocMvmtx, 1, false, mview);
-    glUniformMatrix4fv(g_uniLocPrmtx, 1, false, proj);
+    // Vertex data comes from client memory, which needs the default VAO.
+    GLStateMgr::Instance().UseProgram(m_basic.prog());
+    GLStateMgr::Instance().BindVertexArray(0);
+
+    m_basic.SetUniformMatrix4fv(m_uniMvmtx, mview);
+    m_basic.SetUniformMatrix4fv(m_uniPrmtx, proj);
 
     const GLfloat pointCols[] = {
         1.f, 0.f, 0.f,
@@ -57,8 +65,14 @@ void TouchPoints::display(float* mview, float* proj, const std::vector<touchStat
     };
 
     // The Galaxy Tab 4 Vivante device does not like GL_INT type here, but GL_FLOAT is OK.
-    glEnableVertexAttribArray(g_attrLocPos);
-    glEnableVertexAttribArray(g_attrLocCol);
+    // A location of -1 means the attribute was optimized out or renamed; GL rejects it.
+    const GLint attrLocPos = m_basic.GetAttrLoc(m_attrPos);
+    const GLint attrLocCol = m_basic.GetAttrLoc(m_attrCol);
+    if (attrLocPos < 0)
+        return;
+    glEnableVertexAttribArray(attrLocPos);
+    if (attrLocCol >= 0)
+        glEnableVertexAttribArray(attrLocCol);
 
     int i=0;
     for (std::vector<touchState>::const_iterator it = touches.begin();
@@ -70,8 +84,9 @@ void TouchPoints::display(float* mview, float* proj, const std::vector<touchStat
             continue;
         if (ts.state == ActionPointerUp)
             continue;
-        glVertexAttribPointer(g_attrLocPos, 2, GL_INT, GL_FALSE, sizeof(touchState), &ts.x);
-        glVertexAttribPointer(g_attrLocCol, 3, GL_FLOAT, GL_FALSE, 0, &pointCols[3*i]);
+        glVertexAttribPointer(attrLocPos, 2, GL_INT, GL_FALSE, sizeof(touchState), &ts.x);
+        if (attrLocCol >= 0)
+            glVertexAttribPointer(attrLocCol, 3, GL_FLOAT, GL_FALSE, 0, &pointCols[3*i]);
         glDrawArrays(GL_POINTS, 0, 1);
     }
 }
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "GL_Includes.h"
+#include "ShaderWithVariables.h"
 #include <vector>
 
 struct touchState {
@@ -23,11 +24,11 @@ public:
     void display(float* mview, float* proj, const std::vector<touchState>&);
 
 protected:
-    GLuint g_progBasic;
-    GLuint g_attrLocPos;
-    GLuint g_attrLocCol;
-    GLuint g_uniLocMvmtx;
-    GLuint g_uniLocPrmtx;
+    ShaderWithVariables m_basic;
+    int m_attrPos; ///< Attribute and uniform handles
+    int m_attrCol;
+    int m_uniMvmtx;
+    int m_uniPrmtx;
 
 private:
     TouchPoints(const TouchPoints&);              ///< disallow copy constructor
@@ -0,0 +1,98 @@
+// FileWatcher.cpp
+
+#include "FileWatcher.h"
+
+#if defined(__linux__) && !defined(__ANDROID__)
+#  define USE_INOTIFY 1
+#  include <sys/inotify.h>
+#  include <unistd.h>
+#  include <errno.h>
+#  include <algorithm>
+#else
+#  define USE_INOTIFY 0
+#endif
+
+FileWatcher::FileWatcher()
+: m_directory()
+, m_fd(-1)
+, m_watch(-1)
+{
+}
+
+FileWatcher::~FileWatcher()
+{
+    Stop();
+}
+
+///@brief Begin watching a directory, stopping any previous watch.
+///@return true if changes to the directory will be reported
+bool FileWatcher::Start(const std::string& directory)
+{
+    Stop();
+    m_directory = directory;
+
+#if USE_INOTIFY
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0)
+        return false;
+
+    // Editors either rewrite the file in place or write a new one and rename it over.
+    m_watch = inotify_add_watch(m_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (m_watch < 0)
+    {
+        Stop();
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void FileWatcher::Stop()
+{
+#if USE_INOTIFY
+    if (m_fd >= 0)
+    {
+        if (m_watch >= 0)
+            inotify_rm_watch(m_fd, m_watch);
+        close(m_fd);
+    }
+#endif
+    m_fd = -1;
+    m_watch = -1;
+}
+
+///@brief Append the names, relative to the watched directory, of files changed
+/// since the last call. Each name is reported once per call. Never blocks.
+void FileWatcher::Poll(std::vector<std::string>& changedFiles)
+{
+#if USE_INOTIFY
+    if (m_fd < 0)
+        return;
+
+    const size_t firstNew = changedFiles.size();
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;)
+    {
+        const ssize_t len = read(m_fd, buffer, sizeof(buffer));
+        if (len <= 0) // EAGAIN when there is nothing more to read
+            break;
+
+        const char* p = buffer;
+        while (p < buffer + len)
+        {
+            const struct inotify_event* pEvent = reinterpret_cast<const struct inotify_event*>(p);
+            if ((pEvent->len > 0) && ((pEvent->mask & IN_ISDIR) == 0))
+            {
+                const std::string name(pEvent->name);
+                if (std::find(changedFiles.begin() + firstNew, changedFiles.end(), name) == changedFiles.end())
+                    changedFiles.push_back(name);
+            }
+            p += sizeof(struct inotify_event) + pEvent->len;
+        }
+    }
+#else
+    (void)changedFiles;
+#endif
+}
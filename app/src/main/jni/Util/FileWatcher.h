@@ -0,0 +1,33 @@
+// FileWatcher.h
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+///@brief Reports files in a directory that have been written since the last poll.
+/// Uses inotify on desktop Linux. Start returns false on other platforms,
+/// where nothing is ever reported.
+class FileWatcher
+{
+public:
+    FileWatcher();
+    virtual ~FileWatcher();
+
+    bool Start(const std::string& directory);
+    void Stop();
+    void Poll(std::vector<std::string>& changedFiles);
+
+    /// const Accessors
+    bool IsWatching() const { return m_fd >= 0; }
+    const std::string& GetDirectory() const { return m_directory; }
+
+protected:
+    std::string m_directory;
+    int m_fd;      ///< inotify instance, -1 if not watching
+    int m_watch;   ///< inotify watch descriptor on m_directory
+
+private:
+    FileWatcher(const FileWatcher&);              ///< disallow copy constructor
+    FileWatcher& operator = (const FileWatcher&); ///< disallow assignment operator
+};
@@ -0,0 +1,102 @@
+// MappedFile.cpp
+
+#include "MappedFile.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+: m_pData(NULL)
+, m_size(0)
+#ifdef _WIN32
+, m_file(INVALID_HANDLE_VALUE)
+, m_mapping(NULL)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+///@brief Map the named file read-only, closing any file already mapped.
+///@return true on success. Empty files cannot be mapped and return false.
+bool MappedFile::Open(const char* pFilename)
+{
+    Close();
+    if (pFilename == NULL)
+        return false;
+
+#ifdef _WIN32
+    m_file = CreateFileA(pFilename, GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER sz;
+    if (!GetFileSizeEx(m_file, &sz) || (sz.QuadPart == 0))
+    {
+        Close();
+        return false;
+    }
+
+    m_mapping = CreateFileMapping(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m_mapping == NULL)
+    {
+        Close();
+        return false;
+    }
+
+    m_pData = reinterpret_cast<const unsigned char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (m_pData == NULL)
+    {
+        Close();
+        return false;
+    }
+    m_size = static_cast<size_t>(sz.QuadPart);
+#else
+    const int fd = open(pFilename, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if ((fstat(fd, &st) != 0) || (st.st_size == 0))
+    {
+        close(fd);
+        return false;
+    }
+
+    void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping holds its own reference to the file.
+    if (p == MAP_FAILED)
+        return false;
+
+    m_pData = reinterpret_cast<const unsigned char*>(p);
+    m_size = static_cast<size_t>(st.st_size);
+#endif
+    return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+    if (m_pData != NULL)
+        UnmapViewOfFile(m_pData);
+    if (m_mapping != NULL)
+        CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE)
+        CloseHandle(m_file);
+    m_mapping = NULL;
+    m_file = INVALID_HANDLE_VALUE;
+#else
+    if (m_pData != NULL)
+        munmap(const_cast<unsigned char*>(m_pData), m_size);
+#endif
+    m_pData = NULL;
+    m_size = 0;
+}
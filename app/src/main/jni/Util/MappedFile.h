@@ -0,0 +1,40 @@
+// MappedFile.h
+
+#pragma once
+
+#ifdef _WIN32
+#  define WINDOWS_LEAN_AND_MEAN
+#  define NOMINMAX
+#  include <windows.h>
+#endif
+
+#include <stddef.h>
+
+///@brief A read-only memory mapping of a whole file.
+/// The mapping stays valid until Close is called or the object is destroyed.
+class MappedFile
+{
+public:
+    MappedFile();
+    virtual ~MappedFile();
+
+    bool Open(const char* pFilename);
+    void Close();
+
+    /// const Accessors
+    bool IsOpen() const { return m_pData != NULL; }
+    const unsigned char* Data() const { return m_pData; }
+    size_t Size() const { return m_size; }
+
+protected:
+    const unsigned char* m_pData;
+    size_t m_size;
+#ifdef _WIN32
+    HANDLE m_file;
+    HANDLE m_mapping;
+#endif
+
+private:
+    MappedFile(const MappedFile&);              ///< disallow copy constructor
+    MappedFile& operator = (const MappedFile&); ///< disallow assignment operator
+};
@@ -0,0 +1,51 @@
+// Mutex.h
+// Two implementations of a Mutex class separated by #ifdefs
+
+#pragma once
+
+#ifdef _WIN32
+#  define WINDOWS_LEAN_AND_MEAN
+#  define NOMINMAX
+#  include <windows.h>
+
+///@brief A non-recursive lock for data shared with worker threads.
+class Mutex {
+  public:
+    Mutex() { InitializeCriticalSection(&cs_); }
+    ~Mutex() { DeleteCriticalSection(&cs_); }
+    void lock() { EnterCriticalSection(&cs_); }
+    void unlock() { LeaveCriticalSection(&cs_); }
+    CRITICAL_SECTION* native() { return &cs_; }
+  private:
+    CRITICAL_SECTION cs_;
+    Mutex(const Mutex&);
+    Mutex& operator=(const Mutex&);
+};
+#else
+#include <pthread.h>
+
+///@brief A non-recursive lock for data shared with worker threads.
+class Mutex {
+  public:
+    Mutex() { pthread_mutex_init(&m_, NULL); }
+    ~Mutex() { pthread_mutex_destroy(&m_); }
+    void lock() { pthread_mutex_lock(&m_); }
+    void unlock() { pthread_mutex_unlock(&m_); }
+    pthread_mutex_t* native() { return &m_; }
+  private:
+    pthread_mutex_t m_;
+    Mutex(const Mutex&);
+    Mutex& operator=(const Mutex&);
+};
+#endif
+
+///@brief Holds a Mutex locked for the lifetime of the enclosing scope.
+class ScopedLock {
+  public:
+    explicit ScopedLock(Mutex& m) : m_(m) { m_.lock(); }
+    ~ScopedLock() { m_.unlock(); }
+  private:
+    Mutex& m_;
+    ScopedLock(const ScopedLock&);
+    ScopedLock& operator=(const ScopedLock&);
+};
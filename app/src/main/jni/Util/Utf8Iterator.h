@@ -0,0 +1,69 @@
+// Utf8Iterator.h
+
+#pragma once
+
+#include <stddef.h>
+
+///@brief Walks a range of UTF-8 bytes one code point at a time without allocating.
+/// The range does not need to be NULL terminated; decoding stops at pEnd.
+/// Malformed sequences(stray continuation bytes, truncated or overlong encodings,
+/// surrogates) decode to U+FFFD and advance by one byte so decoding can resync.
+class Utf8Iterator
+{
+public:
+    Utf8Iterator(const char* pBegin, const char* pEnd)
+    : m_p(reinterpret_cast<const unsigned char*>(pBegin))
+    , m_pEnd(reinterpret_cast<const unsigned char*>(pEnd))
+    {}
+
+    Utf8Iterator(const char* pStr, size_t len)
+    : m_p(reinterpret_cast<const unsigned char*>(pStr))
+    , m_pEnd(reinterpret_cast<const unsigned char*>(pStr) + len)
+    {}
+
+    bool AtEnd() const { return m_p >= m_pEnd; }
+
+    /// Pointer to the first byte of the next code point to be decoded.
+    const char* Position() const { return reinterpret_cast<const char*>(m_p); }
+
+    /// Decode the code point at the current position and advance past it.
+    ///@return The decoded code point, or 0xFFFD if the bytes are malformed.
+    unsigned int Next()
+    {
+        const unsigned char c0 = *m_p++;
+        if (c0 < 0x80)
+            return c0;
+
+        unsigned int cp;
+        unsigned int trailing;
+        unsigned int minimum;
+        if ((c0 & 0xe0) == 0xc0)      { cp = c0 & 0x1f; trailing = 1; minimum = 0x80; }
+        else if ((c0 & 0xf0) == 0xe0) { cp = c0 & 0x0f; trailing = 2; minimum = 0x800; }
+        else if ((c0 & 0xf8) == 0xf0) { cp = c0 & 0x07; trailing = 3; minimum = 0x10000; }
+        else
+            return s_replacementChar;
+
+        if (static_cast<size_t>(m_pEnd - m_p) < trailing)
+            return s_replacementChar;
+
+        for (unsigned int i=0; i<trailing; ++i)
+        {
+            const unsigned char c = m_p[i];
+            if ((c & 0xc0) != 0x80)
+                return s_replacementChar;
+            cp = (cp << 6) | (c & 0x3f);
+        }
+
+        if ((cp < minimum) || (cp > 0x10ffff) || ((cp >= 0xd800) && (cp <= 0xdfff)))
+            return s_replacementChar;
+
+        m_p += trailing;
+        return cp;
+    }
+
+    static const unsigned int s_replacementChar = 0xfffd;
+
+protected:
+    const unsigned char* m_p;
+    const unsigned char* m_pEnd;
+};
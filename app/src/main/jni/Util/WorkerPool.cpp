@@ -0,0 +1,202 @@
+// WorkerPool.cpp
+
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool()
+: m_mutex()
+, m_pending()
+, m_finished()
+, m_running(0)
+, m_stopping(false)
+, m_threads()
+{
+#ifdef _WIN32
+    InitializeConditionVariable(&m_cond);
+#else
+    pthread_cond_init(&m_cond, NULL);
+#endif
+}
+
+WorkerPool::~WorkerPool()
+{
+    Stop();
+
+    // Jobs nobody collected are ours to delete.
+    for (std::deque<WorkerJob*>::iterator it = m_finished.begin();
+        it != m_finished.end();
+        ++it)
+    {
+        delete *it;
+    }
+    m_finished.clear();
+
+#ifndef _WIN32
+    pthread_cond_destroy(&m_cond);
+#endif
+}
+
+///@brief Spin up the worker threads. Does nothing if already running.
+///@return true if at least one thread is running
+bool WorkerPool::Start(int numThreads)
+{
+    if (IsRunning())
+        return true;
+
+    m_stopping = false;
+    for (int i=0; i<numThreads; ++i)
+    {
+#ifdef _WIN32
+        HANDLE h = CreateThread(NULL, 0, _ThreadProc, this, 0, NULL);
+        if (h == NULL)
+            break;
+        m_threads.push_back(h);
+#else
+        pthread_t t;
+        if (pthread_create(&t, NULL, _ThreadProc, this) != 0)
+            break;
+        m_threads.push_back(t);
+#endif
+    }
+    return IsRunning();
+}
+
+///@brief Run every job already submitted, then join the threads.
+/// Finished jobs stay queued for PopFinished.
+void WorkerPool::Stop()
+{
+    if (!IsRunning())
+        return;
+
+    {
+        ScopedLock lock(m_mutex);
+        m_stopping = true;
+        _Signal();
+    }
+
+    for (size_t i=0; i<m_threads.size(); ++i)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(m_threads[i], INFINITE);
+        CloseHandle(m_threads[i]);
+#else
+        pthread_join(m_threads[i], NULL);
+#endif
+    }
+    m_threads.clear();
+}
+
+///@brief Queue a job to be run. If no threads are running, it is run immediately
+/// on the calling thread so callers need not handle that case separately.
+void WorkerPool::Submit(WorkerJob* pJob)
+{
+    if (pJob == NULL)
+        return;
+
+    if (!IsRunning())
+    {
+        pJob->Run();
+        ScopedLock lock(m_mutex);
+        m_finished.push_back(pJob);
+        return;
+    }
+
+    ScopedLock lock(m_mutex);
+    m_pending.push_back(pJob);
+    _Signal();
+}
+
+///@return The next completed job, or NULL if none are ready. Never blocks.
+WorkerJob* WorkerPool::PopFinished()
+{
+    ScopedLock lock(m_mutex);
+    if (m_finished.empty())
+        return NULL;
+    WorkerJob* pJob = m_finished.front();
+    m_finished.pop_front();
+    return pJob;
+}
+
+///@return The next completed job, blocking until one is ready, or NULL if none are in flight.
+WorkerJob* WorkerPool::WaitFinished()
+{
+    ScopedLock lock(m_mutex);
+    while (m_finished.empty())
+    {
+        if (m_pending.empty() && (m_running == 0))
+            return NULL;
+        _Wait();
+    }
+    WorkerJob* pJob = m_finished.front();
+    m_finished.pop_front();
+    return pJob;
+}
+
+///@return The number of jobs submitted but not yet returned by PopFinished.
+int WorkerPool::InFlightCount() const
+{
+    ScopedLock lock(m_mutex);
+    return static_cast<int>(m_pending.size() + m_finished.size()) + m_running;
+}
+
+#ifdef _WIN32
+DWORD WINAPI WorkerPool::_ThreadProc(LPVOID pParam)
+{
+    reinterpret_cast<WorkerPool*>(pParam)->_Loop();
+    return 0;
+}
+#else
+void* WorkerPool::_ThreadProc(void* pParam)
+{
+    reinterpret_cast<WorkerPool*>(pParam)->_Loop();
+    return NULL;
+}
+#endif
+
+void WorkerPool::_Loop()
+{
+    for (;;)
+    {
+        WorkerJob* pJob = NULL;
+        {
+            ScopedLock lock(m_mutex);
+            while (m_pending.empty() && !m_stopping)
+                _Wait();
+            if (m_pending.empty())
+                return; // stopping and drained
+            pJob = m_pending.front();
+            m_pending.pop_front();
+            ++m_running;
+        }
+
+        pJob->Run();
+
+        {
+            ScopedLock lock(m_mutex);
+            m_finished.push_back(pJob);
+            --m_running;
+            _Signal();
+        }
+    }
+}
+
+///@brief Wake every waiter. Idle workers and WaitFinished callers share one
+/// condition, so waking just one could wake the wrong kind of waiter.
+///@note Call with m_mutex held.
+void WorkerPool::_Signal()
+{
+#ifdef _WIN32
+    WakeAllConditionVariable(&m_cond);
+#else
+    pthread_cond_broadcast(&m_cond);
+#endif
+}
+
+///@note Call with m_mutex held.
+void WorkerPool::_Wait()
+{
+#ifdef _WIN32
+    SleepConditionVariableCS(&m_cond, m_mutex.native(), INFINITE);
+#else
+    pthread_cond_wait(&m_cond, m_mutex.native());
+#endif
+}
@@ -0,0 +1,70 @@
+// WorkerPool.h
+
+#pragma once
+
+#include "Mutex.h"
+#include <deque>
+#include <vector>
+
+///@brief A unit of work to be run off the GL thread by a WorkerPool.
+/// Run() must not touch any GL state; results are picked up on the GL thread
+/// by polling WorkerPool::PopFinished.
+class WorkerJob
+{
+public:
+    WorkerJob() {}
+    virtual ~WorkerJob() {}
+    virtual void Run() = 0;
+
+private:
+    WorkerJob(const WorkerJob&);              ///< disallow copy constructor
+    WorkerJob& operator = (const WorkerJob&); ///< disallow assignment operator
+};
+
+///@brief A small pool of threads that run submitted WorkerJobs in order of submission.
+/// Jobs are owned by the pool from Submit until they are returned by PopFinished,
+/// after which the caller owns(and deletes) them.
+class WorkerPool
+{
+public:
+    WorkerPool();
+    virtual ~WorkerPool();
+
+    bool Start(int numThreads=1);
+    void Stop();
+
+    void Submit(WorkerJob* pJob);
+    WorkerJob* PopFinished();
+    WorkerJob* WaitFinished();
+
+    /// const Accessors
+    bool IsRunning() const { return !m_threads.empty(); }
+    int InFlightCount() const;
+
+protected:
+#ifdef _WIN32
+    static DWORD WINAPI _ThreadProc(LPVOID pParam);
+#else
+    static void* _ThreadProc(void* pParam);
+#endif
+    void _Loop();
+    void _Signal();
+    void _Wait();
+
+    mutable Mutex           m_mutex;
+    std::deque<WorkerJob*>  m_pending;
+    std::deque<WorkerJob*>  m_finished;
+    int                     m_running;  ///< Jobs currently inside Run()
+    bool                    m_stopping;
+#ifdef _WIN32
+    CONDITION_VARIABLE      m_cond;
+    std::vector<HANDLE>     m_threads;
+#else
+    pthread_cond_t          m_cond;
+    std::vector<pthread_t>  m_threads;
+#endif
+
+private:
+    WorkerPool(const WorkerPool&);              ///< disallow copy constructor
+    WorkerPool& operator = (const WorkerPool&); ///< disallow assignment operator
+};
@@ -0,0 +1,279 @@
+/* GENERATED FILE - DO NOT EDIT!
+ * Created by hardcode_shaders.py.
+ *
+ */
+
+#include <stddef.h>
+
+static const char basic_frag[] = 
+    "#version 310 es\n"
+    "// basic.frag\n"
+    "\n"
+    "#include \"precision.glsl\"\n"
+    "\n"
+    "in vec3 vfColor;\n"
+    "out vec4 fragColor;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    fragColor = vec4(vfColor, 1.0);\n"
+    "}\n"
+;
+
+static const char basic_vert[] = 
+    "#version 310 es\n"
+    "// basic.vert\n"
+    "\n"
+    "#include \"precision.glsl\"\n"
+    "\n"
+    "in vec3 vPosition;\n"
+    "in vec3 vColor;\n"
+    "\n"
+    "out vec3 vfColor;\n"
+    "\n"
+    "uniform mat4 mvmtx;\n"
+    "#ifdef CAMERA_BLOCK\n"
+    "#include \"camerablock.glsl\"\n"
+    "#else\n"
+    "uniform mat4 prmtx;\n"
+    "#endif\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    vfColor = vColor;\n"
+    "    gl_Position = prmtx * mvmtx * vec4(vPosition, 1.);\n"
+    "}\n"
+;
+
+static const char basicline_frag[] = 
+    "#version 310 es\n"
+    "\n"
+    "#include \"precision.glsl\"\n"
+    "\n"
+    "//uniform vec3 uColor;\n"
+    "in float vfVertexIdx;\n"
+    "out vec4 fragColor;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    vec3 col = mix(vec3(1.,0.,0.), vec3(0.,1.,0.), vfVertexIdx);\n"
+    "    fragColor = vec4(col, 1.);\n"
+    "}\n"
+;
+
+static const char basicline_vert[] = 
+    "#version 310 es\n"
+    "\n"
+    "#include \"precision.glsl\"\n"
+    "\n"
+    "uniform mat4 mvmtx;\n"
+    "uniform mat4 prmtx;\n"
+    "uniform int uVertexBase;\n"
+    "uniform int uVertexCount;\n"
+    "\n"
+    "in vec4 vPosition;\n"
+    "out float vfVertexIdx;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    vfVertexIdx = float(gl_VertexID-uVertexBase) / float(uVertexCount);\n"
+    "    vec4 mvPos = mvmtx * vec4(vPosition.xyz, 1.);\n"
+    "    float a = vPosition.w;\n"
+    "    vec3 thickVec = vec3(cos(a), sin(a), 0.);\n"
+    "    mvPos.xyz += thickVec * float(gl_VertexID % 2) * .05;\n"
+    "    gl_Position = prmtx * mvPos;\n"
+    "}\n"
+;
+
+static const char basicplane_frag[] = 
+    "#version 310 es\n"
+    "// basicplane.frag\n"
+    "// Apply a simple black and white checkerboard pattern to a quad\n"
+    "// with texture coordinates in the unit interval.\n"
+    "\n"
+    "#include \"precision.glsl\"\n"
+    "\n"
+    "in vec2 vfTexCoord;\n"
+    "out vec4 fragColor;\n"
+    "\n"
+    "float pi = 3.14159265358979323846;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    float freq = 16.0 * pi;\n"
+    "    float lum = floor(1.0 + 2.0*sin(freq*vfTexCoord.x) * sin(freq*vfTexCoord.y));\n"
+    "    fragColor = vec4(vec3(lum), 1.0);\n"
+    "}\n"
+;
+
+static const char basicplane_vert[] = 
+    "#version 310 es\n"
+    "// basicplane.vert\n"
+    "\n"
+    "#include \"precision.glsl\"\n"
+    "\n"
+    "in vec3 vPosition;\n"
+    "in vec2 vTexCoord;\n"
+    "\n"
+    "out vec2 vfTexCoord;\n"
+    "\n"
+    "uniform mat4 mvmtx;\n"
+    "#ifdef CAMERA_BLOCK\n"
+    "#include \"camerablock.glsl\"\n"
+    "#else\n"
+    "uniform mat4 prmtx;\n"
+    "#endif\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    vfTexCoord = vTexCoord;\n"
+    "    gl_Position = prmtx * mvmtx * vec4(vPosition, 1.0);\n"
+    "}\n"
+;
+
+static const char basictex_frag[] = 
+    "#version 310 es\n"
+    "// basictex.frag\n"
+    "\n"
+    "#include \"precision.glsl\"\n"
+    "\n"
+    "uniform sampler2D s_texture;\n"
+    "\n"
+    "in vec2 vfTex;\n"
+    "out vec4 fragColor;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    float lum = texture(s_texture, vfTex).x;\n"
+    "    vec3 texCol = vec3(lum);\n"
+    "    fragColor = vec4(texCol, 1.);\n"
+    "}\n"
+;
+
+static const char basictex_vert[] = 
+    "#version 310 es\n"
+    "// basictex.vert\n"
+    "\n"
+    "#include \"precision.glsl\"\n"
+    "\n"
+    "in vec2 vPosition;\n"
+    "in vec2 vTexCoord;\n"
+    "\n"
+    "out vec2 vfTex;\n"
+    "\n"
+    "uniform mat4 mvmtx;\n"
+    "uniform mat4 prmtx;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    vfTex = vTexCoord;\n"
+    "    gl_Position = prmtx * mvmtx * vec4(vPosition, 0., 1.);\n"
+    "}\n"
+;
+
+static const char camerablock_glsl[] = 
+    "// camerablock.glsl\n"
+    "// Camera data shared by all programs, filled once per frame by CameraUniformMgr.\n"
+    "// The layout must match CameraBlockData.\n"
+    "\n"
+    "layout(std140) uniform CameraBlock\n"
+    "{\n"
+    "    mat4 viewmtx;\n"
+    "    mat4 prmtx;\n"
+    "    vec4 cameraTime; // x: absolute time in seconds, y: timestep\n"
+    "};\n"
+;
+
+static const char fontrenderer_frag[] = 
+    "#version 310 es\n"
+    "// fontrenderer.frag\n"
+    "// Shader for FontRenderer class\n"
+    "// Shader runs with blending enabled:  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);\n"
+    "\n"
+    "#ifdef GL_ES\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "\n"
+    "in vec2 v_texCoord;\n"
+    "out vec4 fragColor;\n"
+    "\n"
+    "uniform vec3 u_fontColor;\n"
+    "uniform sampler2D s_texture;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    /// Texture is luminance only\n"
+    "    float lum = texture(s_texture, v_texCoord).r;\n"
+    "    \n"
+    "    /// Some options here to beef up the font weight a bit:\n"
+    "    lum = clamp(2.0 * lum, 0.0, 1.0);\n"
+    "    //lum = pow(lum, 0.25);\n"
+    "    //lum = sin(lum*1.57079632679);\n"
+    "\n"
+    "    ///\n"
+    "    /// These functions appear to cause an error on the Tegra 3 device:\n"
+    "    /// Cyan text with black background showing through. No sqrt?\n"
+    "    ///\n"
+    "    //lum = sqrt(lum);\n"
+    "    //lum = sqrt(sin(lum*1.57079632679));\n"
+    "\n"
+    "\n"
+    "    fragColor = vec4(u_fontColor, lum);\n"
+    "}\n"
+;
+
+static const char fontrenderer_vert[] = 
+    "#version 310 es\n"
+    "// fontrenderer.vert\n"
+    "// Shader for FontRenderer class\n"
+    "// Vertex shader simply takes quads textured to unit interval and scales them to pixel coordinates.\n"
+    "\n"
+    "in vec3 a_position;\n"
+    "in vec2 a_texCoord;\n"
+    "\n"
+    "out vec2 v_texCoord;\n"
+    "\n"
+    "uniform mat4 mvmtx;\n"
+    "uniform mat4 prmtx;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = prmtx * mvmtx * vec4(a_position, 1.0);\n"
+    "    v_texCoord = a_texCoord;\n"
+    "}\n"
+;
+
+static const char precision_glsl[] = 
+    "// precision.glsl\n"
+    "// Default precision for the ES shaders; desktop GL ignores these.\n"
+    "\n"
+    "#ifdef GL_ES\n"
+    "precision mediump float;\n"
+    "precision mediump int;\n"
+    "#endif\n"
+;
+
+
+struct EmbeddedShader
+{
+    const char* name;
+    const char* source;
+    size_t length;
+};
+
+// Sorted by name for binary search.
+static const EmbeddedShader g_shaderTable[] = {
+    { "basic.frag", basic_frag, sizeof(basic_frag) - 1 },
+    { "basic.vert", basic_vert, sizeof(basic_vert) - 1 },
+    { "basicline.frag", basicline_frag, sizeof(basicline_frag) - 1 },
+    { "basicline.vert", basicline_vert, sizeof(basicline_vert) - 1 },
+    { "basicplane.frag", basicplane_frag, sizeof(basicplane_frag) - 1 },
+    { "basicplane.vert", basicplane_vert, sizeof(basicplane_vert) - 1 },
+    { "basictex.frag", basictex_frag, sizeof(basictex_frag) - 1 },
+    { "basictex.vert", basictex_vert, sizeof(basictex_vert) - 1 },
+    { "camerablock.glsl", camerablock_glsl, sizeof(camerablock_glsl) - 1 },
+    { "fontrenderer.frag", fontrenderer_frag, sizeof(fontrenderer_frag) - 1 },
+    { "fontrenderer.vert", fontrenderer_vert, sizeof(fontrenderer_vert) - 1 },
+    { "precision.glsl", precision_glsl, sizeof(precision_glsl) - 1 },
+};
+static const size_t g_shaderCount = 12;
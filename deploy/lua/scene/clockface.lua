@@ -51,7 +51,11 @@ in vec4 vColor;
 out vec3 vfColor;
 
 uniform mat4 mvmtx;
+#ifdef CAMERA_BLOCK
+#include "camerablock.glsl"
+#else
 uniform mat4 prmtx;
+#endif
 
 void main()
 {
@@ -144,9 +148,11 @@ end
 
 function clockface:render_for_one_eye(view, proj)
     local umv_loc = gl.glGetUniformLocation(self.prog, "mvmtx")
-    local upr_loc = gl.glGetUniformLocation(self.prog, "prmtx")
     gl.glUseProgram(self.prog)
-    gl.glUniformMatrix4fv(upr_loc, 1, GL.GL_FALSE, glFloatv(16, proj))
+    if not sf.camera_block_active() then
+        local upr_loc = gl.glGetUniformLocation(self.prog, "prmtx")
+        gl.glUniformMatrix4fv(upr_loc, 1, GL.GL_FALSE, glFloatv(16, proj))
+    end
     
     local m = {}
     mm.make_identity_matrix(m)
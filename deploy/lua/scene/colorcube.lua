@@ -43,7 +43,11 @@ in vec4 vColor;
 out vec3 vfColor;
 
 uniform mat4 mvmtx;
+#ifdef CAMERA_BLOCK
+#include "camerablock.glsl"
+#else
 uniform mat4 prmtx;
+#endif
 
 void main()
 {
@@ -152,9 +156,11 @@ function colorcube:render_for_one_eye(view, proj)
     mm.glh_translate(m, -.5,-.5,-.5)
 
     local umv_loc = gl.glGetUniformLocation(self.prog, "mvmtx")
-    local upr_loc = gl.glGetUniformLocation(self.prog, "prmtx")
     gl.glUseProgram(self.prog)
-    gl.glUniformMatrix4fv(upr_loc, 1, GL.GL_FALSE, glFloatv(16, proj))
+    if not sf.camera_block_active() then
+        local upr_loc = gl.glGetUniformLocation(self.prog, "prmtx")
+        gl.glUniformMatrix4fv(upr_loc, 1, GL.GL_FALSE, glFloatv(16, proj))
+    end
     gl.glUniformMatrix4fv(umv_loc, 1, GL.GL_FALSE, glFloatv(16, m))
     gl.glBindVertexArray(self.vao)
     gl.glDrawElements(GL.GL_TRIANGLES, 6*3*2, GL.GL_UNSIGNED_INT, nil)
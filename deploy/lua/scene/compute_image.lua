@@ -38,7 +38,11 @@ in vec4 vPosition;
 in vec4 vColor;
 
 uniform mat4 mvmtx;
+#ifdef CAMERA_BLOCK
+#include "camerablock.glsl"
+#else
 uniform mat4 prmtx;
+#endif
 
 out vec3 vfColor;
 
@@ -385,8 +389,10 @@ function compute_image:render_for_one_eye(view, proj)
 
     gl.glUseProgram(self.prog)
     local umv_loc = gl.glGetUniformLocation(self.prog, "mvmtx")
-    local upr_loc = gl.glGetUniformLocation(self.prog, "prmtx")
-    gl.glUniformMatrix4fv(upr_loc, 1, GL.GL_FALSE, glFloatv(16, proj))
+    if not sf.camera_block_active() then
+        local upr_loc = gl.glGetUniformLocation(self.prog, "prmtx")
+        gl.glUniformMatrix4fv(upr_loc, 1, GL.GL_FALSE, glFloatv(16, proj))
+    end
 
     gl.glBindVertexArray(self.vao)
 
@@ -417,8 +423,10 @@ function compute_image:render_for_one_eye(view, proj)
     -- Draw the combined texture
     gl.glUseProgram(self.prog_combined)
     local umv_loc = gl.glGetUniformLocation(self.prog_combined, "mvmtx")
-    local upr_loc = gl.glGetUniformLocation(self.prog_combined, "prmtx")
-    gl.glUniformMatrix4fv(upr_loc, 1, GL.GL_FALSE, glFloatv(16, proj))
+    if not sf.camera_block_active() then
+        local upr_loc = gl.glGetUniformLocation(self.prog_combined, "prmtx")
+        gl.glUniformMatrix4fv(upr_loc, 1, GL.GL_FALSE, glFloatv(16, proj))
+    end
 
     gl.glBindVertexArray(self.vao)
 
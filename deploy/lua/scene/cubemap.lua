@@ -22,7 +22,9 @@ function cubemap:init()
     self.vao = 0
     self.prog = 0
     self.texID = 0
+    self.texShared = false -- Acquired from TextureMgr; give it back with texture_release
     self.dataDir = nil
+    self.compareLoaders = false -- Set to time the native and script loaders against each other
 end
 
 --local openGL = require("opengl")
@@ -42,7 +44,11 @@ in vec4 vPosition;
 out vec3 vfColor;
 
 uniform mat4 mvmtx;
+#ifdef CAMERA_BLOCK
+#include "camerablock.glsl"
+#else
 uniform mat4 prmtx;
+#endif
 
 void main()
 {
@@ -77,23 +83,13 @@ function cubemap:setDataDirectory(dir)
     self.dataDir = dir
 end
 
-function cubemap:loadtextures()
-    local texfilenames = {
-        "posx_",
-        "negx_",
-        "posy_",
-        "negy_",
-        "posz_",
-        "negz_",
-    }
+-- Read six raw faces with io.open and upload them one at a time.
+local function load_cubemap_in_script(paths, dim)
     local dtxId = ffi.new("GLuint[1]")
     gl.glGenTextures(1, dtxId)
-    self.texID = dtxId[0]
-    gl.glBindTexture(GL.GL_TEXTURE_CUBE_MAP, self.texID)
-    local dim = 128
-    for i,name in ipairs(texfilenames) do
-        local fn = name..dim..".raw"
-        if self.dataDir then fn = self.dataDir .. "/images/" .. fn end
+    local texID = dtxId[0]
+    gl.glBindTexture(GL.GL_TEXTURE_CUBE_MAP, texID)
+    for i,fn in ipairs(paths) do
         local w,h = dim,dim
         local inp = assert(io.open(fn, "rb"))
         local data = inp:read("*all")
@@ -110,6 +106,63 @@ function cubemap:loadtextures()
             GL.GL_RGB, GL.GL_UNSIGNED_BYTE, data)
     end
     gl.glBindTexture(GL.GL_TEXTURE_CUBE_MAP, 0)
+    return texID
+end
+
+-- Load the faces both ways, timed on the same host wall clock, and print the
+-- comparison. os.clock is CPU time, which misses the native loader's worker
+-- threads and any time spent waiting on storage.
+function cubemap:compare_loaders(paths, dim)
+    if not (timer_seconds and texture_load_cubemap) then
+        print("cubemap: the host has no native loader or timer to compare against.")
+        return
+    end
+    local start = timer_seconds()
+    local nativeTex = texture_load_cubemap(paths, dim, dim, 3)
+    local nativeTime = timer_seconds() - start
+    texture_delete(nativeTex)
+
+    start = timer_seconds()
+    local scriptTex = load_cubemap_in_script(paths, dim)
+    local scriptTime = timer_seconds() - start
+    local dtexId = ffi.new("GLuint[1]", scriptTex)
+    gl.glDeleteTextures(1, dtexId)
+
+    print(string.format("Loaded %d px cubemap natively in %.2f ms, in script in %.2f ms (%.1fx).",
+        dim, 1000 * nativeTime, 1000 * scriptTime, scriptTime / math.max(nativeTime, 1e-6)))
+end
+
+function cubemap:loadtextures()
+    local texfilenames = {
+        "posx_",
+        "negx_",
+        "posy_",
+        "negy_",
+        "posz_",
+        "negz_",
+    }
+    local dim = 128
+    local paths = {}
+    for i,name in ipairs(texfilenames) do
+        local fn = name..dim..".raw"
+        if self.dataDir then fn = self.dataDir .. "/images/" .. fn end
+        paths[i] = fn
+    end
+
+    if self.compareLoaders then
+        self:compare_loaders(paths, dim)
+    end
+
+    -- TextureMgr shares the cube map and reads all six faces in parallel.
+    if texture_acquire_cubemap then
+        self.texID = texture_acquire_cubemap(paths, dim, dim, 3)
+        if self.texID ~= 0 then
+            self.texShared = true
+            return
+        end
+    end
+
+    self.texID = load_cubemap_in_script(paths, dim)
 end
 
 function cubemap:init_cube_attributes()
@@ -199,15 +252,21 @@ function cubemap:exitGL()
     local vaoId = ffi.new("GLuint[1]", self.vao)
     gl.glDeleteVertexArrays(1, vaoId)
 
-    local dtexId = ffi.new("GLuint[1]", self.texID)
-    gl.glDeleteTextures(1, dtexId)
+    if self.texShared then
+        texture_release(self.texID)
+    else
+        local dtexId = ffi.new("GLuint[1]", self.texID)
+        gl.glDeleteTextures(1, dtexId)
+    end
 end
 
 function cubemap:render_for_one_eye(view, proj)
     local umv_loc = gl.glGetUniformLocation(self.prog, "mvmtx")
-    local upr_loc = gl.glGetUniformLocation(self.prog, "prmtx")
     gl.glUseProgram(self.prog)
-    gl.glUniformMatrix4fv(upr_loc, 1, GL.GL_FALSE, glFloatv(16, proj))
+    if not sf.camera_block_active() then
+        local upr_loc = gl.glGetUniformLocation(self.prog, "prmtx")
+        gl.glUniformMatrix4fv(upr_loc, 1, GL.GL_FALSE, glFloatv(16, proj))
+    end
 
     gl.glActiveTexture(GL.GL_TEXTURE0)
     gl.glBindTexture(GL.GL_TEXTURE_CUBE_MAP, self.texID)
@@ -36,7 +36,11 @@ in vec4 vPosition;
 in vec4 vColor;
 
 uniform mat4 mvmtx;
+#ifdef CAMERA_BLOCK
+#include "camerablock.glsl"
+#else
 uniform mat4 prmtx;
+#endif
 
 out vec3 vfColor;
 
@@ -200,9 +204,11 @@ function droid:render_for_one_eye(view, proj)
     --gl.glPolygonMode(GL.GL_FRONT_AND_BACK, GL.GL_LINE)
     --gl.glEnable(GL.GL_CULL_FACE)
     local umv_loc = gl.glGetUniformLocation(self.prog, "mvmtx")
-    local upr_loc = gl.glGetUniformLocation(self.prog, "prmtx")
     gl.glUniformMatrix4fv(umv_loc, 1, GL.GL_FALSE, glFloatv(16, view))
-    gl.glUniformMatrix4fv(upr_loc, 1, GL.GL_FALSE, glFloatv(16, proj))
+    if not sf.camera_block_active() then
+        local upr_loc = gl.glGetUniformLocation(self.prog, "prmtx")
+        gl.glUniformMatrix4fv(upr_loc, 1, GL.GL_FALSE, glFloatv(16, proj))
+    end
     gl.glBindVertexArray(self.vao)
     gl.glDrawElements(GL.GL_TRIANGLES, self.numTris, GL.GL_UNSIGNED_INT, nil)
     gl.glBindVertexArray(0)
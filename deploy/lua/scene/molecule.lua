@@ -48,7 +48,11 @@ layout(location = 0) in vec4 vPosition;
 layout(location = 1) in vec4 vColor;
 
 layout(location = 0) uniform mat4 mvmtx;
+#ifdef CAMERA_BLOCK
+#include "camerablock.glsl"
+#else
 layout(location = 1) uniform mat4 prmtx;
+#endif
 
 out vec3  v_color;
 out float v_sqrradius;
@@ -92,7 +96,11 @@ precision highp float;
 precision mediump int;
 #endif
 
+#ifdef CAMERA_BLOCK
+#include "camerablock.glsl"
+#else
 layout(location = 1) uniform mat4 prmtx;
+#endif
 
 in vec3  v_color;
 in float v_sqrradius;
@@ -314,7 +322,9 @@ end
 function molecule:render_for_one_eye(mview, proj)
     gl.glUseProgram(self.prog)
     gl.glUniformMatrix4fv(0, 1, GL.GL_FALSE, glFloatv(16, mview))
-    gl.glUniformMatrix4fv(1, 1, GL.GL_FALSE, glFloatv(16, proj))
+    if not sf.camera_block_active() then
+        gl.glUniformMatrix4fv(1, 1, GL.GL_FALSE, glFloatv(16, proj))
+    end
 
     gl.glBindVertexArray(self.vao)
     gl.glDrawArrays(GL.GL_TRIANGLES, 0, 3 * self.num_atoms)
@@ -139,9 +139,12 @@ function multipass_example:initGL()
     self.vao = vaoId[0]
     gl.glBindVertexArray(self.vao)
 
+    -- The quads are drawn both in the scene and in the HUD's own screen
+    -- space projection, so this program keeps its prmtx uniform.
     self.prog = sf.make_shader_from_source({
         vsrc = basic_vert,
         fsrc = basic_frag,
+        camera_block = false,
         })
 
     self:init_quad_attributes()
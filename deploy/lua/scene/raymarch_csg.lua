@@ -22,6 +22,7 @@ end
 
 local ffi = require("ffi")
 require("util.fullscreen_shader")
+local sf = require("util.shaderfunctions")
 
 local glIntv = ffi.typeof('GLint[?]')
 local glUintv = ffi.typeof('GLuint[?]')
@@ -29,7 +30,11 @@ local glFloatv = ffi.typeof('GLfloat[?]')
 
 local rm_frag = [[
 uniform mat4 mvmtx;
+#ifdef CAMERA_BLOCK
+#include "camerablock.glsl"
+#else
 uniform mat4 prmtx;
+#endif
 
 // Simple ray marching example
 // @var url https://www.shadertoy.com/view/ldB3Rw
@@ -241,8 +246,10 @@ function raymarch_csg:render_for_one_eye(view, proj)
     local function set_variables(prog)
         local umv_loc = gl.glGetUniformLocation(prog, "mvmtx")
         gl.glUniformMatrix4fv(umv_loc, 1, GL.GL_FALSE, glFloatv(16, view))
-        local upr_loc = gl.glGetUniformLocation(prog, "prmtx")
-        gl.glUniformMatrix4fv(upr_loc, 1, GL.GL_FALSE, glFloatv(16, proj))
+        if not sf.camera_block_active() then
+            local upr_loc = gl.glGetUniformLocation(prog, "prmtx")
+            gl.glUniformMatrix4fv(upr_loc, 1, GL.GL_FALSE, glFloatv(16, proj))
+        end
     end
 
     self.shader:render(view, proj, set_variables)
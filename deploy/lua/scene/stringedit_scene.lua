@@ -35,6 +35,8 @@ function stringedit_scene:init(source)
     self.fbw, self.fbh = 2048,1024
     self.textscale = .0008
     self.max_charw = 0
+    self.layout = nil
+    self.wrap_cols = 120 -- Lines longer than this many widest glyphs wrap
 
     if type(source.data_dir) == "string" then
         self.data_dir = source.data_dir
@@ -165,12 +167,11 @@ function stringedit_scene:renderCurrentLineBackdrop(view, proj)
     local m = {}
     self:makeModelMatrix(m)
     mm.glh_translate(m, 0, 0, -.0002) -- place behind text
-    local cline = self.editbuf.curline
-    local line = self.editbuf.lines[cline]
-    if not line then return end
-    mm.glh_scale(m,#line,1,1) -- cover under entire line
+    if not self.editbuf.lines[self.editbuf.curline] then return end
+    local crow, _, rowlen = self:cursorRow()
+    mm.glh_scale(m,rowlen,1,1) -- cover under entire row
 
-    mm.glh_translate(m, 0, (cline-1)*self.lineh, 0)
+    mm.glh_translate(m, 0, (crow-1)*self.lineh, 0)
     mm.glh_translate(m, 0, -self.scroll * self.lineh, 0)
 
     gl.glEnable(GL.GL_BLEND)
@@ -197,7 +198,7 @@ function stringedit_scene:renderCursor(view, proj)
     self:makeModelMatrix(m)
     mm.glh_translate(m, 0, 0, .0002) -- put cursor in front
 
-    local ccol, cline = self.editbuf.curcol, self.editbuf.curline
+    local cline, ccol = self:cursorRow()
     mm.glh_translate(m, ccol*self.max_charw, (cline-1)*self.lineh, 0)
     mm.glh_translate(m, 0, -self.scroll * self.lineh, 0)
 
@@ -357,6 +358,12 @@ function stringedit_scene:initGL()
     self.max_charw = self.glfont:get_max_char_width()
     self.lineh = self.glfont.font.common.lineHeight
 
+    -- Wrap with a native layout of the same font when the host provides one.
+    if textlayout_new and self.editbuf then
+        self.layout = textlayout_new('courier_512', self.wrap_cols * self.max_charw)
+        self.editbuf:setLayout(self.layout)
+    end
+
     self:initGL_cursor()
     self:initGL_quad()
 
@@ -368,6 +375,8 @@ function stringedit_scene:initGL()
 end
 
 function stringedit_scene:exitGL()
+    if self.editbuf then self.editbuf:setLayout(nil) end
+    self.layout = nil
     self.glfont:exitGL()
     self:exitGL_cursor()
     self:exitGL_quad()
@@ -409,24 +418,82 @@ function stringedit_scene:renderToFbo()
     gl.glBindFramebuffer(GL.GL_FRAMEBUFFER, boundfbo[0])
 end
 
+-- Lay out any lines edited since the last call.
+-- Returns the number of display rows: wrapped lines with a layout, else lines.
+function stringedit_scene:updateLayout()
+    if not self.layout then return #self.editbuf.lines end
+    return (textlayout_update(self.layout))
+end
+
+-- Returns the display row holding the cursor, the cursor's column in that row
+-- and the row's length in bytes.
+function stringedit_scene:cursorRow()
+    local buf = self.editbuf
+    local line = buf.lines[buf.curline] or ''
+    if not self.layout then return buf.curline, buf.curcol, #line end
+
+    self:updateLayout()
+    local first, count = textlayout_paragraph_lines(self.layout, buf.curline)
+    if not first then return buf.curline, buf.curcol, #line end
+    for row=first,first+count-1 do
+        local _, b, e = textlayout_line(self.layout, row)
+        if buf.curcol <= e or row == first+count-1 then
+            return row, buf.curcol - (b-1), e - b + 1
+        end
+    end
+end
+
+-- Returns the last display row of line k, under which its error message goes.
+function stringedit_scene:lineLastRow(k)
+    if not self.layout then return k end
+    self:updateLayout()
+    local first, count = textlayout_paragraph_lines(self.layout, k)
+    if not first then return k end
+    return first + count - 1
+end
+
+-- Scroll just far enough to show the cursor's row.
+function stringedit_scene:scrollToCursor()
+    local crow = self:cursorRow()
+    if self.scroll + self.visible_lines < crow then
+        self.scroll = crow - self.visible_lines
+        self.scroll = math.max(0, self.scroll)
+    end
+    if self.scroll >= crow then
+        self.scroll = crow - 1
+    end
+end
+
 function stringedit_scene:renderText(view, proj)
     local m = {}
     self:makeModelMatrix(m)
 
     local linenum_color = {.7, .7, .7}
     local text_color = {1, 1, 1}
-    local numlines = math.min(self.visible_lines, #self.editbuf.lines)
-    for i=1,numlines do
-        local k = i + self.scroll
-        local v = self.editbuf.lines[k]
+    local numrows = math.min(self.visible_lines, self:updateLayout() - self.scroll)
+    for i=1,numrows do
+        local k, v = i + self.scroll, nil
+        local first_row = true
+        if self.layout then
+            -- Show one wrapped row; number only the first row of each line.
+            local b, e
+            k, b, e = textlayout_line(self.layout, i + self.scroll)
+            if not k then break end
+            v = string.sub(self.editbuf.lines[k], b, e)
+            first_row = (b == 1)
+        else
+            v = self.editbuf.lines[k]
+        end
         self.glfont:render_string(m, proj, text_color, v)
 
         -- Line numbers
-        local linenum_str = tostring(k)
-        local mn = {}
-        for i=1,16 do mn[i] = m[i] end
-        mm.glh_translate(mn, -40-59*string.len(linenum_str), 0, 0)
-        self.glfont:render_string(mn, proj, linenum_color, linenum_str)
+        if first_row then
+            local linenum_str = tostring(k)
+            local mn = {}
+            for i=1,16 do mn[i] = m[i] end
+            mm.glh_translate(mn, -40-59*string.len(linenum_str), 0, 0)
+            self.glfont:render_string(mn, proj, linenum_color, linenum_str)
+        end
 
         mm.glh_translate(m, 0, self.lineh, 0)
     end
@@ -441,7 +508,7 @@ function stringedit_scene:renderErrorBackdrop(view, proj)
         mm.glh_translate(m, 0, 0, .0002) -- put cursor in front
         mm.glh_scale(m,#v,1,1) -- cover under entire message
 
-        local ccol, cline = 0, k+1
+        local ccol, cline = 0, self:lineLastRow(k)+1
         mm.glh_translate(m, ccol*self.max_charw, (cline-1)*self.lineh, 0)
         mm.glh_translate(m, 0, -self.scroll * self.lineh, 0)
 
@@ -472,7 +539,7 @@ function stringedit_scene:renderErrorText(view, proj)
         local emat = {}
         self:makeModelMatrix(emat)
 
-        mm.glh_translate(emat, 0, (k - self.scroll)*self.lineh, 0)
+        mm.glh_translate(emat, 0, (self:lineLastRow(k) - self.scroll)*self.lineh, 0)
         self.glfont:render_string(emat, proj, errcol, v)
     end
 end
@@ -558,16 +625,11 @@ function stringedit_scene:keypressed(key, scancode, action, mods)
         end,
         [264] = function (x) -- Down
             self.editbuf:cursorMotion(0,1)
-            if self.scroll + self.visible_lines < self.editbuf.curline then
-                self.scroll = self.editbuf.curline - self.visible_lines
-                self.scroll = math.max(0, self.scroll)
-            end
+            self:scrollToCursor()
         end,
         [265] = function (x) -- Up
             self.editbuf:cursorMotion(0,-1)
-            if self.scroll >= self.editbuf.curline then
-                self.scroll = self.editbuf.curline - 1
-            end
+            self:scrollToCursor()
         end,
         [266] = function (x) -- Page Up
             self.scroll = self.scroll - scrollAmt
@@ -576,7 +638,8 @@ function stringedit_scene:keypressed(key, scancode, action, mods)
         end,
         [267] = function (x) -- Page Down
             self.scroll = self.scroll + scrollAmt
-            self.scroll = math.min(self.scroll, #self.editbuf.lines - self.visible_lines)
+            self.scroll = math.min(self.scroll, self:updateLayout() - self.visible_lines)
+            self.scroll = math.max(self.scroll, 0)
             self.editbuf:cursorMotion(0,scrollAmt)
         end,
     }
@@ -599,15 +662,7 @@ function stringedit_scene:onwheel(x,y)
 
     y = math.floor(-5*y)
     self.editbuf:cursorMotion(0,y)
-
-    if self.scroll + self.visible_lines < self.editbuf.curline then
-        self.scroll = self.editbuf.curline - self.visible_lines
-        self.scroll = math.max(0, self.scroll)
-    end
-
-    if self.scroll >= self.editbuf.curline then
-        self.scroll = self.editbuf.curline - 1
-    end
+    self:scrollToCursor()
 end
 
 return stringedit_scene
@@ -29,6 +29,7 @@ function textured_cubes:init()
     self.vao = 0
     self.prog = 0
     self.texID = 0
+    self.texShared = false
     self.dataDir = nil
 end
 
@@ -55,7 +56,11 @@ in vec4 vColor;
 out vec3 vfColor;
 
 uniform mat4 mvmtx;
+#ifdef CAMERA_BLOCK
+#include "camerablock.glsl"
+#else
 uniform mat4 prmtx;
+#endif
 
 void main()
 {
@@ -92,6 +97,12 @@ function textured_cubes:loadtextures()
     local texfilename = "stone_128x128.raw"
     if self.dataDir then texfilename = self.dataDir .. "/images/" .. texfilename end
     local w,h = 128,128
+    if texture_acquire then
+        self.texID = texture_acquire(texfilename, w, h, 3, tonumber(GL.GL_NEAREST))
+        self.texShared = true
+        return
+    end
+
     local inp = io.open(texfilename, "rb")
     local data = nil
     if inp then
@@ -220,8 +231,12 @@ function textured_cubes:exitGL()
     self.vbos = {}
 
     gl.glDeleteProgram(self.prog)
-    local texdel = ffi.new("GLuint[1]", self.texID)
-    gl.glDeleteTextures(1,texdel)
+    if self.texShared then
+        texture_release(self.texID)
+    else
+        local texdel = ffi.new("GLuint[1]", self.texID)
+        gl.glDeleteTextures(1,texdel)
+    end
 
     local vaoId = ffi.new("GLuint[1]", self.vao)
     gl.glDeleteVertexArrays(1, vaoId)
@@ -230,9 +245,11 @@ end
 
 function textured_cubes:render_for_one_eye(view, proj)
     local umv_loc = gl.glGetUniformLocation(self.prog, "mvmtx")
-    local upr_loc = gl.glGetUniformLocation(self.prog, "prmtx")
     gl.glUseProgram(self.prog)
-    gl.glUniformMatrix4fv(upr_loc, 1, GL.GL_FALSE, glFloatv(16, proj))
+    if not sf.camera_block_active() then
+        local upr_loc = gl.glGetUniformLocation(self.prog, "prmtx")
+        gl.glUniformMatrix4fv(upr_loc, 1, GL.GL_FALSE, glFloatv(16, proj))
+    end
 
     gl.glActiveTexture(GL.GL_TEXTURE0)
     gl.glBindTexture(GL.GL_TEXTURE_2D, self.texID)
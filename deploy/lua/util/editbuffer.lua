@@ -1,7 +1,9 @@
 -- editbuffer.lua
 -- A minimally functional text editor in a small amount of LOC.
 -- Holds a file in a buffer as a list of lines and a cursor position.
--- Does not handle any display.
+-- Does not handle any display, but can keep a native text layout(textlayout_new)
+-- in step with its lines so a display can show them word-wrapped, with only the
+-- lines touched by each edit wrapped again.
 
 EditBuffer = {}
 EditBuffer.__index = EditBuffer
@@ -19,6 +21,36 @@ function EditBuffer:init()
     self.lines = {}
     self.curline = 1
     self.curcol = 0
+    self.layout = nil
+end
+
+-- Mirror the lines into a text layout from now on; one paragraph per line.
+function EditBuffer:setLayout(layout)
+    self.layout = layout
+    self:syncLayout()
+end
+
+-- Hand the layout all lines at once. Lines whose text it already holds keep
+-- their line breaks.
+function EditBuffer:syncLayout()
+    if not self.layout then return end
+    textlayout_set_text(self.layout, table.concat(self.lines, '\n'))
+    if #self.lines == 1 and self.lines[1] == '' then
+        -- An empty string holds no paragraphs, but this is one empty line.
+        textlayout_insert_paragraph(self.layout, 1, '')
+    end
+end
+
+function EditBuffer:layoutSet(i)
+    if self.layout then textlayout_set_paragraph(self.layout, i, self.lines[i]) end
+end
+
+function EditBuffer:layoutInsert(i)
+    if self.layout then textlayout_insert_paragraph(self.layout, i, self.lines[i]) end
+end
+
+function EditBuffer:layoutErase(i)
+    if self.layout then textlayout_erase_paragraph(self.layout, i) end
 end
 
 -- Add a character into the edit buffer at the current cursor position.
@@ -30,8 +62,10 @@ function EditBuffer:addChar(ch)
         local p2 = string.sub(line, c+1, string.len(line))
         self.lines[self.curline] = p1..ch..p2
         self.curcol = c + 1
+        self:layoutSet(self.curline)
     else
         self.lines[self.curline] = ch
+        self:layoutInsert(self.curline)
     end
 end
 
@@ -44,6 +78,7 @@ function EditBuffer:onBackspace()
         local p1 = string.sub(line, 1, c-1)
         local p2 = string.sub(line, c+1, string.len(line))
         self.lines[self.curline] = p1..p2
+        self:layoutSet(self.curline)
         if #line > 0 then
             self.curcol = self.curcol - 1
         end
@@ -60,6 +95,8 @@ function EditBuffer:onBackspace()
                 self.lines[i-1] = self.lines[i]
             end
             self.lines[n] = nil
+            self:layoutSet(l-1)
+            self:layoutErase(l)
 
             self.curcol = #s1
             self.curline = self.curline-1
@@ -81,8 +118,11 @@ function EditBuffer:onEnter()
     local row = self.curline
     self.lines[row] = string.sub(line, 1, self.curcol)
 
+    self:layoutSet(row)
+
     row = row + 1
     self.lines[row] = string.sub(line, self.curcol+1, #line)
+    self:layoutInsert(row)
     self.curline = row
 
     self.curcol = 0
@@ -147,6 +187,7 @@ function EditBuffer:loadFromFile(filename)
     else
         print("file "..filename.." not found.")
     end
+    self:syncLayout()
 end
 
 function EditBuffer:saveToFile(filename)
@@ -174,18 +215,16 @@ end
 -- Load string into buffer
 function EditBuffer:loadFromString(contents)
     self.lines = {}
-    if not contents then return end
-    for _,line in pairs(split_into_lines(contents)) do
-        table.insert(self.lines, line)
+    if contents then
+        for _,line in pairs(split_into_lines(contents)) do
+            table.insert(self.lines, line)
+        end
     end
+    self:syncLayout()
 end
 
 function EditBuffer:saveToString()
-    local s = ''
-    local newline = '\n'
-    for k,line in pairs(self.lines) do
-        s = s..line
-        s = s..newline
-    end
-    return s
+    if #self.lines == 0 then return '' end
+    -- One concatenation instead of one per line, which is quadratic in file size
+    return table.concat(self.lines, '\n')..'\n'
 end
@@ -38,6 +38,7 @@ function GLFont:init(fontfile, imagefile)
     self.vao = 0
     self.prog = 0
     self.tex = 0
+    self.texShared = false
     self.vbos = {}
     self.string_vbo_table = {}
     self.dataDir = nil
@@ -104,10 +105,6 @@ function GLFont:initGL()
     gl.glEnableVertexAttribArray(vcol_loc)
     gl.glBindVertexArray(0)
 
-    local texId = ffi.new("GLuint[1]")
-    gl.glGenTextures(1, texId);
-    self.tex = texId[0]
-
     -- $ convert papyrus_512_0.png  -size 512x512 -depth 32 -channel RGBA gray:papyrus_512_0.raw
     local fontname, texname, tw, th, td, format = self.fontfile, self.imagefile, 512, 512, 4, GL.GL_RGBA
     self.tex_w = tw
@@ -116,6 +113,15 @@ function GLFont:initGL()
     if self.dataDir then texname = self.dataDir .. "/" .. texname end
 
     self.font = BMFont.new(fontname, nil)
+    if texture_acquire then
+        self.tex = texture_acquire(texname, tw, th, td, tonumber(GL.GL_LINEAR))
+        self.texShared = true
+        return
+    end
+
+    local texId = ffi.new("GLuint[1]")
+    gl.glGenTextures(1, texId);
+    self.tex = texId[0]
     local inp = io.open(texname, "rb")
     if inp then
         local data = inp:read("*all")
@@ -134,8 +140,12 @@ function GLFont:exitGL()
         gl.glDeleteBuffers(1,v)
     end
 
-    local texdel = ffi.new("GLuint[1]", self.tex)
-    gl.glDeleteTextures(1,texdel)
+    if self.texShared then
+        texture_release(self.tex)
+    else
+        local texdel = ffi.new("GLuint[1]", self.tex)
+        gl.glDeleteTextures(1,texdel)
+    end
 
     self.vbos = {}
     gl.glDeleteProgram(self.prog)
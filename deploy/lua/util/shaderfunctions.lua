@@ -58,7 +58,98 @@ function load_and_compile_shader_source(src, type)
     return s
 end
 
+-- Same layout as ProgramCacheMgr::AppendStage on the C++ side: the stage
+-- type in decimal, then the source, each NUL terminated.
+local function program_cache_key(sources)
+    local stages = {
+        {"vsrc", GL.GL_VERTEX_SHADER},
+        {"tcsrc", GL.GL_TESS_CONTROL_SHADER},
+        {"tesrc", GL.GL_TESS_EVALUATION_SHADER},
+        {"gsrc", GL.GL_GEOMETRY_SHADER},
+        {"fsrc", GL.GL_FRAGMENT_SHADER},
+        {"compsrc", GL.GL_COMPUTE_SHADER},
+    }
+    local parts = {}
+    for _,stage in ipairs(stages) do
+        local src = sources[stage[1]]
+        if type(src) == "string" then
+            table.insert(parts, tostring(tonumber(stage[2])).."\0"..src.."\0")
+        end
+    end
+    return table.concat(parts)
+end
+
+-- Returns a copy of sources with #includes resolved and sources.defines(a string
+-- like "USE_TEX;N=4", or a list of such strings) injected after each stage's
+-- #version line.
+local function preprocess_sources(sources)
+    local defines = sources.defines
+    if type(defines) == "table" then defines = table.concat(defines, ";") end
+    local out = {}
+    for k,v in pairs(sources) do
+        if type(v) == "string" and k ~= "defines" then
+            out[k] = shader_preprocess(v, defines)
+        else
+            out[k] = v
+        end
+    end
+    return out
+end
+
+-- True when the host fills the per-frame CameraBlock(shaders/camerablock.glsl)
+-- with the view and projection passed to render_for_one_eye. Programs from
+-- make_shader_from_source are then built with CAMERA_BLOCK defined, so a
+-- vertex shader can take prmtx from the block:
+--   #ifdef CAMERA_BLOCK
+--   #include "camerablock.glsl"
+--   #else
+--   uniform mat4 prmtx;
+--   #endif
+-- and its scene skips uploading prmtx when this returns true.
+-- The block holds the host's projection only. A program drawn with a
+-- projection of its own(a HUD, an FBO pass, a full-screen quad) must pass
+-- camera_block = false in its sources, which builds it without CAMERA_BLOCK,
+-- and always upload its prmtx.
+function shaderfunctions.camera_block_active()
+    return (shader_preprocess ~= nil) and (camera_block_bind ~= nil)
+end
+
+-- Returns sources with CAMERA_BLOCK added to its defines.
+local function add_camera_block_define(sources)
+    local out = {}
+    for k,v in pairs(sources) do out[k] = v end
+    local defines = sources.defines
+    if type(defines) == "table" then defines = table.concat(defines, ";") end
+    if type(defines) == "string" and defines ~= "" then
+        out.defines = defines..";CAMERA_BLOCK"
+    else
+        out.defines = "CAMERA_BLOCK"
+    end
+    return out
+end
+
 function shaderfunctions.make_shader_from_source(sources)
+    -- Includes and variant defines use the host app's preprocessor so they
+    -- match C++ shaders.
+    if shaderfunctions.camera_block_active() and (sources.camera_block ~= false) then
+        sources = add_camera_block_define(sources)
+    end
+    if shader_preprocess then
+        sources = preprocess_sources(sources)
+    end
+
+    -- The binary cache functions are registered by the host app, if it has one.
+    local cache_key = nil
+    local start_time = os.clock()
+    if program_cache_load then
+        cache_key = program_cache_key(sources)
+        local cached = program_cache_load(cache_key)
+        if cached ~= 0 then
+            if camera_block_bind then camera_block_bind(cached) end
+            return cached
+        end
+    end
+
     local program = gl.glCreateProgram()
 
     -- Deleted shaders, once attached, will be deleted when program is.
@@ -107,6 +198,13 @@ function shaderfunctions.make_shader_from_source(sources)
         return 0
     end
 
+    if cache_key then
+        program_cache_store(cache_key, program, os.clock() - start_time)
+    end
+
+    -- Programs declaring CameraBlock read the host's per-frame camera buffer.
+    if camera_block_bind then camera_block_bind(program) end
+
     gl.glUseProgram(0)
     return program
 end
@@ -1,10 +1,7 @@
 #version 310 es
 // basic.frag
 
-#ifdef GL_ES
-precision mediump float;
-precision mediump int;
-#endif
+#include "precision.glsl"
 
 in vec3 vfColor;
 out vec4 fragColor;
@@ -1,9 +1,6 @@
 #version 310 es
 
-#ifdef GL_ES
-precision mediump float;
-precision mediump int;
-#endif
+#include "precision.glsl"
 
 //uniform vec3 uColor;
 in float vfVertexIdx;
@@ -1,9 +1,6 @@
 #version 310 es
 
-#ifdef GL_ES
-precision mediump float;
-precision mediump int;
-#endif
+#include "precision.glsl"
 
 uniform mat4 mvmtx;
 uniform mat4 prmtx;
@@ -3,10 +3,7 @@
 // Apply a simple black and white checkerboard pattern to a quad
 // with texture coordinates in the unit interval.
 
-#ifdef GL_ES
-precision mediump float;
-precision mediump int;
-#endif
+#include "precision.glsl"
 
 in vec2 vfTexCoord;
 out vec4 fragColor;
@@ -1,10 +1,7 @@
 #version 310 es
 // basicplane.vert
 
-#ifdef GL_ES
-precision mediump float;
-precision mediump int;
-#endif
+#include "precision.glsl"
 
 in vec3 vPosition;
 in vec2 vTexCoord;
@@ -12,7 +9,11 @@ in vec2 vTexCoord;
 out vec2 vfTexCoord;
 
 uniform mat4 mvmtx;
+#ifdef CAMERA_BLOCK
+#include "camerablock.glsl"
+#else
 uniform mat4 prmtx;
+#endif
 
 void main()
 {
@@ -1,10 +1,7 @@
 #version 310 es
 // basictex.frag
 
-#ifdef GL_ES
-precision mediump float;
-precision mediump int;
-#endif
+#include "precision.glsl"
 
 uniform sampler2D s_texture;
 
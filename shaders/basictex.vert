@@ -1,10 +1,7 @@
 #version 310 es
 // basictex.vert
 
-#ifdef GL_ES
-precision mediump float;
-precision mediump int;
-#endif
+#include "precision.glsl"
 
 in vec2 vPosition;
 in vec2 vTexCoord;
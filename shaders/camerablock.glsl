@@ -0,0 +1,10 @@
+// camerablock.glsl
+// Camera data shared by all programs, filled once per frame by CameraUniformMgr.
+// The layout must match CameraBlockData.
+
+layout(std140) uniform CameraBlock
+{
+    mat4 viewmtx;
+    mat4 prmtx;
+    vec4 cameraTime; // x: absolute time in seconds, y: timestep
+};
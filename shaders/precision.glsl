@@ -0,0 +1,7 @@
+// precision.glsl
+// Default precision for the ES shaders; desktop GL ignores these.
+
+#ifdef GL_ES
+precision mediump float;
+precision mediump int;
+#endif
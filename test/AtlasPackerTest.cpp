@@ -0,0 +1,160 @@
+// AtlasPackerTest.cpp
+// AtlasPacker places every rectangle it accepts inside its page without
+// overlapping any other, for random streams of sizes, and fills exact tilings
+// of the page completely. Needs no GL context.
+
+#include "AtlasPacker.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+static int s_failures = 0;
+
+static void check(bool ok, const char* pWhat)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s\n", pWhat);
+        ++s_failures;
+    }
+}
+
+struct Rect
+{
+    unsigned int x;
+    unsigned int y;
+    unsigned int width;
+    unsigned int height;
+};
+
+static bool overlaps(const Rect& a, const Rect& b)
+{
+    return (a.x < b.x + b.width) && (b.x < a.x + a.width) &&
+           (a.y < b.y + b.height) && (b.y < a.y + a.height);
+}
+
+/// Insert into a packer and record where the rectangle went.
+static bool insert(AtlasPacker& packer, unsigned int width, unsigned int height, std::vector<Rect>& placed)
+{
+    Rect r = { 0, 0, width, height };
+    if (!packer.Insert(width, height, r.x, r.y))
+        return false;
+    placed.push_back(r);
+    return true;
+}
+
+/// Check the placed rectangles are inside the page, disjoint, and account for the used area.
+static void checkPlacement(const AtlasPacker& packer, const std::vector<Rect>& placed, const char* pWhat)
+{
+    bool inside = true;
+    bool disjoint = true;
+    unsigned long area = 0;
+    for (size_t i = 0; i < placed.size(); ++i)
+    {
+        const Rect& r = placed[i];
+        inside = inside && (r.x + r.width <= packer.GetWidth()) && (r.y + r.height <= packer.GetHeight());
+        for (size_t j = i + 1; j < placed.size(); ++j)
+            disjoint = disjoint && !overlaps(r, placed[j]);
+        area += static_cast<unsigned long>(r.width) * r.height;
+    }
+    if (!inside || !disjoint || (area != packer.GetUsedArea()))
+    {
+        printf("  %s: %u rectangles, inside %d, disjoint %d, area %lu of %lu\n", pWhat,
+            static_cast<unsigned int>(placed.size()), inside, disjoint, area, packer.GetUsedArea());
+    }
+    check(inside, "every rectangle is inside the page");
+    check(disjoint, "no two rectangles overlap");
+    check(area == packer.GetUsedArea(), "used area is the sum of the rectangles");
+}
+
+/// Random sizes, inserted until a run of them has been refused.
+static void testRandom()
+{
+    srand(23);
+    float worstOccupancy = 1.f;
+    for (int page = 0; page < 200; ++page)
+    {
+        const unsigned int width = 64 + rand() % 448;
+        const unsigned int height = 64 + rand() % 448;
+        const unsigned int largest = 8 + rand() % 96;
+        AtlasPacker packer(width, height);
+        std::vector<Rect> placed;
+        int refused = 0;
+        while (refused < 50)
+        {
+            const unsigned int w = 1 + rand() % largest;
+            const unsigned int h = 1 + rand() % largest;
+            if (!insert(packer, w, h, placed))
+                ++refused;
+        }
+        checkPlacement(packer, placed, "random sizes");
+        if (packer.GetOccupancy() < worstOccupancy)
+            worstOccupancy = packer.GetOccupancy();
+    }
+    printf("AtlasPacker worst occupancy over random pages: %.2f\n", worstOccupancy);
+    check(worstOccupancy > .5f, "random pages are more than half filled");
+}
+
+/// Sizes that tile the page exactly must all fit.
+static void testExactFit()
+{
+    AtlasPacker packer(256, 128);
+    std::vector<Rect> placed;
+    bool all = true;
+    for (int i = 0; i < 8; ++i)
+        all = insert(packer, 64, 64, placed) && all;
+    check(all, "eight 64 px squares fill a 256 x 128 page");
+    check(packer.GetOccupancy() == 1.f, "a tiled page is fully occupied");
+    check(!insert(packer, 1, 1, placed), "a full page refuses more");
+    checkPlacement(packer, placed, "64 px squares");
+
+    // Rows of mixed widths, each as wide as the page, stack flat on each other.
+    packer.Reset();
+    placed.clear();
+    check(packer.GetUsedArea() == 0, "Reset empties the page");
+    const unsigned int widths[] = { 100, 60, 96, 128, 128, 1, 255 };
+    const unsigned int rowHeights[] = { 32, 32, 32, 64, 64, 32, 32 };
+    all = true;
+    for (size_t i = 0; i < sizeof(widths) / sizeof(widths[0]); ++i)
+        all = insert(packer, widths[i], rowHeights[i], placed) && all;
+    check(all, "rows as wide as the page fit on top of each other");
+    check(packer.GetOccupancy() == 1.f, "rows fill the page");
+    checkPlacement(packer, placed, "mixed rows");
+}
+
+static void testLimits()
+{
+    AtlasPacker packer(100, 50);
+    std::vector<Rect> placed;
+    check(!insert(packer, 0, 10, placed), "zero width is refused");
+    check(!insert(packer, 10, 0, placed), "zero height is refused");
+    check(!insert(packer, 101, 10, placed), "wider than the page is refused");
+    check(!insert(packer, 10, 51, placed), "taller than the page is refused");
+    check(insert(packer, 100, 50, placed), "a page-sized rectangle fits an empty page");
+    check(!insert(packer, 1, 1, placed), "nothing fits beside a page-sized rectangle");
+    checkPlacement(packer, placed, "limits");
+
+    // A tall narrow one then a wide one: the wide one goes beside it only if it fits.
+    packer.Reset();
+    placed.clear();
+    check(insert(packer, 10, 50, placed), "a full-height strip fits");
+    check(insert(packer, 90, 25, placed), "the rest of the width fits beside it");
+    check(!insert(packer, 91, 1, placed), "wider than the space left is refused");
+    check(insert(packer, 90, 25, placed), "the space above fits exactly");
+    checkPlacement(packer, placed, "strips");
+}
+
+int main()
+{
+    testRandom();
+    testExactFit();
+    testLimits();
+    if (s_failures > 0)
+    {
+        printf("%d checks failed.\n", s_failures);
+        return 1;
+    }
+    printf("All atlas packer checks passed.\n");
+    return 0;
+}
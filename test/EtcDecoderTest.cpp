@@ -0,0 +1,512 @@
+// EtcDecoderTest.cpp
+// DecodeEtcImage against texels worked out by hand from the block layouts in
+// appendix C of the OpenGL ES 3.0 specification: ETC1 individual and
+// differential blocks, the ETC2 T, H and planar modes, punch-through alpha, and
+// the EAC alpha and R11 blocks. Blocks are built field by field here so each
+// case states the values it encodes.
+
+#include "EtcDecoder.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+static int s_failures = 0;
+
+static void check(bool ok, const char* pWhat)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s\n", pWhat);
+        ++s_failures;
+    }
+}
+
+/// A 64 bit block, numbered as in the specification: bit 63 is the top bit of
+/// the first byte.
+class BlockWord
+{
+public:
+    BlockWord() : m_word(0) {}
+
+    void Set(int high, int low, unsigned int value)
+    {
+        const unsigned long long mask = ((1ull << (high - low + 1)) - 1) << low;
+        m_word = (m_word & ~mask) | ((static_cast<unsigned long long>(value) << low) & mask);
+    }
+
+    unsigned int Get(int high, int low) const
+    {
+        return static_cast<unsigned int>((m_word >> low) & ((1ull << (high - low + 1)) - 1));
+    }
+
+    void Write(unsigned char* p) const
+    {
+        for (int i=0; i<8; ++i)
+            p[i] = static_cast<unsigned char>(m_word >> (56 - 8*i));
+    }
+
+protected:
+    unsigned long long m_word;
+};
+
+/// Color blocks hold a 2 bit index per pixel, its high bit in the upper half
+/// word; pixels are numbered down the columns.
+static void setColorIndex(BlockWord& block, int x, int y, unsigned int index)
+{
+    const int j = x*4 + y;
+    block.Set(j + 16, j + 16, index >> 1);
+    block.Set(j, j, index & 1);
+}
+
+/// EAC blocks hold a 3 bit index per pixel from bit 47 down, numbered down the columns.
+static void setEacIndex(BlockWord& block, int x, int y, unsigned int index)
+{
+    const int j = x*4 + y;
+    block.Set(47 - 3*j, 45 - 3*j, index);
+}
+
+/// Whether a differential base color channel plus its 3 bit signed delta leaves 0..31.
+static bool overflows(const BlockWord& block, int baseHigh)
+{
+    int delta = static_cast<int>(block.Get(baseHigh - 5, baseHigh - 7));
+    if (delta & 4)
+        delta -= 8;
+    const int sum = static_cast<int>(block.Get(baseHigh, baseHigh - 4)) + delta;
+    return (sum < 0) || (sum > 31);
+}
+
+enum EtcMode { ModeT, ModeH, ModePlanar };
+
+static bool selectsMode(const BlockWord& block, EtcMode mode)
+{
+    const bool r = overflows(block, 63);
+    const bool g = overflows(block, 55);
+    const bool b = overflows(block, 47);
+    switch (mode)
+    {
+    case ModeT: return r;
+    case ModeH: return !r && g;
+    default:    return !r && !g && b;
+    }
+}
+
+/// The T, H and planar modes are chosen by a channel overflowing in the
+/// differential layout. Try the bits the mode leaves unused until it is chosen,
+/// as an encoder does.
+static void chooseFreeBits(BlockWord& block, const int* pFreeBits, int count, EtcMode mode)
+{
+    for (unsigned int combo=0; combo < (1u << count); ++combo)
+    {
+        for (int i=0; i<count; ++i)
+            block.Set(pFreeBits[i], pFreeBits[i], (combo >> i) & 1);
+        if (selectsMode(block, mode))
+            return;
+    }
+    check(false, "block fields leave no way to select the mode");
+}
+
+static bool decode(GLenum format, const unsigned char* pData, size_t bytes, unsigned int w, unsigned int h,
+    std::vector<unsigned char>& pixels, GLenum& pixelFormat)
+{
+    GLenum pixelInternalFormat = 0;
+    return DecodeEtcImage(format, pData, bytes, w, h, pixels, pixelFormat, pixelInternalFormat);
+}
+
+/// Compare decoded pixels with the expected ones, printing the first that differs.
+static void checkPixels(const std::vector<unsigned char>& pixels, const unsigned char* pExpected,
+    unsigned int width, unsigned int channels, const char* pWhat)
+{
+    for (size_t i=0; i<pixels.size(); ++i)
+    {
+        if (pixels[i] != pExpected[i])
+        {
+            const size_t pixel = i / channels;
+            printf("  %s: pixel (%u,%u) channel %u is %d, expected %d\n", pWhat,
+                static_cast<unsigned int>(pixel % width), static_cast<unsigned int>(pixel / width),
+                static_cast<unsigned int>(i % channels), pixels[i], pExpected[i]);
+            check(false, pWhat);
+            return;
+        }
+    }
+}
+
+/// Decode one 4x4 color block as RGB8_ETC2 and compare it with 16 RGB pixels.
+static void checkRgbBlock(const BlockWord& block, const unsigned char expected[48], const char* pWhat)
+{
+    unsigned char data[8];
+    block.Write(data);
+    std::vector<unsigned char> pixels;
+    GLenum pixelFormat = 0;
+    check(decode(GL_COMPRESSED_RGB8_ETC2, data, 8, 4, 4, pixels, pixelFormat), pWhat);
+    check((pixelFormat == GL_RGB) && (pixels.size() == 48), "RGB8_ETC2 decodes to RGB");
+    if (pixels.size() == 48)
+        checkPixels(pixels, expected, 4, 3, pWhat);
+}
+
+/// The 4 bit colors and distance index of a T or H mode block, with pixel
+/// indices (x+y)&3, and the paint colors they should decode to.
+static void checkPaintBlock(const BlockWord& block, const unsigned char paint[4][3], const char* pWhat)
+{
+    unsigned char expected[48];
+    for (int y=0; y<4; ++y)
+    {
+        for (int x=0; x<4; ++x)
+            memcpy(&expected[(y*4 + x)*3], paint[(x + y) & 3], 3);
+    }
+    checkRgbBlock(block, expected, pWhat);
+}
+
+/// ETC1 individual mode: two 4 bit base colors, left and right halves.
+static void testIndividual()
+{
+    BlockWord block;
+    block.Set(63, 60, 0x8); block.Set(59, 56, 0x1); // R1, R2
+    block.Set(55, 52, 0x4); block.Set(51, 48, 0x2); // G1, G2
+    block.Set(47, 44, 0x2); block.Set(43, 40, 0x3); // B1, B2
+    block.Set(39, 37, 0);   block.Set(36, 34, 7);   // tables {2,8} and {47,183}
+    block.Set(33, 33, 0);   block.Set(32, 32, 0);   // individual, not flipped
+    for (int y=0; y<4; ++y)
+    {
+        for (int x=0; x<4; ++x)
+            setColorIndex(block, x, y, y);
+    }
+
+    // Bases (136,68,34) and (17,34,51); index y gives +small, +large, -small, -large.
+    const unsigned char expected[48] = {
+        138,  70,  36, 138,  70,  36,  64,  81,  98,  64,  81,  98,
+        144,  76,  42, 144,  76,  42, 200, 217, 234, 200, 217, 234,
+        134,  66,  32, 134,  66,  32,   0,   0,   4,   0,   0,   4,
+        128,  60,  26, 128,  60,  26,   0,   0,   0,   0,   0,   0,
+    };
+    checkRgbBlock(block, expected, "individual mode block");
+}
+
+/// ETC1 differential mode: a 5 bit base and a signed delta, top and bottom halves.
+static BlockWord makeDifferentialBlock(int table1, int table2, int dR, int dG)
+{
+    BlockWord block;
+    block.Set(63, 59, 20); block.Set(58, 56, static_cast<unsigned int>(dR) & 7);
+    block.Set(55, 51, 10); block.Set(50, 48, static_cast<unsigned int>(dG) & 7);
+    block.Set(47, 43, 5);  block.Set(42, 40, 0);
+    block.Set(39, 37, table1); block.Set(36, 34, table2);
+    block.Set(33, 33, 1);
+    return block;
+}
+
+static void testDifferential()
+{
+    BlockWord block = makeDifferentialBlock(2, 4, -3, 2);
+    block.Set(32, 32, 1); // flipped
+    for (int y=0; y<4; ++y)
+    {
+        for (int x=0; x<4; ++x)
+            setColorIndex(block, x, y, x);
+    }
+
+    // Bases (165,82,41) and (140,99,41), tables {9,29} and {18,60}; index x.
+    const unsigned char expected[48] = {
+        174,  91,  50, 194, 111,  70, 156,  73,  32, 136,  53,  12,
+        174,  91,  50, 194, 111,  70, 156,  73,  32, 136,  53,  12,
+        158, 117,  59, 200, 159, 101, 122,  81,  23,  80,  39,   0,
+        158, 117,  59, 200, 159, 101, 122,  81,  23,  80,  39,   0,
+    };
+    checkRgbBlock(block, expected, "differential mode block");
+}
+
+static BlockWord makeTBlock()
+{
+    BlockWord block;
+    block.Set(60, 59, 0xA >> 2); block.Set(57, 56, 0xA & 3); // C1 = (A,5,0)
+    block.Set(55, 52, 0x5);      block.Set(51, 48, 0x0);
+    block.Set(47, 44, 0x3);      block.Set(43, 40, 0x8);     // C2 = (3,8,C)
+    block.Set(39, 36, 0xC);
+    block.Set(35, 34, 2);        block.Set(32, 32, 1);       // distance index 5: 32
+    block.Set(33, 33, 1);
+    const int freeBits[] = { 63, 62, 61, 58 };
+    chooseFreeBits(block, freeBits, 4, ModeT);
+    for (int y=0; y<4; ++y)
+    {
+        for (int x=0; x<4; ++x)
+            setColorIndex(block, x, y, (x + y) & 3);
+    }
+    return block;
+}
+
+/// ETC2 T mode: C1, then C2 + d, C2, C2 - d.
+static void testTMode()
+{
+    const unsigned char paint[4][3] = {
+        { 170,  85,   0 },
+        {  83, 168, 236 },
+        {  51, 136, 204 },
+        {  19, 104, 172 },
+    };
+    checkPaintBlock(makeTBlock(), paint, "T mode block");
+}
+
+/// H mode colors C1 and C2 in 4 bits, distance index high bits 2.
+static BlockWord makeHBlock(const unsigned int c1[3], const unsigned int c2[3])
+{
+    BlockWord block;
+    block.Set(62, 59, c1[0]);
+    block.Set(58, 56, c1[1] >> 1); block.Set(52, 52, c1[1] & 1);
+    block.Set(51, 51, c1[2] >> 3); block.Set(49, 47, c1[2] & 7);
+    block.Set(46, 43, c2[0]);
+    block.Set(42, 39, c2[1]);
+    block.Set(38, 35, c2[2]);
+    block.Set(34, 34, 1); block.Set(32, 32, 0);
+    block.Set(33, 33, 1);
+    const int freeBits[] = { 63, 55, 54, 53, 50 };
+    chooseFreeBits(block, freeBits, 5, ModeH);
+    for (int y=0; y<4; ++y)
+    {
+        for (int x=0; x<4; ++x)
+            setColorIndex(block, x, y, (x + y) & 3);
+    }
+    return block;
+}
+
+/// ETC2 H mode: C1 + d, C1 - d, C2 + d, C2 - d, where the low bit of the
+/// distance index is whether C1 >= C2.
+static void testHMode()
+{
+    const unsigned int a[3] = { 0x2, 0x9, 0x6 }; // (34,153,102)
+    const unsigned int b[3] = { 0x7, 0x1, 0xE }; // (119,17,238)
+
+    // a < b: distance index 4, 23
+    const unsigned char paintAB[4][3] = {
+        {  57, 176, 125 },
+        {  11, 130,  79 },
+        { 142,  40, 255 },
+        {  96,   0, 215 },
+    };
+    checkPaintBlock(makeHBlock(a, b), paintAB, "H mode block with C1 < C2");
+
+    // b >= a: distance index 5, 32
+    const unsigned char paintBA[4][3] = {
+        { 151,  49, 255 },
+        {  87,   0, 206 },
+        {  66, 185, 134 },
+        {   2, 121,  70 },
+    };
+    checkPaintBlock(makeHBlock(b, a), paintBA, "H mode block with C1 >= C2");
+}
+
+/// ETC2 planar mode: colors at the origin, right and bottom, interpolated.
+static void testPlanarMode()
+{
+    BlockWord block;
+    block.Set(62, 57, 32);                                               // RO
+    block.Set(56, 56, 64 >> 6); block.Set(54, 49, 64 & 0x3f);           // GO
+    block.Set(48, 48, 16 >> 5); block.Set(44, 43, (16 >> 3) & 3); block.Set(41, 39, 16 & 7); // BO
+    block.Set(38, 34, 63 >> 1); block.Set(32, 32, 63 & 1);               // RH
+    block.Set(31, 25, 0);                                                // GH
+    block.Set(24, 19, 16);                                               // BH
+    block.Set(18, 13, 0);                                                // RV
+    block.Set(12, 6, 127);                                               // GV
+    block.Set(5, 0, 48);                                                 // BV
+    block.Set(33, 33, 1);
+    const int freeBits[] = { 63, 55, 47, 46, 45, 42 };
+    chooseFreeBits(block, freeBits, 6, ModePlanar);
+
+    // O = (130,129,65), H = (255,0,65), V = (0,255,195)
+    const unsigned char expected[48] = {
+        130, 129,  65, 161,  97,  65, 193,  65,  65, 224,  32,  65,
+         98, 161,  98, 129, 128,  98, 160,  96,  98, 191,  64,  98,
+         65, 192, 130,  96, 160, 130, 128, 128, 130, 159,  95, 130,
+         33, 224, 163,  64, 191, 163,  95, 159, 163, 126, 127, 163,
+    };
+    checkRgbBlock(block, expected, "planar mode block");
+}
+
+/// RGB8_PUNCHTHROUGH_ALPHA1: with the opaque bit clear, index 2 is transparent
+/// black and, outside the T, H and planar modes, index 0 has no modifier.
+static void testPunchthrough()
+{
+    BlockWord block = makeDifferentialBlock(1, 1, 0, 0);
+    for (int y=0; y<4; ++y)
+    {
+        for (int x=0; x<4; ++x)
+            setColorIndex(block, x, y, y);
+    }
+    unsigned char data[8];
+    std::vector<unsigned char> pixels;
+    GLenum pixelFormat = 0;
+
+    // Base (165,82,41), table {5,17}
+    const unsigned char opaqueRows[4][4] = {
+        { 170, 87, 46, 255 }, { 182, 99, 58, 255 }, { 160, 77, 36, 255 }, { 148, 65, 24, 255 } };
+    const unsigned char clearRows[4][4] = {
+        { 165, 82, 41, 255 }, { 182, 99, 58, 255 }, {   0,  0,  0,   0 }, { 148, 65, 24, 255 } };
+    for (int opaque=0; opaque<2; ++opaque)
+    {
+        block.Set(33, 33, opaque);
+        block.Write(data);
+        check(decode(GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2, data, 8, 4, 4, pixels, pixelFormat),
+            "decode punch-through block");
+        check(pixelFormat == GL_RGBA, "punch-through decodes to RGBA");
+        unsigned char expected[64];
+        for (int i=0; i<16; ++i)
+            memcpy(&expected[i*4], opaque ? opaqueRows[i / 4] : clearRows[i / 4], 4);
+        if (pixels.size() == 64)
+            checkPixels(pixels, expected, 4, 4, opaque ? "opaque punch-through block" : "punch-through block");
+    }
+
+    // In T mode only index 2 becomes transparent.
+    BlockWord tBlock = makeTBlock();
+    tBlock.Set(33, 33, 0);
+    tBlock.Write(data);
+    check(decode(GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2, data, 8, 4, 4, pixels, pixelFormat),
+        "decode punch-through T block");
+    const unsigned char paint[4][4] = {
+        { 170, 85, 0, 255 }, { 83, 168, 236, 255 }, { 0, 0, 0, 0 }, { 19, 104, 172, 255 } };
+    unsigned char expected[64];
+    for (int y=0; y<4; ++y)
+    {
+        for (int x=0; x<4; ++x)
+            memcpy(&expected[(y*4 + x)*4], paint[(x + y) & 3], 4);
+    }
+    if (pixels.size() == 64)
+        checkPixels(pixels, expected, 4, 4, "punch-through T mode block");
+}
+
+static BlockWord makeEacBlock(unsigned int base, unsigned int multiplier, unsigned int table)
+{
+    BlockWord block;
+    block.Set(63, 56, base);
+    block.Set(55, 52, multiplier);
+    block.Set(51, 48, table);
+    for (int y=0; y<4; ++y)
+    {
+        for (int x=0; x<4; ++x)
+            setEacIndex(block, x, y, (x*4 + y) & 7);
+    }
+    return block;
+}
+
+/// Index (x*4+y)&7 gives the 8 values of the block in each pair of columns.
+static void checkEacBlock(GLenum format, const BlockWord& block, const int values[8], const char* pWhat)
+{
+    unsigned char data[8];
+    block.Write(data);
+    std::vector<unsigned char> pixels;
+    GLenum pixelFormat = 0;
+    check(decode(format, data, 8, 4, 4, pixels, pixelFormat), pWhat);
+    check(pixelFormat == GL_RED, "R11 EAC decodes to one channel");
+    unsigned char expected[16];
+    for (int y=0; y<4; ++y)
+    {
+        for (int x=0; x<4; ++x)
+            expected[y*4 + x] = static_cast<unsigned char>(values[(x*4 + y) & 7] & 0xff);
+    }
+    if (pixels.size() == 16)
+        checkPixels(pixels, expected, 4, 1, pWhat);
+}
+
+/// R11 values are base*8 + 4 + modifier*multiplier*8, clamped to 11 bits, and
+/// decode to their top 8 bits. Signed values are scaled to -127..127.
+static void testR11()
+{
+    // Table 13 {-1,-2,-3,-10,0,1,2,9}: 804 + 24*modifier
+    const int plain[8] = { 97, 94, 91, 70, 100, 103, 106, 127 };
+    checkEacBlock(GL_COMPRESSED_R11_EAC, makeEacBlock(100, 3, 13), plain, "R11 EAC block");
+
+    // Table 0 {-3,-6,-9,-15,2,5,8,14} at 2044 + 120*modifier, clamped to 0..2047.
+    const int clamped[8] = { 210, 165, 120, 30, 255, 255, 255, 255 };
+    checkEacBlock(GL_COMPRESSED_R11_EAC, makeEacBlock(255, 15, 0), clamped, "clamped R11 EAC block");
+
+    // A zero multiplier adds the modifier unscaled: 84 + modifier.
+    const int unscaled[8] = { 10, 9, 9, 8, 10, 11, 11, 12 };
+    checkEacBlock(GL_COMPRESSED_R11_EAC, makeEacBlock(10, 0, 0), unscaled, "R11 EAC block with multiplier 0");
+
+    // Signed: base -128 reads as -127, -1016 + 8*modifier clamped to -1023,
+    // scaled by 127/1023 toward zero.
+    const int negative[8] = { -127, -127, -127, -127, -126, -125, -124, -117 };
+    checkEacBlock(GL_COMPRESSED_SIGNED_R11_EAC, makeEacBlock(0x80, 1, 13), negative, "signed R11 EAC block");
+}
+
+/// RGBA8_ETC2_EAC: an EAC alpha block, base + modifier*multiplier, then a color block.
+static void testRgbaAlpha()
+{
+    const BlockWord alpha = makeEacBlock(200, 2, 0);
+    BlockWord color = makeDifferentialBlock(1, 1, 0, 0);
+    for (int y=0; y<4; ++y)
+    {
+        for (int x=0; x<4; ++x)
+            setColorIndex(color, x, y, 1);
+    }
+    unsigned char data[16];
+    alpha.Write(data);
+    color.Write(data + 8);
+    std::vector<unsigned char> pixels;
+    GLenum pixelFormat = 0;
+    check(decode(GL_COMPRESSED_RGBA8_ETC2_EAC, data, 16, 4, 4, pixels, pixelFormat), "decode RGBA8 block");
+    check(pixelFormat == GL_RGBA, "RGBA8_ETC2_EAC decodes to RGBA");
+    const int alphas[8] = { 194, 188, 182, 170, 204, 210, 216, 228 };
+    unsigned char expected[64];
+    for (int y=0; y<4; ++y)
+    {
+        for (int x=0; x<4; ++x)
+        {
+            unsigned char* p = &expected[(y*4 + x)*4];
+            p[0] = 182; p[1] = 99; p[2] = 58;
+            p[3] = static_cast<unsigned char>(alphas[(x*4 + y) & 7]);
+        }
+    }
+    if (pixels.size() == 64)
+        checkPixels(pixels, expected, 4, 4, "RGBA8 ETC2 EAC block");
+}
+
+/// A 6x5 image is 2x2 blocks in rows; pixels past the edge are dropped.
+static void testImageLayout()
+{
+    BlockWord blocks[4];
+    unsigned char data[32];
+    for (int i=0; i<4; ++i)
+    {
+        // Individual mode, solid 4 bit gray i*4+1, index 0 with table {2,8}: +2
+        const unsigned int gray = static_cast<unsigned int>(i*4 + 1);
+        blocks[i].Set(63, 60, gray); blocks[i].Set(59, 56, gray);
+        blocks[i].Set(55, 52, gray); blocks[i].Set(51, 48, gray);
+        blocks[i].Set(47, 44, gray); blocks[i].Set(43, 40, gray);
+        blocks[i].Write(data + 8*i);
+    }
+    std::vector<unsigned char> pixels;
+    GLenum pixelFormat = 0;
+    check(!decode(GL_COMPRESSED_RGB8_ETC2, data, 31, 6, 5, pixels, pixelFormat), "short data is rejected");
+    check(!decode(GL_RGB8, data, 32, 6, 5, pixels, pixelFormat), "uncompressed format is rejected");
+    check(decode(GL_COMPRESSED_RGB8_ETC2, data, 32, 6, 5, pixels, pixelFormat), "decode 6x5 image");
+    bool placed = (pixels.size() == 6*5*3);
+    for (unsigned int y=0; placed && (y<5); ++y)
+    {
+        for (unsigned int x=0; x<6; ++x)
+        {
+            const int blockIdx = static_cast<int>((y / 4) * 2 + (x / 4));
+            const int value = (blockIdx*4 + 1) * 17 + 2;
+            if (pixels[(y*6 + x)*3] != value)
+                placed = false;
+        }
+    }
+    check(placed, "blocks are placed in rows and cropped to the image");
+}
+
+int main()
+{
+    testIndividual();
+    testDifferential();
+    testTMode();
+    testHMode();
+    testPlanarMode();
+    testPunchthrough();
+    testR11();
+    testRgbaAlpha();
+    testImageLayout();
+    if (s_failures > 0)
+    {
+        printf("%d checks failed.\n", s_failures);
+        return 1;
+    }
+    printf("All ETC decoder checks passed.\n");
+    return 0;
+}
@@ -0,0 +1,108 @@
+// FontFileBench.cpp
+// Time reading the blocks of every BMFont .fnt file in deploy/fonts through
+// std::ifstream with a heap buffer per block, as FontRenderer used to, against
+// walking them in place in a MappedFile as it does now. Both read the same bytes.
+
+#include "MappedFile.h"
+#include "Timer.h"
+
+#include <stdio.h>
+#include <fstream>
+#include <string>
+
+static const char* s_fonts[] = {
+    "SegoeUI_10px",
+    "SegoeUI_13px",
+    "SegoeUI_18px",
+    "SegoeUI_24px",
+    "courier_512",
+    "papyrus_512",
+};
+static const size_t s_fontCount = sizeof(s_fonts) / sizeof(s_fonts[0]);
+static const int s_iterations = 2000;
+
+/// Each block is a 1 byte id and a 4 byte little-endian size after the 4 byte header.
+///@return Sum of the first byte of each block, so the reads cannot be skipped
+static unsigned int readWithStream(const std::string& filename)
+{
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+    char header[4];
+    file.read(header, 4);
+    unsigned int sum = 0;
+    while (file.good())
+    {
+        unsigned char blockHeader[5];
+        file.read(reinterpret_cast<char*>(blockHeader), 5);
+        if (!file.good())
+            break;
+        const unsigned int sz = blockHeader[1] | (blockHeader[2] << 8) | (blockHeader[3] << 16) | (blockHeader[4] << 24);
+        char* pBlock = new char[sz];
+        file.read(pBlock, sz);
+        if (file.good() && (sz > 0))
+            sum += static_cast<unsigned char>(pBlock[0]);
+        delete [] pBlock;
+    }
+    return sum;
+}
+
+static unsigned int readWithMapping(const std::string& filename)
+{
+    MappedFile file;
+    if (!file.Open(filename.c_str()))
+        return 0;
+    const unsigned char* pData = file.Data();
+    const size_t size = file.Size();
+    unsigned int sum = 0;
+    size_t offset = 4;
+    while (offset + 5 <= size)
+    {
+        const unsigned int sz = pData[offset+1] | (pData[offset+2] << 8) | (pData[offset+3] << 16) | (pData[offset+4] << 24);
+        offset += 5;
+        if (sz > size - offset)
+            break;
+        if (sz > 0)
+            sum += pData[offset];
+        offset += sz;
+    }
+    return sum;
+}
+
+int main()
+{
+    std::string filenames[s_fontCount];
+    for (size_t i = 0; i < s_fontCount; ++i)
+    {
+        filenames[i] = APP_DATA_DIRECTORY;
+        filenames[i] += "fonts/";
+        filenames[i] += s_fonts[i];
+        filenames[i] += ".fnt";
+    }
+
+    unsigned int streamSum = 0;
+    Timer timer;
+    for (int r = 0; r < s_iterations; ++r)
+    {
+        for (size_t i = 0; i < s_fontCount; ++i)
+            streamSum += readWithStream(filenames[i]);
+    }
+    const double streamTime = timer.seconds();
+
+    unsigned int mappedSum = 0;
+    timer.reset();
+    for (int r = 0; r < s_iterations; ++r)
+    {
+        for (size_t i = 0; i < s_fontCount; ++i)
+            mappedSum += readWithMapping(filenames[i]);
+    }
+    const double mappedTime = timer.seconds();
+
+    printf("%u .fnt files, %d times:\n", static_cast<unsigned int>(s_fontCount), s_iterations);
+    printf("  ifstream:   %6.1f us per set\n", 1.e6 * streamTime / s_iterations);
+    printf("  MappedFile: %6.1f us per set\n", 1.e6 * mappedTime / s_iterations);
+    if ((streamSum == 0) || (streamSum != mappedSum))
+    {
+        printf("FAIL: the two readers saw different bytes (%u, %u)\n", streamSum, mappedSum);
+        return 1;
+    }
+    return 0;
+}
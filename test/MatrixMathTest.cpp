@@ -0,0 +1,421 @@
+// MatrixMathTest.cpp
+// The SSE/NEON matrix kernels give bit for bit the results of the scalar ones,
+// InvertMatrix is accurate against a double precision reference, batched
+// TransformPoints gives bit for bit what transform gives point by point, and each
+// kernel is timed both ways. Without SIMD compiled in, both runs use the scalar kernels.
+
+#include "MatrixMath.h"
+#include "Timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+static int s_failures = 0;
+
+static void check(bool ok, const char* pWhat)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s\n", pWhat);
+        ++s_failures;
+    }
+}
+
+static float randomFloat()
+{
+    return 4.f * static_cast<float>(rand()) / static_cast<float>(RAND_MAX) - 2.f;
+}
+
+static void randomMatrix(float* pMtx)
+{
+    for (int i = 0; i < 16; ++i)
+        pMtx[i] = randomFloat();
+}
+
+static bool sameBits(const void* pA, const void* pB, size_t bytes)
+{
+    return memcmp(pA, pB, bytes) == 0;
+}
+
+/// Gauss-Jordan inverse with partial pivoting in double precision.
+///@return false if src is singular
+static bool invertReference(const float* src, double* dst)
+{
+    double a[4][8];
+    for (int r = 0; r < 4; ++r)
+    {
+        for (int c = 0; c < 4; ++c)
+        {
+            a[r][c] = src[c*4 + r];
+            a[r][4 + c] = (r == c) ? 1. : 0.;
+        }
+    }
+    for (int c = 0; c < 4; ++c)
+    {
+        int pivot = c;
+        for (int r = c + 1; r < 4; ++r)
+        {
+            if (fabs(a[r][c]) > fabs(a[pivot][c]))
+                pivot = r;
+        }
+        if (a[pivot][c] == 0.)
+            return false;
+        for (int k = 0; k < 8; ++k)
+        {
+            const double t = a[c][k];
+            a[c][k] = a[pivot][k];
+            a[pivot][k] = t;
+        }
+        const double d = a[c][c];
+        for (int k = 0; k < 8; ++k)
+            a[c][k] /= d;
+        for (int r = 0; r < 4; ++r)
+        {
+            if (r == c)
+                continue;
+            const double f = a[r][c];
+            for (int k = 0; k < 8; ++k)
+                a[r][k] -= f * a[c][k];
+        }
+    }
+    for (int r = 0; r < 4; ++r)
+    {
+        for (int c = 0; c < 4; ++c)
+            dst[c*4 + r] = a[r][4 + c];
+    }
+    return true;
+}
+
+/// Run each kernel on the same random inputs with SIMD on and off.
+static void testSimdMatchesScalar()
+{
+    srand(3);
+    bool multiply = true;
+    bool pre = true;
+    bool post = true;
+    bool point = true;
+    bool transpose = true;
+    bool inverse = true;
+    for (int it = 0; it < 20000; ++it)
+    {
+        float a[16];
+        float b[16];
+        randomMatrix(a);
+        randomMatrix(b);
+        float3 p;
+        p.x = randomFloat();
+        p.y = randomFloat();
+        p.z = randomFloat();
+
+        float simd[16];
+        float scalar[16];
+        SetMatrixSimdEnabled(true);
+        MultiplyMatrix(simd, a, b);
+        SetMatrixSimdEnabled(false);
+        MultiplyMatrix(scalar, a, b);
+        multiply = multiply && sameBits(simd, scalar, sizeof(simd));
+
+        memcpy(simd, a, sizeof(a));
+        memcpy(scalar, a, sizeof(a));
+        SetMatrixSimdEnabled(true);
+        preMultiply(simd, b);
+        SetMatrixSimdEnabled(false);
+        preMultiply(scalar, b);
+        pre = pre && sameBits(simd, scalar, sizeof(simd));
+
+        memcpy(simd, a, sizeof(a));
+        memcpy(scalar, a, sizeof(a));
+        SetMatrixSimdEnabled(true);
+        postMultiply(simd, b);
+        SetMatrixSimdEnabled(false);
+        postMultiply(scalar, b);
+        post = post && sameBits(simd, scalar, sizeof(simd));
+
+        SetMatrixSimdEnabled(true);
+        const float3 simdPoint = transform(p, a);
+        SetMatrixSimdEnabled(false);
+        const float3 scalarPoint = transform(p, a);
+        point = point && sameBits(&simdPoint, &scalarPoint, sizeof(float3));
+
+        SetMatrixSimdEnabled(true);
+        TransposeMatrix(simd, a);
+        SetMatrixSimdEnabled(false);
+        TransposeMatrix(scalar, a);
+        transpose = transpose && sameBits(simd, scalar, sizeof(simd)) && (simd[1] == a[4]) && (simd[14] == a[11]);
+
+        SetMatrixSimdEnabled(true);
+        const bool simdOk = InvertMatrix(simd, a);
+        SetMatrixSimdEnabled(false);
+        const bool scalarOk = InvertMatrix(scalar, a);
+        inverse = inverse && (simdOk == scalarOk) && (!simdOk || sameBits(simd, scalar, sizeof(simd)));
+    }
+    check(multiply, "SIMD MultiplyMatrix matches scalar");
+    check(pre, "SIMD preMultiply matches scalar");
+    check(post, "SIMD postMultiply matches scalar");
+    check(point, "SIMD transform matches scalar");
+    check(transpose, "SIMD TransposeMatrix matches scalar");
+    check(inverse, "SIMD InvertMatrix matches scalar");
+}
+
+/// Compare InvertMatrix against the double reference, relative to the inverse's
+/// largest element so ill-conditioned random matrices do not dominate.
+static void testInverseAccuracy()
+{
+    srand(7);
+    double worst = 0.;
+    for (int simdOn = 0; simdOn < 2; ++simdOn)
+    {
+        SetMatrixSimdEnabled(simdOn != 0);
+        for (int it = 0; it < 20000; ++it)
+        {
+            float a[16];
+            randomMatrix(a);
+            float inv[16];
+            double ref[16];
+            if (!invertReference(a, ref) || !InvertMatrix(inv, a))
+                continue;
+            double largest = 0.;
+            double err = 0.;
+            for (int i = 0; i < 16; ++i)
+            {
+                largest = fmax(largest, fabs(ref[i]));
+                err = fmax(err, fabs(ref[i] - inv[i]));
+            }
+            if (largest < 100.)
+                worst = fmax(worst, err / largest);
+        }
+    }
+    printf("InvertMatrix worst relative error: %.3g\n", worst);
+    check(worst < 1.e-4, "InvertMatrix agrees with the double reference");
+
+    float view[16];
+    MakeIdentityMatrix(view);
+    glhTranslate(view, .3f, -.2f, -5.f);
+    glhRotate(view, 30.f, 0.f, 1.f, 0.f);
+    float product[16];
+    InvertMatrix(product, view);
+    postMultiply(product, view);
+    bool identity = true;
+    for (int i = 0; i < 16; ++i)
+    {
+        const float expected = (i % 5 == 0) ? 1.f : 0.f;
+        if (fabsf(product[i] - expected) > 1.e-5f)
+            identity = false;
+    }
+    check(identity, "inverse of a view matrix times itself is the identity");
+
+    const float singular[16] = { 1,2,3,4, 2,4,6,8, 0,1,0,1, 1,0,0,1 };
+    float out[16];
+    for (int simdOn = 0; simdOn < 2; ++simdOn)
+    {
+        SetMatrixSimdEnabled(simdOn != 0);
+        check(!InvertMatrix(out, singular), "InvertMatrix rejects a singular matrix");
+    }
+}
+
+static const int s_iterations = 2000000;
+
+static void timeKernels()
+{
+    srand(11);
+    // A rotation keeps the repeated products from overflowing.
+    float m[16];
+    MakeIdentityMatrix(m);
+    glhRotate(m, 30.f, .48f, .6f, .64f);
+    for (int simdOn = 0; simdOn < 2; ++simdOn)
+    {
+        SetMatrixSimdEnabled(simdOn != 0);
+        float acc[16];
+        randomMatrix(acc);
+
+        Timer timer;
+        for (int i = 0; i < s_iterations; ++i)
+            postMultiply(acc, m);
+        const double multiplyTime = timer.seconds();
+
+        // Change the input each time so the inverse cannot be hoisted out of the loop.
+        float n[16];
+        memcpy(n, m, sizeof(m));
+        float inv[16];
+        timer.reset();
+        for (int i = 0; i < s_iterations; ++i)
+        {
+            InvertMatrix(inv, n);
+            n[0] += 1.e-7f;
+        }
+        const double inverseTime = timer.seconds();
+
+        float3 p;
+        p.x = 1.f;
+        p.y = 2.f;
+        p.z = 3.f;
+        float sum = 0.f;
+        timer.reset();
+        for (int i = 0; i < s_iterations; ++i)
+        {
+            p.x += 1.e-6f;
+            sum += transform(p, m).x;
+        }
+        const double transformTime = timer.seconds();
+
+        printf("%s: multiply %5.1f ns, inverse %5.1f ns, transform %5.1f ns (%g %g %g)\n",
+            simdOn ? "SIMD  " : "scalar",
+            1.e9 * multiplyTime / s_iterations,
+            1.e9 * inverseTime / s_iterations,
+            1.e9 * transformTime / s_iterations,
+            acc[0], inv[0], sum);
+    }
+}
+
+/// Affine view and projective view-projection matrices, which TransformPoints
+/// handles by different paths.
+static void makeTestMatrices(float* pAffine, float* pProjective)
+{
+    MakeIdentityMatrix(pAffine);
+    glhTranslate(pAffine, .3f, -.2f, -5.f);
+    glhRotate(pAffine, 30.f, 0.f, 1.f, 0.f);
+    glhPerspectivef2(pProjective, 60.f, 1.5f, .1f, 100.f);
+    postMultiply(pProjective, pAffine);
+}
+
+/// Both layouts of TransformPoints against transform, for counts around the SIMD
+/// width and one large enough to be split across threads, also in place. The
+/// element past the end must be left alone.
+static void testTransformPoints()
+{
+    srand(5);
+    float affine[16];
+    float projective[16];
+    makeTestMatrices(affine, projective);
+    const size_t counts[] = { 0, 1, 2, 3, 4, 5, 7, 8, 13, 100, 70001 };
+    const size_t numCounts = sizeof(counts) / sizeof(counts[0]);
+    const float3 sentinel = { 123.f, 456.f, 789.f };
+
+    bool packed = true;
+    bool separate = true;
+    bool inPlace = true;
+    bool bounds = true;
+    for (int m = 0; m < 2; ++m)
+    {
+        const float* mtx = m ? projective : affine;
+        for (int simdOn = 0; simdOn < 2; ++simdOn)
+        {
+            SetMatrixSimdEnabled(simdOn != 0);
+            for (size_t c = 0; c < numCounts; ++c)
+            {
+                for (int threads = 1; threads <= 4; threads += 3)
+                {
+                    const size_t n = counts[c];
+                    std::vector<float3> in(n + 1);
+                    std::vector<float3> out(n + 1);
+                    std::vector<float> x(n + 1), y(n + 1), z(n + 1);
+                    std::vector<float> outX(n + 1), outY(n + 1), outZ(n + 1);
+                    for (size_t i = 0; i < n; ++i)
+                    {
+                        in[i].x = x[i] = randomFloat();
+                        in[i].y = y[i] = randomFloat();
+                        in[i].z = z[i] = randomFloat();
+                    }
+                    out[n] = sentinel;
+                    outX[n] = sentinel.x;
+
+                    TransformPoints(&out[0], &in[0], n, mtx, threads);
+                    TransformPoints(&outX[0], &outY[0], &outZ[0], &x[0], &y[0], &z[0], n, mtx, threads);
+                    std::vector<float3> same(in);
+                    TransformPoints(&same[0], &same[0], n, mtx, threads);
+
+                    for (size_t i = 0; i < n; ++i)
+                    {
+                        const float3 expected = transform(in[i], mtx);
+                        packed = packed && sameBits(&expected, &out[i], sizeof(float3));
+                        separate = separate && (expected.x == outX[i]) && (expected.y == outY[i]) && (expected.z == outZ[i]);
+                        inPlace = inPlace && sameBits(&expected, &same[i], sizeof(float3));
+                    }
+                    bounds = bounds && sameBits(&out[n], &sentinel, sizeof(float3)) && (outX[n] == sentinel.x);
+                }
+            }
+        }
+    }
+    check(packed, "packed TransformPoints matches transform");
+    check(separate, "separate x, y, z TransformPoints matches transform");
+    check(inPlace, "TransformPoints in place matches transform");
+    check(bounds, "TransformPoints writes only count points");
+}
+
+static void timeTransformPoints()
+{
+    srand(13);
+    float affine[16];
+    float projective[16];
+    makeTestMatrices(affine, projective);
+    const size_t n = 1 << 20;
+    const int repeats = 4;
+    std::vector<float3> in(n), out(n);
+    std::vector<float> x(n), y(n), z(n), outX(n), outY(n), outZ(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        in[i].x = x[i] = randomFloat();
+        in[i].y = y[i] = randomFloat();
+        in[i].z = z[i] = randomFloat();
+    }
+
+    for (int m = 0; m < 2; ++m)
+    {
+        const float* mtx = m ? projective : affine;
+        for (int simdOn = 0; simdOn < 2; ++simdOn)
+        {
+            SetMatrixSimdEnabled(simdOn != 0);
+            Timer timer;
+            for (int r = 0; r < repeats; ++r)
+            {
+                for (size_t i = 0; i < n; ++i)
+                    out[i] = transform(in[i], mtx);
+            }
+            const double pointTime = timer.seconds();
+
+            timer.reset();
+            for (int r = 0; r < repeats; ++r)
+                TransformPoints(&out[0], &in[0], n, mtx);
+            const double packedTime = timer.seconds();
+
+            timer.reset();
+            for (int r = 0; r < repeats; ++r)
+                TransformPoints(&outX[0], &outY[0], &outZ[0], &x[0], &y[0], &z[0], n, mtx);
+            const double separateTime = timer.seconds();
+
+            timer.reset();
+            for (int r = 0; r < repeats; ++r)
+                TransformPoints(&outX[0], &outY[0], &outZ[0], &x[0], &y[0], &z[0], n, mtx, 4);
+            const double threadedTime = timer.seconds();
+
+            const double perPoint = 1.e9 / (static_cast<double>(n) * repeats);
+            printf("%s %s: transform %5.2f ns, packed %5.2f ns, separate %5.2f ns, 4 threads %5.2f ns per point\n",
+                m ? "projective" : "affine    ",
+                simdOn ? "SIMD  " : "scalar",
+                pointTime * perPoint,
+                packedTime * perPoint,
+                separateTime * perPoint,
+                threadedTime * perPoint);
+        }
+    }
+}
+
+int main()
+{
+    testSimdMatchesScalar();
+    testInverseAccuracy();
+    testTransformPoints();
+    timeKernels();
+    timeTransformPoints();
+    SetMatrixSimdEnabled(true);
+    if (s_failures > 0)
+    {
+        printf("%d checks failed.\n", s_failures);
+        return 1;
+    }
+    printf("All matrix checks passed.\n");
+    return 0;
+}
@@ -0,0 +1,224 @@
+// MatrixStackTest.cpp
+// MatrixStack builds the same matrices as the glh* functions applied to a plain
+// array for the same sequence of calls, including its in-place rotations about a
+// coordinate axis, and its cached inverse and normal matrix agree with InvertMatrix.
+
+#include "MatrixStack.h"
+#include "MatrixMath.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+static int s_failures = 0;
+
+static void check(bool ok, const char* pWhat)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s\n", pWhat);
+        ++s_failures;
+    }
+}
+
+static float randomFloat(float lo, float hi)
+{
+    return lo + (hi - lo) * static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
+}
+
+/// A stack entry of the reference, built with the glh* functions.
+struct Matrix
+{
+    float m[16];
+};
+
+///@return Largest difference between a and b relative to the largest element of b
+static float relativeError(const float* a, const float* b, int n)
+{
+    float largest = 1.e-6f;
+    float err = 0.f;
+    for (int i = 0; i < n; ++i)
+    {
+        largest = std::max(largest, fabsf(b[i]));
+        err = std::max(err, fabsf(a[i] - b[i]));
+    }
+    return err / largest;
+}
+
+static bool isAffine(const float* m)
+{
+    return (m[3] == 0.f) && (m[7] == 0.f) && (m[11] == 0.f) && (m[15] == 1.f);
+}
+
+/// Compare the stack's top, inverse and normal matrix against the reference top.
+static void compareTop(const MatrixStack& stack, const Matrix& ref, float& worstMatrix, float& worstInverse, bool& affine)
+{
+    worstMatrix = std::max(worstMatrix, relativeError(stack.Get(), ref.m, 16));
+    affine = affine && (stack.IsAffine() == isAffine(ref.m));
+
+    float inverse[16];
+    if (!InvertMatrix(inverse, ref.m))
+        return;
+    worstInverse = std::max(worstInverse, relativeError(stack.GetInverse(), inverse, 16));
+
+    float normal[9];
+    for (int col = 0; col < 3; ++col)
+    {
+        for (int row = 0; row < 3; ++row)
+            normal[3*col + row] = inverse[4*row + col];
+    }
+    worstInverse = std::max(worstInverse, relativeError(stack.GetNormalMatrix(), normal, 9));
+}
+
+/// Apply the same random calls to a MatrixStack and to a reference stack of
+/// arrays, checking the tops after every call.
+static void testAgainstGlh()
+{
+    srand(17);
+    float projection[16];
+    glhPerspectivef2(projection, 60.f, 1.5f, .1f, 100.f);
+
+    float worstMatrix = 0.f;
+    float worstInverse = 0.f;
+    bool affine = true;
+    bool depth = true;
+    for (int sequence = 0; sequence < 500; ++sequence)
+    {
+        MatrixStack stack;
+        std::vector<Matrix> ref(1);
+        MakeIdentityMatrix(ref.back().m);
+
+        for (int step = 0; step < 40; ++step)
+        {
+            float* top = ref.back().m;
+            const float x = randomFloat(-2.f, 2.f);
+            const float y = randomFloat(-2.f, 2.f);
+            const float z = randomFloat(-2.f, 2.f);
+            const float degrees = randomFloat(-180.f, 180.f);
+            switch (rand() % 10)
+            {
+            case 0:
+                stack.Translate(x, y, z);
+                glhTranslate(top, x, y, z);
+                break;
+            case 1:
+                stack.Scale(fabsf(x) + .5f, fabsf(y) + .5f, fabsf(z) + .5f);
+                glhScale(top, fabsf(x) + .5f, fabsf(y) + .5f, fabsf(z) + .5f);
+                break;
+            case 2:
+            {
+                // About a coordinate axis either way, taking the in-place path.
+                float axis[3] = { 0.f, 0.f, 0.f };
+                axis[rand() % 3] = (rand() & 1) ? 1.f : -1.f;
+                stack.Rotate(degrees, axis[0], axis[1], axis[2]);
+                glhRotate(top, degrees, axis[0], axis[1], axis[2]);
+                break;
+            }
+            case 3:
+                stack.Rotate(degrees, x, y, z);
+                glhRotate(top, degrees, x, y, z);
+                break;
+            case 4:
+            {
+                float other[16];
+                MakeIdentityMatrix(other);
+                glhRotate(other, degrees, x, y, z);
+                glhTranslate(other, z, x, y);
+                stack.Multiply(other);
+                postMultiply(top, other);
+                break;
+            }
+            case 5:
+                // Rarely, so most sequences stay affine.
+                if (rand() % 4 == 0)
+                {
+                    stack.Multiply(projection);
+                    postMultiply(top, projection);
+                }
+                break;
+            case 6:
+                stack.Push();
+                ref.push_back(ref.back());
+                break;
+            case 7:
+                depth = depth && (stack.Pop() == (ref.size() > 1));
+                if (ref.size() > 1)
+                    ref.pop_back();
+                break;
+            case 8:
+            {
+                float loaded[16];
+                MakeIdentityMatrix(loaded);
+                glhTranslate(loaded, x, y, z);
+                glhRotate(loaded, degrees, z, x, y);
+                stack.Load(loaded);
+                memcpy(top, loaded, sizeof(loaded));
+                break;
+            }
+            default:
+                if (rand() % 4 == 0)
+                {
+                    stack.LoadIdentity();
+                    MakeIdentityMatrix(top);
+                }
+                break;
+            }
+            depth = depth && (stack.GetDepth() == static_cast<int>(ref.size()));
+            compareTop(stack, ref.back(), worstMatrix, worstInverse, affine);
+        }
+    }
+    printf("MatrixStack worst relative error: %.3g matrix, %.3g inverse and normal\n", worstMatrix, worstInverse);
+    check(worstMatrix < 1.e-5f, "MatrixStack matches glhTranslate, glhScale, glhRotate and postMultiply");
+    check(worstInverse < 1.e-3f, "MatrixStack inverse and normal matrix match InvertMatrix");
+    check(affine, "IsAffine follows the last row");
+    check(depth, "Push and Pop track depth; the bottom matrix is never popped");
+}
+
+/// Cached results must be recomputed after every change.
+static void testCaching()
+{
+    MatrixStack stack;
+    stack.Translate(1.f, 2.f, 3.f);
+    const float* pInverse = stack.GetInverse();
+    check(pInverse[12] == -1.f, "inverse of a translation");
+    stack.Scale(2.f, 2.f, 2.f);
+    check(stack.GetInverse()[0] == .5f, "inverse follows a change after being cached");
+    stack.Push();
+    stack.Rotate(90.f, 0.f, 0.f, 1.f);
+    stack.Pop();
+    check(stack.GetInverse()[0] == .5f, "inverse of the popped-to matrix");
+
+    // Pointers stay put while the stack is no deeper than it reserves.
+    const float* pBottom = stack.Get();
+    for (int i = 1; i < 32; ++i)
+        stack.Push();
+    while (stack.Pop()) {}
+    check(stack.Get() == pBottom, "accessor pointers survive pushes to 32 deep");
+
+    const float singular[16] = { 0 };
+    stack.Load(singular);
+    float identity[16];
+    MakeIdentityMatrix(identity);
+    check(memcmp(stack.GetInverse(), identity, sizeof(identity)) == 0, "singular top inverts to the identity");
+}
+
+int main()
+{
+    for (int simdOn = 0; simdOn < 2; ++simdOn)
+    {
+        SetMatrixSimdEnabled(simdOn != 0);
+        testAgainstGlh();
+        testCaching();
+    }
+    SetMatrixSimdEnabled(true);
+    if (s_failures > 0)
+    {
+        printf("%d checks failed.\n", s_failures);
+        return 1;
+    }
+    printf("All matrix stack checks passed.\n");
+    return 0;
+}
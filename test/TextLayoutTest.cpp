@@ -0,0 +1,173 @@
+// TextLayoutTest.cpp
+// Word wrapping never overflows the wrap width, and SetText lays out again only
+// the paragraphs whose text changed, wherever they moved to.
+
+#include "TextLayout.h"
+#include "FontRenderer.h"
+
+#include <stdio.h>
+#include <string>
+
+static int s_failures = 0;
+
+static void check(bool ok, const char* pWhat)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s\n", pWhat);
+        ++s_failures;
+    }
+}
+
+/// Every wrapped line, measured again glyph by glyph, fits the wrap width
+/// unless it is a single glyph, and the lines cover the paragraph in order.
+static void checkLines(const TextLayout& layout, const FontRenderer& font, int wrapWidth)
+{
+    bool fits = true;
+    bool ordered = true;
+    for (size_t p = 0; p < layout.GetParagraphCount(); ++p)
+    {
+        const std::string& text = layout.GetParagraph(p);
+        const std::vector<TextLayout::Line>& lines = layout.GetParagraphLines(p);
+        size_t end = 0;
+        for (size_t i = 0; i < lines.size(); ++i)
+        {
+            const TextLayout::Line& line = lines[i];
+            if (line.begin < end)
+                ordered = false;
+            end = line.begin + line.len;
+            const int width = font.StringLengthPixels(text.c_str() + line.begin, line.len);
+            if ((width > wrapWidth) && (line.len > 1))
+            {
+                printf("  line \"%s\" is %d px\n", text.substr(line.begin, line.len).c_str(), width);
+                fits = false;
+            }
+        }
+        if (end > text.length())
+            ordered = false;
+    }
+    check(fits, "wrapped lines fit the wrap width");
+    check(ordered, "wrapped lines cover each paragraph in order");
+}
+
+static void testWrapping(const FontRenderer& font)
+{
+    const int wrapWidth = 60;
+    TextLayout layout;
+    layout.SetFont(&font);
+    layout.SetWrapWidth(wrapWidth);
+    layout.SetDoKerning(false);
+
+    // After "a " the long word is carried to its own line, and is still too
+    // long for it: it must break again instead of running over.
+    layout.SetText("a supercalifragilisticexpialidocious word\n"
+        "several short words that wrap at spaces\n"
+        "\n"
+        "x");
+    layout.Update();
+    checkLines(layout, font, wrapWidth);
+    check(layout.GetParagraphLines(0).size() >= 3, "a carried long word breaks again");
+    check(layout.GetParagraphLines(2).size() == 1, "an empty paragraph is one line");
+
+    // Line lookup agrees with the per-paragraph lists.
+    bool found = true;
+    int lineIdx = 0;
+    for (size_t p = 0; p < layout.GetParagraphCount(); ++p)
+    {
+        if (layout.GetParagraphFirstLine(p) != lineIdx)
+            found = false;
+        for (size_t i = 0; i < layout.GetParagraphLines(p).size(); ++i, ++lineIdx)
+        {
+            size_t para = 0;
+            size_t line = 0;
+            if (!layout.FindLine(lineIdx, para, line) || (para != p) || (line != i))
+                found = false;
+        }
+    }
+    check(found && (lineIdx == layout.GetLineCount()), "FindLine and GetParagraphFirstLine");
+    size_t para = 0;
+    size_t line = 0;
+    check(!layout.FindLine(layout.GetLineCount(), para, line), "FindLine past the end");
+}
+
+static void testIncremental(const FontRenderer& font)
+{
+    TextLayout layout;
+    layout.SetFont(&font);
+    layout.SetWrapWidth(200);
+
+    std::string text;
+    char buf[128];
+    for (int i = 0; i < 2000; ++i)
+    {
+        sprintf(buf, "    float v%d = texture(tex, uv + vec2(%d.0)).x; // line %d\n", i, i, i);
+        text += buf;
+    }
+    layout.SetText(text);
+    layout.Update();
+    check(layout.GetRelayoutCount() == 2001, "first layout covers every paragraph");
+    const int lines = layout.GetLineCount();
+
+    // One line inserted near the top: only it is laid out.
+    const std::string inserted = "    // a comment near the top\n";
+    const size_t secondLine = text.find('\n') + 1;
+    text.insert(secondLine, inserted);
+    layout.SetText(text);
+    layout.Update();
+    check(layout.GetRelayoutCount() == 1, "insert near the top lays out one paragraph");
+    check(layout.GetParagraphCount() == 2002, "insert adds a paragraph");
+
+    // Edits at both ends: only the two edited lines are laid out.
+    text.replace(0, 4, "\t");
+    text.insert(text.length() - 1, " edited");
+    layout.SetText(text);
+    layout.Update();
+    check(layout.GetRelayoutCount() == 2, "edits at both ends lay out two paragraphs");
+
+    // Removing the inserted line gives back the original layout with nothing laid out.
+    text.erase(secondLine - 3, inserted.length());
+    layout.SetText(text);
+    layout.Update();
+    check(layout.GetRelayoutCount() == 0, "deleting a line lays out nothing");
+    check(layout.GetParagraphCount() == 2001, "delete removes a paragraph");
+    check(layout.GetLineCount() >= lines - 1, "line count follows the text");
+    checkLines(layout, font, 200);
+}
+
+/// StringLengthPixels measures kerned text as layout does, so an unwrapped
+/// line is exactly as wide as the string.
+static void testMeasurement(const FontRenderer& font)
+{
+    const char* const pText = "AVAST, Ye Olde Tavern. To WAVY LTA";
+    TextLayout layout;
+    layout.SetFont(&font);
+    layout.SetWrapWidth(0);
+    layout.SetText(pText);
+    layout.Update();
+    const int laidOut = layout.GetParagraphLines(0)[0].widthPx;
+    const int measured = font.StringLengthPixels(pText);
+    printf("\"%s\" is %d px laid out, %d px measured.\n", pText, laidOut, measured);
+    check(laidOut == measured, "StringLengthPixels matches the laid out width");
+}
+
+int main()
+{
+    FontRenderer font("SegoeUI_13px", 600, false);
+    font.LoadMetrics();
+    if (font.GlyphAdvance('a') <= 0.f)
+    {
+        printf("FAIL: could not load SegoeUI_13px metrics\n");
+        return 1;
+    }
+
+    testWrapping(font);
+    testIncremental(font);
+    testMeasurement(font);
+    if (s_failures > 0)
+    {
+        printf("%d checks failed.\n", s_failures);
+        return 1;
+    }
+    printf("All text layout checks passed.\n");
+    return 0;
+}
@@ -0,0 +1,65 @@
+// UniformLookupBench.cpp
+// Time looking up uniform locations in ShaderWithVariables by name, as draw code
+// used to with a string literal at each call, against by integer handle.
+// The table is filled as reflection would fill it, so no GL context is needed.
+
+#include "ShaderWithVariables.h"
+#include "Timer.h"
+
+#include <stdio.h>
+
+/// Stands in for a linked program with FontRenderer's four uniforms.
+class ReflectedShader : public ShaderWithVariables
+{
+public:
+    ReflectedShader()
+    {
+        m_unis["mvmtx"] = 0;
+        m_unis["prmtx"] = 1;
+        m_unis["s_texture"] = 2;
+        m_unis["u_fontColor"] = 3;
+        resolveHandles();
+    }
+};
+
+static const int s_lookups = 20000000;
+
+int main()
+{
+    ReflectedShader shader;
+    const int handles[] = {
+        shader.GetUniformHandle("mvmtx"),
+        shader.GetUniformHandle("prmtx"),
+        shader.GetUniformHandle("s_texture"),
+        shader.GetUniformHandle("u_fontColor"),
+    };
+
+    long nameSum = 0;
+    Timer timer;
+    for (int i = 0; i < s_lookups; i += 4)
+    {
+        nameSum += shader.GetUniLoc("mvmtx");
+        nameSum += shader.GetUniLoc("prmtx");
+        nameSum += shader.GetUniLoc("s_texture");
+        nameSum += shader.GetUniLoc("u_fontColor");
+    }
+    const double nameTime = timer.seconds();
+
+    long handleSum = 0;
+    timer.reset();
+    for (int i = 0; i < s_lookups; ++i)
+    {
+        handleSum += shader.GetUniLoc(handles[i & 3]);
+    }
+    const double handleTime = timer.seconds();
+
+    printf("%d uniform location lookups:\n", s_lookups);
+    printf("  by name:   %7.1f M/s\n", 1.e-6 * s_lookups / nameTime);
+    printf("  by handle: %7.1f M/s\n", 1.e-6 * s_lookups / handleTime);
+    if ((nameSum != handleSum) || (nameSum != 6L * s_lookups / 4))
+    {
+        printf("FAIL: lookups by name and by handle disagree (%ld, %ld)\n", nameSum, handleSum);
+        return 1;
+    }
+    return 0;
+}
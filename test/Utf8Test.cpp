@@ -0,0 +1,154 @@
+// Utf8Test.cpp
+// Decoding of multibyte UTF-8 by Utf8Iterator, and FontRenderer's measurement
+// of multibyte strings against the same text given as code points.
+
+#include "Utf8Iterator.h"
+#include "FontRenderer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+static int s_failures = 0;
+
+static void check(bool ok, const char* pWhat)
+{
+    if (!ok)
+    {
+        printf("FAIL: %s\n", pWhat);
+        ++s_failures;
+    }
+}
+
+/// Decode len bytes and compare against the expected code points and the
+/// byte offset at which each one starts.
+static void checkDecode(const char* pWhat, const char* pStr, size_t len,
+    const unsigned int* pExpected, const size_t* pOffsets, size_t count)
+{
+    Utf8Iterator it(pStr, len);
+    size_t i = 0;
+    bool ok = true;
+    while (!it.AtEnd())
+    {
+        if (i >= count)
+        {
+            ok = false;
+            break;
+        }
+        if (it.Position() != pStr + pOffsets[i])
+            ok = false;
+        if (it.Next() != pExpected[i])
+            ok = false;
+        ++i;
+    }
+    check(ok && (i == count), pWhat);
+}
+
+static void testIterator()
+{
+    const unsigned int fffd = Utf8Iterator::s_replacementChar;
+    {
+        // A, e acute(2 bytes), katakana a(3 bytes), U+1F600(4 bytes), z
+        const char s[] = "A\xc3\xa9\xe3\x82\xa2\xf0\x9f\x98\x80z";
+        const unsigned int cps[] = { 'A', 0xe9, 0x30a2, 0x1f600, 'z' };
+        const size_t offs[] = { 0, 1, 3, 6, 10 };
+        checkDecode("one of each sequence length", s, strlen(s), cps, offs, 5);
+    }
+    {
+        // Largest code point of each length, and U+10FFFF.
+        const char s[] = "\x7f\xdf\xbf\xef\xbf\xbf\xf4\x8f\xbf\xbf";
+        const unsigned int cps[] = { 0x7f, 0x7ff, 0xffff, 0x10ffff };
+        const size_t offs[] = { 0, 1, 3, 6 };
+        checkDecode("upper bounds", s, strlen(s), cps, offs, 4);
+    }
+    {
+        // Overlong '/' in 2 and 3 bytes: each lead byte and each continuation is replaced.
+        const char s[] = "\xc0\xaf\xe0\x80\xaf";
+        const unsigned int cps[] = { fffd, fffd, fffd, fffd, fffd };
+        const size_t offs[] = { 0, 1, 2, 3, 4 };
+        checkDecode("overlong encodings", s, strlen(s), cps, offs, 5);
+    }
+    {
+        // Encoded surrogate U+D800 and U+110000 are not valid scalar values.
+        const char s[] = "\xed\xa0\x80" "a" "\xf4\x90\x80\x80";
+        const unsigned int cps[] = { fffd, fffd, fffd, 'a', fffd, fffd, fffd, fffd };
+        const size_t offs[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+        checkDecode("surrogates and out of range", s, strlen(s), cps, offs, 8);
+    }
+    {
+        // Stray continuation byte, then a 3 byte sequence cut short by an ASCII byte.
+        const char s[] = "\x80" "b" "\xe3\x82" "c";
+        const unsigned int cps[] = { fffd, 'b', fffd, fffd, 'c' };
+        const size_t offs[] = { 0, 1, 2, 3, 4 };
+        checkDecode("stray and interrupted sequences", s, strlen(s), cps, offs, 5);
+    }
+    {
+        // The length ends mid-sequence: nothing past it is read.
+        const char s[] = "x\xf0\x9f\x98\x80";
+        const unsigned int cps[] = { 'x', fffd, fffd, fffd };
+        const size_t offs[] = { 0, 1, 2, 3 };
+        checkDecode("truncated by length", s, 4, cps, offs, 4);
+    }
+    {
+        // Embedded NUL is a code point like any other when a length is given.
+        const char s[] = "a\0\xc3\xa9";
+        const unsigned int cps[] = { 'a', 0, 0xe9 };
+        const size_t offs[] = { 0, 1, 2 };
+        checkDecode("embedded NUL", s, 4, cps, offs, 3);
+    }
+    {
+        Utf8Iterator it("", static_cast<size_t>(0));
+        check(it.AtEnd(), "empty range");
+    }
+}
+
+/// Measure text given as UTF-8 and as code points, which must agree glyph for glyph.
+static void testFontMeasurement()
+{
+    FontRenderer font("SegoeUI_24px", 600, false);
+    font.LoadFiles();
+    if (font.GetPageCount() == 0)
+    {
+        check(false, "load SegoeUI_24px");
+        return;
+    }
+
+    // e acute and u umlaut are 2 byte sequences, on the font's first page.
+    const char utf8[] = "Caf\xc3\xa9 M\xc3\xbcller";
+    const wchar_t wide[] = { 'C', 'a', 'f', 0xe9, ' ', 'M', 0xfc, 'l', 'l', 'e', 'r', 0 };
+    float pen = 0.f;
+    float right = 0.f;
+    for (size_t i = 0; wide[i] != 0; ++i)
+    {
+        const int kern = (i > 0) ? font.KerningOffset(wide[i-1], wide[i]) : 0;
+        right = std::max(right, pen + static_cast<float>(kern) + font.GlyphAdvance(wide[i]));
+        pen += font.GlyphAdvance(wide[i]);
+    }
+    const int sum = static_cast<int>(right);
+    check(font.GlyphAdvance(0xe9) > 0.f, "font has U+00E9");
+    check(font.StringLengthPixels(utf8) == sum, "UTF-8 length matches kerned advances");
+    check(font.StringLengthPixels(wide) == sum, "wide length matches kerned advances");
+    check(font.StringLengthPixels(utf8, 5) == font.StringLengthPixels("Caf\xc3\xa9"), "length of a byte range");
+
+    // A code point above U+FFFF must not alias the glyph for its low 16 bits.
+    check(font.GlyphAdvance('A') > 0.f, "font has A");
+    check(font.GlyphAdvance(0x10041) == 0.f, "U+10041 is not A");
+    check(font.StringLengthPixels("\xf0\x90\x81\x81") == 0, "U+10041 measures as missing");
+
+    // Malformed bytes measure as U+FFFD would, not as the bytes' values.
+    check(font.StringLengthPixels("\xc3") == static_cast<int>(font.GlyphAdvance(0xfffd)), "lone lead byte");
+    printf("\"%s\" is %d px in SegoeUI_24px.\n", utf8, font.StringLengthPixels(utf8));
+}
+
+int main()
+{
+    testIterator();
+    testFontMeasurement();
+    if (s_failures > 0)
+    {
+        printf("%d checks failed.\n", s_failures);
+        return 1;
+    }
+    printf("All UTF-8 checks passed.\n");
+    return 0;
+}
@@ -18,56 +18,65 @@ def generateSourceFile():
 	autogenDir = "app/src/main/jni/autogen/"
 	sourceFileOut = autogenDir + "g_shaders.h"
 
-	# Write a small comment if no shaders directory.
-	if not os.path.isdir(shaderPath):
-		print("Directory", shaderPath, "does not exist.")
-		with open(sourceFileOut,'w') as outStream:
-			print("/* Directory", shaderPath, "does not exist. */", file=outStream,)
-		return
-
 	# Create autogen/ if it's not there.
 	if not os.path.isdir(autogenDir):
 		os.makedirs(autogenDir)
 
-	print("hardcode_shaders.py writing the following shaders to",autogenDir,":")
-	shaderList = os.listdir(shaderPath)
+	# Write an empty table if no shaders directory.
+	shaderList = []
+	if os.path.isdir(shaderPath):
+		print("hardcode_shaders.py writing the following shaders to",autogenDir,":")
+		shaderList = os.listdir(shaderPath)
+	else:
+		print("Directory", shaderPath, "does not exist.")
 	# filter out some extraneous results: directories, svn files...
 	shaderList = [s for s in shaderList if s != '.svn']
 	shaderList = [s for s in shaderList if not os.path.isdir(shaderPath + s)]
 	for shaderName in shaderList:
 		print("    hardcoding shader:", shaderName)
 
+	# The table is searched by binary search on the name, so it must be sorted
+	# in strcmp order.
+	shaderList = sorted(shaderList)
+
 	tab = "    "
-	decl = "const char* "
 	newline = "\\n"
 	quote = "\""
 
 	with open(sourceFileOut,'w') as outStream:
 		print(header, file=outStream)
-		print("#include <map>", file=outStream)
-		
-		#shaderList = os.listdir(shaderPath)
+		print("#include <stddef.h>", file=outStream)
+
 		for shaderName in shaderList:
 			file = shaderPath + shaderName
+			# Blank lines are kept so compiler messages match the files' line numbers.
 			lines = open(file).read().splitlines()
 			varname = shaderName.replace(".","_")
-			print("\n" + decl + varname + " = ", file=outStream)
+			print("\nstatic const char " + varname + "[] = ", file=outStream)
+			if not lines:
+				print(tab + quote + quote, file=outStream)
 			for l in lines:
-				if l != "":
-					l = l.replace('"', '\\"')
-					print(tab + quote + l + newline + quote, file=outStream)
+				l = l.replace('\\', '\\\\').replace('"', '\\"')
+				print(tab + quote + l + newline + quote, file=outStream)
 			print(";", file=outStream)
 
-		mapvar = "g_shaderMap"
-		print("\n", file=outStream)
-		print("std::map<std::string, std::string> " + mapvar + ";", file=outStream)
 		print("\n", file=outStream)
-
-		print("void initShaderList() {", file=outStream)
+		print("struct EmbeddedShader", file=outStream)
+		print("{", file=outStream)
+		print(tab + "const char* name;", file=outStream)
+		print(tab + "const char* source;", file=outStream)
+		print(tab + "size_t length;", file=outStream)
+		print("};", file=outStream)
+		print("", file=outStream)
+		print("// Sorted by name for binary search.", file=outStream)
+		print("static const EmbeddedShader g_shaderTable[] = {", file=outStream)
 		for fname in shaderList:
 			varname = fname.replace(".","_")
-			print(tab + mapvar + "[\"" + fname + "\"] = " + varname + ";", file=outStream)
-		print("}", file=outStream)
+			print(tab + "{ \"" + fname + "\", " + varname + ", sizeof(" + varname + ") - 1 },", file=outStream)
+		if not shaderList:
+			print(tab + "{ \"\", \"\", 0 },", file=outStream)
+		print("};", file=outStream)
+		print("static const size_t g_shaderCount = " + str(len(shaderList)) + ";", file=outStream)
 
 
 #
@@ -0,0 +1,418 @@
+# raw_to_ktx.py
+# Compresses the app's uncompressed .raw images into ETC2/EAC KTX files.
+#
+# Usage:
+#   python tools/raw_to_ktx.py -W 128 -H 128 -c 3 stone_128x128.raw -o stone_128x128.ktx
+#   python tools/raw_to_ktx.py -W 128 -H 128 -c 3 posx_128.raw negx_128.raw posy_128.raw \
+#       negy_128.raw posz_128.raw negz_128.raw -o cube_128.ktx
+#   python tools/raw_to_ktx.py -W 512 -H 512 -c 1 courier_512_0.raw -o courier_512_0.ktx
+#   python tools/raw_to_ktx.py -W 128 -H 128 -c 3 --mips kaiser stone_128x128.raw -o stone_128x128.ktx
+#
+# 1 channel images become R11_EAC, 3 channel ETC2 RGB8 and 4 channel ETC2 RGBA8,
+# or stay uncompressed with --uncompressed. Six inputs are written as the faces of
+# a cubemap in the order given, which should be +X -X +Y -Y +Z -Z. Color blocks
+# only use the ETC1 modes, so the output also decodes correctly on ETC1-only
+# hardware (as RGB8_ETC2).
+#
+# --mips writes the full mip chain down to 1x1, each level filtered from the one
+# above with a box or Kaiser-windowed sinc filter. Color channels are filtered in
+# linear light, converting from and back to sRGB; alpha and 1 channel images
+# (font coverage) are filtered as they are unless --srgb is given.
+
+from __future__ import print_function
+import sys
+import math
+import struct
+import argparse
+
+GL_UNSIGNED_BYTE = 0x1401
+GL_RED = 0x1903
+GL_RGB = 0x1907
+GL_RGBA = 0x1908
+GL_R8 = 0x8229
+GL_RGB8 = 0x8051
+GL_RGBA8 = 0x8058
+GL_COMPRESSED_R11_EAC = 0x9270
+GL_COMPRESSED_RGB8_ETC2 = 0x9274
+GL_COMPRESSED_RGBA8_ETC2_EAC = 0x9278
+
+KTX_IDENTIFIER = bytearray([0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A])
+
+ETC_MODIFIERS = [
+	[2, 8], [5, 17], [9, 29], [13, 42],
+	[18, 60], [24, 80], [33, 106], [47, 183]]
+
+EAC_MODIFIERS = [
+	[-3, -6, -9, -15, 2, 5, 8, 14],
+	[-3, -7, -10, -13, 2, 6, 9, 12],
+	[-2, -5, -8, -13, 1, 4, 7, 12],
+	[-2, -4, -6, -13, 1, 3, 5, 12],
+	[-3, -6, -8, -12, 2, 5, 7, 11],
+	[-3, -7, -9, -11, 2, 6, 8, 10],
+	[-4, -7, -8, -11, 3, 6, 7, 10],
+	[-3, -5, -8, -11, 2, 4, 7, 10],
+	[-2, -6, -8, -10, 1, 5, 7, 9],
+	[-2, -5, -8, -10, 1, 4, 7, 9],
+	[-2, -4, -8, -10, 1, 3, 7, 9],
+	[-2, -5, -7, -10, 1, 4, 6, 9],
+	[-3, -4, -7, -10, 2, 3, 6, 9],
+	[-1, -2, -3, -10, 0, 1, 2, 9],
+	[-4, -6, -8, -9, 3, 5, 7, 8],
+	[-3, -5, -7, -9, 2, 4, 6, 8]]
+
+
+def clamp(v, lo, hi):
+	return lo if v < lo else (hi if v > hi else v)
+
+
+def getBlock(pixels, width, height, channels, bx, by):
+	"""
+	Return the 16 pixels of a 4x4 block indexed [y*4+x], each a list of
+	channel values. Edge pixels are repeated to fill partial blocks.
+	"""
+	block = []
+	for y in range(4):
+		py = min(by * 4 + y, height - 1)
+		for x in range(4):
+			px = min(bx * 4 + x, width - 1)
+			i = (py * width + px) * channels
+			block.append(list(pixels[i:i + channels]))
+	return block
+
+
+def subblockPixels(flip, sub):
+	"""Pixel coordinates (x, y) in half 'sub' of a block with the given flip."""
+	coords = []
+	for y in range(4):
+		for x in range(4):
+			half = (y // 2) if flip else (x // 2)
+			if half == sub:
+				coords.append((x, y))
+	return coords
+
+
+def fitSubblock(block, coords, base):
+	"""
+	Find the modifier table and per pixel indices that best fit pixels to a
+	base color.
+	@return (error, table, {(x, y): index})
+	"""
+	best = None
+	for table in range(8):
+		small, large = ETC_MODIFIERS[table]
+		# Index order is +small, +large, -small, -large.
+		mods = [small, large, -small, -large]
+		err = 0
+		indices = {}
+		for (x, y) in coords:
+			p = block[y * 4 + x]
+			bestIdx, bestErr = 0, None
+			for idx in range(4):
+				e = 0
+				for c in range(3):
+					d = clamp(base[c] + mods[idx], 0, 255) - p[c]
+					e += d * d
+				if bestErr is None or e < bestErr:
+					bestIdx, bestErr = idx, e
+			indices[(x, y)] = bestIdx
+			err += bestErr
+			if best is not None and err >= best[0]:
+				break
+		if best is None or err < best[0]:
+			best = (err, table, indices)
+	return best
+
+
+def encodeEtcBlock(block):
+	"""Encode 16 RGB pixels as an 8 byte ETC1-mode ETC2 block."""
+	best = None
+	for flip in (0, 1):
+		coords = [subblockPixels(flip, 0), subblockPixels(flip, 1)]
+		averages = []
+		for sub in range(2):
+			avg = [0.0, 0.0, 0.0]
+			for (x, y) in coords[sub]:
+				for c in range(3):
+					avg[c] += block[y * 4 + x][c]
+			averages.append([a / len(coords[sub]) for a in avg])
+
+		# Differential mode if the halves are close enough, otherwise individual.
+		q5 = [[int(round(a * 31.0 / 255.0)) for a in avg] for avg in averages]
+		deltas = [q5[1][c] - q5[0][c] for c in range(3)]
+		if all(-4 <= d <= 3 for d in deltas):
+			diff = 1
+			bases = [[(v << 3) | (v >> 2) for v in q] for q in q5]
+		else:
+			diff = 0
+			q4 = [[int(round(a * 15.0 / 255.0)) for a in avg] for avg in averages]
+			bases = [[(v << 4) | v for v in q] for q in q4]
+
+		fits = [fitSubblock(block, coords[sub], bases[sub]) for sub in range(2)]
+		err = fits[0][0] + fits[1][0]
+		if best is not None and err >= best[0]:
+			continue
+
+		word = 0
+		if diff:
+			for c in range(3):
+				word |= q5[0][c] << (59 - 8 * c)
+				word |= (deltas[c] & 7) << (56 - 8 * c)
+		else:
+			for c in range(3):
+				word |= q4[0][c] << (60 - 8 * c)
+				word |= q4[1][c] << (56 - 8 * c)
+		word |= fits[0][1] << 37
+		word |= fits[1][1] << 34
+		word |= diff << 33
+		word |= flip << 32
+		for sub in range(2):
+			for (x, y), idx in fits[sub][2].items():
+				j = x * 4 + y
+				word |= (idx >> 1) << (j + 16)
+				word |= (idx & 1) << j
+		best = (err, word)
+	return struct.pack('>Q', best[1])
+
+
+def encodeEacBlock(values):
+	"""
+	Encode 16 values in 0..255, indexed [y*4+x], as an 8 byte EAC block. The
+	same block serves as ETC2 alpha and, with values read as 11 bit, R11_EAC.
+	"""
+	lo, hi = min(values), max(values)
+	if lo == hi:
+		# Table 13 has a zero modifier.
+		table, mult, base, indices = 13, 1, lo, [4] * 16
+	else:
+		best = None
+		for table in range(16):
+			mods = EAC_MODIFIERS[table]
+			span = float(mods[7] - mods[3])
+			guess = int(round((hi - lo) / span))
+			for mult in range(max(1, guess - 1), min(15, guess + 1) + 1):
+				base = clamp(int(round((lo + hi) / 2.0 - (mods[7] + mods[3]) * mult / 2.0)), 0, 255)
+				palette = [clamp(base + m * mult, 0, 255) for m in mods]
+				err = 0
+				indices = []
+				for v in values:
+					idx = min(range(8), key=lambda k: abs(palette[k] - v))
+					indices.append(idx)
+					err += (palette[idx] - v) ** 2
+				if best is None or err < best[0]:
+					best = (err, table, mult, base, indices)
+		_, table, mult, base, indices = best
+
+	word = (base << 56) | (mult << 52) | (table << 48)
+	for x in range(4):
+		for y in range(4):
+			j = x * 4 + y
+			word |= indices[y * 4 + x] << (45 - 3 * j)
+	return struct.pack('>Q', word)
+
+
+def srgbToLinear(v):
+	c = v / 255.0
+	return c / 12.92 if c <= 0.04045 else ((c + 0.055) / 1.055) ** 2.4
+
+
+def linearToSrgb(c):
+	c = clamp(c, 0.0, 1.0)
+	s = c * 12.92 if c <= 0.0031308 else 1.055 * c ** (1.0 / 2.4) - 0.055
+	return int(round(s * 255.0))
+
+
+def besselI0(x):
+	"""Zeroth order modified Bessel function of the first kind, by its series."""
+	total, term, k = 1.0, 1.0, 1
+	while term > 1e-12 * total:
+		term *= (x / (2.0 * k)) ** 2
+		total += term
+		k += 1
+	return total
+
+
+def filterWeights(srcSize, dstSize, mipFilter):
+	"""
+	Weights for resampling one axis from srcSize to dstSize pixels.
+	@return for each destination pixel, a list of (source index, weight)
+	"""
+	scale = srcSize / float(dstSize)
+	weights = []
+	for i in range(dstSize):
+		taps = []
+		if mipFilter == 'box':
+			lo, hi = i * scale, (i + 1) * scale
+			for j in range(int(math.floor(lo)), int(math.ceil(hi))):
+				taps.append((j, min(hi, j + 1) - max(lo, j)))
+		else:
+			# Sinc at the new Nyquist frequency, windowed out to two destination pixels.
+			alpha, radius = 4.0, 2.0 * scale
+			center = (i + 0.5) * scale
+			for j in range(int(math.floor(center - radius)), int(math.ceil(center + radius)) + 1):
+				d = (j + 0.5 - center) / scale
+				x = (j + 0.5 - center) / radius
+				if abs(x) >= 1.0:
+					continue
+				sinc = 1.0 if d == 0 else math.sin(math.pi * d) / (math.pi * d)
+				window = besselI0(alpha * math.sqrt(1.0 - x * x)) / besselI0(alpha)
+				taps.append((clamp(j, 0, srcSize - 1), sinc * window))
+		total = sum(w for _, w in taps)
+		weights.append([(j, w / total) for j, w in taps])
+	return weights
+
+
+def downsample(plane, width, height, channels, mipFilter):
+	"""
+	Halve a float image, rounding sizes down but not below 1.
+	@return (plane, width, height)
+	"""
+	newWidth, newHeight = max(1, width // 2), max(1, height // 2)
+	wx = filterWeights(width, newWidth, mipFilter)
+	wy = filterWeights(height, newHeight, mipFilter)
+
+	rows = []
+	for y in range(height):
+		row = []
+		for x in range(newWidth):
+			for c in range(channels):
+				row.append(sum(plane[(y * width + j) * channels + c] * w for j, w in wx[x]))
+		rows.append(row)
+
+	out = []
+	for y in range(newHeight):
+		for i in range(newWidth * channels):
+			out.append(sum(rows[j][i] * w for j, w in wy[y]))
+	return out, newWidth, newHeight
+
+
+def makeMipChain(pixels, width, height, channels, mipFilter, srgb):
+	"""
+	Filter an image down to 1x1 in linear light.
+	@return a list of (pixels, width, height), largest first
+	"""
+	colorChannels = min(channels, 3) if srgb else 0
+	toLinear = [srgbToLinear(v) for v in range(256)]
+	plane = []
+	for i, v in enumerate(pixels):
+		plane.append(toLinear[v] if (i % channels) < colorChannels else v / 255.0)
+
+	levels = [(bytearray(pixels), width, height)]
+	while width > 1 or height > 1:
+		plane, width, height = downsample(plane, width, height, channels, mipFilter)
+		level = bytearray()
+		for i, v in enumerate(plane):
+			if (i % channels) < colorChannels:
+				level.append(linearToSrgb(v))
+			else:
+				level.append(int(round(clamp(v, 0.0, 1.0) * 255.0)))
+		levels.append((level, width, height))
+	return levels
+
+
+def padRows(pixels, width, height, channels):
+	"""Pad uncompressed rows to 4 bytes as KTX requires."""
+	rowBytes = width * channels
+	padding = (4 - rowBytes % 4) % 4
+	if padding == 0:
+		return bytearray(pixels)
+	out = bytearray()
+	for y in range(height):
+		out += pixels[y * rowBytes:(y + 1) * rowBytes] + bytearray(padding)
+	return out
+
+
+def compressImage(pixels, width, height, channels):
+	out = bytearray()
+	for by in range((height + 3) // 4):
+		for bx in range((width + 3) // 4):
+			block = getBlock(pixels, width, height, channels, bx, by)
+			if channels == 1:
+				out += encodeEacBlock([p[0] for p in block])
+			elif channels == 3:
+				out += encodeEtcBlock(block)
+			else:
+				out += encodeEacBlock([p[3] for p in block])
+				out += encodeEtcBlock(block)
+	return out
+
+
+def writeKtx(filename, levels, width, height, channels, compressed):
+	"""
+	Write a KTX file. levels holds one list of images per mip level, largest
+	first, with one image per cubemap face.
+	"""
+	internalFormat, baseFormat = {
+		1: (GL_COMPRESSED_R11_EAC, GL_RED),
+		3: (GL_COMPRESSED_RGB8_ETC2, GL_RGB),
+		4: (GL_COMPRESSED_RGBA8_ETC2_EAC, GL_RGBA)}[channels]
+	glType, glFormat = 0, 0
+	if not compressed:
+		internalFormat = {1: GL_R8, 3: GL_RGB8, 4: GL_RGBA8}[channels]
+		glType, glFormat = GL_UNSIGNED_BYTE, baseFormat
+	with open(filename, 'wb') as outStream:
+		outStream.write(KTX_IDENTIFIER)
+		outStream.write(struct.pack('<13I',
+			0x04030201,
+			glType, 1, glFormat, # glType, glTypeSize, glFormat
+			internalFormat, baseFormat,
+			width, height, 0,    # pixelDepth
+			0,                   # numberOfArrayElements
+			len(levels[0]),      # numberOfFaces
+			len(levels),         # numberOfMipmapLevels
+			0))                  # bytesOfKeyValueData
+		for faces in levels:
+			outStream.write(struct.pack('<I', len(faces[0])))
+			for image in faces:
+				outStream.write(image)
+				# Cube faces and levels are padded to 4 bytes.
+				outStream.write(bytearray((4 - len(image) % 4) % 4))
+
+
+#
+# Main: enter here
+#
+def main(argv=None):
+	parser = argparse.ArgumentParser(description='Compress .raw images to ETC2/EAC KTX files.')
+	parser.add_argument('inputs', nargs='+', help='one .raw file, or six cubemap faces')
+	parser.add_argument('-W', '--width', type=int, required=True)
+	parser.add_argument('-H', '--height', type=int, required=True)
+	parser.add_argument('-c', '--channels', type=int, default=3, choices=[1, 3, 4])
+	parser.add_argument('-o', '--output', required=True)
+	parser.add_argument('--mips', choices=['box', 'kaiser'], help='write a full mip chain made with this filter')
+	parser.add_argument('--srgb', action='store_true', help='filter 1 channel images as sRGB too')
+	parser.add_argument('--linear', action='store_true', help='filter color as it is, not as sRGB')
+	parser.add_argument('--uncompressed', action='store_true', help='write 8 bit pixels instead of ETC2/EAC')
+	args = parser.parse_args(argv)
+
+	if len(args.inputs) not in (1, 6):
+		print("Give one image or six cubemap faces.")
+		return 1
+
+	srgb = (args.channels > 1 or args.srgb) and not args.linear
+	levels = []
+	for filename in args.inputs:
+		pixels = bytearray(open(filename, 'rb').read())
+		expected = args.width * args.height * args.channels
+		if len(pixels) < expected:
+			print(filename, "has", len(pixels), "bytes, expected", expected)
+			return 1
+		print("Converting", filename)
+		chain = [(pixels[:expected], args.width, args.height)]
+		if args.mips:
+			chain = makeMipChain(pixels[:expected], args.width, args.height, args.channels, args.mips, srgb)
+		for i, (image, w, h) in enumerate(chain):
+			if args.uncompressed:
+				data = padRows(image, w, h, args.channels)
+			else:
+				data = compressImage(image, w, h, args.channels)
+			if i == len(levels):
+				levels.append([])
+			levels[i].append(data)
+
+	writeKtx(args.output, levels, args.width, args.height, args.channels, not args.uncompressed)
+	print("Wrote", args.output)
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())